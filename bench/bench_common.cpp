@@ -0,0 +1,49 @@
+#include "bench_common.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+std::atomic<std::size_t> g_allocations{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+std::size_t bench_allocations() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void print_stage(const char* stage, const BenchResult& result, double work_per_pass, const char* unit) {
+    const double passes = static_cast<double>(result.iterations);
+    double rate = result.seconds > 0.0 ? work_per_pass * passes / result.seconds : 0.0;
+    if (std::strcmp(unit, "MB/s") == 0) {
+        rate /= 1024.0 * 1024.0;
+    }
+    std::printf(
+        "%-30s %11.1f %-9s %9.3f ms/pass %12.1f allocs/pass\n",
+        stage,
+        rate,
+        unit,
+        result.seconds * 1000.0 / passes,
+        static_cast<double>(result.allocations) / passes
+    );
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+/// Heap allocations so far: every call of the replacement `operator new` in bench_common.cpp.
+std::size_t bench_allocations();
+
+struct BenchResult {
+    double seconds = 0.0;
+    std::size_t allocations = 0;
+    std::size_t iterations = 0;
+};
+
+/// One warm-up call (static tables, arena blocks, vector capacity), then `iterations` timed calls.
+template <typename Fn>
+BenchResult run_passes(std::size_t iterations, Fn&& fn) {
+    fn();
+    const std::size_t alloc_before = bench_allocations();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    BenchResult result;
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.allocations = bench_allocations() - alloc_before;
+    result.iterations = iterations;
+    return result;
+}
+
+/// One table row: throughput of `work_per_pass` (bytes when `unit` is "MB/s", items otherwise), ms and
+/// allocations per pass.
+void print_stage(const char* stage, const BenchResult& result, double work_per_pass, const char* unit);
@@ -0,0 +1,187 @@
+// Segment extraction: the previous std::string/unordered_set extraction vs. collect_tei_segments(), both on the
+// same parsed DOMs, so the rows measure extraction only.
+
+#include "bench_stages.hpp"
+
+#include "bench_common.hpp"
+
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <pugixml.hpp>
+
+namespace {
+
+// ---- previous extraction (kept verbatim as the "before" baseline) ----
+
+struct LegacySegment {
+    std::size_t index = 0;
+    std::string id;
+    std::string source_zh;
+};
+
+std::string legacy_local_name(const char* raw_name) {
+    if (raw_name == nullptr) {
+        return {};
+    }
+    std::string name(raw_name);
+    const auto pos = name.find(':');
+    if (pos == std::string::npos) {
+        return name;
+    }
+    return name.substr(pos + 1);
+}
+
+bool legacy_is_translatable_tag(const std::string& name) {
+    static const std::unordered_set<std::string> tags = {"p", "l", "ab", "head", "seg"};
+    return tags.contains(name);
+}
+
+bool legacy_should_skip_text_subtree(const std::string& name) {
+    static const std::unordered_set<std::string> skip_tags = {
+        "note", "pb", "lb", "cb", "fw", "ref", "anchor", "milestone"
+    };
+    return skip_tags.contains(name);
+}
+
+std::string legacy_normalize_whitespace(const std::string& input) {
+    std::string out;
+    out.reserve(input.size());
+    bool in_space = false;
+
+    for (unsigned char ch : input) {
+        if (std::isspace(ch)) {
+            if (!in_space) {
+                out.push_back(' ');
+                in_space = true;
+            }
+        } else {
+            out.push_back(static_cast<char>(ch));
+            in_space = false;
+        }
+    }
+
+    while (!out.empty() && out.front() == ' ') {
+        out.erase(out.begin());
+    }
+    while (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+
+    return out;
+}
+
+void legacy_collect_text(const pugi::xml_node& node, std::string& out) {
+    if (node.type() == pugi::node_pcdata || node.type() == pugi::node_cdata) {
+        out.append(node.value());
+        out.push_back(' ');
+        return;
+    }
+
+    if (node.type() != pugi::node_element) {
+        return;
+    }
+
+    const auto name = legacy_local_name(node.name());
+    if (legacy_should_skip_text_subtree(name)) {
+        return;
+    }
+
+    for (const auto& child : node.children()) {
+        legacy_collect_text(child, out);
+    }
+}
+
+std::string legacy_node_id_or_fallback(const pugi::xml_node& node, std::size_t index) {
+    if (const auto attr = node.attribute("xml:id")) {
+        return attr.value();
+    }
+    if (const auto attr = node.attribute("id")) {
+        return attr.value();
+    }
+
+    std::ostringstream oss;
+    oss << "seg-" << index;
+    return oss.str();
+}
+
+void legacy_collect_segments(
+    const pugi::xml_node& node,
+    bool in_header,
+    bool in_body,
+    std::vector<LegacySegment>& out
+) {
+    if (node.type() != pugi::node_element) {
+        return;
+    }
+
+    const auto name = legacy_local_name(node.name());
+    const bool now_in_header = in_header || name == "teiHeader";
+    const bool now_in_body = in_body || name == "body";
+
+    if (now_in_header) {
+        for (const auto& child : node.children()) {
+            legacy_collect_segments(child, now_in_header, now_in_body, out);
+        }
+        return;
+    }
+
+    if (now_in_body && legacy_is_translatable_tag(name)) {
+        std::string raw_text;
+        legacy_collect_text(node, raw_text);
+        const std::string normalized = legacy_normalize_whitespace(raw_text);
+
+        if (!normalized.empty()) {
+            LegacySegment segment;
+            segment.index = out.size();
+            segment.id = legacy_node_id_or_fallback(node, segment.index);
+            segment.source_zh = normalized;
+            out.push_back(std::move(segment));
+        }
+        return;
+    }
+
+    for (const auto& child : node.children()) {
+        legacy_collect_segments(child, now_in_header, now_in_body, out);
+    }
+}
+
+}  // namespace
+
+bool bench_extract(BenchCorpus& corpus, std::size_t iterations, std::string& error) {
+    std::vector<std::vector<LegacySegment>> legacy(corpus.docs.size());
+    const BenchResult before = run_passes(iterations, [&]() {
+        for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+            legacy[d].clear();
+            legacy_collect_segments(corpus.docs[d].xml.document_element(), false, false, legacy[d]);
+        }
+    });
+    const BenchResult after = run_passes(iterations, [&]() {
+        for (auto& doc : corpus.docs) {
+            collect_tei_segments(doc);
+        }
+    });
+
+    for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+        const auto& segments = corpus.docs[d].segments;
+        if (legacy[d].size() != segments.size()) {
+            error = "segment count mismatch in " + corpus.docs[d].source_path.string() + ": legacy="
+                + std::to_string(legacy[d].size()) + " arena=" + std::to_string(segments.size());
+            return false;
+        }
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            if (legacy[d][i].id != segments[i].id || legacy[d][i].source_zh != segments[i].source_zh) {
+                error = "segment " + std::to_string(i) + " of " + corpus.docs[d].source_path.string()
+                    + " differs between legacy and arena extraction";
+                return false;
+            }
+        }
+    }
+
+    print_stage("extract (legacy)", before, static_cast<double>(corpus.bytes), "MB/s");
+    print_stage("collect_tei_segments", after, static_cast<double>(corpus.bytes), "MB/s");
+    return true;
+}
@@ -0,0 +1,146 @@
+// Throughput and heap allocations per pass of the pipeline stages that run without a model.
+//
+//   tei_mt_bench [--input file.xml|dir] [--metadata json] [--files N] [--blocks N] [--seed N] [--iterations N]
+//                [--keep dir]
+//   tei_mt_bench generate --output dir [--files N] [--blocks N] [--seed N]
+//
+// Without --input a synthetic CBETA-like corpus (see synthetic_corpus.hpp) is generated into a temporary directory,
+// or into --keep, which is left in place for later runs. `generate` only writes the corpus and its metadata JSON.
+
+#include "bench_stages.hpp"
+#include "synthetic_corpus.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void print_usage() {
+    std::cerr << "Usage: tei_mt_bench [--input file.xml|dir] [--metadata json] [--files N] [--blocks N] [--seed N]\n"
+                 "                    [--iterations N] [--keep dir]\n"
+                 "       tei_mt_bench generate --output dir [--files N] [--blocks N] [--seed N]\n";
+}
+
+bool collect_xml_files(const std::filesystem::path& input, BenchCorpus& corpus, std::string& error) {
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(input, ec)) {
+        corpus.root = input.parent_path();
+        corpus.files.push_back(input);
+        return true;
+    }
+    corpus.root = input;
+    for (auto it = std::filesystem::recursive_directory_iterator(input, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator();
+         it.increment(ec)) {
+        if (it->is_regular_file() && it->path().extension() == ".xml") {
+            corpus.files.push_back(it->path());
+        }
+    }
+    std::sort(corpus.files.begin(), corpus.files.end());
+    if (corpus.files.empty()) {
+        error = "no XML files under " + input.string();
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const bool generate_only = argc > 1 && std::string(argv[1]) == "generate";
+    std::filesystem::path input;
+    std::filesystem::path keep_dir;
+    std::filesystem::path metadata;
+    SyntheticCorpusOptions options;
+    std::size_t iterations = 20;
+
+    for (int i = generate_only ? 2 : 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc) {
+            input = argv[++i];
+        } else if ((arg == "--keep" || arg == "--output") && i + 1 < argc) {
+            keep_dir = argv[++i];
+        } else if (arg == "--metadata" && i + 1 < argc) {
+            metadata = argv[++i];
+        } else if (arg == "--files" && i + 1 < argc) {
+            options.files = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--blocks" && i + 1 < argc) {
+            options.median_blocks = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            print_usage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    if (generate_only && keep_dir.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    std::string error;
+    BenchCorpus corpus;
+    const bool synthetic = input.empty();
+    const auto scratch = keep_dir.empty()
+        ? std::filesystem::temp_directory_path()
+            / ("tei_mt_bench-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()))
+        : keep_dir;
+    if (synthetic) {
+        corpus.root = scratch / "xml-p5";
+        if (!write_synthetic_corpus(corpus.root, options, corpus.files, corpus.metadata_json, error)) {
+            std::cerr << "Failed to generate corpus: " << error << "\n";
+            return 1;
+        }
+        if (generate_only) {
+            std::printf("wrote %zu documents and %s\n", corpus.files.size(), corpus.metadata_json.string().c_str());
+            return 0;
+        }
+    } else if (!collect_xml_files(input, corpus, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    if (!metadata.empty()) {
+        corpus.metadata_json = metadata;
+    }
+    for (const auto& file : corpus.files) {
+        std::error_code ec;
+        corpus.bytes += static_cast<std::size_t>(std::filesystem::file_size(file, ec));
+    }
+
+    bool ok = bench_read(corpus, iterations, error);
+    if (ok) {
+        std::size_t segments = 0;
+        for (const auto& doc : corpus.docs) {
+            segments += doc.segments.size();
+        }
+        std::printf(
+            "corpus: %s, %zu files, %.2f MiB, %zu segments, %zu iterations\n",
+            synthetic ? "synthetic" : input.string().c_str(),
+            corpus.files.size(),
+            static_cast<double>(corpus.bytes) / (1024.0 * 1024.0),
+            segments,
+            iterations
+        );
+        ok = bench_extract(corpus, iterations, error) && bench_normalize(corpus, iterations, error)
+            && bench_coalesce(corpus, iterations, error) && bench_write(corpus, scratch / "out", iterations, error)
+            && bench_sorting(corpus, iterations, error);
+    }
+
+    std::error_code ec;
+    if (keep_dir.empty()) {
+        std::filesystem::remove_all(scratch, ec);
+    } else {
+        std::filesystem::remove_all(scratch / "out", ec);
+    }
+    if (!ok) {
+        std::cerr << "Benchmark failed: " << error << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Pipeline stages around inference: reading, text normalization, coalescing, note output and metadata matching.
+
+#include "bench_stages.hpp"
+
+#include "bench_common.hpp"
+#include "segment_batch.hpp"
+#include "sorting_filter.hpp"
+#include "text_arena.hpp"
+#include "writer_tei.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+
+namespace {
+
+/// English of about the same byte length as `zh` (what the model returns for a passage, give or take).
+std::string fake_english(std::string_view zh) {
+    static const std::string kSentence =
+        "Thus have I heard. At one time the Buddha was dwelling at Sravasti, in the Jeta Grove, together with a "
+        "great assembly of monks, and the World-Honored One addressed them, saying: all conditioned things are "
+        "impermanent. ";
+    std::string out;
+    out.reserve(zh.size());
+    while (out.size() < zh.size()) {
+        out.append(kSentence, 0, std::min(kSentence.size(), zh.size() - out.size()));
+    }
+    return out.empty() ? std::string("(empty)") : out;
+}
+
+void collect_raw_text(const pugi::xml_node& node, std::vector<std::string_view>& out) {
+    if (node.type() == pugi::node_pcdata || node.type() == pugi::node_cdata) {
+        out.emplace_back(node.value());
+        return;
+    }
+    for (const auto& child : node.children()) {
+        collect_raw_text(child, out);
+    }
+}
+
+}  // namespace
+
+bool bench_read(BenchCorpus& corpus, std::size_t iterations, std::string& error) {
+    bool ok = true;
+    const BenchResult result = run_passes(iterations, [&]() {
+        for (const auto& file : corpus.files) {
+            TeiDocument doc;
+            ok = read_tei_file(file, doc, error) && ok;
+        }
+    });
+    if (!ok) {
+        return false;
+    }
+    print_stage("read_tei_file", result, static_cast<double>(corpus.bytes), "MB/s");
+
+    corpus.docs.clear();
+    for (const auto& file : corpus.files) {
+        if (!read_tei_file(file, corpus.docs.emplace_back(), error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool bench_normalize(BenchCorpus& corpus, std::size_t iterations, std::string&) {
+    // The raw text nodes under each segment element, as the reader feeds them to the builder.
+    std::vector<std::vector<std::string_view>> pieces;
+    std::size_t raw_bytes = 0;
+    for (const auto& doc : corpus.docs) {
+        for (const auto& node : doc.segment_nodes) {
+            auto& group = pieces.emplace_back();
+            collect_raw_text(node, group);
+            for (const auto piece : group) {
+                raw_bytes += piece.size();
+            }
+        }
+    }
+
+    TextArena arena;
+    const BenchResult result = run_passes(iterations, [&]() {
+        arena.clear();
+        for (const auto& group : pieces) {
+            NormalizedTextBuilder text(arena);
+            for (const auto piece : group) {
+                text.append(piece);
+                text.separator();
+            }
+            text.finish();
+        }
+    });
+    print_stage("normalize (NormalizedText)", result, static_cast<double>(raw_bytes), "MB/s");
+    return true;
+}
+
+bool bench_coalesce(BenchCorpus& corpus, std::size_t iterations, std::string& error) {
+    const CoalesceParams params;
+    std::size_t segments = 0;
+    std::vector<std::vector<TranslationWorkUnit>> units(corpus.docs.size());
+    const BenchResult build = run_passes(iterations, [&]() {
+        for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+            units[d] = build_translation_work_units(corpus.docs[d].segments, params);
+        }
+    });
+    for (const auto& doc : corpus.docs) {
+        segments += doc.segments.size();
+    }
+    print_stage("build_translation_work_units", build, static_cast<double>(segments), "seg/s");
+
+    std::size_t merged_bytes = 0;
+    std::vector<std::string> responses;
+    std::vector<std::size_t> response_parts;
+    const std::string delim = std::string("\n") + k_coalesce_marker + "\n";
+    for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+        for (const auto& unit : units[d]) {
+            if (unit.segment_indices.size() < 2) {
+                continue;
+            }
+            merged_bytes += merge_source_zh(corpus.docs[d].segments, unit.segment_indices).size();
+            std::string response;
+            for (const std::size_t i : unit.segment_indices) {
+                response += (response.empty() ? "" : delim) + fake_english(corpus.docs[d].segments[i].source_zh);
+            }
+            responses.push_back(std::move(response));
+            response_parts.push_back(unit.segment_indices.size());
+        }
+    }
+
+    const BenchResult merge = run_passes(iterations, [&]() {
+        for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+            for (const auto& unit : units[d]) {
+                if (unit.segment_indices.size() >= 2) {
+                    const std::string merged = merge_source_zh(corpus.docs[d].segments, unit.segment_indices);
+                    (void)merged;
+                }
+            }
+        }
+    });
+    print_stage("merge_source_zh", merge, static_cast<double>(merged_bytes), "MB/s");
+
+    std::size_t response_bytes = 0;
+    for (std::size_t r = 0; r < responses.size(); ++r) {
+        response_bytes += responses[r].size();
+        if (split_coalesced_english(responses[r], response_parts[r]).size() != response_parts[r]) {
+            error = "split_coalesced_english did not recover " + std::to_string(response_parts[r]) + " parts";
+            return false;
+        }
+    }
+    const BenchResult split = run_passes(iterations, [&]() {
+        for (std::size_t r = 0; r < responses.size(); ++r) {
+            const auto parts = split_coalesced_english(responses[r], response_parts[r]);
+            (void)parts;
+        }
+    });
+    print_stage("split_coalesced_english", split, static_cast<double>(response_bytes), "MB/s");
+    return true;
+}
+
+bool bench_write(BenchCorpus& corpus, const std::filesystem::path& out_dir, std::size_t iterations, std::string& error) {
+    std::vector<std::vector<std::string>> translations(corpus.docs.size());
+    std::size_t spliced = 0;
+    for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+        for (const auto& segment : corpus.docs[d].segments) {
+            translations[d].push_back(fake_english(segment.source_zh));
+        }
+        spliced += corpus.docs[d].note_sites.empty() ? 0 : 1;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(out_dir, ec);
+    bool ok = true;
+    const BenchResult result = run_passes(iterations, [&]() {
+        for (std::size_t d = 0; d < corpus.docs.size(); ++d) {
+            const auto out_path = out_dir / ("out" + std::to_string(d) + ".xml");
+            ok = write_tei_note_output(out_path, corpus.docs[d], translations[d], false, error) && ok;
+        }
+    });
+    if (!ok) {
+        return false;
+    }
+    print_stage("write_tei_note_output", result, static_cast<double>(corpus.bytes), "MB/s");
+    if (spliced != corpus.docs.size()) {
+        std::printf("  (%zu of %zu documents used the DOM fallback writer)\n", corpus.docs.size() - spliced, corpus.docs.size());
+    }
+    return true;
+}
+
+bool bench_sorting(BenchCorpus& corpus, std::size_t iterations, std::string& error) {
+    if (corpus.metadata_json.empty()) {
+        return true;
+    }
+    const std::filesystem::path snapshot = corpus.metadata_json.string() + ".tmidx";
+
+    SortingMetadataIndex metadata;
+    bool ok = true;
+    const BenchResult from_json = run_passes(iterations, [&]() {
+        std::error_code ec;
+        std::filesystem::remove(snapshot, ec);
+        ok = metadata.load(corpus.metadata_json, error) && !metadata.loaded_from_snapshot() && ok;
+    });
+    if (!ok) {
+        error = error.empty() ? "metadata load unexpectedly used the snapshot" : error;
+        return false;
+    }
+    print_stage("SortingMetadataIndex (json)", from_json, static_cast<double>(metadata.record_count()), "rec/s");
+
+    const BenchResult from_snapshot = run_passes(iterations, [&]() {
+        ok = metadata.load(corpus.metadata_json, error) && metadata.loaded_from_snapshot() && ok;
+    });
+    if (!ok) {
+        error = error.empty() ? "metadata snapshot was not reused" : error;
+        return false;
+    }
+    print_stage("SortingMetadataIndex (snapshot)", from_snapshot, static_cast<double>(metadata.record_count()), "rec/s");
+
+    const double files = static_cast<double>(corpus.files.size());
+    const BenchResult bind = run_passes(iterations, [&]() {
+        const SortingFileIndex index(metadata, corpus.files, corpus.root, true);
+        (void)index;
+    });
+    print_stage("SortingFileIndex (match)", bind, files, "file/s");
+
+    const SortingFileIndex index(metadata, corpus.files, corpus.root, true);
+    SortingFilters filters;
+    filters.period = {"Tang", "Song"};
+    filters.tradition = {"Chan/Zen"};
+    std::size_t selected = 0;
+    const BenchResult select = run_passes(iterations, [&]() { selected = index.select(filters).count(); });
+    print_stage("SortingFileIndex::select", select, files, "file/s");
+    std::printf(
+        "  (%zu of %zu files have metadata, %zu match period=Tang|Song tradition=Chan/Zen)\n",
+        index.with_metadata().count(),
+        corpus.files.size(),
+        selected
+    );
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "tei_reader.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct BenchCorpus {
+    std::filesystem::path root;
+    std::vector<std::filesystem::path> files;
+    /// Sorting metadata JSON for the files (empty: the sorting stages are skipped).
+    std::filesystem::path metadata_json;
+    std::size_t bytes = 0;
+    /// Every file read once; the later stages run on these.
+    std::deque<TeiDocument> docs;
+};
+
+/// Each stage prints its rows and returns false only if its output failed a sanity check.
+bool bench_read(BenchCorpus& corpus, std::size_t iterations, std::string& error);
+bool bench_extract(BenchCorpus& corpus, std::size_t iterations, std::string& error);
+bool bench_normalize(BenchCorpus& corpus, std::size_t iterations, std::string& error);
+bool bench_coalesce(BenchCorpus& corpus, std::size_t iterations, std::string& error);
+bool bench_write(BenchCorpus& corpus, const std::filesystem::path& out_dir, std::size_t iterations, std::string& error);
+bool bench_sorting(BenchCorpus& corpus, std::size_t iterations, std::string& error);
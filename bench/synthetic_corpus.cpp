@@ -0,0 +1,218 @@
+#include "synthetic_corpus.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+constexpr std::array<const char*, 16> kPhrases = {
+    "如是我聞", "一時佛在舍衛國", "祇樹給孤獨園", "與大比丘眾千二百五十人俱", "爾時世尊", "告諸比丘",
+    "汝等當知", "諸行無常", "是生滅法", "生滅滅已", "寂滅為樂", "菩薩摩訶薩", "般若波羅蜜多",
+    "善男子善女人", "應無所住而生其心", "一切有為法",
+};
+
+constexpr std::array<const char*, 24> kChars = {
+    "心", "佛", "法", "僧", "空", "性", "相", "因", "緣", "道", "智", "慧", "色", "受", "想", "行",
+    "識", "眾", "生", "滅", "無", "有", "即", "是",
+};
+
+constexpr std::array<const char*, 6> kPeriods = {"Tang", "Song", "Northern Wei", "Eastern Jin", "Ming", "Unknown Period"};
+constexpr std::array<const char*, 5> kOrigins = {"India", "China", "Central Asia", "Japan", "Unknown Origin"};
+constexpr std::array<const char*, 6> kTraditions = {"Chan/Zen", "Pure Land", "Tiantai", "Huayan", "Madhyamaka", "Yogacara"};
+
+/// CBETA line ids: page, column (a-c) and line within the column.
+std::string line_id(std::size_t page, std::size_t line) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%04zu%c%02zu", page, static_cast<char>('a' + (line / 29) % 3), line % 29 + 1);
+    return buf;
+}
+
+struct DocumentWriter {
+    std::mt19937& rng;
+    std::string xml;
+    std::string id;
+    std::size_t page = 1;
+    std::size_t line = 0;
+    std::size_t notes = 0;
+
+    bool chance(double p) { return std::bernoulli_distribution(p)(rng); }
+    std::size_t pick(std::size_t n) { return std::uniform_int_distribution<std::size_t>(0, n - 1)(rng); }
+
+    void lb() {
+        if (++line == 87) {
+            line = 0;
+            ++page;
+            xml += "<pb ed=\"T\" xml:id=\"" + id + "." + std::to_string(page) + "a\" n=\"" + std::to_string(page) + "a\"/>";
+        }
+        xml += "<lb n=\"" + line_id(page, line) + "\" ed=\"T\"/>";
+    }
+
+    /// Roughly `chars` CJK characters: phrases and single characters, punctuated, with milestone and note noise.
+    void text(std::size_t chars, bool allow_lb) {
+        std::size_t since_lb = 0;
+        for (std::size_t written = 0; written < chars;) {
+            const bool phrase = chance(0.6);
+            const char* piece = phrase ? kPhrases[pick(kPhrases.size())] : kChars[pick(kChars.size())];
+            xml += piece;
+            const std::size_t n = std::char_traits<char>::length(piece) / 3;
+            written += n;
+            since_lb += n;
+            if (chance(0.02)) {
+                xml += "<g ref=\"#CB0" + std::to_string(1000 + pick(9000)) + "\"/>";
+            }
+            if (chance(0.3)) {
+                xml += chance(0.5) ? "，" : "。";
+            }
+            if (chance(0.04)) {
+                ++notes;
+                xml += chance(0.5)
+                    ? "<note n=\"" + line_id(page, line) + "\" resp=\"Taisho\" type=\"orig\" place=\"foot text\">"
+                          + std::string(kPhrases[pick(kPhrases.size())]) + "【宋】【元】【明】</note>"
+                    : "<note place=\"inline\">" + std::string(kChars[pick(kChars.size())]) + "</note>";
+            }
+            if (allow_lb && since_lb >= 17) {
+                since_lb = 0;
+                xml += chance(0.3) ? "\n" : "";
+                lb();
+            }
+        }
+    }
+
+    /// Prose length in characters: log-normal around ~70 with a long tail of multi-page paragraphs.
+    std::size_t paragraph_chars() {
+        const double chars = std::lognormal_distribution<double>(std::log(70.0), 0.9)(rng);
+        return std::clamp<std::size_t>(static_cast<std::size_t>(chars), 4, 6000);
+    }
+
+    void paragraph(std::size_t index) {
+        xml += "<p xml:id=\"p" + id + "_" + std::to_string(index) + "\">";
+        lb();
+        text(paragraph_chars(), true);
+        xml += "</p>\n";
+    }
+
+    void verse(std::size_t index) {
+        static constexpr std::array<std::size_t, 3> kLineChars = {4, 5, 7};
+        const std::size_t per_line = kLineChars[pick(kLineChars.size())];
+        const std::size_t lines = 2 + 2 * pick(6);
+        xml += "<lg xml:id=\"lg" + id + "_" + std::to_string(index) + "\" type=\"regular\">";
+        for (std::size_t l = 0; l < lines; ++l) {
+            if (l % 2 == 0) {
+                lb();
+            }
+            xml += "<l>";
+            for (std::size_t c = 0; c < per_line; ++c) {
+                xml += kChars[pick(kChars.size())];
+            }
+            xml += l % 2 == 0 ? "，" : "。";
+            xml += "</l>";
+        }
+        xml += "</lg>\n";
+    }
+};
+
+}  // namespace
+
+std::string synthetic_cbeta_document(std::mt19937& rng, std::size_t blocks, const std::string& xml_id) {
+    DocumentWriter w{.rng = rng, .xml = {}, .id = xml_id};
+    w.xml.reserve(blocks * 300 + 4096);
+    w.xml += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+             "<TEI xmlns=\"http://www.tei-c.org/ns/1.0\" xmlns:cb=\"http://www.cbeta.org/ns/1.0\" xml:id=\"" + xml_id
+        + "\">\n<teiHeader><fileDesc><titleStmt><title>Synthetic sutra " + xml_id + "</title></titleStmt>"
+          "<publicationStmt><p>generated for tei_mt_bench</p></publicationStmt></fileDesc>"
+          "<encodingDesc><p>CBETA-like test data</p></encodingDesc></teiHeader>\n<text><body>\n";
+    w.xml += "<pb ed=\"T\" xml:id=\"" + xml_id + ".1a\" n=\"0001a\"/>";
+
+    // A juan holds 1-3 levels of cb:div; each starts with a head (and sometimes a byline, which is not translated).
+    std::size_t block = 0;
+    for (std::size_t juan = 1; block < blocks; ++juan) {
+        w.xml += "<cb:juan fun=\"open\" n=\"" + std::to_string(juan) + "\"><cb:jhead>卷第" + std::to_string(juan)
+            + "</cb:jhead></cb:juan>\n";
+        const std::size_t juan_blocks = std::min(blocks - block, 40 + w.pick(160));
+        const std::size_t depth = 1 + w.pick(3);
+        for (std::size_t d = 0; d < depth; ++d) {
+            w.xml += "<cb:div type=\"" + std::string(d == 0 ? "jing" : "pin") + "\">";
+            w.lb();
+            w.xml += "<head>";
+            w.text(4 + w.pick(12), false);
+            w.xml += "</head>\n";
+        }
+        if (w.chance(0.5)) {
+            w.xml += "<byline cb:type=\"Translator\">";
+            w.text(8, false);
+            w.xml += "</byline>\n";
+        }
+        for (std::size_t i = 0; i < juan_blocks; ++i, ++block) {
+            if (w.chance(0.2)) {
+                w.verse(block);
+            } else {
+                w.paragraph(block);
+            }
+        }
+        for (std::size_t d = 0; d < depth; ++d) {
+            w.xml += "</cb:div>\n";
+        }
+        w.xml += "<cb:juan fun=\"close\" n=\"" + std::to_string(juan) + "\"/>\n";
+    }
+    w.xml += "</body></text>\n</TEI>\n";
+    return std::move(w.xml);
+}
+
+bool write_synthetic_corpus(
+    const std::filesystem::path& dir,
+    const SyntheticCorpusOptions& options,
+    std::vector<std::filesystem::path>& out_files,
+    std::filesystem::path& out_metadata_json,
+    std::string& error
+) {
+    std::mt19937 rng(options.seed);
+    std::lognormal_distribution<double> size_dist(std::log(static_cast<double>(std::max<std::size_t>(1, options.median_blocks))), 1.0);
+
+    std::string json = "{\"summary\":{\"generator\":\"tei_mt_bench\"},\"detailed_analysis\":[\n";
+    out_files.clear();
+    const std::size_t records = options.files * 2;
+    for (std::size_t i = 0; i < records; ++i) {
+        char volume[24];
+        char name[48];
+        std::snprintf(volume, sizeof(volume), "T%02zu", i / 40 + 1);
+        std::snprintf(name, sizeof(name), "%sn%04zu", volume, i + 1);
+        const std::string rel = std::string("T/") + volume + "/" + name + ".xml";
+
+        if (i < options.files) {
+            const auto blocks = std::clamp<std::size_t>(
+                static_cast<std::size_t>(size_dist(rng)), 5, std::max<std::size_t>(5, options.median_blocks * 50)
+            );
+            const auto path = dir / rel;
+            std::error_code ec;
+            std::filesystem::create_directories(path.parent_path(), ec);
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << synthetic_cbeta_document(rng, blocks, name);
+            if (!out) {
+                error = "Failed to write " + path.string();
+                return false;
+            }
+            out_files.push_back(path);
+        }
+
+        json += std::string(i == 0 ? "" : ",\n") + "{\"file\":\"" + rel + "\",\"canon\":\"T\",\"period\":\""
+            + kPeriods[i % kPeriods.size()] + "\",\"origin\":\"" + kOrigins[(i / 3) % kOrigins.size()]
+            + "\",\"traditions\":[\"" + kTraditions[i % kTraditions.size()] + "\"";
+        if (i % 4 == 0) {
+            json += ",\"" + std::string(kTraditions[(i + 1 + (i / 4) % 5) % kTraditions.size()]) + "\"";
+        }
+        json += "],\"chinese_chars\":" + std::to_string(1000 + i * 37) + "}";
+    }
+    json += "\n]}\n";
+
+    out_metadata_json = dir / "metadata.json";
+    std::ofstream out(out_metadata_json, std::ios::binary | std::ios::trunc);
+    out << json;
+    if (!out) {
+        error = "Failed to write " + out_metadata_json.string();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+struct SyntheticCorpusOptions {
+    std::size_t files = 24;
+    /// Median blocks (`<p>` or `<lg>`) per document; document sizes are log-normal around it, from one-page texts
+    /// to canon-sized files, like CBETA.
+    std::size_t median_blocks = 300;
+    std::uint32_t seed = 1;
+};
+
+/// One CBETA-like TEI document: teiHeader, nested `cb:div` with `cb:juan`/`pb`/`lb` milestones, prose `<p>` of
+/// log-normal length, verse `<lg>` of short `<l>` lines, inline and foot `<note>` noise, `<g>` gaiji refs and
+/// CJK running text. Deterministic for a given generator state.
+std::string synthetic_cbeta_document(std::mt19937& rng, std::size_t blocks, const std::string& xml_id);
+
+/// Write a corpus under `dir` in CBETA layout (`T/T01/T01n0001.xml`, ...) plus `metadata.json`, a sorting metadata
+/// file with a record for every document and as many again for documents that are absent (as in the real data).
+bool write_synthetic_corpus(
+    const std::filesystem::path& dir,
+    const SyntheticCorpusOptions& options,
+    std::vector<std::filesystem::path>& out_files,
+    std::filesystem::path& out_metadata_json,
+    std::string& error
+);
@@ -200,6 +200,8 @@ bool run_translation_process(const RunConfig& cfg, RunControl& control, const Pr
     fcntl(pipefd[0], F_SETFL, flags | O_NONBLOCK);
 
     bool child_paused = false;
+    bool drain_sent = false;
+    bool abort_sent = false;
     bool child_exited = false;
     int wait_status = 0;
     int done_files = 0;
@@ -207,16 +209,22 @@ bool run_translation_process(const RunConfig& cfg, RunControl& control, const Pr
     char chunk[4096];
 
     while (!child_exited) {
-        if (control.cancel_requested.load(std::memory_order_relaxed)) {
+        // One SIGTERM per transition: the child drains on the first and aborts on the second, which is only sent
+        // on a later pass so the two are never merged into one pending signal.
+        if (control.cancel_requested.load(std::memory_order_relaxed) && !drain_sent) {
             kill(pid, SIGTERM);
+            drain_sent = true;
+        } else if (control.abort_requested.load(std::memory_order_relaxed) && drain_sent && !abort_sent) {
+            kill(pid, SIGTERM);
+            abort_sent = true;
         }
 
-        const bool should_pause = control.pause_requested.load(std::memory_order_relaxed);
+        const bool should_pause = control.pause_requested.load(std::memory_order_relaxed) && !drain_sent;
         if (should_pause && !child_paused) {
-            kill(pid, SIGSTOP);
+            kill(pid, SIGUSR1);
             child_paused = true;
         } else if (!should_pause && child_paused) {
-            kill(pid, SIGCONT);
+            kill(pid, SIGUSR2);
             child_paused = false;
         }
 
@@ -24,8 +24,12 @@ struct RunConfig {
     bool no_progress = true;
 };
 
+/// Requests for the tei_mt child, delivered as the signals it handles cooperatively: cancel drains (SIGTERM: units
+/// in flight finish and completed work is written), abort stops generation at once (a second SIGTERM),
+/// pause/resume free and rebuild its contexts (SIGUSR1/SIGUSR2) while the model stays loaded.
 struct RunControl {
     std::atomic<bool> cancel_requested{false};
+    std::atomic<bool> abort_requested{false};
     std::atomic<bool> pause_requested{false};
 };
 
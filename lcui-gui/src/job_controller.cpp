@@ -5,7 +5,7 @@ namespace tei_mt_gui {
 JobController::JobController() = default;
 
 JobController::~JobController() {
-    cancel();
+    abort();
     if (worker_.joinable()) {
         worker_.join();
     }
@@ -17,6 +17,7 @@ bool JobController::start(const RunConfig& cfg) {
     }
 
     control_.cancel_requested.store(false, std::memory_order_relaxed);
+    control_.abort_requested.store(false, std::memory_order_relaxed);
     control_.pause_requested.store(false, std::memory_order_relaxed);
     paused_.store(false, std::memory_order_relaxed);
     running_.store(true, std::memory_order_relaxed);
@@ -42,6 +43,16 @@ void JobController::resume() {
 }
 
 void JobController::cancel() {
+    if (control_.cancel_requested.exchange(true, std::memory_order_relaxed)) {
+        abort();
+        return;
+    }
+    control_.pause_requested.store(false, std::memory_order_relaxed);
+    paused_.store(false, std::memory_order_relaxed);
+}
+
+void JobController::abort() {
+    control_.abort_requested.store(true, std::memory_order_relaxed);
     control_.cancel_requested.store(true, std::memory_order_relaxed);
     control_.pause_requested.store(false, std::memory_order_relaxed);
     paused_.store(false, std::memory_order_relaxed);
@@ -55,6 +66,10 @@ bool JobController::is_paused() const {
     return paused_.load(std::memory_order_relaxed);
 }
 
+bool JobController::is_cancelling() const {
+    return control_.cancel_requested.load(std::memory_order_relaxed);
+}
+
 std::vector<ProgressEvent> JobController::poll_events() {
     auto events = events_.pop_all();
     bool saw_finished = false;
@@ -16,10 +16,14 @@ public:
     bool start(const RunConfig& cfg);
     void pause();
     void resume();
+    /// Let units in flight finish, write completed work and stop; a second cancel aborts.
     void cancel();
+    /// Stop at once; the file being translated is left for the next run.
+    void abort();
 
     bool is_running() const;
     bool is_paused() const;
+    bool is_cancelling() const;
 
     std::vector<ProgressEvent> poll_events();
 
@@ -172,8 +172,9 @@ void on_cancel_click(ui_widget_t* /*self*/, ui_event_t* /*e*/, void* /*arg*/) {
     if (!g_ctx) {
         return;
     }
+    const bool draining = g_ctx->controller.is_cancelling();
     g_ctx->controller.cancel();
-    g_ctx->state.status = "Cancel requested...";
+    g_ctx->state.status = draining ? "Aborting..." : "Finishing in-flight units (Cancel again to abort)...";
     refresh_ui(*g_ctx);
 }
 
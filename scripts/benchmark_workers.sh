@@ -22,6 +22,10 @@ if [[ ! -x "$BIN" ]]; then
   exit 1
 fi
 
+# Extract once; every worker count below then runs from the same mapped segments and token ids.
+STORE="$OUT_DIR/corpus.tmseg"
+"$BIN" compile --input "$INPUT_XML" --output "$STORE" --model "$MODEL" >"$OUT_DIR/compile.log" 2>&1
+
 printf "workers,time_ms,segments,ms_per_segment,seg_per_sec\n"
 for w in "${WORKERS[@]}"; do
   RUN_OUT_DIR="$OUT_DIR/w${w}"
@@ -29,6 +33,7 @@ for w in "${WORKERS[@]}"; do
 
   LOG="$("$BIN" \
     --input "$INPUT_XML" \
+    --segment-store "$STORE" \
     --output "$RUN_OUT_DIR" \
     --model "$MODEL" \
     --workers "$w" \
@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Run a coordinator and N workers on this machine over a Unix socket. With a kill delay, one worker is killed
+# mid-run so the coordinator's reassignment path is exercised; the output must still be complete.
+
+if [[ $# -lt 3 ]]; then
+  echo "Usage: $0 <tei-file-or-dir> <gguf-model> <out-dir> [workers=3] [kill_after_sec=0]"
+  exit 1
+fi
+
+INPUT="$1"
+MODEL="$2"
+OUT_DIR="$3"
+WORKERS="${4:-3}"
+KILL_AFTER="${5:-0}"
+
+BIN="$(cd "$(dirname "$0")/.." && pwd)/build/tei_mt"
+if [[ ! -x "$BIN" ]]; then
+  echo "Missing binary: $BIN"
+  echo "Build first: cmake -S . -B build && cmake --build build -j"
+  exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+SOCK="$OUT_DIR/coordinator.sock"
+
+"$BIN" --input "$INPUT" --output "$OUT_DIR/out" --coordinator "unix:$SOCK" --unit-segments 16 --unit-timeout 300 \
+  --no-progress >"$OUT_DIR/coordinator.log" 2>&1 &
+COORD_PID=$!
+
+PIDS=()
+for ((i = 0; i < WORKERS; ++i)); do
+  "$BIN" --worker "unix:$SOCK" --model "$MODEL" --workers 1 >"$OUT_DIR/worker$i.log" 2>&1 &
+  PIDS+=($!)
+done
+trap 'kill "${PIDS[@]}" "$COORD_PID" 2>/dev/null || true' EXIT
+
+if [[ "$KILL_AFTER" -gt 0 ]]; then
+  sleep "$KILL_AFTER"
+  echo "killing worker 0 (pid ${PIDS[0]})"
+  kill -9 "${PIDS[0]}" 2>/dev/null || true
+fi
+
+STATUS=0
+wait "$COORD_PID" || STATUS=$?
+grep -E "^\[(coord|summary)\]" "$OUT_DIR/coordinator.log" || true
+exit "$STATUS"
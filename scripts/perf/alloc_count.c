@@ -0,0 +1,70 @@
+/* LD_PRELOAD shim for the performance harness: counts heap allocations of the whole process (glibc only) and
+ * writes the total to $TEI_MT_ALLOC_COUNT_OUT at exit. Build: cc -O2 -shared -fPIC alloc_count.c -o alloc_count.so */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static unsigned long long g_allocations;
+
+static void count(void) {
+    __atomic_fetch_add(&g_allocations, 1, __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t size) {
+    count();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    count();
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    count();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    count();
+    void* p = __libc_memalign(alignment, size);
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+__attribute__((destructor)) static void write_count(void) {
+    const char* path = getenv("TEI_MT_ALLOC_COUNT_OUT");
+    if (path == NULL) {
+        return;
+    }
+    FILE* out = fopen(path, "w");
+    if (out != NULL) {
+        fprintf(out, "%llu\n", __atomic_load_n(&g_allocations, __ATOMIC_RELAXED));
+        fclose(out);
+    }
+}
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Write a tiny llama-architecture GGUF with random weights for the performance harness.
+
+The model is meaningless but exercises the real inference path: an SPM tokenizer with byte fallback, whole-character
+tokens for CJK, kana, CJK punctuation and ASCII, and a few transformer blocks sized to run in milliseconds per token
+on any CPU. Greedy decoding over fixed weights is deterministic, so token counts are stable across runs.
+
+Standard library only (no numpy, no gguf-py), so it runs offline on a plain Linux box.
+"""
+
+import argparse
+import random
+import struct
+
+GGUF_MAGIC = 0x46554747
+GGUF_VERSION = 3
+ALIGNMENT = 32
+
+T_UINT32, T_INT32, T_FLOAT32, T_BOOL, T_STRING, T_ARRAY = 4, 5, 6, 7, 8, 9
+GGML_TYPE_F32 = 0
+
+TOKEN_NORMAL, TOKEN_UNKNOWN, TOKEN_CONTROL, TOKEN_BYTE = 1, 2, 3, 6
+
+
+def gguf_string(value: str) -> bytes:
+    data = value.encode("utf-8")
+    return struct.pack("<Q", len(data)) + data
+
+
+def kv(key: str, vtype: int, value) -> bytes:
+    out = gguf_string(key) + struct.pack("<I", vtype)
+    if vtype == T_UINT32:
+        return out + struct.pack("<I", value)
+    if vtype == T_INT32:
+        return out + struct.pack("<i", value)
+    if vtype == T_FLOAT32:
+        return out + struct.pack("<f", value)
+    if vtype == T_BOOL:
+        return out + struct.pack("<B", 1 if value else 0)
+    if vtype == T_STRING:
+        return out + gguf_string(value)
+    raise ValueError(vtype)
+
+
+def kv_array(key: str, elem_type: int, values) -> bytes:
+    out = gguf_string(key) + struct.pack("<IIQ", T_ARRAY, elem_type, len(values))
+    if elem_type == T_STRING:
+        return out + b"".join(gguf_string(v) for v in values)
+    fmt = {T_FLOAT32: "f", T_INT32: "i"}[elem_type]
+    return out + struct.pack("<%d%s" % (len(values), fmt), *values)
+
+
+def build_vocab():
+    tokens = ["<unk>", "<s>", "</s>"]
+    types = [TOKEN_UNKNOWN, TOKEN_CONTROL, TOKEN_CONTROL]
+    for b in range(256):
+        tokens.append("<0x%02X>" % b)
+        types.append(TOKEN_BYTE)
+    pieces = ["▁"] + ["▁" + chr(c) for c in range(0x21, 0x7F)] + [chr(c) for c in range(0x21, 0x7F)]
+    pieces += [chr(c) for c in range(0x3000, 0x3040)]  # CJK punctuation
+    pieces += [chr(c) for c in range(0x3040, 0x3100)]  # kana
+    pieces += [chr(c) for c in range(0x4E00, 0x9FA6)]  # CJK unified ideographs
+    pieces += [chr(c) for c in range(0xFF01, 0xFF5F)]  # fullwidth forms
+    seen = set(tokens)
+    for piece in pieces:
+        if piece not in seen:
+            seen.add(piece)
+            tokens.append(piece)
+            types.append(TOKEN_NORMAL)
+    scores = [0.0] * 259 + [-float(i) for i in range(len(tokens) - 259)]
+    return tokens, scores, types
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--out", required=True)
+    parser.add_argument("--seed", type=int, default=1234)
+    parser.add_argument("--n-embd", type=int, default=64)
+    parser.add_argument("--n-layer", type=int, default=2)
+    parser.add_argument("--n-head", type=int, default=4)
+    parser.add_argument("--n-ff", type=int, default=192)
+    parser.add_argument("--n-ctx-train", type=int, default=4096)
+    args = parser.parse_args()
+
+    tokens, scores, types = build_vocab()
+    n_vocab, n_embd, n_ff = len(tokens), args.n_embd, args.n_ff
+
+    # ggml order: ne[0] is the input (innermost) dimension.
+    shapes = [("token_embd.weight", (n_embd, n_vocab)), ("output_norm.weight", (n_embd,)), ("output.weight", (n_embd, n_vocab))]
+    for layer in range(args.n_layer):
+        p = "blk.%d." % layer
+        shapes += [
+            (p + "attn_norm.weight", (n_embd,)),
+            (p + "attn_q.weight", (n_embd, n_embd)),
+            (p + "attn_k.weight", (n_embd, n_embd)),
+            (p + "attn_v.weight", (n_embd, n_embd)),
+            (p + "attn_output.weight", (n_embd, n_embd)),
+            (p + "ffn_norm.weight", (n_embd,)),
+            (p + "ffn_gate.weight", (n_embd, n_ff)),
+            (p + "ffn_up.weight", (n_embd, n_ff)),
+            (p + "ffn_down.weight", (n_ff, n_embd)),
+        ]
+
+    metadata = [
+        kv("general.architecture", T_STRING, "llama"),
+        kv("general.name", T_STRING, "tei_mt tiny perf model"),
+        kv("general.alignment", T_UINT32, ALIGNMENT),
+        kv("general.file_type", T_UINT32, 0),
+        kv("llama.context_length", T_UINT32, args.n_ctx_train),
+        kv("llama.embedding_length", T_UINT32, n_embd),
+        kv("llama.block_count", T_UINT32, args.n_layer),
+        kv("llama.feed_forward_length", T_UINT32, n_ff),
+        kv("llama.attention.head_count", T_UINT32, args.n_head),
+        kv("llama.attention.head_count_kv", T_UINT32, args.n_head),
+        kv("llama.rope.dimension_count", T_UINT32, n_embd // args.n_head),
+        kv("llama.rope.freq_base", T_FLOAT32, 10000.0),
+        kv("llama.attention.layer_norm_rms_epsilon", T_FLOAT32, 1e-5),
+        kv("llama.vocab_size", T_UINT32, n_vocab),
+        kv("tokenizer.ggml.model", T_STRING, "llama"),
+        kv_array("tokenizer.ggml.tokens", T_STRING, tokens),
+        kv_array("tokenizer.ggml.scores", T_FLOAT32, scores),
+        kv_array("tokenizer.ggml.token_type", T_INT32, types),
+        kv("tokenizer.ggml.unknown_token_id", T_UINT32, 0),
+        kv("tokenizer.ggml.bos_token_id", T_UINT32, 1),
+        kv("tokenizer.ggml.eos_token_id", T_UINT32, 2),
+        kv("tokenizer.ggml.add_bos_token", T_BOOL, True),
+        kv("tokenizer.ggml.add_eos_token", T_BOOL, False),
+    ]
+
+    infos = []
+    offset = 0
+    for name, shape in shapes:
+        infos.append(gguf_string(name) + struct.pack("<I", len(shape)) + b"".join(struct.pack("<Q", d) for d in shape)
+                     + struct.pack("<IQ", GGML_TYPE_F32, offset))
+        size = 4
+        for d in shape:
+            size *= d
+        offset += (size + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+    rng = random.Random(args.seed)
+    with open(args.out, "wb") as out:
+        out.write(struct.pack("<IIQQ", GGUF_MAGIC, GGUF_VERSION, len(shapes), len(metadata)))
+        for item in metadata:
+            out.write(item)
+        for info in infos:
+            out.write(info)
+        out.write(b"\0" * (-out.tell() % ALIGNMENT))
+        for name, shape in shapes:
+            count = 1
+            for d in shape:
+                count *= d
+            if name.endswith("norm.weight"):
+                values = [1.0] * count
+            else:
+                values = [rng.gauss(0.0, 0.08) for _ in range(count)]
+            data = struct.pack("<%df" % count, *values)
+            out.write(data)
+            out.write(b"\0" * (-len(data) % ALIGNMENT))
+    print("wrote %s (vocab=%d, embd=%d, layers=%d)" % (args.out, n_vocab, n_embd, args.n_layer))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
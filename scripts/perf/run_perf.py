@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""End-to-end performance regression check: real CLI, real llama.cpp inference, tiny model, fixed corpus.
+
+Runs `tei_mt` over scripts/perf/corpus on CPU with a tiny random-weight GGUF (make_tiny_gguf.py), several times,
+and takes the median of: ms per segment and generated tokens/s (from the `[summary]` and `[tokens]` lines), heap
+allocations (LD_PRELOAD counter, alloc_count.c) and peak RSS (wait4 rusage). The result is compared against a
+baseline JSON with per-metric tolerance bands; exit status 1 means a regression.
+
+Timings only compare on the machine that recorded the baseline, so the baseline lives in the build directory by
+default. Record one before a change with --update-baseline, then rerun after it. Standard library only; offline.
+
+    scripts/perf/run_perf.py --bin build/bin/tei_mt --update-baseline
+    scripts/perf/run_perf.py --bin build/bin/tei_mt
+"""
+
+import argparse
+import json
+import os
+import platform
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# Allowed relative change before a metric counts as a regression, and which direction is worse.
+TOLERANCES = {
+    "ms_per_segment": (0.15, "higher"),
+    "gen_tokens_per_sec": (0.15, "lower"),
+    "allocations": (0.05, "higher"),
+    "peak_rss_mb": (0.10, "higher"),
+}
+
+
+def run_once(args, model, shim, work):
+    out_dir = os.path.join(work, "out")
+    shutil.rmtree(out_dir, ignore_errors=True)
+    count_file = os.path.join(work, "allocations.txt")
+    env = dict(os.environ)
+    if shim:
+        env["LD_PRELOAD"] = shim
+        env["TEI_MT_ALLOC_COUNT_OUT"] = count_file
+    cmd = [
+        args.bin, "--input", os.path.join(HERE, "corpus"), "--output", out_dir, "--model", model,
+        "--n-gpu-layers", "0", "--workers", str(args.workers), "--threads", str(args.threads), "--pin", "off",
+        "--ctx", "1024", "--max-tokens", str(args.max_tokens), "--no-coalesce", "--no-progress", "--no-resume",
+    ]
+    started = time.monotonic()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, env=env, text=True)
+    output = proc.stdout.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.monotonic() - started
+    if os.waitstatus_to_exitcode(status) != 0:
+        sys.stderr.write(output)
+        raise SystemExit("tei_mt failed: " + " ".join(cmd))
+
+    summary = re.search(r"\[summary\].* total_segments=(\d+) total_time_ms=(\d+)", output)
+    tokens = re.search(r"\[tokens\] prompt=(\d+) generated=(\d+) gen_tok_per_sec=([\d.eE+-]+)", output)
+    if not summary or not tokens:
+        sys.stderr.write(output)
+        raise SystemExit("could not find [summary]/[tokens] in tei_mt output")
+    segments, ms = int(summary.group(1)), int(summary.group(2))
+    result = {
+        "segments": segments,
+        "generated_tokens": int(tokens.group(2)),
+        "ms_per_segment": ms / max(1, segments),
+        "gen_tokens_per_sec": float(tokens.group(3)),
+        "peak_rss_mb": usage.ru_maxrss / 1024.0,
+        "wall_s": wall,
+    }
+    if shim and os.path.exists(count_file):
+        with open(count_file) as f:
+            result["allocations"] = int(f.read().strip())
+    return result
+
+
+def build_shim(work):
+    cc = shutil.which("cc") or shutil.which("gcc") or shutil.which("clang")
+    if not cc or platform.system() != "Linux":
+        print("[perf] no C compiler or not Linux: allocations are not counted")
+        return None
+    shim = os.path.join(work, "alloc_count.so")
+    subprocess.run([cc, "-O2", "-shared", "-fPIC", os.path.join(HERE, "alloc_count.c"), "-o", shim], check=True)
+    return shim
+
+
+def main():
+    parser = argparse.ArgumentParser(description="tei_mt end-to-end performance regression check")
+    parser.add_argument("--bin", default="build/bin/tei_mt")
+    parser.add_argument("--work-dir", default="build/perf")
+    parser.add_argument("--baseline", help="baseline JSON (default: <work-dir>/baseline.json)")
+    parser.add_argument("--update-baseline", action="store_true", help="record this run as the baseline")
+    parser.add_argument("--runs", type=int, default=3)
+    parser.add_argument("--workers", type=int, default=1)
+    parser.add_argument("--threads", type=int, default=2)
+    parser.add_argument("--max-tokens", type=int, default=32)
+    args = parser.parse_args()
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    baseline_path = args.baseline or os.path.join(args.work_dir, "baseline.json")
+    model = os.path.join(args.work_dir, "tiny.gguf")
+    if not os.path.exists(model):
+        subprocess.run([sys.executable, os.path.join(HERE, "make_tiny_gguf.py"), "--out", model], check=True)
+    shim = build_shim(args.work_dir)
+
+    runs = []
+    with tempfile.TemporaryDirectory(dir=args.work_dir) as work:
+        for i in range(args.runs):
+            runs.append(run_once(args, model, shim, work))
+            print("[perf] run %d: %s" % (i + 1, json.dumps(runs[-1], sort_keys=True)))
+
+    current = {key: statistics.median(r[key] for r in runs) for key in runs[0]}
+    print("[perf] median: " + json.dumps(current, sort_keys=True))
+
+    if args.update_baseline:
+        record = {
+            "metrics": current,
+            "tolerances": {k: v[0] for k, v in TOLERANCES.items()},
+            "host": platform.node(),
+            "machine": platform.machine(),
+            "settings": {"workers": args.workers, "threads": args.threads, "max_tokens": args.max_tokens},
+        }
+        with open(baseline_path, "w") as f:
+            json.dump(record, f, indent=2, sort_keys=True)
+        print("[perf] baseline written: " + baseline_path)
+        return 0
+
+    if not os.path.exists(baseline_path):
+        print("[perf] no baseline at %s; record one with --update-baseline" % baseline_path)
+        return 0
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    if baseline.get("host") != platform.node():
+        print("[perf] warning: baseline was recorded on %s; timings may not compare" % baseline.get("host"))
+
+    failed = False
+    if baseline["metrics"].get("generated_tokens") != current["generated_tokens"]:
+        # Not a performance regression, but per-token numbers then measure different work.
+        print("[perf] note: generated tokens changed %s -> %s (decoding output differs)"
+              % (baseline["metrics"].get("generated_tokens"), current["generated_tokens"]))
+    for key, (default_tol, worse) in TOLERANCES.items():
+        if key not in current or key not in baseline["metrics"]:
+            continue
+        base = baseline["metrics"][key]
+        tol = baseline.get("tolerances", {}).get(key, default_tol)
+        change = (current[key] - base) / base if base else 0.0
+        regressed = change > tol if worse == "higher" else change < -tol
+        failed = failed or regressed
+        print("[perf] %-20s base=%-12.4g now=%-12.4g change=%+6.1f%% (tolerance %.0f%%) %s"
+              % (key, base, current[key], change * 100.0, tol * 100.0, "REGRESSION" if regressed else "ok"))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
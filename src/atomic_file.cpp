@@ -0,0 +1,27 @@
+#include "atomic_file.hpp"
+
+#include <fstream>
+#include <system_error>
+
+bool write_file_atomically(const std::filesystem::path& path, std::string_view bytes, std::string& error) {
+    const std::filesystem::path tmp = path.string() + ".part";
+    std::error_code ec;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        out.flush();
+        if (!out) {
+            error = "Failed to write " + tmp.string();
+            out.close();
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        error = "Failed to write " + path.string() + " (" + ec.message() + ")";
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+/// Write `bytes` to `<path>.part` and rename it over `path`, so readers see the old file or the complete new one,
+/// never a torn write. On failure the `.part` file is removed and `error` names the file.
+bool write_file_atomically(const std::filesystem::path& path, std::string_view bytes, std::string& error);
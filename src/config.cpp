@@ -1,11 +1,14 @@
 #include "config.hpp"
 
+#include "atomic_file.hpp"
+#include "memory_plan.hpp"
+
 #include <algorithm>
 #include <cctype>
-#include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <thread>
+#include <sstream>
 #include <vector>
 
 namespace {
@@ -30,6 +33,91 @@ bool parse_size_arg(const std::string& key, const std::string& value, std::size_
     }
 }
 
+/// Bytes with an optional binary suffix: `12G`, `1536M`, `8GiB`, `64k`.
+bool parse_bytes_arg(const std::string& key, const std::string& value, std::uint64_t& out, std::string& error) {
+    std::size_t used = 0;
+    double amount = 0.0;
+    try {
+        amount = std::stod(value, &used);
+    } catch (...) {
+        used = 0;
+    }
+    std::string suffix = value.substr(used);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    if (suffix.ends_with("ib")) {
+        suffix.resize(suffix.size() - 2);
+    } else if (suffix.ends_with("b")) {
+        suffix.pop_back();
+    }
+    const std::string units = "kmgt";
+    const auto unit = suffix.empty() ? std::string::npos : units.find(suffix);
+    if (used == 0 || amount < 0.0 || suffix.size() > 1 || (!suffix.empty() && unit == std::string::npos)) {
+        error = "Invalid size for " + key + " (e.g. 12G, 1536M): " + value;
+        return false;
+    }
+    const double scale = suffix.empty() ? 1.0 : static_cast<double>(std::uint64_t{1} << (10 * (unit + 1)));
+    out = static_cast<std::uint64_t>(amount * scale);
+    return true;
+}
+
+/// `i/N` with 0 <= i < N.
+bool parse_shard_arg(const std::string& value, std::size_t& index, std::size_t& count, std::string& error) {
+    const auto slash = value.find('/');
+    if (slash == std::string::npos
+        || !parse_size_arg("--shard", value.substr(0, slash), index, error)
+        || !parse_size_arg("--shard", value.substr(slash + 1), count, error)) {
+        error = "Invalid value for --shard (expected i/N): " + value;
+        return false;
+    }
+    if (count == 0 || index >= count) {
+        error = "--shard index must be in [0, N): " + value;
+        return false;
+    }
+    return true;
+}
+
+/// Keys a tuning profile may set, each the name of a run option without its leading dashes.
+constexpr const char* kProfileKeys[] = {
+    "workers", "threads", "decode-threads", "n-batch", "n-ubatch", "coalesce", "coalesce-max-batch",
+    "coalesce-max-chars", "ctx",
+};
+
+std::string trim_copy(std::string s);
+
+/// Expand a `key=value` profile into the equivalent options, appended to `args`.
+bool load_profile_args(const std::string& path, std::vector<std::string>& args, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot read --profile: " + path;
+        return false;
+    }
+    std::string line;
+    for (int line_no = 1; std::getline(in, line); ++line_no) {
+        line = trim_copy(line);
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        const auto eq = line.find('=');
+        const std::string key = eq == std::string::npos ? line : trim_copy(line.substr(0, eq));
+        const std::string value = eq == std::string::npos ? std::string{} : trim_copy(line.substr(eq + 1));
+        if (std::ranges::find(kProfileKeys, key) == std::end(kProfileKeys) || value.empty()) {
+            error = "Invalid profile entry at " + path + ":" + std::to_string(line_no) + ": " + line;
+            return false;
+        }
+        if (key == "coalesce") {
+            if (value == "off") {
+                args.push_back("--no-coalesce");
+            }
+            continue;
+        }
+        args.push_back("--" + key);
+        args.push_back(value);
+    }
+    return true;
+}
+
 std::string trim_copy(std::string s) {
     const auto not_space = [](unsigned char c) {
         return !std::isspace(c);
@@ -73,19 +161,55 @@ bool has_noninteractive_drilldown(const AppConfig& config) {
 void print_usage(const char* program_name) {
     std::cout
         << "Usage:\n"
-        << "  " << program_name << " --input <tei-file-or-dir> [--output <out-dir-or-file.xml>] [--model <gguf-path>] [options]\n\n"
+        << "  " << program_name << " --input <tei-file-or-dir> [--output <out-dir-or-file.xml>] [--model <gguf-path>] [options]\n"
+        << "  " << program_name << " merge --input <tei-file-or-dir> --standoff <jsonl-or-dir> [--output <path>]"
+        << " [--overwrite-existing-translations]\n"
+        << "  " << program_name << " compile --input <tei-file-or-dir> --output <store.tmseg> [--model <gguf-path>]\n"
+        << "  " << program_name << " report diff <a.json> <b.json>\n"
+        << "  " << program_name << " --worker <endpoint> [--model <gguf-path>] [options]\n\n"
         << "Options:\n"
         << "  --workers <n>         Worker threads (0=auto: 2 or fewer for GPU offload, else up to 4 on CPU)\n"
         << "  --max-tokens <n>      Max generated tokens per segment (default: 192)\n"
         << "  --ctx <n>             Initial context size (default: 2048); may auto-grow up to --max-ctx\n"
         << "  --max-ctx <n>         Maximum context when auto-growing for long prompts (default: 131072)\n"
         << "  --n-gpu-layers <n>    llama.cpp GPU layers (default: -1)\n"
-        << "  --threads <n>         llama.cpp CPU threads per context (0=auto: ~cores/workers; default: 0)\n"
+        << "  --threads <n>         llama.cpp CPU threads per context (0=auto: ~physical cores/workers; default: 0)\n"
+        << "  --decode-threads <n>  llama.cpp threads for token-by-token decode (0=auto: half of --threads)\n"
+        << "  --pin <auto|on|off>   Pin each worker's llama threads to disjoint physical cores (auto: CPU-only runs)\n"
+        << "  --backend <name>      llama (default) or mock: no model, simulated latency (load testing)\n"
+        << "  --mock-costs <spec>   Mock costs, e.g. prefill_us=20,decode_us=200,jitter=0.3,fail=0,drift=0,loop=0,grow_ms=40,seed=1\n"
+        << "  --n-batch <n>         llama.cpp logical batch for prompt prefill (default: 512)\n"
+        << "  --n-ubatch <n>        llama.cpp physical micro-batch (default: 256)\n"
+        << "  --cache-type-k <t>    KV cache type for K: f16 (default), bf16, f32, q8_0, q5_1, q5_0, q4_1, q4_0, iq4_nl\n"
+        << "  --cache-type-v <t>    KV cache type for V (same types; quantized V turns on flash attention)\n"
+        << "  --memory-budget <sz>  Fit model + contexts in this much RAM (e.g. 12G): lowers workers, ctx and max ctx\n"
+        << "  --profile <path>      Load options from a tuning profile (written by --autotune); later options override\n"
+        << "  --autotune            Measure a sample of the input under candidate settings and write a profile\n"
+        << "  --autotune-out <p>    Profile written by --autotune (default: tei_mt.profile)\n"
+        << "  --autotune-segments <n> Segments sampled from the input for --autotune (default: 64)\n"
         << "  --no-coalesce         Translate each TEI segment separately (disables batching)\n"
         << "  --coalesce-max-batch <n> Max segments merged per inference (default: 6)\n"
         << "  --coalesce-max-chars <n> Max UTF-8 chars per merged batch, approximate (default: 2800)\n"
-        << "  --tei-strategy <s>    TEI output strategy, currently: note\n"
+        << "  --tei-strategy <s>    TEI output strategy: note (in-place notes, default) or standoff (<name>.en.jsonl)\n"
+        << "  --stream-windows <u>  Stream giant documents in bounded memory, one window per div|juan\n"
+        << "  --stream-window-bytes <n> Soft byte cap per streaming window (default: 4194304)\n"
+        << "  --segment-store <p>   Read segments from a compiled store (tei_mt compile); --input defaults to its root\n"
+        << "  --order <o>           Run queue order: lexical (default), lpt (longest first), shortest, metadata\n"
+        << "  --priority <expr>     category=value group to run first with --order metadata (repeatable, in order)\n"
+        << "  --shard <i/N>         Process only shard i (0-based) of N, partitioned by relative path hash\n"
+        << "  --lease               Claim files with <output>.lease files so several processes can share a corpus\n"
+        << "  --lease-ttl <sec>     Lease expiry without heartbeat before another process may reclaim it (default: 300)\n"
+        << "  --coordinator <ep>    Distribute segments to --worker processes (ep: unix:/path, tcp:host:port)\n"
+        << "  --worker <ep>         Run as a worker for the coordinator at ep (loads the model; no --input)\n"
+        << "  --unit-segments <n>   Segments per work unit sent to a worker (default: 32)\n"
+        << "  --unit-timeout <sec>  Reassign a unit whose worker has not answered by then (default: 900)\n"
+        << "  --unit-retries <n>    Retries of a failing unit (fresh context, then half the budget; 0-2, default: 2)\n"
         << "  --emit-markdown       Also write sidecar Markdown output (*.en.md)\n"
+        << "  --report <path>       Write a JSON run report; compare two with `report diff a.json b.json`\n"
+        << "  --metrics <path>      Export live metrics: Prometheus text (*.prom) or a JSON snapshot (*.json)\n"
+        << "  --metrics-interval <sec> Seconds between metrics exports (default: 15)\n"
+        << "  --trace <path>        Write a Chrome/Perfetto trace of per-thread spans (prefill, decode, I/O, ...)\n"
+        << "  --unit-log <path>     Append one JSON line per translation unit (tokens, timings, ctx, fallbacks)\n"
         << "  --no-progress         Disable progress bar output\n"
         << "  --no-resume           Always reprocess files even if output looks complete\n"
         << "  --overwrite-existing-translations  Replace existing translation notes while writing\n"
@@ -112,8 +236,21 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
         return false;
     }
 
+    // `--profile <path>` is expanded in place, so options given after it override the profile.
+    std::vector<std::string> args;
     for (int i = 1; i < argc; ++i) {
-        const std::string arg = argv[i];
+        if (std::string(argv[i]) != "--profile") {
+            args.emplace_back(argv[i]);
+        } else if (i + 1 >= argc) {
+            error = "Missing value for --profile";
+            return false;
+        } else if (!load_profile_args(argv[++i], args, error)) {
+            return false;
+        }
+    }
+
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        const std::string arg = args[i];
 
         if (arg == "-h" || arg == "--help") {
             error = "help";
@@ -121,12 +258,12 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
         }
 
         auto require_value = [&](const std::string& key) -> std::string {
-            if (i + 1 >= argc) {
+            if (i + 1 >= args.size()) {
                 error = "Missing value for " + key;
                 return {};
             }
             ++i;
-            return argv[i];
+            return args[i];
         };
 
         if (arg == "--input") {
@@ -165,6 +302,50 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
                 error = "Invalid --threads: must be >= 0 (0 selects auto based on CPU cores and workers)";
                 return false;
             }
+        } else if (arg == "--decode-threads") {
+            if (!parse_int_arg(arg, require_value(arg), config.decode_threads, error)) {
+                return false;
+            }
+            if (config.decode_threads < 0) {
+                error = "Invalid --decode-threads: must be >= 0 (0 selects half of --threads)";
+                return false;
+            }
+        } else if (arg == "--pin") {
+            config.pin_threads = require_value(arg);
+        } else if (arg == "--backend") {
+            config.backend = require_value(arg);
+        } else if (arg == "--mock-costs") {
+            if (!parse_mock_costs(require_value(arg), config.mock, error)) {
+                return false;
+            }
+        } else if (arg == "--n-batch") {
+            if (!parse_int_arg(arg, require_value(arg), config.n_batch, error)) {
+                return false;
+            }
+        } else if (arg == "--n-ubatch") {
+            if (!parse_int_arg(arg, require_value(arg), config.n_ubatch, error)) {
+                return false;
+            }
+        } else if (arg == "--cache-type-k") {
+            config.cache_type_k = require_value(arg);
+        } else if (arg == "--cache-type-v") {
+            config.cache_type_v = require_value(arg);
+        } else if (arg == "--memory-budget") {
+            if (!parse_bytes_arg(arg, require_value(arg), config.memory_budget_bytes, error)) {
+                return false;
+            }
+        } else if (arg == "--autotune") {
+            config.autotune = true;
+        } else if (arg == "--autotune-out") {
+            config.autotune_out = require_value(arg);
+        } else if (arg == "--autotune-segments") {
+            if (!parse_int_arg(arg, require_value(arg), config.autotune_segments, error)) {
+                return false;
+            }
+            if (config.autotune_segments < 8) {
+                error = "--autotune-segments must be >= 8";
+                return false;
+            }
         } else if (arg == "--no-coalesce") {
             config.coalesce_segments = false;
         } else if (arg == "--coalesce-max-batch") {
@@ -185,8 +366,82 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
             }
         } else if (arg == "--tei-strategy") {
             config.tei_strategy = require_value(arg);
+        } else if (arg == "--stream-windows") {
+            config.stream_windows = require_value(arg);
+        } else if (arg == "--stream-window-bytes") {
+            if (!parse_size_arg(arg, require_value(arg), config.stream_window_bytes, error)) {
+                return false;
+            }
+            if (config.stream_window_bytes < 4096) {
+                error = "--stream-window-bytes must be >= 4096";
+                return false;
+            }
+        } else if (arg == "--segment-store") {
+            config.segment_store_path = require_value(arg);
+        } else if (arg == "--order") {
+            config.run_order = require_value(arg);
+        } else if (arg == "--priority") {
+            config.priority_terms.push_back(require_value(arg));
+        } else if (arg == "--shard") {
+            if (!parse_shard_arg(require_value(arg), config.shard_index, config.shard_count, error)) {
+                return false;
+            }
+        } else if (arg == "--lease") {
+            config.lease = true;
+        } else if (arg == "--lease-ttl") {
+            if (!parse_int_arg(arg, require_value(arg), config.lease_ttl_seconds, error)) {
+                return false;
+            }
+            if (config.lease_ttl_seconds < 10) {
+                error = "--lease-ttl must be >= 10";
+                return false;
+            }
+        } else if (arg == "--coordinator") {
+            config.coordinator_endpoint = require_value(arg);
+        } else if (arg == "--worker") {
+            config.worker_endpoint = require_value(arg);
+        } else if (arg == "--unit-segments") {
+            if (!parse_int_arg(arg, require_value(arg), config.unit_segments, error)) {
+                return false;
+            }
+            if (config.unit_segments < 1) {
+                error = "--unit-segments must be >= 1";
+                return false;
+            }
+        } else if (arg == "--unit-timeout") {
+            if (!parse_int_arg(arg, require_value(arg), config.unit_timeout_seconds, error)) {
+                return false;
+            }
+            if (config.unit_timeout_seconds < 1) {
+                error = "--unit-timeout must be >= 1";
+                return false;
+            }
+        } else if (arg == "--unit-retries") {
+            if (!parse_int_arg(arg, require_value(arg), config.unit_retries, error)) {
+                return false;
+            }
+            if (config.unit_retries < 0 || config.unit_retries > 2) {
+                error = "--unit-retries must be 0, 1 or 2";
+                return false;
+            }
         } else if (arg == "--emit-markdown") {
             config.emit_markdown = true;
+        } else if (arg == "--report") {
+            config.report_path = require_value(arg);
+        } else if (arg == "--trace") {
+            config.trace_path = require_value(arg);
+        } else if (arg == "--unit-log") {
+            config.unit_log_path = require_value(arg);
+        } else if (arg == "--metrics") {
+            config.metrics_path = require_value(arg);
+        } else if (arg == "--metrics-interval") {
+            if (!parse_int_arg(arg, require_value(arg), config.metrics_interval_seconds, error)) {
+                return false;
+            }
+            if (config.metrics_interval_seconds < 1) {
+                error = "--metrics-interval must be >= 1";
+                return false;
+            }
         } else if (arg == "--no-progress") {
             config.show_progress = false;
         } else if (arg == "--no-resume") {
@@ -219,45 +474,52 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
         }
     }
 
-    const unsigned hw = std::thread::hardware_concurrency();
-    const unsigned cores = hw == 0 ? 4u : hw;
-
-    if (config.workers == 0) {
-        const bool cpu_only = (config.n_gpu_layers == 0);
-        if (cpu_only) {
-            config.workers = std::min<std::size_t>(4u, std::max<std::size_t>(1u, cores / 2));
-        } else {
-            config.workers = std::min<std::size_t>(2u, std::max<std::size_t>(1u, cores / 8));
+    for (const std::string* type : {&config.cache_type_k, &config.cache_type_v}) {
+        if (!is_kv_cache_type(*type)) {
+            error = "Unsupported KV cache type: " + *type
+                + " (supported: f16, bf16, f32, q8_0, q5_1, q5_0, q4_1, q4_0, iq4_nl)";
+            return false;
         }
     }
-    if (config.workers < 1) {
-        config.workers = 1;
+    if (config.memory_budget_bytes > 0
+        && (config.backend != "llama" || config.autotune || !config.coordinator_endpoint.empty())) {
+        error = "--memory-budget needs --backend llama and cannot be combined with --autotune or --coordinator";
+        return false;
     }
 
-    if (config.n_threads == 0) {
-        config.n_threads = static_cast<int>(std::max(1u, cores / static_cast<unsigned>(config.workers)));
+    if (config.pin_threads != "auto" && config.pin_threads != "on" && config.pin_threads != "off") {
+        error = "Unsupported --pin: " + config.pin_threads + " (supported: auto, on, off)";
+        return false;
     }
 
-    const auto thread_product = [&]() -> std::uint64_t {
-        return static_cast<std::uint64_t>(config.workers) * static_cast<std::uint64_t>(config.n_threads);
-    };
-    const std::uint64_t cap = static_cast<std::uint64_t>(cores);
-    while (thread_product() > cap) {
-        if (config.n_threads > 1) {
-            --config.n_threads;
-        } else {
-            config.workers = std::min(config.workers, static_cast<std::size_t>(cap));
-            break;
-        }
-    }
-    if (config.n_threads < 1) {
-        config.n_threads = 1;
-    }
+    // Sized against physical cores in our affinity mask/cpuset, capped by the cgroup CPU quota.
+    const bool gpu_offload = config.n_gpu_layers != 0;
+    const bool pin = config.pin_threads == "on" || (config.pin_threads == "auto" && !gpu_offload);
+    config.cpu_topology = detect_cpu_topology();
+    config.requested_n_threads = config.n_threads;
+    config.thread_plan = plan_threads(
+        config.cpu_topology,
+        config.workers,
+        config.n_threads,
+        config.decode_threads,
+        gpu_offload,
+        pin
+    );
+    config.workers = config.thread_plan.workers;
+    config.n_threads = config.thread_plan.n_threads;
 
-    if (config.input_path.empty()) {
+    if (!config.worker_endpoint.empty() && !config.coordinator_endpoint.empty()) {
+        error = "--worker cannot be combined with --coordinator";
+        return false;
+    }
+    if (config.input_path.empty() && config.segment_store_path.empty() && config.worker_endpoint.empty()) {
         error = "--input is required";
         return false;
     }
+    if (!config.segment_store_path.empty() && !config.stream_windows.empty()) {
+        error = "--segment-store cannot be combined with --stream-windows";
+        return false;
+    }
     if (config.interactive_drilldown && has_any_sorting_filter(config)) {
         error = "--interactive-drilldown cannot be combined with --filter-* arguments";
         return false;
@@ -271,8 +533,64 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
         return false;
     }
 
-    if (!config.drilldown_help && config.tei_strategy != "note") {
-        error = "Unsupported --tei-strategy: " + config.tei_strategy + " (supported: note)";
+    if (!config.drilldown_help && config.tei_strategy != "note" && config.tei_strategy != "standoff") {
+        error = "Unsupported --tei-strategy: " + config.tei_strategy + " (supported: note, standoff)";
+        return false;
+    }
+
+    if (!config.stream_windows.empty() && config.stream_windows != "div" && config.stream_windows != "juan") {
+        error = "Unsupported --stream-windows: " + config.stream_windows + " (supported: div, juan)";
+        return false;
+    }
+
+    if (config.run_order != "lexical" && config.run_order != "lpt" && config.run_order != "shortest"
+        && config.run_order != "metadata") {
+        error = "Unsupported --order: " + config.run_order + " (supported: lexical, lpt, shortest, metadata)";
+        return false;
+    }
+    if ((config.run_order == "metadata") != !config.priority_terms.empty()) {
+        error = "--order metadata and --priority must be used together";
+        return false;
+    }
+
+    if (config.lease && !config.resume) {
+        error = "--lease needs resume (files finished by other processes are recognized by their output)";
+        return false;
+    }
+
+    if (config.n_batch < 0 || config.n_ubatch < 0 || (config.n_batch > 0 && config.n_ubatch > config.n_batch)) {
+        error = "--n-ubatch must be <= --n-batch (0 selects the default)";
+        return false;
+    }
+    if (config.backend != "llama" && config.backend != "mock") {
+        error = "Unsupported --backend: " + config.backend + " (supported: llama, mock)";
+        return false;
+    }
+    if (config.autotune && config.backend != "llama") {
+        error = "--autotune needs --backend llama";
+        return false;
+    }
+    if (config.autotune && config.input_path.empty()) {
+        error = "--autotune needs --input to sample from";
+        return false;
+    }
+    if (config.autotune && (!config.coordinator_endpoint.empty() || !config.worker_endpoint.empty())) {
+        error = "--autotune cannot be combined with --coordinator/--worker";
+        return false;
+    }
+#ifndef TEI_MT_TRACE
+    if (!config.trace_path.empty()) {
+        error = "--trace needs a build with HYMT_ENABLE_TRACE=ON";
+        return false;
+    }
+#endif
+    if (!config.report_path.empty() && (config.autotune || !config.worker_endpoint.empty())) {
+        error = "--report needs a translation run (not --autotune or --worker)";
+        return false;
+    }
+    if (!config.unit_log_path.empty()
+        && (config.autotune || !config.coordinator_endpoint.empty() || !config.worker_endpoint.empty())) {
+        error = "--unit-log needs a local translation run (not --autotune, --coordinator or --worker)";
         return false;
     }
 
@@ -291,3 +609,113 @@ bool parse_args(int argc, char** argv, AppConfig& config, std::string& error) {
 
     return true;
 }
+
+bool parse_merge_args(int argc, char** argv, MergeConfig& config, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            error = "help";
+            return false;
+        }
+
+        auto require_value = [&](const std::string& key) -> std::string {
+            if (i + 1 >= argc) {
+                error = "Missing value for " + key;
+                return {};
+            }
+            ++i;
+            return argv[i];
+        };
+
+        if (arg == "--input") {
+            config.input_path = require_value(arg);
+        } else if (arg == "--standoff") {
+            config.standoff_path = require_value(arg);
+        } else if (arg == "--output") {
+            config.output_dir = require_value(arg);
+        } else if (arg == "--overwrite-existing-translations") {
+            config.overwrite_existing_translations = true;
+        } else {
+            error = "Unknown merge argument: " + arg;
+            return false;
+        }
+
+        if (!error.empty()) {
+            return false;
+        }
+    }
+
+    if (config.input_path.empty()) {
+        error = "merge: --input is required";
+        return false;
+    }
+    if (config.standoff_path.empty()) {
+        error = "merge: --standoff is required";
+        return false;
+    }
+    return true;
+}
+
+bool parse_compile_args(int argc, char** argv, CompileConfig& config, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            error = "help";
+            return false;
+        }
+
+        auto require_value = [&](const std::string& key) -> std::string {
+            if (i + 1 >= argc) {
+                error = "Missing value for " + key;
+                return {};
+            }
+            ++i;
+            return argv[i];
+        };
+
+        if (arg == "--input") {
+            config.input_path = require_value(arg);
+        } else if (arg == "--output") {
+            config.output_path = require_value(arg);
+        } else if (arg == "--model") {
+            config.model_path = require_value(arg);
+        } else {
+            error = "Unknown compile argument: " + arg;
+            return false;
+        }
+
+        if (!error.empty()) {
+            return false;
+        }
+    }
+
+    if (config.input_path.empty()) {
+        error = "compile: --input is required";
+        return false;
+    }
+    if (config.output_path.empty()) {
+        error = "compile: --output is required";
+        return false;
+    }
+    return true;
+}
+
+bool write_profile(const std::filesystem::path& path, const AppConfig& config, const std::string& note, std::string& error) {
+    std::ostringstream out;
+    out << "# tei_mt tuning profile; load with --profile " << path.string() << "\n";
+    if (!note.empty()) {
+        out << "# " << note << "\n";
+    }
+    out << "workers=" << config.workers << "\n"
+        << "threads=" << config.n_threads << "\n"
+        << "decode-threads=" << config.decode_threads << "\n"
+        << "n-batch=" << config.n_batch << "\n"
+        << "n-ubatch=" << config.n_ubatch << "\n"
+        << "coalesce=" << (config.coalesce_segments ? "on" : "off") << "\n"
+        << "coalesce-max-batch=" << config.coalesce_max_batch << "\n"
+        << "coalesce-max-chars=" << config.coalesce_max_merged_chars << "\n"
+        << "ctx=" << config.n_ctx << "\n";
+    return write_file_atomically(path, out.view(), error);
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "cpu_topology.hpp"
+#include "mock_options.hpp"
+
+#include <cstdint>
 #include <filesystem>
 #include <string>
 #include <vector>
@@ -8,19 +12,77 @@ struct AppConfig {
     std::filesystem::path input_path;
     std::filesystem::path output_dir;
     std::string model_path;
+    /// `--backend <llama|mock>`: the mock needs no model and simulates costs from `mock` (`--mock-costs`).
+    std::string backend = "llama";
+    MockTranslatorConfig mock;
     std::size_t workers = 0;
     int max_tokens = 192;
     int n_ctx = 2048;
     /// Ceiling for automatic context growth (see LlamaTranslator).
     int max_n_ctx = 131072;
     int n_gpu_layers = -1;
-    /// 0 = derive from hardware_concurrency and workers after parsing (see config.cpp).
+    /// 0 = derive from the CPU topology and workers after parsing (see config.cpp).
     int n_threads = 0;
+    /// `--threads` as given, for re-planning threads when the memory plan lowers workers.
+    int requested_n_threads = 0;
+    /// Threads for single-token decode per worker (0 = auto, half of n_threads); prefill uses n_threads.
+    int decode_threads = 0;
+    /// llama.cpp logical / physical batch sizes (0 = translator defaults).
+    int n_batch = 0;
+    int n_ubatch = 0;
+    /// `--cache-type-k` / `--cache-type-v`: KV cache element types (f16, q8_0, q4_0, ...; see memory_plan.hpp).
+    std::string cache_type_k = "f16";
+    std::string cache_type_v = "f16";
+    /// `--memory-budget`: host bytes for model plus contexts (0 = unplanned); sizes workers, ctx and max ctx.
+    std::uint64_t memory_budget_bytes = 0;
+    /// `--autotune`: measure candidate settings on a sample of the input and write them to `autotune_out`.
+    bool autotune = false;
+    std::filesystem::path autotune_out = "tei_mt.profile";
+    int autotune_segments = 64;
+    /// `--pin <auto|on|off>`: pin each worker's llama threads to its own cores (auto = CPU-only runs).
+    std::string pin_threads = "auto";
+    /// Filled by parse_args: what was detected and how workers/threads were sized and placed.
+    CpuTopology cpu_topology;
+    ThreadPlan thread_plan;
     bool coalesce_segments = true;
     int coalesce_max_batch = 6;
     int coalesce_max_merged_chars = 2800;
     std::string tei_strategy = "note";
+    /// Windowed streaming unit (`div` or `juan`); empty = whole-document DOM mode.
+    std::string stream_windows;
+    /// Soft byte cap per streaming window (see TeiStreamOptions).
+    std::size_t stream_window_bytes = std::size_t{4} << 20;
+    /// Compiled segment store (`tei_mt compile`); fresh documents are read from it instead of parsed.
+    std::filesystem::path segment_store_path;
+    /// Run queue order: lexical, lpt, shortest or metadata (see RunOrder).
+    std::string run_order = "lexical";
+    /// `category=value` terms for `--order metadata`, highest priority first.
+    std::vector<std::string> priority_terms;
+    /// `--shard i/N`: only files whose path hash falls in shard `shard_index` of `shard_count`.
+    std::size_t shard_index = 0;
+    std::size_t shard_count = 1;
+    /// Claim each file with a lease in the output tree so several processes can share one corpus.
+    bool lease = false;
+    int lease_ttl_seconds = 300;
+    /// `--coordinator <endpoint>`: hand segments out to `--worker` processes instead of translating locally.
+    std::string coordinator_endpoint;
+    /// `--worker <endpoint>`: translate units from a coordinator; no input or output of its own.
+    std::string worker_endpoint;
+    int unit_segments = 32;
+    int unit_timeout_seconds = 900;
+    /// `--unit-retries <n>`: retries of a unit that throws before its segments are left untranslated (0 fails
+    /// the file, as before).
+    int unit_retries = 2;
     bool emit_markdown = false;
+    /// `--report <path>`: JSON run report (configuration, model, host, per-file and latency results).
+    std::filesystem::path report_path;
+    /// `--metrics <path>`: metrics exported every `metrics_interval_seconds` (Prometheus text, or JSON for `.json`).
+    std::filesystem::path metrics_path;
+    int metrics_interval_seconds = 15;
+    /// `--trace <path>`: Chrome trace-event timeline of every thread's spans, written at exit.
+    std::filesystem::path trace_path;
+    /// `--unit-log <path>`: JSONL record per translation unit (tokens, timings, context, fallbacks), appended to.
+    std::filesystem::path unit_log_path;
     bool show_progress = true;
     bool resume = true;
     bool overwrite_existing_translations = false;
@@ -34,5 +96,28 @@ struct AppConfig {
     std::vector<std::string> filter_origin;
 };
 
+/// `tei_mt merge`: splice standoff translations into copies of the source TEI.
+struct MergeConfig {
+    std::filesystem::path input_path;
+    /// Standoff file, or the output directory of a standoff run (mirrors the input tree).
+    std::filesystem::path standoff_path;
+    std::filesystem::path output_dir;
+    bool overwrite_existing_translations = false;
+};
+
+/// `tei_mt compile`: extract a corpus once into a segment store.
+struct CompileConfig {
+    std::filesystem::path input_path;
+    std::filesystem::path output_path;
+    /// Optional GGUF; when set its vocabulary pre-tokenizes segment text into the store.
+    std::string model_path;
+};
+
 void print_usage(const char* program_name);
 bool parse_args(int argc, char** argv, AppConfig& config, std::string& error);
+/// Write the tunable run options of `config` as a `--profile` file (atomically).
+bool write_profile(const std::filesystem::path& path, const AppConfig& config, const std::string& note, std::string& error);
+/// `argv[0]` is the subcommand name.
+bool parse_merge_args(int argc, char** argv, MergeConfig& config, std::string& error);
+/// `argv[0]` is the subcommand name.
+bool parse_compile_args(int argc, char** argv, CompileConfig& config, std::string& error);
@@ -0,0 +1,346 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+std::string read_first_line(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+bool read_int(const std::filesystem::path& path, int& out) {
+    try {
+        const std::string line = read_first_line(path);
+        if (line.empty()) {
+            return false;
+        }
+        out = std::stoi(line);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+/// Kernel CPU list syntax: `0-3,8,10-11`.
+std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        try {
+            const auto dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (...) {
+        }
+    }
+    return cpus;
+}
+
+#ifdef __linux__
+
+/// The process's cgroup v2 directory, or empty.
+std::filesystem::path cgroup_v2_dir() {
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.starts_with("0::")) {
+            return std::filesystem::path("/sys/fs/cgroup") / std::filesystem::path(line.substr(3)).relative_path();
+        }
+    }
+    return {};
+}
+
+/// Tightest `cpu.max` quota from the cgroup up to the root (each level limits everything below it).
+double cgroup_cpu_quota(const std::filesystem::path& dir) {
+    double quota = 0.0;
+    const std::filesystem::path root("/sys/fs/cgroup");
+    for (auto level = dir; !level.empty(); level = level.parent_path()) {
+        std::istringstream fields(read_first_line(level / "cpu.max"));
+        std::string max;
+        double period = 0.0;
+        if (fields >> max >> period && max != "max" && period > 0.0) {
+            try {
+                const double cpus = std::stod(max) / period;
+                quota = quota == 0.0 ? cpus : std::min(quota, cpus);
+            } catch (...) {
+            }
+        }
+        if (level == root || level == level.parent_path()) {
+            break;
+        }
+    }
+    return quota;
+}
+
+#endif
+
+}  // namespace
+
+std::size_t CpuTopology::physical_cores() const {
+    std::set<int> cores;
+    for (const auto& cpu : cpus) {
+        cores.insert(cpu.core);
+    }
+    return cores.size();
+}
+
+std::size_t CpuTopology::cache_domains() const {
+    std::set<int> domains;
+    for (const auto& cpu : cpus) {
+        domains.insert(cpu.cache_domain);
+    }
+    return domains.size();
+}
+
+CpuTopology detect_cpu_topology() {
+    CpuTopology topology;
+
+#ifdef __linux__
+    std::vector<int> allowed;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &mask)) {
+                allowed.push_back(cpu);
+            }
+        }
+    }
+
+    const auto cgroup = cgroup_v2_dir();
+    if (!cgroup.empty()) {
+        const auto cpuset = parse_cpu_list(read_first_line(cgroup / "cpuset.cpus.effective"));
+        if (!cpuset.empty()) {
+            std::erase_if(allowed, [&](int cpu) { return std::ranges::find(cpuset, cpu) == cpuset.end(); });
+        }
+        topology.cpu_quota = cgroup_cpu_quota(cgroup);
+    }
+
+    const std::filesystem::path sys("/sys/devices/system/cpu");
+    bool complete = !allowed.empty();
+    for (const int id : allowed) {
+        const auto dir = sys / ("cpu" + std::to_string(id));
+        LogicalCpu cpu;
+        cpu.id = id;
+        int core_id = 0;
+        int package = 0;
+        if (!read_int(dir / "topology/core_id", core_id) || !read_int(dir / "topology/physical_package_id", package)) {
+            complete = false;
+            break;
+        }
+        cpu.core = (package << 16) | (core_id & 0xFFFF);
+        cpu.cache_domain = -1;
+
+        std::error_code ec;
+        for (const auto& index : std::filesystem::directory_iterator(dir / "cache", ec)) {
+            int level = 0;
+            if (read_int(index.path() / "level", level) && level == 3) {
+                const auto sharing = parse_cpu_list(read_first_line(index.path() / "shared_cpu_list"));
+                if (!sharing.empty()) {
+                    cpu.cache_domain = *std::ranges::min_element(sharing);
+                }
+            }
+        }
+        if (cpu.cache_domain < 0) {
+            // No L3 information: NUMA node, then package. Offset so they cannot collide with CPU ids.
+            cpu.cache_domain = (1 << 20) + package;
+            for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                const auto name = entry.path().filename().string();
+                if (name.starts_with("node")) {
+                    try {
+                        cpu.cache_domain = (1 << 21) + std::stoi(name.substr(4));
+                    } catch (...) {
+                    }
+                }
+            }
+        }
+        topology.cpus.push_back(cpu);
+    }
+    topology.from_sysfs = complete;
+    if (!complete) {
+        topology.cpus.clear();
+        for (const int id : allowed) {
+            topology.cpus.push_back(LogicalCpu{.id = id, .core = id, .cache_domain = 0});
+        }
+    }
+#endif
+
+    if (topology.cpus.empty()) {
+        const unsigned hw = std::thread::hardware_concurrency();
+        for (unsigned id = 0; id < (hw == 0 ? 4u : hw); ++id) {
+            topology.cpus.push_back(LogicalCpu{.id = static_cast<int>(id), .core = static_cast<int>(id), .cache_domain = 0});
+        }
+    }
+    return topology;
+}
+
+ThreadPlan plan_threads(
+    const CpuTopology& topology,
+    std::size_t workers,
+    int n_threads,
+    int decode_threads,
+    bool gpu_offload,
+    bool pin
+) {
+    ThreadPlan plan;
+    std::size_t budget = std::max<std::size_t>(1, topology.physical_cores());
+    if (topology.cpu_quota > 0.0) {
+        budget = std::clamp<std::size_t>(static_cast<std::size_t>(std::floor(topology.cpu_quota)), 1, budget);
+    }
+    plan.budget = budget;
+
+    if (workers == 0) {
+        workers = gpu_offload
+            ? std::min<std::size_t>(2u, std::max<std::size_t>(1u, budget / 8))
+            : std::min<std::size_t>(4u, std::max<std::size_t>(1u, budget / 2));
+    }
+    if (n_threads <= 0) {
+        n_threads = static_cast<int>(std::max<std::size_t>(1, budget / workers));
+    }
+    // Oversubscription is the slowdown this avoids: shrink threads first, then workers.
+    while (workers * static_cast<std::size_t>(n_threads) > budget) {
+        if (n_threads > 1) {
+            --n_threads;
+        } else {
+            workers = budget;
+        }
+    }
+    plan.workers = workers;
+    plan.n_threads = n_threads;
+    plan.decode_threads = decode_threads <= 0 ? std::max(1, (n_threads + 1) / 2) : std::min(decode_threads, n_threads);
+
+    if (!pin || !topology.from_sysfs) {
+        return plan;
+    }
+
+    // Free physical cores per cache domain, each represented by its lowest logical CPU (SMT siblings stay idle).
+    std::map<int, std::vector<int>> domains;
+    std::set<int> seen_cores;
+    for (const auto& cpu : topology.cpus) {
+        if (seen_cores.insert(cpu.core).second) {
+            domains[cpu.cache_domain].push_back(cpu.id);
+        }
+    }
+
+    for (std::size_t w = 0; w < workers; ++w) {
+        std::vector<int> cpus;
+        while (cpus.size() < static_cast<std::size_t>(n_threads)) {
+            const std::size_t need = static_cast<std::size_t>(n_threads) - cpus.size();
+            // Best fit: the domain with the fewest free cores that still holds all we need, else the fullest one.
+            auto pick = domains.end();
+            for (auto it = domains.begin(); it != domains.end(); ++it) {
+                if (it->second.empty()) {
+                    continue;
+                }
+                if (pick == domains.end()) {
+                    pick = it;
+                    continue;
+                }
+                const bool fits = it->second.size() >= need;
+                const bool pick_fits = pick->second.size() >= need;
+                if (fits != pick_fits ? fits
+                                      : (fits ? it->second.size() < pick->second.size()
+                                              : it->second.size() > pick->second.size())) {
+                    pick = it;
+                }
+            }
+            if (pick == domains.end()) {
+                return plan;  // cannot happen while workers*threads <= cores; leave unpinned
+            }
+            const std::size_t take = std::min(need, pick->second.size());
+            cpus.insert(cpus.end(), pick->second.begin(), pick->second.begin() + static_cast<std::ptrdiff_t>(take));
+            pick->second.erase(pick->second.begin(), pick->second.begin() + static_cast<std::ptrdiff_t>(take));
+        }
+        plan.worker_cpus.push_back(std::move(cpus));
+    }
+
+    if (workers > 1 && plan.decode_threads < n_threads) {
+        for (std::size_t w = 0; w < workers; ++w) {
+            std::vector<int> wide = plan.worker_cpus[w];
+            for (std::size_t other = 0; other < workers; ++other) {
+                if (other != w) {
+                    const auto& cpus = plan.worker_cpus[other];
+                    wide.insert(wide.end(), cpus.begin() + plan.decode_threads, cpus.end());
+                }
+            }
+            std::ranges::sort(wide);
+            plan.worker_prefill_cpus.push_back(std::move(wide));
+        }
+    }
+    return plan;
+}
+
+std::string describe_thread_plan(const CpuTopology& topology, const ThreadPlan& plan) {
+    std::ostringstream out;
+    out << "[threads] cpus=" << topology.cpus.size() << " cores=" << topology.physical_cores()
+        << " cache_domains=" << topology.cache_domains() << " quota=";
+    if (topology.cpu_quota > 0.0) {
+        out << topology.cpu_quota;
+    } else {
+        out << "none";
+    }
+    out << " budget=" << plan.budget << " workers=" << plan.workers << " threads=" << plan.n_threads
+        << " decode_threads=" << plan.decode_threads << " pin=" << (plan.worker_cpus.empty() ? "off" : "on") << (topology.from_sysfs ? "" : " (no sysfs topology)")
+        << "\n";
+    for (std::size_t w = 0; w < plan.worker_cpus.size(); ++w) {
+        out << "[threads] worker " << w << " cpus=";
+        for (std::size_t i = 0; i < plan.worker_cpus[w].size(); ++i) {
+            out << (i == 0 ? "" : ",") << plan.worker_cpus[w][i];
+        }
+        if (w < plan.worker_prefill_cpus.size()) {
+            // Cores of the wide set that another worker may be computing on at the same time (its decode cores,
+            // which it also prefills on without the lease); 0 unless the plan is broken.
+            std::size_t overlap = 0;
+            for (const int cpu : plan.worker_prefill_cpus[w]) {
+                for (std::size_t other = 0; other < plan.worker_cpus.size(); ++other) {
+                    const auto& cpus = plan.worker_cpus[other];
+                    const auto own = cpus.begin() + std::min<std::ptrdiff_t>(plan.decode_threads, std::ssize(cpus));
+                    if (other != w && std::find(cpus.begin(), own, cpu) != own) {
+                        ++overlap;
+                    }
+                }
+            }
+            out << " prefill_borrow=" << plan.worker_prefill_cpus[w].size() << " prefill_overlap=" << overlap;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+bool pin_current_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (const int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &mask);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
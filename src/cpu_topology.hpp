@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// One logical CPU this process may run on.
+struct LogicalCpu {
+    int id = 0;
+    /// Physical core (package << 16 | core_id); SMT siblings share it.
+    int core = 0;
+    /// Last-level cache domain: the first CPU sharing its L3, else its NUMA node, else its package.
+    int cache_domain = 0;
+};
+
+struct CpuTopology {
+    /// CPUs allowed by the affinity mask and cgroup cpuset, sorted by id.
+    std::vector<LogicalCpu> cpus;
+    /// cgroup v2 `cpu.max` quota in CPUs along the process's cgroup path (0 = unlimited).
+    double cpu_quota = 0.0;
+    /// False when sysfs was unavailable and every CPU was assumed to be its own core (no pinning then).
+    bool from_sysfs = false;
+
+    std::size_t physical_cores() const;
+    std::size_t cache_domains() const;
+};
+
+CpuTopology detect_cpu_topology();
+
+struct ThreadPlan {
+    std::size_t workers = 1;
+    /// Threads per worker for prompt prefill (batched, compute-bound).
+    int n_threads = 1;
+    /// Threads per worker for single-token decode (latency/memory-bound); the first of the worker's cores.
+    int decode_threads = 1;
+    /// Physical cores the plan may keep busy: usable cores, capped by the cgroup quota.
+    std::size_t budget = 1;
+    /// Per worker, the logical CPUs its llama threads are pinned to (one per physical core); empty = unpinned.
+    std::vector<std::vector<int>> worker_cpus;
+    /// Per worker, its own cores plus every other worker's non-decode cores: the wide set a worker borrows for a
+    /// prefill while it holds the shared prefill lease. Workers without the lease then prefill on their decode
+    /// cores only, so the sets never overlap. Empty unless pinned with more than one worker.
+    std::vector<std::vector<int>> worker_prefill_cpus;
+};
+
+/// Size workers and llama threads (0 = auto) so that workers*threads fits the budget of physical cores, and when
+/// `pin` give each worker a disjoint set of cores, kept inside one cache domain where it fits. `decode_threads`
+/// (0 = auto: half the worker's threads) is clamped to n_threads.
+ThreadPlan plan_threads(
+    const CpuTopology& topology,
+    std::size_t workers,
+    int n_threads,
+    int decode_threads,
+    bool gpu_offload,
+    bool pin
+);
+
+/// `[threads]` lines describing the topology and the plan.
+std::string describe_thread_plan(const CpuTopology& topology, const ThreadPlan& plan);
+
+/// Restrict the calling thread to `cpus`; false where unsupported.
+bool pin_current_thread(const std::vector<int>& cpus);
@@ -0,0 +1,28 @@
+#include "failed_segments.hpp"
+
+#include "atomic_file.hpp"
+
+#include <nlohmann/json.hpp>
+
+std::filesystem::path failed_segments_path_for(const std::filesystem::path& tei_path) {
+    std::filesystem::path out = tei_path;
+    out.replace_extension(".failed.json");
+    return out;
+}
+
+bool write_failed_segments(
+    const std::filesystem::path& path,
+    const std::string& source_name,
+    const std::vector<FailedSegment>& failed,
+    std::string& error
+) {
+    nlohmann::ordered_json segments = nlohmann::ordered_json::array();
+    for (const auto& segment : failed) {
+        segments.push_back({{"key", segment.key}, {"error", segment.error}});
+    }
+    const nlohmann::ordered_json list{{"source", source_name}, {"failed", std::move(segments)}};
+
+    return write_file_atomically(
+        path, list.dump(2, ' ', false, nlohmann::json::error_handler_t::replace) + "\n", error
+    );
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// Segments a run left untranslated after every retry of their unit (see UnitRetryPolicy), kept next to the
+/// file's output. The output itself is complete apart from those segments, which get no note (or no standoff
+/// record). While the list exists, a `--resume` run translates just the missing segments into the existing
+/// output; a run that leaves none behind removes it.
+///
+///   {"source":"T01n0001.xml","failed":[{"key":"pT01p0001a0101","error":"llama_decode failed"}]}
+
+/// `<dir>/<stem>.failed.json` for a TEI output path `<dir>/<stem>.xml`.
+std::filesystem::path failed_segments_path_for(const std::filesystem::path& tei_path);
+
+/// Write the list atomically (`<path>.part` + rename).
+bool write_failed_segments(
+    const std::filesystem::path& path,
+    const std::string& source_name,
+    const std::vector<FailedSegment>& failed,
+    std::string& error
+);
@@ -0,0 +1,181 @@
+#include "file_claim.hpp"
+
+#include "fnv1a.hpp"
+#include "host_info.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+long process_id() {
+#ifdef _WIN32
+    return static_cast<long>(_getpid());
+#else
+    return static_cast<long>(::getpid());
+#endif
+}
+
+/// First line of a lease file: `owner <id>`.
+std::string read_lease_owner(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    std::string word;
+    std::string owner;
+    if (in >> word >> owner && word == "owner") {
+        return owner;
+    }
+    return {};
+}
+
+bool lease_expired(const std::filesystem::path& path, std::chrono::seconds ttl) {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    return std::filesystem::file_time_type::clock::now() - mtime > ttl;
+}
+
+}  // namespace
+
+std::size_t shard_for_key(std::string_view key, std::size_t shard_count) {
+    return shard_count <= 1 ? 0 : static_cast<std::size_t>(fnv1a64(key) % shard_count);
+}
+
+std::string lease_owner_id() {
+    std::random_device rd;
+    std::ostringstream id;
+    id << host_name() << ':' << process_id() << ':' << std::hex << rd();
+    return id.str();
+}
+
+std::filesystem::path lease_path_for(const std::filesystem::path& output_path) {
+    return output_path.string() + ".lease";
+}
+
+FileLease::~FileLease() {
+    release();
+}
+
+bool FileLease::write_lease(std::string& error) const {
+    std::ofstream out(path_, std::ios::trunc);
+    const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    );
+    out << "owner " << owner_ << "\nheartbeat_unix_ms " << now.count() << "\n";
+    out.flush();
+    if (!out) {
+        error = "Failed to write lease: " + path_.string();
+        return false;
+    }
+    return true;
+}
+
+LeaseClaim FileLease::acquire(
+    const std::filesystem::path& lease_path,
+    const std::string& owner,
+    std::chrono::seconds ttl,
+    std::string& error
+) {
+    release();
+    path_ = lease_path;
+    owner_ = owner;
+    ttl_ = ttl;
+    reclaimed_ = false;
+    lost_ = false;
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        {
+            // Exclusive create: exactly one process wins a free lease.
+            std::ofstream create(path_, std::ios::out | std::ios::noreplace);
+            if (create.is_open()) {
+                create.close();
+                if (!write_lease(error)) {
+                    std::error_code ec;
+                    std::filesystem::remove(path_, ec);
+                    return LeaseClaim::Error;
+                }
+                held_ = true;
+                heartbeat_ = std::jthread([this](std::stop_token stop) { heartbeat_loop(stop); });
+                return LeaseClaim::Acquired;
+            }
+        }
+
+        std::error_code ec;
+        if (!std::filesystem::exists(path_, ec)) {
+            if (ec) {
+                error = "Failed to create lease: " + path_.string() + " (" + ec.message() + ")";
+                return LeaseClaim::Error;
+            }
+            continue;  // released between our create and the check
+        }
+        if (attempt > 0 || !lease_expired(path_, ttl_)) {
+            return LeaseClaim::Busy;
+        }
+
+        // Reclaim: move the stale lease aside atomically, so of several reclaimers only one gets it, then make
+        // sure what we moved is still the stale lease (not one a faster reclaimer just created).
+        const std::filesystem::path aside = path_.string() + ".reclaim-" + owner_;
+        std::filesystem::rename(path_, aside, ec);
+        if (ec) {
+            continue;
+        }
+        if (!lease_expired(aside, ttl_)) {
+            // Put the live lease back without replacing one a third process may have created meanwhile: a hard
+            // link fails if the path exists. If it cannot be restored, its owner's heartbeat reports it lost.
+            std::filesystem::create_hard_link(aside, path_, ec);
+            std::filesystem::remove(aside, ec);
+            return LeaseClaim::Busy;
+        }
+        std::filesystem::remove(aside, ec);
+        reclaimed_ = true;
+    }
+    return LeaseClaim::Busy;
+}
+
+void FileLease::heartbeat_loop(std::stop_token stop) {
+    const auto interval = std::max<std::chrono::milliseconds>(std::chrono::milliseconds(500), ttl_ / 4);
+    std::unique_lock lock(mutex_);
+    while (!stop.stop_requested()) {
+        wake_.wait_for(lock, stop, interval, [] { return false; });
+        if (stop.stop_requested()) {
+            return;
+        }
+        if (read_lease_owner(path_) != owner_) {
+            lost_ = true;
+            return;
+        }
+        std::string error;
+        write_lease(error);
+    }
+}
+
+void FileLease::release() {
+    if (!held_) {
+        return;
+    }
+    if (heartbeat_.joinable()) {
+        heartbeat_.request_stop();
+        heartbeat_.join();
+    }
+    held_ = false;
+
+    // Never delete a lease someone else has taken over.
+    if (read_lease_owner(path_) == owner_) {
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+    }
+}
+
+bool FileLease::lost() const {
+    std::lock_guard lock(mutex_);
+    return lost_;
+}
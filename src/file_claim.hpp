@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/// Deterministic shard of a file key (relative input path): stable across hosts and runs.
+std::size_t shard_for_key(std::string_view key, std::size_t shard_count);
+
+/// `host:pid:nonce`, unique per process; written into lease files.
+std::string lease_owner_id();
+
+/// Lease file next to an output (`<output>.lease`).
+std::filesystem::path lease_path_for(const std::filesystem::path& output_path);
+
+enum class LeaseClaim {
+    Acquired,
+    /// Another live process holds the lease.
+    Busy,
+    Error,
+};
+
+/// Exclusive claim on one file among processes sharing an output tree. The lease file is created atomically
+/// (exclusive create), kept alive by a heartbeat thread that rewrites it every ttl/4, and removed on release.
+/// A lease whose mtime is older than the TTL belongs to a crashed process and may be reclaimed.
+class FileLease {
+public:
+    FileLease() = default;
+    ~FileLease();
+    FileLease(const FileLease&) = delete;
+    FileLease& operator=(const FileLease&) = delete;
+
+    LeaseClaim acquire(
+        const std::filesystem::path& lease_path,
+        const std::string& owner,
+        std::chrono::seconds ttl,
+        std::string& error
+    );
+    void release();
+
+    bool held() const { return held_; }
+    /// True when acquire() took over an expired lease.
+    bool reclaimed() const { return reclaimed_; }
+    /// True if the heartbeat found the lease gone or owned by someone else (our work may be duplicated).
+    bool lost() const;
+
+private:
+    bool write_lease(std::string& error) const;
+    void heartbeat_loop(std::stop_token stop);
+
+    std::filesystem::path path_;
+    std::string owner_;
+    std::chrono::seconds ttl_{0};
+    bool held_ = false;
+    bool reclaimed_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any wake_;
+    bool lost_ = false;
+    std::jthread heartbeat_;
+};
@@ -0,0 +1,207 @@
+#include "file_scan.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+struct DirIdentity {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+
+    bool operator==(const DirIdentity&) const = default;
+};
+
+#ifndef _WIN32
+std::optional<DirIdentity> dir_identity(const std::filesystem::path& path) {
+    struct stat st {};
+    if (::stat(path.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+    return DirIdentity{static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino)};
+}
+#endif
+
+/// True when `dir` is the excluded output directory.
+bool is_excluded(const std::filesystem::path& dir, const std::filesystem::path& exclude_dir, const void* exclude_identity) {
+    if (exclude_identity == nullptr) {
+        return false;
+    }
+#ifdef _WIN32
+    // No cheap inode on Windows; equivalent() opens both handles, but only once per directory.
+    std::error_code ec;
+    return std::filesystem::equivalent(dir, exclude_dir, ec);
+#else
+    (void)exclude_dir;
+    const auto identity = dir_identity(dir);
+    return identity && *identity == *static_cast<const DirIdentity*>(exclude_identity);
+#endif
+}
+
+}  // namespace
+
+void InputFileQueue::push(std::vector<std::filesystem::path> files) {
+    if (files.empty()) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        discovered_ += files.size();
+        for (auto& file : files) {
+            files_.push_back(std::move(file));
+        }
+    }
+    ready_.notify_all();
+}
+
+void InputFileQueue::close() {
+    {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+    }
+    ready_.notify_all();
+}
+
+bool InputFileQueue::pop(std::filesystem::path& out) {
+    std::unique_lock lock(mutex_);
+    ready_.wait(lock, [&] { return !files_.empty() || closed_; });
+    if (files_.empty()) {
+        return false;
+    }
+    out = std::move(files_.front());
+    files_.pop_front();
+    return true;
+}
+
+std::size_t InputFileQueue::discovered() const {
+    std::lock_guard lock(mutex_);
+    return discovered_;
+}
+
+bool InputFileQueue::closed() const {
+    std::lock_guard lock(mutex_);
+    return closed_;
+}
+
+bool scan_directory_parallel(
+    const std::filesystem::path& root,
+    const std::filesystem::path& exclude_dir,
+    std::size_t threads,
+    const std::function<bool(const std::filesystem::path&)>& accept,
+    const std::function<void(std::vector<std::filesystem::path>&&)>& on_files,
+    FileScanStats& stats,
+    std::string& error
+) {
+    stats = {};
+    std::error_code ec;
+    if (!std::filesystem::is_directory(root, ec)) {
+        error = "Input path is not a directory: " + root.string();
+        return false;
+    }
+
+    const void* exclude_identity = nullptr;
+#ifdef _WIN32
+    static const int kExcludeMarker = 0;
+    if (!exclude_dir.empty() && std::filesystem::is_directory(exclude_dir, ec)) {
+        exclude_identity = &kExcludeMarker;
+    }
+#else
+    const auto exclude = exclude_dir.empty() ? std::nullopt : dir_identity(exclude_dir);
+    if (exclude) {
+        exclude_identity = &*exclude;
+    }
+#endif
+
+    if (threads == 0) {
+        const unsigned hw = std::thread::hardware_concurrency();
+        threads = std::clamp<std::size_t>(hw == 0 ? 4u : hw, 2u, 8u);
+    }
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::deque<std::filesystem::path> pending{root};
+    // Directories queued or being listed; the scan is finished when this reaches zero.
+    std::size_t outstanding = 1;
+    std::mutex emit_mutex;
+
+    const auto worker = [&] {
+        std::vector<std::filesystem::path> files;
+        std::vector<std::filesystem::path> subdirs;
+        while (true) {
+            std::filesystem::path dir;
+            {
+                std::unique_lock lock(mutex);
+                work_ready.wait(lock, [&] { return !pending.empty() || outstanding == 0; });
+                if (pending.empty()) {
+                    return;
+                }
+                dir = std::move(pending.front());
+                pending.pop_front();
+            }
+
+            files.clear();
+            subdirs.clear();
+            bool listed = true;
+            std::error_code dir_ec;
+            std::filesystem::directory_iterator it(dir, dir_ec);
+            if (dir_ec) {
+                listed = false;
+            }
+            for (; !dir_ec && it != std::filesystem::directory_iterator(); it.increment(dir_ec)) {
+                const auto& entry = *it;
+                std::error_code entry_ec;
+                if (entry.is_directory(entry_ec) && !entry.is_symlink(entry_ec)) {
+                    if (!is_excluded(entry.path(), exclude_dir, exclude_identity)) {
+                        subdirs.push_back(entry.path());
+                    }
+                } else if (entry.is_regular_file(entry_ec) && accept(entry.path())) {
+                    files.push_back(entry.path());
+                }
+            }
+            if (dir_ec) {
+                listed = false;
+            }
+
+            std::sort(files.begin(), files.end());
+            const std::size_t found = files.size();
+            {
+                std::lock_guard lock(emit_mutex);
+                if (!files.empty()) {
+                    on_files(std::move(files));
+                    files = {};
+                }
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                ++stats.directories;
+                stats.files += found;
+                if (!listed) {
+                    ++stats.skipped_directories;
+                }
+                for (auto& subdir : subdirs) {
+                    pending.push_back(std::move(subdir));
+                }
+                outstanding += subdirs.size();
+                --outstanding;
+            }
+            work_ready.notify_all();
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(worker);
+        }
+    }
+    return true;
+}
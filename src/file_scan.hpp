@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Files handed from a running scan to the translation loop. The producer closes it when the scan is done.
+class InputFileQueue {
+public:
+    void push(std::vector<std::filesystem::path> files);
+    void close();
+    /// Blocks until a file is available; false once the queue is closed and drained.
+    bool pop(std::filesystem::path& out);
+    /// Files pushed so far (the final total once closed()).
+    std::size_t discovered() const;
+    bool closed() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::filesystem::path> files_;
+    std::size_t discovered_ = 0;
+    bool closed_ = false;
+};
+
+struct FileScanStats {
+    std::size_t directories = 0;
+    std::size_t files = 0;
+    /// Directories that could not be listed (permissions, vanished while scanning).
+    std::size_t skipped_directories = 0;
+};
+
+/// Walk `root` with `threads` workers (0 = auto), one directory per task. `exclude_dir` (if it exists) is pruned
+/// by device/inode identity, so no entry path is canonicalized. `on_files` receives each directory's accepted files,
+/// sorted, one call at a time. Directory symlinks are not followed.
+bool scan_directory_parallel(
+    const std::filesystem::path& root,
+    const std::filesystem::path& exclude_dir,
+    std::size_t threads,
+    const std::function<bool(const std::filesystem::path&)>& accept,
+    const std::function<void(std::vector<std::filesystem::path>&&)>& on_files,
+    FileScanStats& stats,
+    std::string& error
+);
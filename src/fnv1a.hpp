@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+inline constexpr std::uint64_t kFnv1a64Offset = 14695981039346656037ull;
+
+/// 64-bit FNV-1a over `bytes`, continuing from `hash` (chain calls to hash several pieces). Stable across builds
+/// and platforms; used for shard keys, source hashes and fingerprints, so it must never change.
+constexpr std::uint64_t fnv1a64(std::string_view bytes, std::uint64_t hash = kFnv1a64Offset) {
+    for (const char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
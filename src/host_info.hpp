@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+/// This machine's name, or "host" when the OS will not say. Identifies lease owners and run reports.
+std::string host_name();
@@ -1,15 +1,32 @@
 #include "config.hpp"
+#include "failed_segments.hpp"
+#include "file_claim.hpp"
+#include "file_scan.hpp"
+#include "memory_plan.hpp"
+#include "metrics.hpp"
 #include "pipeline.hpp"
+#include "run_control.hpp"
+#include "run_order.hpp"
+#include "run_report.hpp"
+#include "segment_store.hpp"
 #include "sorting_filter.hpp"
+#include "standoff.hpp"
 #include "tei_reader.hpp"
+#include "tei_stream.hpp"
+#include "trace.hpp"
 #include "translator_llama.hpp"
+#include "translator_mock.hpp"
+#include "unit_log.hpp"
+#include "work_coordinator.hpp"
 #include "writer_md.hpp"
 #include "writer_tei.hpp"
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <exception>
 #include <filesystem>
 #include <fstream>
@@ -151,12 +168,7 @@ std::string trim_copy(std::string s) {
     return std::string(first, last);
 }
 
-enum class DrilldownCategory {
-    Canon,
-    Tradition,
-    Period,
-    Origin,
-};
+using DrilldownCategory = SortingCategory;
 
 std::string category_label(DrilldownCategory category) {
     switch (category) {
@@ -290,77 +302,6 @@ bool build_filters_from_drilldown_terms(
     return true;
 }
 
-std::vector<std::filesystem::path> apply_sorting_filters(
-    const std::vector<std::filesystem::path>& files,
-    const SortingMetadataIndex& metadata_index,
-    const std::filesystem::path& input_root,
-    bool input_is_dir,
-    const SortingFilters& filters
-) {
-    std::vector<std::filesystem::path> out;
-    out.reserve(files.size());
-    for (const auto& file : files) {
-        if (metadata_index.match(file, input_root, input_is_dir, filters)) {
-            out.push_back(file);
-        }
-    }
-    return out;
-}
-
-std::vector<std::pair<std::string, std::size_t>> count_by_category(
-    const std::vector<std::filesystem::path>& files,
-    const SortingMetadataIndex& metadata_index,
-    const std::filesystem::path& input_root,
-    bool input_is_dir,
-    DrilldownCategory category
-) {
-    std::unordered_map<std::string, std::size_t> counts;
-
-    for (const auto& file : files) {
-        const auto* rec = metadata_index.lookup(file, input_root, input_is_dir);
-        if (rec == nullptr) {
-            continue;
-        }
-
-        if (category == DrilldownCategory::Tradition) {
-            std::vector<std::string> values = rec->traditions;
-            if (values.empty()) {
-                values.push_back("Unknown Tradition");
-            }
-            std::sort(values.begin(), values.end());
-            values.erase(std::unique(values.begin(), values.end()), values.end());
-            for (const auto& value : values) {
-                const auto label = value.empty() ? "Unknown Tradition" : value;
-                ++counts[label];
-            }
-            continue;
-        }
-
-        std::string value;
-        if (category == DrilldownCategory::Canon) {
-            value = rec->canon.empty() ? "Unknown" : rec->canon;
-        } else if (category == DrilldownCategory::Period) {
-            value = rec->period.empty() ? "Unknown Period" : rec->period;
-        } else if (category == DrilldownCategory::Origin) {
-            value = rec->origin.empty() ? "Unknown Origin" : rec->origin;
-        }
-        ++counts[value];
-    }
-
-    std::vector<std::pair<std::string, std::size_t>> out;
-    out.reserve(counts.size());
-    for (const auto& [key, count] : counts) {
-        out.push_back({key, count});
-    }
-    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
-        if (a.second != b.second) {
-            return a.second > b.second;
-        }
-        return a.first < b.first;
-    });
-    return out;
-}
-
 void print_options_with_counts(
     const std::vector<std::pair<std::string, std::size_t>>& options
 ) {
@@ -372,12 +313,7 @@ void print_options_with_counts(
     }
 }
 
-void print_drilldown_help_for_dataset(
-    const std::vector<std::filesystem::path>& files,
-    const SortingMetadataIndex& metadata_index,
-    const std::filesystem::path& input_root,
-    bool input_is_dir
-) {
+void print_drilldown_help_for_dataset(const SortingFileIndex& file_index) {
     const std::vector<DrilldownCategory> categories = {
         DrilldownCategory::Tradition,
         DrilldownCategory::Period,
@@ -404,19 +340,13 @@ void print_drilldown_help_for_dataset(
     }
     std::cout << "\n";
 
-    std::size_t matched_records = 0;
-    for (const auto& file : files) {
-        if (metadata_index.lookup(file, input_root, input_is_dir) != nullptr) {
-            ++matched_records;
-        }
-    }
     std::cout << "Dataset scope:\n";
-    std::cout << "  input XML files: " << files.size() << "\n";
-    std::cout << "  files with metadata records: " << matched_records << "\n\n";
+    std::cout << "  input XML files: " << file_index.files().size() << "\n";
+    std::cout << "  files with metadata records: " << file_index.with_metadata().count() << "\n\n";
 
     for (const auto category : categories) {
         std::cout << category_label(category) << " subcategories:\n";
-        const auto options = count_by_category(files, metadata_index, input_root, input_is_dir, category);
+        const auto options = file_index.facet_counts(category, file_index.with_metadata());
         print_options_with_counts(options);
         std::cout << "\n";
     }
@@ -494,10 +424,7 @@ bool prompt_index_choice(
 }
 
 bool interactive_drilldown_select(
-    const SortingMetadataIndex& metadata_index,
-    const std::filesystem::path& input_root,
-    bool input_is_dir,
-    const std::vector<std::filesystem::path>& all_files,
+    const SortingFileIndex& file_index,
     SortingFilters& out_filters,
     std::vector<std::filesystem::path>& out_files,
     bool& cancelled,
@@ -505,7 +432,8 @@ bool interactive_drilldown_select(
 ) {
     cancelled = false;
     out_filters = {};
-    out_files = all_files;
+    out_files.clear();
+    SortingBitset selection = file_index.with_metadata();
 
     const std::vector<DrilldownCategory> categories = {
         DrilldownCategory::Tradition,
@@ -526,7 +454,7 @@ bool interactive_drilldown_select(
     }
     const auto primary_category = categories[primary_category_index];
 
-    const auto primary_options = count_by_category(out_files, metadata_index, input_root, input_is_dir, primary_category);
+    const auto primary_options = file_index.facet_counts(primary_category, selection);
     if (primary_options.empty()) {
         error = "No metadata buckets available for selected primary category.";
         return false;
@@ -541,7 +469,7 @@ bool interactive_drilldown_select(
     const auto& primary_value = primary_options[primary_value_index].first;
     const auto primary_count = primary_options[primary_value_index].second;
     add_filter_value(out_filters, primary_category, primary_value);
-    out_files = apply_sorting_filters(all_files, metadata_index, input_root, input_is_dir, out_filters);
+    selection = file_index.select(out_filters);
 
     std::cout
         << "[drilldown] selected "
@@ -570,7 +498,7 @@ bool interactive_drilldown_select(
             return false;
         }
         const auto secondary_category = secondary_categories[secondary_category_index];
-        const auto secondary_options = count_by_category(out_files, metadata_index, input_root, input_is_dir, secondary_category);
+        const auto secondary_options = file_index.facet_counts(secondary_category, selection);
         if (secondary_options.empty()) {
             error = "No metadata buckets available for selected secondary category.";
             return false;
@@ -590,7 +518,7 @@ bool interactive_drilldown_select(
         const auto secondary_count = secondary_options[secondary_value_index].second;
 
         add_filter_value(out_filters, secondary_category, secondary_value);
-        out_files = apply_sorting_filters(all_files, metadata_index, input_root, input_is_dir, out_filters);
+        selection = file_index.select(out_filters);
 
         std::cout
             << "[drilldown] selected "
@@ -598,6 +526,7 @@ bool interactive_drilldown_select(
             << " -> " << secondary_count << " files in subcategory\n";
     }
 
+    out_files = file_index.files_in(selection);
     if (out_files.empty()) {
         error = "Drill-down matched zero files.";
         return false;
@@ -650,21 +579,19 @@ bool collect_input_files(
         return false;
     }
 
-    std::error_code ec;
-    const auto input_abs = std::filesystem::weakly_canonical(input, ec);
-    const auto output_abs = std::filesystem::weakly_canonical(output_dir, ec);
-    const bool skip_output_subtree = !ec && output_abs.string().starts_with(input_abs.string());
-
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
-        if (entry.is_regular_file() && has_xml_extension(entry.path())) {
-            if (skip_output_subtree) {
-                const auto entry_abs = std::filesystem::weakly_canonical(entry.path(), ec);
-                if (!ec && entry_abs.string().starts_with(output_abs.string())) {
-                    continue;
-                }
-            }
-            out_files.push_back(entry.path());
-        }
+    FileScanStats stats;
+    if (!scan_directory_parallel(
+            input,
+            output_dir,
+            0,
+            has_xml_extension,
+            [&](std::vector<std::filesystem::path>&& files) {
+                out_files.insert(out_files.end(), files.begin(), files.end());
+            },
+            stats,
+            error
+        )) {
+        return false;
     }
 
     std::sort(out_files.begin(), out_files.end());
@@ -763,15 +690,21 @@ std::string format_progress_bar(double ratio, std::size_t width) {
     return bar;
 }
 
+/// `total_final` is false while a streaming scan is still discovering files; the total and percentage are then
+/// provisional and shown as such.
 void print_progress(
     std::size_t file_index,
     std::size_t total_files,
+    bool total_final,
     std::size_t done_segments,
     std::size_t total_segments,
     const std::string& current_file,
     bool done
 ) {
     if (total_files == 0) {
+        if (!total_final) {
+            std::cerr << "\r[scanning...] files 0/0+" << std::flush;
+        }
         return;
     }
 
@@ -793,8 +726,8 @@ void print_progress(
         << "\r["
         << format_progress_bar(overall_fraction, 30)
         << "] "
-        << std::setw(3) << pct << "% "
-        << "files " << file_index << "/" << total_files
+        << (total_final ? "" : "~") << std::setw(3) << pct << "% "
+        << "files " << file_index << "/" << total_files << (total_final ? "" : "+ (scanning)")
         << " segments " << done_segments << "/" << total_segments
         << " " << current_file;
 
@@ -843,8 +776,10 @@ bool should_resume_skip_file(
     const std::filesystem::path& output_xml,
     std::size_t expected_segments,
     bool resume_enabled,
+    bool streaming,
     std::string& reason
 ) {
+    TEI_MT_TRACE_SCOPE("resume_check");
     if (!resume_enabled || !std::filesystem::exists(output_xml)) {
         return false;
     }
@@ -868,7 +803,12 @@ bool should_resume_skip_file(
     }
 
     std::string parse_error;
-    const std::size_t note_count = count_translation_notes_en(output_xml, parse_error);
+    std::size_t note_count = 0;
+    if (streaming) {
+        count_translation_notes_streaming(output_xml, note_count, parse_error);
+    } else {
+        note_count = count_translation_notes_en(output_xml, parse_error);
+    }
     if (!parse_error.empty()) {
         reason = parse_error;
         return false;
@@ -883,48 +823,312 @@ bool should_resume_skip_file(
     return false;
 }
 
-}  // namespace
+using SegmentTranslateFn = std::function<bool(
+    const std::vector<Segment>&,
+    std::vector<std::string>&,
+    TranslationStats&,
+    std::string&,
+    const std::function<void(std::size_t, std::size_t)>&,
+    const SegmentDoneCallback&
+)>;
+
+/// Translate only the segments for which `recorded` returns no translation. `translations` receives recorded and
+/// new translations, parallel to `segments`; `on_translated` sees each new one as soon as its unit finishes, and
+/// failed segments in `stats` are indexed by `segments`.
+bool translate_missing_segments(
+    const std::vector<Segment>& segments,
+    const std::function<const std::string*(std::size_t)>& recorded,
+    const SegmentTranslateFn& translate,
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    const std::function<void(const Segment&, const std::string&)>& on_translated,
+    std::vector<std::string>& translations,
+    TranslationStats& stats,
+    std::string& error
+) {
+    stats = TranslationStats{};
+    translations.assign(segments.size(), {});
+
+    std::vector<Segment> pending;
+    std::vector<std::size_t> pending_slots;
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        if (const std::string* translation = recorded(i)) {
+            translations[i] = *translation;
+        } else {
+            pending.push_back(segments[i]);
+            pending_slots.push_back(i);
+        }
+    }
+    if (pending.empty()) {
+        return true;
+    }
 
-int main(int argc, char** argv) {
-    AppConfig config;
-    std::string error;
+    std::vector<std::string> pending_out;
+    SegmentDoneCallback segment_done;
+    if (on_translated) {
+        segment_done = [&](std::size_t i) {
+            on_translated(pending[i], pending_out[i]);
+        };
+    }
+    if (!translate(pending, pending_out, stats, error, progress_callback, segment_done)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+        translations[pending_slots[i]] = std::move(pending_out[i]);
+    }
+    for (auto& failed : stats.failed_segments) {
+        failed.index = pending_slots[failed.index];
+    }
+    return true;
+}
 
-    if (!parse_args(argc, argv, config, error)) {
-        if (error != "help") {
-            std::cerr << "Argument error: " << error << "\n\n";
+/// Standoff strategy: translate only segments without a current record in `log`, appending each result as soon
+/// as its unit finishes. `translations` receives recorded and new translations, parallel to `segments`.
+bool translate_segments_standoff(
+    const std::vector<Segment>& segments,
+    StandoffLog& log,
+    const SegmentTranslateFn& translate,
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    std::vector<std::string>& translations,
+    TranslationStats& stats,
+    std::string& error
+) {
+    return translate_missing_segments(
+        segments,
+        [&](std::size_t i) { return log.find(segments[i]); },
+        translate,
+        progress_callback,
+        [&](const Segment& segment, const std::string& translation) { log.append(segment, translation); },
+        translations,
+        stats,
+        error
+    );
+}
+
+/// Fill mode (see failed_segments.hpp): `doc` is a partial output of an earlier run; translate the segments that
+/// have no translation note yet. `translations` also receives the existing notes' text.
+bool translate_segments_filling(
+    const TeiDocument& doc,
+    const SegmentTranslateFn& translate,
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    std::vector<std::string>& translations,
+    TranslationStats& stats,
+    std::string& error
+) {
+    std::vector<std::string> existing(doc.segments.size());
+    std::vector<char> has_note(doc.segments.size());
+    for (std::size_t i = 0; i < doc.segments.size(); ++i) {
+        has_note[i] = existing_translation_note(doc, i, existing[i]);
+    }
+    return translate_missing_segments(
+        doc.segments,
+        [&](std::size_t i) { return has_note[i] ? &existing[i] : nullptr; },
+        translate,
+        progress_callback,
+        {},
+        translations,
+        stats,
+        error
+    );
+}
+
+/// Remove the entries of failed segments (sorted indices into `items`), the way merge drops segments without a
+/// standoff record, so that the TEI writer leaves them without a note.
+template <typename T>
+void erase_failed_segments(std::vector<T>& items, const std::vector<FailedSegment>& failed) {
+    std::size_t next_failed = 0;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        if (next_failed < failed.size() && failed[next_failed].index == i) {
+            ++next_failed;
+            continue;
         }
-        print_usage(argv[0]);
-        return error == "help" ? 0 : 1;
+        if (kept != i) {
+            items[kept] = std::move(items[i]);
+        }
+        ++kept;
+    }
+    items.erase(items.begin() + static_cast<std::ptrdiff_t>(kept), items.end());
+}
+
+/// Markdown stand-in for a segment left untranslated; the TEI output gets no note for it.
+void mark_failed_segments(std::vector<std::string>& translations, const std::vector<FailedSegment>& failed) {
+    for (const auto& segment : failed) {
+        translations[segment.index] = "[untranslated: " + segment.error + "]";
+    }
+}
+
+/// `tei_path` is a partial output of `xml_file` left by an earlier run (its failed segment list exists and it is
+/// not older than the input), so resume fills its missing segments instead of retranslating the file.
+bool is_partial_output(const std::filesystem::path& xml_file, const std::filesystem::path& tei_path) {
+    std::error_code ec;
+    if (!std::filesystem::exists(failed_segments_path_for(tei_path), ec) || !std::filesystem::exists(tei_path, ec)) {
+        return false;
+    }
+    const auto in_time = std::filesystem::last_write_time(xml_file, ec);
+    if (ec) {
+        return false;
+    }
+    const auto out_time = std::filesystem::last_write_time(tei_path, ec);
+    return !ec && out_time >= in_time;
+}
+
+/// Windowed mode: each window is extracted, translated and spliced into the output before the next one is read,
+/// so memory stays bounded by the window size rather than the document size. With `standoff` set, windows are
+/// translated into that log instead and no TEI output is written. With `fill_missing`, `tei_path` is a partial
+/// output of an earlier run: it is read instead of `xml_file` and only segments without a note are translated.
+bool translate_file_streaming(
+    const std::filesystem::path& xml_file,
+    const std::filesystem::path& tei_path,
+    const std::filesystem::path& md_path,
+    const TeiStreamOptions& options,
+    std::size_t expected_segments,
+    bool overwrite_existing_translations,
+    bool fill_missing,
+    StandoffLog* standoff,
+    const SegmentTranslateFn& translate,
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    TranslationStats& out_stats,
+    std::string& error
+) {
+    out_stats = TranslationStats{};
+
+    TeiSpliceOutput tei_out;
+    if (standoff == nullptr && !tei_out.open(tei_path, error)) {
+        return false;
+    }
+
+    std::ofstream md_out;
+    if (!md_path.empty()) {
+        md_out.open(md_path);
+        if (!md_out) {
+            error = "Failed to open markdown output: " + md_path.string();
+            return false;
+        }
+        md_out << "# " << xml_file.filename().string() << "\n\n";
     }
 
+    // Scoped so the input is closed before a filled output is renamed over it.
+    std::size_t segments_seen = 0;
     {
-        const unsigned hc = std::thread::hardware_concurrency();
-        std::cout << "[config] workers=" << config.workers << " llama_threads=" << config.n_threads
-                  << " (workers*llama_threads=" << (config.workers * static_cast<std::size_t>(config.n_threads));
-        if (hc == 0) {
-            std::cout << ", hardware_concurrency=unknown)\n";
-        } else {
-            std::cout << ", hardware_concurrency=" << hc << ")\n";
+        TeiWindowReader reader(options);
+        if (!reader.open(fill_missing ? tei_path : xml_file, error)) {
+            return false;
         }
-        std::cout << "[config] segment_coalesce=" << (config.coalesce_segments ? "on" : "off")
-                  << " coalesce_max_batch=" << config.coalesce_max_batch
-                  << " coalesce_max_chars=" << config.coalesce_max_merged_chars << "\n";
-        std::cout << "[config] ctx=" << config.n_ctx << " max_ctx=" << config.max_n_ctx << " (auto-grow on)\n";
+
+        TeiWindow window;
+        std::vector<std::string> translations;
+        std::vector<std::string> existing;
+        while (reader.next(window, error)) {
+            translations.clear();
+            if (!window.segments.empty()) {
+                const std::size_t done_before = out_stats.segments_total;
+                const auto window_progress = [&](std::size_t done, std::size_t /*window_total*/) {
+                    if (progress_callback) {
+                        progress_callback(done_before + done, std::max(expected_segments, reader.segments_seen()));
+                    }
+                };
+
+                TranslationStats window_stats;
+                bool translated = false;
+                if (standoff != nullptr) {
+                    translated = translate_segments_standoff(
+                        window.segments, *standoff, translate, window_progress, translations, window_stats, error
+                    );
+                } else if (fill_missing) {
+                    existing.assign(window.segments.size(), {});
+                    for (std::size_t i = 0; i < window.segments.size(); ++i) {
+                        existing[i] = existing_translation_text(window.bytes, window.note_sites[i]);
+                    }
+                    translated = translate_missing_segments(
+                        window.segments,
+                        [&](std::size_t i) {
+                            return window.note_sites[i].existing_notes.empty() ? nullptr : &existing[i];
+                        },
+                        translate,
+                        window_progress,
+                        {},
+                        translations,
+                        window_stats,
+                        error
+                    );
+                } else {
+                    translated = translate(window.segments, translations, window_stats, error, window_progress, {});
+                }
+                if (!translated) {
+                    return false;
+                }
+                out_stats.segments_total += window_stats.segments_total;
+                out_stats.translation_units += window_stats.translation_units;
+                out_stats.coalesce_fallback_units += window_stats.coalesce_fallback_units;
+                out_stats.retried_units += window_stats.retried_units;
+                out_stats.workers_used = std::max(out_stats.workers_used, window_stats.workers_used);
+                out_stats.wall_time += window_stats.wall_time;
+                out_stats.unit_latency_ms.insert(
+                    out_stats.unit_latency_ms.end(),
+                    window_stats.unit_latency_ms.begin(),
+                    window_stats.unit_latency_ms.end()
+                );
+
+                const auto& failed = window_stats.failed_segments;
+                mark_failed_segments(translations, failed);
+                if (md_out.is_open()) {
+                    write_markdown_segments(md_out, window.segments, translations, window.segments.front().index + 1);
+                }
+                erase_failed_segments(window.note_sites, failed);
+                erase_failed_segments(translations, failed);
+                for (const auto& segment : failed) {
+                    out_stats.failed_segments.push_back(
+                        FailedSegment{window.segments[segment.index].index, segment.key, segment.error}
+                    );
+                }
+            }
+
+            if (standoff == nullptr
+                && !tei_out.write(
+                    window.bytes,
+                    window.note_sites,
+                    translations,
+                    overwrite_existing_translations && !fill_missing,
+                    error
+                )) {
+                return false;
+            }
+        }
+        if (!error.empty()) {
+            return false;
+        }
+        segments_seen = reader.segments_seen();
     }
 
-    const auto runtime_dir = detect_runtime_dir(argv[0]);
-    if (config.model_path.empty()) {
-        config.model_path = kDefaultModelName;
+    if (segments_seen == 0) {
+        error = "No translatable segments found in " + xml_file.string();
+        return false;
+    }
+    if (standoff == nullptr && !tei_out.commit(error)) {
+        return false;
     }
-    config.model_path = resolve_optional_path_with_runtime_dir(config.model_path, runtime_dir).string();
 
-    const bool needs_sorting_data =
-        has_sorting_filters(config) || config.interactive_drilldown || config.drilldown_help || !config.drilldown_select.empty();
-    if (needs_sorting_data) {
-        if (config.sorting_data_path.empty()) {
-            config.sorting_data_path = kDefaultSortingDataName;
+    const double wall_seconds = static_cast<double>(out_stats.wall_time.count()) / 1000.0;
+    if (wall_seconds > 0.0) {
+        out_stats.segments_per_second = static_cast<double>(out_stats.segments_total) / wall_seconds;
+    }
+    if (out_stats.segments_total > 0) {
+        out_stats.ms_per_segment = static_cast<double>(out_stats.wall_time.count()) /
+            static_cast<double>(out_stats.segments_total);
+    }
+    return true;
+}
+
+/// `tei_mt merge`: write in-place note copies of the source TEI from the standoff files of an earlier run.
+int run_merge_command(int argc, char** argv, const char* program_name) {
+    MergeConfig config;
+    std::string error;
+    if (!parse_merge_args(argc, argv, config, error)) {
+        if (error != "help") {
+            std::cerr << "Argument error: " << error << "\n\n";
         }
-        config.sorting_data_path = resolve_optional_path_with_runtime_dir(config.sorting_data_path, runtime_dir);
+        print_usage(program_name);
+        return error == "help" ? 0 : 1;
     }
 
     if (!std::filesystem::exists(config.input_path)) {
@@ -932,124 +1136,939 @@ int main(int argc, char** argv) {
         return 1;
     }
     const bool input_is_dir = std::filesystem::is_directory(config.input_path);
-    if (config.output_dir.empty() && !config.drilldown_help) {
+    const bool standoff_is_dir = std::filesystem::is_directory(config.standoff_path);
+    if (input_is_dir && !standoff_is_dir) {
+        std::cerr << "For directory input, --standoff must be the output directory of a standoff run.\n";
+        return 1;
+    }
+    if (config.output_dir.empty()) {
         config.output_dir = derive_default_output_dir(config.input_path, input_is_dir);
         std::cout << "[config] default output=" << config.output_dir << "\n";
     }
-
-    const auto scan_output_anchor = config.output_dir.empty()
-        ? (std::filesystem::current_path() / "__tei_mt_no_output__")
-        : config.output_dir;
+    const bool output_is_single_xml_file = !input_is_dir && output_path_looks_like_xml_file(config.output_dir);
 
     std::vector<std::filesystem::path> input_files;
-    if (!collect_input_files(config.input_path, scan_output_anchor, input_files, error)) {
+    if (!collect_input_files(config.input_path, config.output_dir, input_files, error)) {
         std::cerr << error << "\n";
         return 1;
     }
 
-    if (has_sorting_filters(config) || config.interactive_drilldown || config.drilldown_help || !config.drilldown_select.empty()) {
-        SortingMetadataIndex metadata_index;
-        if (!metadata_index.load(config.sorting_data_path, error)) {
-            std::cerr << "[fatal] " << error << "\n";
-            return 1;
+    std::size_t files_ok = 0;
+    std::size_t files_failed = 0;
+    std::size_t total_merged = 0;
+    std::size_t total_missing = 0;
+    for (const auto& xml_file : input_files) {
+        const auto rel_path = output_relative_for(config.input_path, input_is_dir, xml_file);
+        const auto standoff_path = standoff_is_dir
+            ? standoff_path_for(config.standoff_path / rel_path)
+            : config.standoff_path;
+        const auto out_path = output_is_single_xml_file ? config.output_dir : config.output_dir / rel_path;
+
+        if (!std::filesystem::exists(standoff_path)) {
+            std::cout << "[skip] " << xml_file.filename().string() << " no standoff file\n";
+            continue;
         }
 
-        if (config.drilldown_help) {
-            print_drilldown_help_for_dataset(
-                input_files,
-                metadata_index,
-                config.input_path,
-                input_is_dir
-            );
-            return 0;
-        } else if (config.interactive_drilldown) {
-            SortingFilters interactive_filters;
-            std::vector<std::filesystem::path> interactive_files;
-            bool cancelled = false;
-            if (!interactive_drilldown_select(
-                    metadata_index,
-                    config.input_path,
-                    input_is_dir,
-                    input_files,
-                    interactive_filters,
-                    interactive_files,
-                    cancelled,
-                    error
-                )) {
-                if (cancelled) {
-                    std::cout << "[drilldown] cancelled by user.\n";
-                    return 0;
-                }
-                std::cerr << "[fatal] " << error << "\n";
-                return 1;
-            }
-
-            input_files.swap(interactive_files);
-        } else if (!config.drilldown_select.empty()) {
-            SortingFilters drilldown_filters;
-            if (!build_filters_from_drilldown_terms(config.drilldown_select, drilldown_filters, error)) {
-                std::cerr << "[fatal] " << error << "\n";
-                return 1;
-            }
-
-            std::vector<std::filesystem::path> filtered_files = apply_sorting_filters(
-                input_files,
-                metadata_index,
-                config.input_path,
-                input_is_dir,
-                drilldown_filters
-            );
-
-            std::cout
-                << "[drilldown] canon=" << join_values(drilldown_filters.canon)
-                << " tradition=" << join_values(drilldown_filters.tradition)
-                << " period=" << join_values(drilldown_filters.period)
-                << " origin=" << join_values(drilldown_filters.origin)
-                << " matched=" << filtered_files.size() << "/" << input_files.size()
-                << "\n" << std::flush;
+        if (out_path.has_parent_path()) {
+            std::filesystem::create_directories(out_path.parent_path());
+        }
+        std::size_t merged = 0;
+        std::size_t missing = 0;
+        if (!merge_standoff_into_tei(
+                xml_file,
+                standoff_path,
+                out_path,
+                config.overwrite_existing_translations,
+                merged,
+                missing,
+                error
+            )) {
+            std::cerr << "[error] merge failed for " << xml_file << ": " << error << "\n";
+            ++files_failed;
+            continue;
+        }
 
-            if (filtered_files.empty()) {
-                std::cerr << "[fatal] Drill-down matched zero XML files.\n";
-                return 1;
-            }
+        ++files_ok;
+        total_merged += merged;
+        total_missing += missing;
+        std::cout << "[ok] " << xml_file.filename().string() << " merged=" << merged << " missing=" << missing << "\n";
+    }
 
-            input_files.swap(filtered_files);
-        } else {
-            SortingFilters filters;
-            filters.canon = config.filter_canon;
-            filters.tradition = config.filter_tradition;
-            filters.period = config.filter_period;
-            filters.origin = config.filter_origin;
+    std::cout
+        << "[summary] files=" << input_files.size()
+        << " ok=" << files_ok
+        << " failed=" << files_failed
+        << " merged=" << total_merged
+        << " missing=" << total_missing
+        << "\n";
+    return files_failed == 0 ? 0 : 1;
+}
 
-            std::vector<std::filesystem::path> filtered_files = apply_sorting_filters(
-                input_files,
-                metadata_index,
-                config.input_path,
-                input_is_dir,
-                filters
-            );
+/// Key of `xml_file` in a segment store compiled from `store_root` (see run_compile_command).
+std::filesystem::path segment_store_key(const std::filesystem::path& store_root, const std::filesystem::path& xml_file) {
+    std::error_code ec;
+    const bool root_is_dir = std::filesystem::is_directory(store_root, ec);
+    return output_relative_for(store_root, root_is_dir, std::filesystem::weakly_canonical(xml_file, ec));
+}
 
-            std::cout
-                << "[filter] sorting-data=" << config.sorting_data_path
-                << " canon=" << join_values(config.filter_canon)
-                << " tradition=" << join_values(config.filter_tradition)
-                << " period=" << join_values(config.filter_period)
-                << " origin=" << join_values(config.filter_origin)
-                << " matched=" << filtered_files.size() << "/" << input_files.size()
-                << "\n" << std::flush;
+/// Cost-model inputs for `xml_file`: exact segment and token counts from a fresh segment store entry, otherwise
+/// a token estimate from the file size (markup plus 3-byte UTF-8 CJK, roughly 6 bytes per token).
+FileWork estimate_file_work(const std::filesystem::path& xml_file, const SegmentStore& segment_store) {
+    FileWork work;
+    std::error_code ec;
+    work.bytes = std::filesystem::file_size(xml_file, ec);
+    if (ec) {
+        work.bytes = 0;
+    }
 
-            if (filtered_files.empty()) {
-                std::cerr << "[fatal] Metadata filters matched zero XML files.\n";
-                return 1;
+    if (segment_store.is_open()) {
+        const auto doc = segment_store.find(segment_store_key(segment_store.root(), xml_file));
+        if (doc != static_cast<std::size_t>(-1) && segment_store.is_fresh(doc, xml_file)) {
+            std::uint64_t text_bytes = 0;
+            segment_store.doc_work(doc, work.segments, text_bytes, work.tokens);
+            if (work.tokens == 0) {
+                work.tokens = text_bytes / 3;
             }
+            return work;
+        }
+    }
+    work.tokens = work.bytes / 6;
+    return work;
+}
 
-            input_files.swap(filtered_files);
+/// `tei_mt compile`: parse every TEI file once and write the segments (and optionally token ids) to a store.
+int run_compile_command(int argc, char** argv, const char* program_name) {
+    CompileConfig config;
+    std::string error;
+    if (!parse_compile_args(argc, argv, config, error)) {
+        if (error != "help") {
+            std::cerr << "Argument error: " << error << "\n\n";
         }
+        print_usage(program_name);
+        return error == "help" ? 0 : 1;
     }
 
-    const bool output_is_single_xml_file = !input_is_dir && output_path_looks_like_xml_file(config.output_dir);
-    if (input_is_dir && output_is_single_xml_file) {
-        std::cerr << "For directory input, --output must be a directory path.\n";
+    std::error_code ec;
+    const auto root = std::filesystem::weakly_canonical(config.input_path, ec);
+    if (ec || !std::filesystem::exists(root)) {
+        std::cerr << "Input path does not exist: " << config.input_path << "\n";
+        return 1;
+    }
+    const bool input_is_dir = std::filesystem::is_directory(root);
+
+    std::vector<std::filesystem::path> input_files;
+    if (!collect_input_files(root, config.output_path, input_files, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    std::unique_ptr<LlamaTranslator> tokenizer;
+    if (!config.model_path.empty()) {
+        LlamaTranslatorConfig tokenizer_cfg;
+        tokenizer_cfg.model_path = config.model_path;
+        tokenizer_cfg.vocab_only = true;
+        try {
+            tokenizer = std::make_unique<LlamaTranslator>(tokenizer_cfg);
+        } catch (const std::exception& ex) {
+            std::cerr << "[fatal] failed to load vocabulary: " << ex.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (config.output_path.has_parent_path()) {
+        std::filesystem::create_directories(config.output_path.parent_path());
+    }
+    SegmentStoreWriter writer;
+    if (!writer.open(config.output_path, root, error)) {
+        std::cerr << "[fatal] " << error << "\n";
+        return 1;
+    }
+
+    std::size_t files_ok = 0;
+    std::size_t files_failed = 0;
+    std::size_t total_segments = 0;
+    std::vector<std::vector<std::int32_t>> tokens;
+    for (const auto& xml_file : input_files) {
+        TeiDocument doc;
+        if (!read_tei_file(xml_file, doc, error)) {
+            std::cerr << "[skip] " << error << "\n";
+            ++files_failed;
+            continue;
+        }
+
+        tokens.clear();
+        if (tokenizer) {
+            tokens.resize(doc.segments.size());
+            for (std::size_t i = 0; i < doc.segments.size(); ++i) {
+                tokenizer->tokenize_source(doc.segments[i].source_zh, tokens[i]);
+            }
+        }
+
+        if (!writer.add_document(output_relative_for(root, input_is_dir, xml_file), doc, tokens, error)) {
+            std::cerr << "[skip] " << error << "\n";
+            ++files_failed;
+            continue;
+        }
+
+        ++files_ok;
+        total_segments += doc.segments.size();
+        std::cout << "[ok] " << xml_file.filename().string() << " segments=" << doc.segments.size() << "\n";
+    }
+
+    if (!writer.finish(tokenizer ? tokenizer->tokenizer_fingerprint() : 0, error)) {
+        std::cerr << "[fatal] " << error << "\n";
+        return 1;
+    }
+
+    std::cout
+        << "[summary] store=" << config.output_path.string()
+        << " files=" << input_files.size()
+        << " ok=" << files_ok
+        << " failed=" << files_failed
+        << " segments=" << total_segments
+        << " tokens=" << (tokenizer ? "on" : "off")
+        << "\n";
+    return files_failed == 0 ? 0 : 1;
+}
+
+/// Writes the `--trace` timeline when main returns, after every worker thread has finished.
+struct TraceOutput {
+    std::filesystem::path path;
+
+    ~TraceOutput() {
+        if (path.empty()) {
+            return;
+        }
+        std::string error;
+        if (trace_write(path, error)) {
+            std::cout << "[trace] " << path.string() << "\n";
+        } else {
+            std::cerr << "[error] " << error << "\n";
+        }
+    }
+};
+
+/// `tei_mt report diff a.json b.json`.
+int run_report_command(int argc, char** argv, const char* program_name) {
+    if (argc != 4 || std::string(argv[1]) != "diff") {
+        std::cerr << "Argument error: expected `report diff <a.json> <b.json>`\n\n";
+        print_usage(program_name);
+        return 1;
+    }
+    std::string error;
+    if (!diff_run_reports(argv[2], argv[3], std::cout, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+/// How long a `--worker` keeps retrying to reach a coordinator that is not up yet.
+constexpr std::chrono::seconds kWorkerConnectWait{120};
+
+LlamaTranslatorConfig llama_config_for(const AppConfig& config) {
+    LlamaTranslatorConfig translator_cfg;
+    translator_cfg.model_path = config.model_path;
+    translator_cfg.n_ctx = config.n_ctx;
+    translator_cfg.max_n_ctx = config.max_n_ctx;
+    translator_cfg.n_gpu_layers = config.n_gpu_layers;
+    translator_cfg.n_threads = config.n_threads;
+    translator_cfg.max_tokens = config.max_tokens;
+    translator_cfg.n_batch = config.n_batch;
+    translator_cfg.n_ubatch = config.n_ubatch;
+    translator_cfg.cache_type_k = config.cache_type_k;
+    translator_cfg.cache_type_v = config.cache_type_v;
+    translator_cfg.decode_threads = config.thread_plan.decode_threads;
+    translator_cfg.worker_cpus = config.thread_plan.worker_cpus;
+    translator_cfg.worker_prefill_cpus = config.thread_plan.worker_prefill_cpus;
+    return translator_cfg;
+}
+
+/// `--memory-budget`: size workers and contexts from the GGUF header, then re-plan threads for the workers kept.
+bool apply_memory_budget(AppConfig& config, std::string& error) {
+    ModelMemoryInfo model;
+    if (!read_model_memory_info(config.model_path, model, error)) {
+        return false;
+    }
+    const MemoryPlanRequest request{
+        .budget_bytes = config.memory_budget_bytes,
+        .workers = config.workers,
+        .n_ctx = config.n_ctx,
+        .max_n_ctx = config.max_n_ctx,
+        .n_ubatch = config.n_ubatch > 0 ? config.n_ubatch : 256,
+        .cache_type_k = config.cache_type_k,
+        .cache_type_v = config.cache_type_v,
+    };
+    MemoryPlan plan;
+    if (!plan_memory(model, request, plan, error)) {
+        return false;
+    }
+    std::cout << describe_memory_plan(model, request, plan);
+
+    config.n_ctx = plan.n_ctx;
+    config.max_n_ctx = plan.max_n_ctx;
+    if (plan.workers != config.workers) {
+        config.thread_plan = plan_threads(
+            config.cpu_topology,
+            plan.workers,
+            config.requested_n_threads,
+            config.decode_threads,
+            config.n_gpu_layers != 0,
+            !config.thread_plan.worker_cpus.empty()
+        );
+        config.workers = config.thread_plan.workers;
+        config.n_threads = config.thread_plan.n_threads;
+        std::cout << describe_thread_plan(config.cpu_topology, config.thread_plan);
+    }
+    return true;
+}
+
+/// The `--backend` translator: a mock needs no model; llama downloads the model if needed and loads it.
+bool load_translator(AppConfig& config, std::unique_ptr<Translator>& out, std::string& error) {
+    if (config.backend == "mock") {
+        MockTranslatorConfig mock = config.mock;
+        mock.n_ctx = config.n_ctx;
+        mock.max_n_ctx = config.max_n_ctx;
+        mock.max_tokens = config.max_tokens;
+        out = std::make_unique<MockTranslator>(mock);
+        std::cout << "[config] backend=mock prefill_us=" << mock.prefill_us << " decode_us=" << mock.decode_us
+                  << " jitter=" << mock.jitter << " fail=" << mock.fail_rate << " drift=" << mock.drift_rate << " loop=" << mock.loop_rate
+                  << " seed=" << mock.seed << "\n";
+        return true;
+    }
+    if (!ensure_model_available(config.model_path, error)) {
+        return false;
+    }
+    if (config.memory_budget_bytes > 0 && !apply_memory_budget(config, error)) {
+        return false;
+    }
+    try {
+        out = std::make_unique<LlamaTranslator>(llama_config_for(config));
+    } catch (const std::exception& ex) {
+        error = std::string("failed to initialize translator: ") + ex.what();
+        return false;
+    }
+    return true;
+}
+
+/// Translate on this machine with the configured workers and coalescing.
+bool translate_segments_local(
+    const AppConfig& config,
+    const Translator& translator,
+    const std::vector<Segment>& segments,
+    std::vector<std::string>& translations,
+    TranslationStats& stats,
+    std::string& error,
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    const SegmentDoneCallback& segment_done,
+    const UnitDoneCallback& unit_done = {}
+) {
+    const UnitRetryPolicy retry{
+        .retries = static_cast<std::size_t>(config.unit_retries),
+        .max_output_tokens = config.max_tokens,
+    };
+    return config.coalesce_segments
+        ? translate_segments_coalesced_parallel(
+              segments,
+              translator,
+              config.workers,
+              CoalesceParams{
+                  .enabled = true,
+                  .max_per_batch = static_cast<std::size_t>(config.coalesce_max_batch),
+                  .max_merged_chars = static_cast<std::size_t>(config.coalesce_max_merged_chars),
+                  .max_tokens_per_segment = config.max_tokens,
+                  .n_ctx = config.n_ctx,
+              },
+              translations,
+              stats,
+              error,
+              progress_callback,
+              segment_done,
+              unit_done,
+              retry
+          )
+        : translate_segments_parallel(
+              segments,
+              translator,
+              config.workers,
+              translations,
+              stats,
+              error,
+              progress_callback,
+              segment_done,
+              unit_done,
+              retry
+          );
+}
+
+/// `--worker <endpoint>`: load the model, then translate units handed out by a `--coordinator` until it is done.
+int run_worker_mode(AppConfig& config) {
+    std::string error;
+    std::unique_ptr<Translator> translator;
+    if (!load_translator(config, translator, error)) {
+        std::cerr << "[fatal] " << error << "\n";
+        return 1;
+    }
+
+    const bool ok = run_work_worker(
+        config.worker_endpoint,
+        lease_owner_id(),
+        kWorkerConnectWait,
+        [&](const std::vector<Segment>& segments,
+            std::vector<std::string>& translations,
+            std::vector<FailedSegment>& failed,
+            std::string& unit_error) {
+            TranslationStats stats;
+            if (!translate_segments_local(config, *translator, segments, translations, stats, unit_error, {}, {})) {
+                return false;
+            }
+            // Sent back with the result; the coordinator lists them in the file's .failed.json.
+            failed = std::move(stats.failed_segments);
+            return true;
+        },
+        error
+    );
+    if (!ok) {
+        std::cerr << "[fatal] worker: " << error << "\n";
+        return 1;
+    }
+    return run_control_signal() > 0 ? 128 + run_control_signal() : 0;
+}
+
+/// What one `--autotune` candidate achieved on the sample.
+struct AutotuneTrial {
+    double segments_per_second = 0.0;
+    double generated_tokens_per_second = 0.0;
+    /// Merged batches whose output could not be split back and were retranslated segment by segment.
+    double fallback_rate = 0.0;
+    double score = 0.0;
+};
+
+/// Above this fallback rate coalescing is producing unreliable merged output for this model: such a candidate
+/// only wins if it is twice as fast.
+constexpr double kAutotuneMaxFallbackRate = 0.10;
+
+/// A contiguous window from the middle of up to 12 evenly spaced input files, `max_segments` in total. `docs`
+/// owns the text the returned segments view.
+bool collect_autotune_sample(
+    const AppConfig& config,
+    std::size_t max_segments,
+    std::deque<TeiDocument>& docs,
+    std::vector<Segment>& sample,
+    std::string& error
+) {
+    std::vector<std::filesystem::path> files;
+    const auto output_anchor = config.output_dir.empty()
+        ? (std::filesystem::current_path() / "__tei_mt_no_output__")
+        : config.output_dir;
+    if (!collect_input_files(config.input_path, output_anchor, files, error)) {
+        return false;
+    }
+
+    const std::size_t picks = std::min<std::size_t>(12, files.size());
+    const std::size_t per_file = (max_segments + picks - 1) / picks;
+    for (std::size_t p = 0; p < picks && sample.size() < max_segments; ++p) {
+        auto& doc = docs.emplace_back();
+        if (!read_tei_file(files[p * files.size() / picks], doc, error)) {
+            return false;
+        }
+        const std::size_t take = std::min({per_file, doc.segments.size(), max_segments - sample.size()});
+        const std::size_t first = (doc.segments.size() - take) / 2;
+        for (std::size_t i = first; i < first + take; ++i) {
+            Segment segment = doc.segments[i];
+            segment.index = sample.size();
+            sample.push_back(segment);
+        }
+    }
+    if (sample.empty()) {
+        error = "no translatable segments found under " + config.input_path.string();
+        return false;
+    }
+    return true;
+}
+
+bool run_autotune_trial(
+    const AppConfig& variant,
+    const LlamaTranslator& base,
+    const std::vector<Segment>& sample,
+    AutotuneTrial& out,
+    std::string& error
+) {
+    const auto translator = base.clone_with(llama_config_for(variant));
+    const auto tokens_before = base.token_counters();
+    const auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::string> translations;
+    TranslationStats stats;
+    if (!translate_segments_local(variant, *translator, sample, translations, stats, error, {}, {})) {
+        return false;
+    }
+
+    const double seconds = std::max(
+        1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count()
+    );
+    const auto tokens_after = base.token_counters();
+    out.segments_per_second = static_cast<double>(sample.size()) / seconds;
+    out.generated_tokens_per_second =
+        static_cast<double>(tokens_after.generated_tokens - tokens_before.generated_tokens) / seconds;
+    out.fallback_rate = stats.translation_units == 0
+        ? 0.0
+        : static_cast<double>(stats.coalesce_fallback_units) / static_cast<double>(stats.translation_units);
+    // Generated tokens rather than segments: sample segments vary a lot in length, and a candidate should not win
+    // because the units it happened to finish first were short.
+    out.score = out.generated_tokens_per_second * (out.fallback_rate > kAutotuneMaxFallbackRate ? 0.5 : 1.0);
+    return true;
+}
+
+std::string describe_autotune_candidate(const AppConfig& c) {
+    std::ostringstream out;
+    out << "workers=" << c.workers << " threads=" << c.n_threads << " decode_threads=" << c.decode_threads
+        << " n_batch=" << c.n_batch << " n_ubatch=" << c.n_ubatch << " coalesce=";
+    if (c.coalesce_segments) {
+        out << c.coalesce_max_batch << "x" << c.coalesce_max_merged_chars;
+    } else {
+        out << "off";
+    }
+    out << " ctx=" << c.n_ctx;
+    return out.str();
+}
+
+/// `--autotune`: load the model once, then tune one setting at a time (workers/threads, decode threads, llama
+/// batch, coalescing, context) by translating the same input sample under each candidate, keeping the fastest.
+/// The winner is written as a `--profile` file.
+int run_autotune_mode(const AppConfig& config) {
+    std::string error;
+    std::deque<TeiDocument> docs;
+    std::vector<Segment> sample;
+    if (!collect_autotune_sample(config, static_cast<std::size_t>(config.autotune_segments), docs, sample, error)) {
+        std::cerr << "[fatal] autotune: " << error << "\n";
+        return 1;
+    }
+    std::cout << "[autotune] sample=" << sample.size() << " segments from " << docs.size() << " file(s)\n";
+
+    AppConfig model_config = config;
+    if (!ensure_model_available(model_config.model_path, error)) {
+        std::cerr << "[fatal] " << error << "\n";
+        return 1;
+    }
+    std::unique_ptr<LlamaTranslator> base;
+    try {
+        base = std::make_unique<LlamaTranslator>(llama_config_for(model_config));
+    } catch (const std::exception& ex) {
+        std::cerr << "[fatal] failed to initialize translator: " << ex.what() << "\n";
+        return 1;
+    }
+
+    const bool gpu_offload = config.n_gpu_layers != 0;
+    const bool pin = !config.thread_plan.worker_cpus.empty();
+    auto with_threads = [&](AppConfig c, std::size_t workers, int n_threads, int decode_threads) {
+        c.thread_plan = plan_threads(c.cpu_topology, workers, n_threads, decode_threads, gpu_offload, pin);
+        c.workers = c.thread_plan.workers;
+        c.n_threads = c.thread_plan.n_threads;
+        c.decode_threads = c.thread_plan.decode_threads;
+        return c;
+    };
+
+    AppConfig best = with_threads(model_config, config.workers, config.n_threads, config.decode_threads);
+    best.n_batch = best.n_batch > 0 ? best.n_batch : 512;
+    best.n_ubatch = best.n_ubatch > 0 ? best.n_ubatch : 256;
+
+    // Page the model in and warm the allocator so the first candidate is not charged for it.
+    {
+        AutotuneTrial warmup;
+        const std::vector<Segment> head(sample.begin(), sample.begin() + std::min<std::ptrdiff_t>(4, std::ssize(sample)));
+        if (!run_autotune_trial(best, *base, head, warmup, error)) {
+            std::cerr << "[fatal] autotune warmup: " << error << "\n";
+            return 1;
+        }
+    }
+
+    AutotuneTrial best_trial;
+    if (!run_autotune_trial(best, *base, sample, best_trial, error)) {
+        std::cerr << "[fatal] autotune: " << error << "\n";
+        return 1;
+    }
+    std::size_t trials = 1;
+    auto report = [&](const AppConfig& c, const AutotuneTrial& t, const char* verdict) {
+        std::cout << "[autotune] " << describe_autotune_candidate(c) << " -> " << std::fixed << std::setprecision(2)
+                  << t.segments_per_second << " seg/s " << std::setprecision(1) << t.generated_tokens_per_second
+                  << " tok/s fallback=" << std::setprecision(0) << (t.fallback_rate * 100.0) << "%"
+                  << std::defaultfloat << std::setprecision(6) << verdict << "\n";
+    };
+    report(best, best_trial, " (baseline)");
+
+    // Each stage starts from the best so far; a failed candidate (e.g. a context that does not fit) is skipped.
+    auto try_stage = [&](const std::vector<AppConfig>& candidates) {
+        const AppConfig stage_start = best;
+        for (const auto& candidate : candidates) {
+            if (run_control().stopping()) {
+                return;
+            }
+            if (describe_autotune_candidate(candidate) == describe_autotune_candidate(stage_start)) {
+                continue;
+            }
+            AutotuneTrial trial;
+            std::string trial_error;
+            ++trials;
+            const bool trial_ok = run_autotune_trial(candidate, *base, sample, trial, trial_error);
+            // A trial cut short by a drain measured only part of the sample.
+            if (run_control().stopping()) {
+                return;
+            }
+            if (!trial_ok) {
+                std::cout << "[autotune] " << describe_autotune_candidate(candidate) << " -> failed: " << trial_error
+                          << "\n";
+                continue;
+            }
+            const bool better = trial.score > best_trial.score;
+            report(candidate, trial, better ? " *" : "");
+            if (better) {
+                best = candidate;
+                best_trial = trial;
+            }
+        }
+    };
+
+    std::vector<AppConfig> candidates;
+    for (const std::size_t workers : {1, 2, 3, 4, 6, 8}) {
+        if (workers <= best.thread_plan.budget) {
+            candidates.push_back(with_threads(best, workers, 0, 0));
+        }
+    }
+    try_stage(candidates);
+
+    candidates.clear();
+    for (const int divisor : {4, 2, 1}) {
+        candidates.push_back(with_threads(best, best.workers, best.n_threads, std::max(1, best.n_threads / divisor)));
+    }
+    try_stage(candidates);
+
+    candidates.clear();
+    for (const auto& [n_batch, n_ubatch] : {std::pair{256, 128}, {512, 256}, {1024, 512}, {2048, 512}}) {
+        AppConfig c = best;
+        c.n_batch = n_batch;
+        c.n_ubatch = n_ubatch;
+        candidates.push_back(c);
+    }
+    try_stage(candidates);
+
+    candidates.clear();
+    {
+        AppConfig c = best;
+        c.coalesce_segments = false;
+        candidates.push_back(c);
+    }
+    for (const int max_batch : {4, 6, 8, 12}) {
+        AppConfig c = best;
+        c.coalesce_segments = true;
+        c.coalesce_max_batch = max_batch;
+        candidates.push_back(c);
+    }
+    try_stage(candidates);
+
+    if (best.coalesce_segments) {
+        candidates.clear();
+        for (const int max_chars : {1600, 2800, 4000}) {
+            AppConfig c = best;
+            c.coalesce_max_merged_chars = max_chars;
+            candidates.push_back(c);
+        }
+        try_stage(candidates);
+    }
+
+    candidates.clear();
+    for (const int n_ctx : {2048, 4096}) {
+        AppConfig c = best;
+        c.n_ctx = std::min(n_ctx, c.max_n_ctx);
+        candidates.push_back(c);
+    }
+    try_stage(candidates);
+    if (run_control().stopping()) {
+        std::cout << "[cancel] autotune drained after " << trials << " trials; writing the best so far\n";
+    }
+
+    std::ostringstream note;
+    note << std::fixed << std::setprecision(1) << best_trial.generated_tokens_per_second << " tok/s ("
+         << std::setprecision(2) << best_trial.segments_per_second << " seg/s) on " << sample.size()
+         << " segments of " << config.input_path.string() << " with " << config.model_path << " (" << trials
+         << " trials)";
+    if (!write_profile(config.autotune_out, best, note.str(), error)) {
+        std::cerr << "[fatal] " << error << "\n";
+        return 1;
+    }
+    std::cout << "[autotune] best " << describe_autotune_candidate(best) << "\n";
+    std::cout << "[autotune] wrote " << config.autotune_out.string() << " (use --profile "
+              << config.autotune_out.string() << ")\n";
+    return run_control_signal() > 0 ? 128 + run_control_signal() : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "merge") {
+        return run_merge_command(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && std::string(argv[1]) == "compile") {
+        return run_compile_command(argc - 1, argv + 1, argv[0]);
+    }
+    if (argc > 1 && std::string(argv[1]) == "report") {
+        return run_report_command(argc - 1, argv + 1, argv[0]);
+    }
+
+    AppConfig config;
+    std::string error;
+
+    if (!parse_args(argc, argv, config, error)) {
+        if (error != "help") {
+            std::cerr << "Argument error: " << error << "\n\n";
+        }
+        print_usage(argv[0]);
+        return error == "help" ? 0 : 1;
+    }
+    // Before the model loads, so a pause or drain sent during startup is kept instead of killing the process.
+    install_run_control_signal_handlers();
+
+    {
+        std::cout << "[config] workers=" << config.workers << " llama_threads=" << config.n_threads
+                  << " (workers*llama_threads=" << (config.workers * static_cast<std::size_t>(config.n_threads))
+                  << ", logical_cpus=" << config.cpu_topology.cpus.size() << ")\n";
+        std::cout << describe_thread_plan(config.cpu_topology, config.thread_plan);
+        std::cout << "[config] segment_coalesce=" << (config.coalesce_segments ? "on" : "off")
+                  << " coalesce_max_batch=" << config.coalesce_max_batch
+                  << " coalesce_max_chars=" << config.coalesce_max_merged_chars << "\n";
+        std::cout << "[config] ctx=" << config.n_ctx << " max_ctx=" << config.max_n_ctx << " (auto-grow on)"
+                  << " cache_type_k=" << config.cache_type_k << " cache_type_v=" << config.cache_type_v << "\n";
+    }
+
+    const auto runtime_dir = detect_runtime_dir(argv[0]);
+    if (config.model_path.empty()) {
+        config.model_path = kDefaultModelName;
+    }
+    config.model_path = resolve_optional_path_with_runtime_dir(config.model_path, runtime_dir).string();
+
+    TraceOutput trace_output;
+    if (!config.trace_path.empty()) {
+        trace_output.path = config.trace_path;
+        trace_start();
+        TEI_MT_TRACE_THREAD("main");
+    }
+
+    // Stopped (with a final export) when main returns.
+    MetricsExporter metrics_exporter;
+    if (!config.metrics_path.empty()) {
+        if (!metrics_exporter.start(config.metrics_path, std::chrono::seconds(config.metrics_interval_seconds), error)) {
+            std::cerr << "[fatal] " << error << "\n";
+            return 1;
+        }
+        std::cout << "[metrics] " << config.metrics_path.string() << " every " << config.metrics_interval_seconds
+                  << "s\n";
+    }
+
+    if (!config.worker_endpoint.empty()) {
+        return run_worker_mode(config);
+    }
+    if (config.autotune) {
+        return run_autotune_mode(config);
+    }
+
+    RunOrder run_order = RunOrder::Lexical;
+    parse_run_order(config.run_order, run_order);
+
+    const bool needs_sorting_data = has_sorting_filters(config) || config.interactive_drilldown || config.drilldown_help
+        || !config.drilldown_select.empty() || run_order == RunOrder::Metadata;
+    if (needs_sorting_data) {
+        if (config.sorting_data_path.empty()) {
+            config.sorting_data_path = kDefaultSortingDataName;
+        }
+        config.sorting_data_path = resolve_optional_path_with_runtime_dir(config.sorting_data_path, runtime_dir);
+    }
+
+    SegmentStore segment_store;
+    if (!config.segment_store_path.empty()) {
+        if (!segment_store.open(config.segment_store_path, error)) {
+            std::cerr << "[fatal] " << error << "\n";
+            return 1;
+        }
+        if (config.input_path.empty()) {
+            config.input_path = segment_store.root();
+        }
+        std::cout << "[config] segment_store=" << config.segment_store_path.string()
+                  << " docs=" << segment_store.doc_count() << " root=" << segment_store.root().string() << "\n";
+    }
+
+    if (!std::filesystem::exists(config.input_path)) {
+        std::cerr << "Input path does not exist: " << config.input_path << "\n";
+        return 1;
+    }
+    const bool input_is_dir = std::filesystem::is_directory(config.input_path);
+    if (config.output_dir.empty() && !config.drilldown_help) {
+        config.output_dir = derive_default_output_dir(config.input_path, input_is_dir);
+        std::cout << "[config] default output=" << config.output_dir << "\n";
+    }
+
+    const auto scan_output_anchor = config.output_dir.empty()
+        ? (std::filesystem::current_path() / "__tei_mt_no_output__")
+        : config.output_dir;
+
+    // Key of a file in the cost history and for --shard: its output-relative path, the same on every host.
+    const auto file_key = [&](const std::filesystem::path& xml_file) {
+        return output_relative_for(config.input_path, input_is_dir, xml_file).generic_string();
+    };
+    const bool sharded = config.shard_count > 1;
+    const auto in_shard = [&](const std::filesystem::path& xml_file) {
+        return shard_for_key(file_key(xml_file), config.shard_count) == config.shard_index;
+    };
+
+    // Without a metadata selection nothing needs the complete list, so translation starts while the scan runs.
+    const bool stream_scan = input_is_dir && !needs_sorting_data && run_order == RunOrder::Lexical
+        && !output_path_looks_like_xml_file(config.output_dir);
+    InputFileQueue input_queue;
+    FileScanStats scan_stats;
+    std::string scan_error;
+    bool scan_ok = true;
+    std::jthread scan_thread;
+    std::vector<std::filesystem::path> input_files;
+    if (stream_scan) {
+        // Must exist before the scan starts so a nested output tree is pruned by identity.
+        std::filesystem::create_directories(config.output_dir);
+        scan_thread = std::jthread([&] {
+            scan_ok = scan_directory_parallel(
+                config.input_path,
+                config.output_dir,
+                0,
+                has_xml_extension,
+                [&](std::vector<std::filesystem::path>&& files) {
+                    if (sharded) {
+                        std::erase_if(files, [&](const std::filesystem::path& file) { return !in_shard(file); });
+                    }
+                    input_queue.push(std::move(files));
+                },
+                scan_stats,
+                scan_error
+            );
+            input_queue.close();
+        });
+    } else if (!collect_input_files(config.input_path, scan_output_anchor, input_files, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    } else if (sharded) {
+        const std::size_t scanned = input_files.size();
+        std::erase_if(input_files, [&](const std::filesystem::path& file) { return !in_shard(file); });
+        std::cout << "[shard] " << config.shard_index << "/" << config.shard_count
+                  << " files=" << input_files.size() << "/" << scanned << "\n";
+    }
+
+    // Parallel to input_files for --order metadata: index of the first --priority term a file matches.
+    std::vector<std::size_t> priority_groups;
+    if (needs_sorting_data) {
+        SortingMetadataIndex metadata_index;
+        if (!metadata_index.load(config.sorting_data_path, error)) {
+            std::cerr << "[fatal] " << error << "\n";
+            return 1;
+        }
+        std::cout << "[sorting] records=" << metadata_index.record_count()
+                  << " source=" << (metadata_index.loaded_from_snapshot() ? "snapshot" : "json") << "\n";
+        const SortingFileIndex file_index(metadata_index, input_files, config.input_path, input_is_dir);
+
+        if (config.drilldown_help) {
+            print_drilldown_help_for_dataset(file_index);
+            return 0;
+        } else if (config.interactive_drilldown) {
+            SortingFilters interactive_filters;
+            std::vector<std::filesystem::path> interactive_files;
+            bool cancelled = false;
+            if (!interactive_drilldown_select(
+                    file_index,
+                    interactive_filters,
+                    interactive_files,
+                    cancelled,
+                    error
+                )) {
+                if (cancelled) {
+                    std::cout << "[drilldown] cancelled by user.\n";
+                    return 0;
+                }
+                std::cerr << "[fatal] " << error << "\n";
+                return 1;
+            }
+
+            input_files.swap(interactive_files);
+        } else if (!config.drilldown_select.empty()) {
+            SortingFilters drilldown_filters;
+            if (!build_filters_from_drilldown_terms(config.drilldown_select, drilldown_filters, error)) {
+                std::cerr << "[fatal] " << error << "\n";
+                return 1;
+            }
+
+            std::vector<std::filesystem::path> filtered_files = file_index.files_in(file_index.select(drilldown_filters));
+
+            std::cout
+                << "[drilldown] canon=" << join_values(drilldown_filters.canon)
+                << " tradition=" << join_values(drilldown_filters.tradition)
+                << " period=" << join_values(drilldown_filters.period)
+                << " origin=" << join_values(drilldown_filters.origin)
+                << " matched=" << filtered_files.size() << "/" << input_files.size()
+                << "\n" << std::flush;
+
+            if (filtered_files.empty()) {
+                std::cerr << "[fatal] Drill-down matched zero XML files.\n";
+                return 1;
+            }
+
+            input_files.swap(filtered_files);
+        } else if (has_sorting_filters(config)) {
+            SortingFilters filters;
+            filters.canon = config.filter_canon;
+            filters.tradition = config.filter_tradition;
+            filters.period = config.filter_period;
+            filters.origin = config.filter_origin;
+
+            std::vector<std::filesystem::path> filtered_files = file_index.files_in(file_index.select(filters));
+
+            std::cout
+                << "[filter] sorting-data=" << config.sorting_data_path
+                << " canon=" << join_values(config.filter_canon)
+                << " tradition=" << join_values(config.filter_tradition)
+                << " period=" << join_values(config.filter_period)
+                << " origin=" << join_values(config.filter_origin)
+                << " matched=" << filtered_files.size() << "/" << input_files.size()
+                << "\n" << std::flush;
+
+            if (filtered_files.empty()) {
+                std::cerr << "[fatal] Metadata filters matched zero XML files.\n";
+                return 1;
+            }
+
+            input_files.swap(filtered_files);
+        }
+
+        if (run_order == RunOrder::Metadata) {
+            const SortingFileIndex queue_index(metadata_index, input_files, config.input_path, input_is_dir);
+            priority_groups.assign(input_files.size(), config.priority_terms.size());
+            for (std::size_t term = 0; term < config.priority_terms.size(); ++term) {
+                DrilldownCategory category = DrilldownCategory::Canon;
+                std::string value;
+                if (!parse_drilldown_term(config.priority_terms[term], category, value, error)) {
+                    std::cerr << "[fatal] --priority: " << error << "\n";
+                    return 1;
+                }
+                SortingFilters term_filter;
+                add_filter_value(term_filter, category, value);
+                const SortingBitset matched = queue_index.select(term_filter);
+                for (std::size_t i = 0; i < input_files.size(); ++i) {
+                    if (matched.test(i) && priority_groups[i] == config.priority_terms.size()) {
+                        priority_groups[i] = term;
+                    }
+                }
+                std::cout << "[order] priority " << (term + 1) << ": " << config.priority_terms[term]
+                          << " files=" << matched.count() << "\n";
+            }
+        }
+    }
+
+    const bool output_is_single_xml_file = !input_is_dir && output_path_looks_like_xml_file(config.output_dir);
+    if (input_is_dir && output_is_single_xml_file) {
+        std::cerr << "For directory input, --output must be a directory path.\n";
         return 1;
     }
 
@@ -1062,44 +2081,200 @@ int main(int argc, char** argv) {
         std::filesystem::create_directories(config.output_dir);
     }
 
-    if (!ensure_model_available(config.model_path, error)) {
+    // A coordinator never translates itself; the workers load the model.
+    const bool coordinating = !config.coordinator_endpoint.empty();
+    WorkCoordinator coordinator;
+    std::unique_ptr<Translator> translator;
+    if (coordinating) {
+        const WorkCoordinatorOptions coordinator_options{
+            .unit_segments = static_cast<std::size_t>(config.unit_segments),
+            .unit_timeout = std::chrono::seconds(config.unit_timeout_seconds),
+        };
+        if (!coordinator.listen(config.coordinator_endpoint, coordinator_options, error)) {
+            std::cerr << "[fatal] coordinator: " << error << "\n";
+            return 1;
+        }
+        std::cout << "[config] coordinator=" << coordinator.endpoint_name() << " unit_segments=" << config.unit_segments
+                  << " unit_timeout_s=" << config.unit_timeout_seconds << "\n";
+    } else if (!load_translator(config, translator, error)) {
         std::cerr << "[fatal] " << error << "\n";
         return 1;
     }
 
-    LlamaTranslatorConfig translator_cfg;
-    translator_cfg.model_path = config.model_path;
-    translator_cfg.n_ctx = config.n_ctx;
-    translator_cfg.max_n_ctx = config.max_n_ctx;
-    translator_cfg.n_gpu_layers = config.n_gpu_layers;
-    translator_cfg.n_threads = config.n_threads;
-    translator_cfg.max_tokens = config.max_tokens;
-
-    std::unique_ptr<LlamaTranslator> translator;
-    try {
-        translator = std::make_unique<LlamaTranslator>(translator_cfg);
-    } catch (const std::exception& ex) {
-        std::cerr << "[fatal] failed to initialize translator: " << ex.what() << "\n";
-        return 1;
+    // Pre-tokenized ids are only valid for the vocabulary they were produced with (and are not sent to workers).
+    const auto* llama_translator = dynamic_cast<const LlamaTranslator*>(translator.get());
+    const bool store_tokens = llama_translator != nullptr && segment_store.is_open() && segment_store.has_tokens()
+        && segment_store.tokenizer_fingerprint() == llama_translator->tokenizer_fingerprint();
+    if (segment_store.is_open()) {
+        std::cout << "[config] segment_store_tokens=" << (store_tokens ? "on" : "off");
+        if (segment_store.has_tokens() && !store_tokens) {
+            std::cout << " (compiled with a different vocabulary)";
+        }
+        std::cout << "\n";
     }
 
     std::size_t total_segments = 0;
+    std::size_t total_failed_segments = 0;
     std::chrono::milliseconds total_time{0};
     std::size_t files_ok = 0;
     std::size_t files_failed = 0;
 
-    if (config.show_progress) {
-        print_progress(0, input_files.size(), 0, 0, "", false);
+    const bool reporting = !config.report_path.empty();
+    RunReport run_report;
+    if (reporting) {
+        run_report.begin(argc, argv, config);
+        if (llama_translator != nullptr) {
+            run_report.set_tokenizer_fingerprint(llama_translator->tokenizer_fingerprint());
+        }
     }
 
-    for (std::size_t file_idx = 0; file_idx < input_files.size(); ++file_idx) {
-        const auto& xml_file = input_files[file_idx];
-        TeiDocument doc;
-        if (!read_tei_file(xml_file, doc, error)) {
-            std::cerr << "[skip] " << error << "\n";
-            ++files_failed;
-            continue;
+    UnitLog unit_log;
+    if (!config.unit_log_path.empty()) {
+        if (!unit_log.open(config.unit_log_path, error)) {
+            std::cerr << "[fatal] " << error << "\n";
+            return 1;
+        }
+    }
+    // Input-relative path of the file being translated, for unit log records.
+    std::string unit_log_file;
+
+    const SegmentTranslateFn translate_segments = [&](
+        const std::vector<Segment>& segments,
+        std::vector<std::string>& translations,
+        TranslationStats& stats,
+        std::string& translate_error,
+        const std::function<void(std::size_t, std::size_t)>& progress_callback,
+        const SegmentDoneCallback& segment_done
+    ) {
+        if (coordinating) {
+            return coordinator.translate(segments, translations, stats, translate_error, progress_callback, segment_done);
+        }
+        UnitDoneCallback unit_done;
+        if (unit_log.is_open()) {
+            unit_done = [&](const TranslationUnitReport& unit) {
+                unit_log.submit(make_unit_log_record(unit_log_file, segments, unit));
+            };
+        }
+        return translate_segments_local(
+            config, *translator, segments, translations, stats, translate_error, progress_callback, segment_done, unit_done
+        );
+    };
+
+    const bool streaming = !config.stream_windows.empty();
+    TeiStreamOptions stream_options;
+    if (streaming) {
+        parse_tei_window_unit(config.stream_windows, stream_options.unit);
+        stream_options.max_window_bytes = config.stream_window_bytes;
+        std::cout << "[config] stream_windows=" << config.stream_windows
+                  << " stream_window_bytes=" << config.stream_window_bytes << "\n";
+    }
+
+    const bool standoff = config.tei_strategy == "standoff";
+    if (standoff) {
+        std::cout << "[config] tei_strategy=standoff (records appended to <name>.en.jsonl; "
+                  << "use `merge` for in-place notes)\n";
+    }
+
+    const std::filesystem::path cost_history_path =
+        (output_is_single_xml_file ? config.output_dir.parent_path() : config.output_dir) / ".tei_mt_costs.tsv";
+    CostHistory cost_history;
+    if (!cost_history.load(cost_history_path, error)) {
+        std::cerr << "[warn] " << error << "\n";
+    }
+
+    // Predicted cost per queue position (empty for lexical order, which does not need estimates).
+    std::vector<double> predicted_ms;
+    if (run_order != RunOrder::Lexical) {
+        std::vector<QueuedFile> queue(input_files.size());
+        for (std::size_t i = 0; i < input_files.size(); ++i) {
+            queue[i].file = input_files[i];
+            queue[i].predicted_ms = cost_history.predict_ms(file_key(input_files[i]), estimate_file_work(input_files[i], segment_store));
+            queue[i].priority = priority_groups.empty() ? 0 : priority_groups[i];
+        }
+        order_run_queue(queue, run_order);
+
+        double predicted_total = 0.0;
+        for (std::size_t i = 0; i < queue.size(); ++i) {
+            input_files[i] = std::move(queue[i].file);
+            predicted_ms.push_back(queue[i].predicted_ms);
+            predicted_total += queue[i].predicted_ms;
+        }
+        std::cout << "[order] policy=" << run_order_name(run_order) << " files=" << input_files.size()
+                  << " predicted_total_ms=" << static_cast<std::uint64_t>(predicted_total)
+                  << " ms_per_token=" << cost_history.ms_per_token() << "\n";
+    }
+    double order_predicted_ms = 0.0;
+    double order_actual_ms = 0.0;
+    double order_abs_error_ms = 0.0;
+
+    if (!stream_scan) {
+        input_queue.push(std::move(input_files));
+        input_queue.close();
+    }
+    if (config.show_progress) {
+        print_progress(0, input_queue.discovered(), input_queue.closed(), 0, 0, "", false);
+    }
+
+    const std::string lease_owner = config.lease ? lease_owner_id() : std::string{};
+    const std::chrono::seconds lease_ttl(config.lease_ttl_seconds);
+    if (config.lease) {
+        std::cout << "[config] lease owner=" << lease_owner << " ttl_s=" << config.lease_ttl_seconds << "\n";
+    }
+    // Files whose lease another process holds, with their queue position; retried once the queue is drained.
+    std::deque<std::pair<std::filesystem::path, std::size_t>> deferred;
+    std::size_t files_popped = 0;
+    bool file_retried = false;
+    const auto next_file = [&](std::filesystem::path& file, std::size_t& file_idx) {
+        if (input_queue.pop(file)) {
+            file_idx = files_popped++;
+            file_retried = false;
+            return true;
+        }
+        if (deferred.empty()) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::clamp<std::chrono::seconds>(
+            lease_ttl / 4, std::chrono::seconds(1), std::chrono::seconds(30)
+        ));
+        file = std::move(deferred.front().first);
+        file_idx = deferred.front().second;
+        deferred.pop_front();
+        file_retried = true;
+        return true;
+    };
+    const auto is_last_file = [&](std::size_t) {
+        return input_queue.closed() && deferred.empty() && files_popped == input_queue.discovered();
+    };
+
+    std::filesystem::path xml_file;
+    std::size_t file_idx = 0;
+    const auto fail_file = [&](const std::string& reason) {
+        ++files_failed;
+        tei_metrics().files_failed.add();
+        if (reporting) {
+            run_report.add_failed(file_key(xml_file), reason);
+        }
+    };
+    // A pause or drain signal (see run_control.hpp) is checked between files; a drained file is written as partial
+    // output.
+    RunControl& control = run_control();
+    while (next_file(xml_file, file_idx)) {
+        if (control.paused()) {
+            std::cout << "[pause] paused before " << xml_file.filename().string() << std::endl;
+            control.wait_while_paused();
+            if (!control.stopping()) {
+                std::cout << "[resume] continuing" << std::endl;
+            }
+        }
+        if (control.stopping()) {
+            break;
+        }
+        TEI_MT_TRACE_SCOPE("file");
+        const auto file_started = std::chrono::steady_clock::now();
+        if (unit_log.is_open()) {
+            unit_log_file = file_key(xml_file);
         }
+        tei_metrics().queue_files.set(static_cast<double>(input_queue.discovered() - files_popped + deferred.size()));
 
         std::filesystem::path rel_path;
         std::filesystem::path out_parent;
@@ -1114,23 +2289,140 @@ int main(int argc, char** argv) {
             tei_path = config.output_dir / rel_path;
         }
 
+        std::filesystem::path md_path;
+        if (config.emit_markdown) {
+            if (output_is_single_xml_file) {
+                md_path = tei_path;
+                md_path.replace_extension(".en.md");
+            } else {
+                auto md_name = rel_path.filename();
+                md_name.replace_extension(".en.md");
+                md_path = out_parent / md_name;
+            }
+        }
+
+        // Claimed before anything is read: a file finished by another process is then skipped by resume below.
+        FileLease lease;
+        if (config.lease) {
+            std::error_code mkdir_ec;
+            std::filesystem::create_directories(out_parent, mkdir_ec);
+            switch (lease.acquire(lease_path_for(tei_path), lease_owner, lease_ttl, error)) {
+                case LeaseClaim::Acquired:
+                    if (lease.reclaimed()) {
+                        std::cout << "[lease] reclaimed expired lease for " << xml_file.filename().string() << "\n";
+                    }
+                    break;
+                case LeaseClaim::Busy:
+                    if (!file_retried) {
+                        std::cout << "[lease] busy " << xml_file.filename().string() << " deferred\n";
+                    }
+                    deferred.emplace_back(xml_file, file_idx);
+                    continue;
+                case LeaseClaim::Error:
+                    std::cerr << "[error] " << error << "\n";
+                    fail_file(error);
+                    continue;
+            }
+        }
+
+        const std::filesystem::path standoff_path = standoff ? standoff_path_for(tei_path) : std::filesystem::path{};
+        StandoffLog standoff_log;
+        if (standoff && config.resume && !standoff_log.load(standoff_path, error)) {
+            std::cerr << "[skip] " << error << "\n";
+            fail_file(error);
+            continue;
+        }
+
+        // A partial output whose failed segments get filled in; standoff logs are filled by resume as they are.
+        const std::filesystem::path failed_list_path = failed_segments_path_for(tei_path);
+        const bool filling = !standoff && config.resume && is_partial_output(xml_file, tei_path);
+
+        TeiDocument doc;
+        std::size_t expected_segments = 0;
+        if (filling) {
+            if (!streaming && !read_tei_file(tei_path, doc, error)) {
+                std::cerr << "[skip] " << error << "\n";
+                fail_file(error);
+                continue;
+            }
+            expected_segments = doc.segments.size();
+        } else if (streaming) {
+            // Counting needs a full pass over the input, so only pay for it when there is an output to compare.
+            if (!standoff && config.resume && std::filesystem::exists(tei_path)) {
+                if (!count_tei_segments_streaming(xml_file, stream_options, expected_segments, error)) {
+                    std::cerr << "[skip] " << error << "\n";
+                    fail_file(error);
+                    continue;
+                }
+            }
+        } else {
+            const std::size_t store_doc = segment_store.is_open()
+                ? segment_store.find(segment_store_key(segment_store.root(), xml_file))
+                : static_cast<std::size_t>(-1);
+            const bool from_store = store_doc != static_cast<std::size_t>(-1) && segment_store.is_fresh(store_doc, xml_file);
+            if (segment_store.is_open() && !from_store) {
+                std::cout << "[store] " << xml_file.filename().string()
+                          << (store_doc == static_cast<std::size_t>(-1) ? " not compiled" : " stale") << "; parsing\n";
+            }
+
+            if (from_store) {
+                doc.source_path = xml_file;
+                // Standoff output never touches the source bytes; note output splices into them.
+                if (!segment_store.load_document(store_doc, doc, store_tokens, error)) {
+                    std::cerr << "[skip] " << error << "\n";
+                    fail_file(error);
+                    continue;
+                }
+                if (!standoff && !read_tei_bytes(xml_file, doc.bytes)) {
+                    error = "Failed to read XML " + xml_file.string();
+                    std::cerr << "[skip] " << error << "\n";
+                    fail_file(error);
+                    continue;
+                }
+            } else if (!read_tei_file(xml_file, doc, error)) {
+                std::cerr << "[skip] " << error << "\n";
+                fail_file(error);
+                continue;
+            }
+            expected_segments = doc.segments.size();
+        }
+
         std::string resume_reason;
-        if (should_resume_skip_file(
+        bool resume_skip = false;
+        if (filling) {
+            std::cout << "[resume] " << xml_file.filename().string() << " filling failed segments of partial output\n";
+        } else if (standoff) {
+            // Windowed files are checked window by window while streaming; only the DOM path can tell up front.
+            if (!streaming && standoff_log.size() >= doc.segments.size()) {
+                resume_skip = std::ranges::all_of(doc.segments, [&](const Segment& segment) {
+                    return standoff_log.find(segment) != nullptr;
+                });
+                resume_reason = "standoff complete";
+            }
+        } else {
+            resume_skip = should_resume_skip_file(
                 xml_file,
                 tei_path,
-                doc.segments.size(),
+                expected_segments,
                 config.resume,
+                streaming,
                 resume_reason
-            )) {
+            );
+        }
+        if (resume_skip) {
             ++files_ok;
+            if (reporting) {
+                run_report.add_skipped(file_key(xml_file), resume_reason);
+            }
             if (config.show_progress) {
                 print_progress(
                     file_idx + 1,
-                    input_files.size(),
-                    doc.segments.size(),
-                    doc.segments.size(),
+                    input_queue.discovered(),
+                    input_queue.closed(),
+                    expected_segments,
+                    expected_segments,
                     xml_file.filename().string(),
-                    file_idx + 1 == input_files.size()
+                    is_last_file(file_idx)
                 );
             }
             std::cout << "[skip] " << xml_file.filename().string() << " " << resume_reason << "\n";
@@ -1145,7 +2437,8 @@ int main(int argc, char** argv) {
             }
             print_progress(
                 file_idx,
-                input_files.size(),
+                input_queue.discovered(),
+                input_queue.closed(),
                 done_segments,
                 total_segments_in_file,
                 xml_file.filename().string(),
@@ -1153,82 +2446,143 @@ int main(int argc, char** argv) {
             );
         };
 
-        const bool ok_translate = config.coalesce_segments
-            ? translate_segments_coalesced_parallel(
-                  doc.segments,
-                  *translator,
-                  config.workers,
-                  CoalesceParams{
-                      .enabled = true,
-                      .max_per_batch = static_cast<std::size_t>(config.coalesce_max_batch),
-                      .max_merged_chars = static_cast<std::size_t>(config.coalesce_max_merged_chars),
-                      .max_tokens_per_segment = config.max_tokens,
-                      .n_ctx = config.n_ctx,
-                  },
-                  translations,
-                  stats,
-                  error,
-                  progress_callback
-              )
-            : translate_segments_parallel(
-                  doc.segments,
-                  *translator,
-                  config.workers,
-                  translations,
-                  stats,
-                  error,
-                  progress_callback
-              );
-
-        if (!ok_translate) {
-            std::cerr << "[error] translation failed for " << xml_file << ": " << error << "\n";
-            ++files_failed;
-            continue;
+        if (standoff) {
+            std::filesystem::create_directories(out_parent);
+            if (!standoff_log.open_append(standoff_path, xml_file.filename().string(), error)) {
+                std::cerr << "[error] " << error << "\n";
+                fail_file(error);
+                continue;
+            }
         }
 
-        std::filesystem::create_directories(out_parent);
-
-        if (config.emit_markdown) {
-            std::filesystem::path md_path;
-            if (output_is_single_xml_file) {
-                md_path = tei_path;
-                md_path.replace_extension(".en.md");
+        if (streaming) {
+            std::filesystem::create_directories(out_parent);
+            if (!translate_file_streaming(
+                    xml_file,
+                    tei_path,
+                    md_path,
+                    stream_options,
+                    expected_segments,
+                    config.overwrite_existing_translations,
+                    filling,
+                    standoff ? &standoff_log : nullptr,
+                    translate_segments,
+                    progress_callback,
+                    stats,
+                    error
+                )) {
+                std::cerr << "[error] streaming translation failed for " << xml_file << ": " << error << "\n";
+                fail_file(error);
+                continue;
+            }
+        } else {
+            bool translated = false;
+            if (standoff) {
+                translated = translate_segments_standoff(
+                    doc.segments, standoff_log, translate_segments, progress_callback, translations, stats, error
+                );
+            } else if (filling) {
+                translated =
+                    translate_segments_filling(doc, translate_segments, progress_callback, translations, stats, error);
             } else {
-                auto md_name = rel_path.filename();
-                md_name.replace_extension(".en.md");
-                md_path = out_parent / md_name;
+                translated = translate_segments(doc.segments, translations, stats, error, progress_callback, {});
+            }
+            if (!translated) {
+                std::cerr << "[error] translation failed for " << xml_file << ": " << error << "\n";
+                fail_file(error);
+                continue;
+            }
+            mark_failed_segments(translations, stats.failed_segments);
+
+            std::filesystem::create_directories(out_parent);
+
+            if (config.emit_markdown) {
+                if (!write_markdown_output(md_path, doc, translations, error)) {
+                    std::cerr << "[error] markdown write failed for " << xml_file << ": " << error << "\n";
+                    fail_file(error);
+                    continue;
+                }
+            }
+
+            if (!standoff && !stats.failed_segments.empty()) {
+                if (doc.note_sites.size() == doc.segments.size()) {
+                    erase_failed_segments(doc.note_sites, stats.failed_segments);
+                }
+                erase_failed_segments(doc.segments, stats.failed_segments);
+                erase_failed_segments(doc.segment_nodes, stats.failed_segments);
+                erase_failed_segments(translations, stats.failed_segments);
             }
-            if (!write_markdown_output(md_path, doc, translations, error)) {
-                std::cerr << "[error] markdown write failed for " << xml_file << ": " << error << "\n";
-                ++files_failed;
+            if (!standoff
+                && !write_tei_note_output(
+                    tei_path,
+                    doc,
+                    translations,
+                    config.overwrite_existing_translations && !filling,
+                    error
+                )) {
+                std::cerr << "[error] TEI write failed for " << xml_file << ": " << error << "\n";
+                fail_file(error);
                 continue;
             }
         }
 
-        if (!write_tei_note_output(
-                tei_path,
-                doc,
-                translations,
-                config.overwrite_existing_translations,
-                error
-            )) {
-            std::cerr << "[error] TEI write failed for " << xml_file << ": " << error << "\n";
-            ++files_failed;
+        if (standoff && !standoff_log.close(error)) {
+            std::cerr << "[error] " << error << "\n";
+            fail_file(error);
             continue;
         }
 
+        if (lease.lost()) {
+            std::cerr << "[lease] warn: lease for " << xml_file.filename().string()
+                      << " was taken over while translating; another process may have written it too\n";
+        }
+
+        if (!stats.failed_segments.empty()) {
+            if (!write_failed_segments(failed_list_path, xml_file.filename().string(), stats.failed_segments, error)) {
+                std::cerr << "[warn] " << error << "\n";
+            }
+            std::cout << "[partial] " << xml_file.filename().string()
+                      << " failed_segments=" << stats.failed_segments.size() << " retried_units=" << stats.retried_units << " list=" << failed_list_path.string() << "\n";
+        } else if (std::error_code remove_ec; std::filesystem::remove(failed_list_path, remove_ec) && filling) {
+            std::cout << "[resume] " << xml_file.filename().string() << " partial output complete\n";
+        }
+
         total_segments += stats.segments_total;
+        total_failed_segments += stats.failed_segments.size();
         total_time += stats.wall_time;
         ++files_ok;
+        tei_metrics().files_translated.add();
+        if (reporting) {
+            run_report.add_ok(
+                file_key(xml_file),
+                stats,
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - file_started)
+            );
+        }
+
+        // Only a whole translation measures the file's cost: a resume fill, a partial or a drained run is shorter.
+        const bool whole_file = !filling && stats.failed_segments.empty() && !control.stopping();
+        FileWork work = estimate_file_work(xml_file, segment_store);
+        work.segments = stats.segments_total;
+        const auto actual_ms = static_cast<double>(stats.wall_time.count());
+        if (whole_file && !cost_history.append(file_key(xml_file), work, actual_ms, error)) {
+            std::cerr << "[warn] " << error << "\n";
+        }
+        if (whole_file && file_idx < predicted_ms.size()) {
+            order_predicted_ms += predicted_ms[file_idx];
+            order_actual_ms += actual_ms;
+            order_abs_error_ms += std::abs(predicted_ms[file_idx] - actual_ms);
+        }
 
         if (config.show_progress) {
             print_progress(
                 file_idx + 1,
-                input_files.size(),
+                input_queue.discovered(),
+                input_queue.closed(),
                 stats.segments_total,
                 stats.segments_total,
                 xml_file.filename().string(),
-                file_idx + 1 == input_files.size()
+                is_last_file(file_idx)
             );
         }
 
@@ -1240,21 +2594,107 @@ int main(int argc, char** argv) {
             << " workers=" << stats.workers_used
             << " time_ms=" << stats.wall_time.count()
             << " ms_per_segment=" << stats.ms_per_segment
-            << " seg_per_sec=" << stats.segments_per_second
-            << "\n";
+            << " seg_per_sec=" << stats.segments_per_second;
+        if (file_idx < predicted_ms.size()) {
+            std::cout << " predicted_ms=" << static_cast<std::uint64_t>(predicted_ms[file_idx]);
+        }
+        std::cout << "\n";
+    }
+
+    if (coordinating) {
+        coordinator.shutdown();
+    }
+
+    const bool cancelled = control.stopping();
+    if (cancelled) {
+        std::cout << "[cancel] run drained after " << (files_ok + files_failed) << " files; rerun to continue\n";
+    }
+
+    if (stream_scan) {
+        scan_thread.join();
+        std::cout << "[scan] dirs=" << scan_stats.directories << " files=" << scan_stats.files
+                  << " skipped_dirs=" << scan_stats.skipped_directories;
+        if (sharded) {
+            std::cout << " shard=" << config.shard_index << "/" << config.shard_count << " shard_files=" << files_popped;
+        }
+        std::cout << "\n";
+        if (!scan_ok) {
+            std::cerr << scan_error << "\n";
+            return 1;
+        }
+        if (scan_stats.files == 0) {
+            std::cerr << "No XML files found under: " << config.input_path.string() << "\n";
+            return 1;
+        }
+    }
+
+    if (order_actual_ms > 0.0) {
+        std::cout << "[order] policy=" << run_order_name(run_order)
+                  << " predicted_ms=" << static_cast<std::uint64_t>(order_predicted_ms)
+                  << " actual_ms=" << static_cast<std::uint64_t>(order_actual_ms)
+                  << " mean_abs_error_pct=" << (100.0 * order_abs_error_ms / order_actual_ms) << "\n";
+    }
+
+    // Token totals of whichever backend translated (none for a coordinator), reported once below.
+    std::uint64_t prompt_tokens = 0;
+    std::uint64_t generated_tokens = 0;
+    if (const auto* mock = dynamic_cast<const MockTranslator*>(translator.get())) {
+        const auto mock_stats = mock->stats();
+        prompt_tokens = mock_stats.prompt_tokens;
+        generated_tokens = mock_stats.generated_tokens;
+        std::cout << "[mock] calls=" << mock_stats.calls << " prompt_tokens=" << mock_stats.prompt_tokens
+                  << " generated_tokens=" << mock_stats.generated_tokens << " failures=" << mock_stats.failures
+                  << " marker_drifts=" << mock_stats.marker_drifts << " ctx_grows=" << mock_stats.ctx_grows
+                  << " repetition_loops=" << mock_stats.repetition_loops << " tokens_saved=" << mock_stats.tokens_saved
+                  << "\n";
     }
 
     const double total_seconds = static_cast<double>(total_time.count()) / 1000.0;
     const double total_sps = total_seconds > 0.0 ? static_cast<double>(total_segments) / total_seconds : 0.0;
 
+    if (llama_translator != nullptr) {
+        const auto tokens = llama_translator->token_counters();
+        prompt_tokens = tokens.prompt_tokens;
+        generated_tokens = tokens.generated_tokens;
+        std::cout << "[tokens] prompt=" << tokens.prompt_tokens << " generated=" << tokens.generated_tokens
+                  << " gen_tok_per_sec="
+                  << (total_seconds > 0.0 ? static_cast<double>(tokens.generated_tokens) / total_seconds : 0.0)
+                  << " repetition_loops=" << tokens.repetition_loops
+                  << " tokens_saved=" << tokens.repetition_tokens_saved << "\n";
+    }
+    if (reporting) {
+        run_report.set_tokens(prompt_tokens, generated_tokens);
+    }
+
     std::cout
-        << "[summary] files=" << input_files.size()
+        << "[summary] files=" << input_queue.discovered()
         << " ok=" << files_ok
         << " failed=" << files_failed
         << " total_segments=" << total_segments
+        << " failed_segments=" << total_failed_segments
         << " total_time_ms=" << total_time.count()
         << " seg_per_sec=" << total_sps
         << "\n";
 
+    if (unit_log.is_open()) {
+        if (!unit_log.close(error)) {
+            std::cerr << "[error] " << error << "\n";
+            return 1;
+        }
+        std::cout << "[unit-log] " << config.unit_log_path.string() << " units=" << unit_log.written()
+                  << " dropped=" << unit_log.dropped() << "\n";
+    }
+
+    if (reporting) {
+        if (!run_report.write(config.report_path, error)) {
+            std::cerr << "[error] " << error << "\n";
+            return 1;
+        }
+        std::cout << "[report] " << config.report_path.string() << "\n";
+    }
+
+    if (cancelled) {
+        return run_control_signal() > 0 ? 128 + run_control_signal() : 1;
+    }
     return 0;
 }
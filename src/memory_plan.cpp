@@ -0,0 +1,230 @@
+#include "memory_plan.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#include <ggml.h>
+#include <gguf.h>
+
+namespace {
+
+struct KvCacheType {
+    const char* name;
+    ggml_type type;
+};
+
+constexpr KvCacheType kKvCacheTypes[] = {
+    {"f32", GGML_TYPE_F32},
+    {"f16", GGML_TYPE_F16},
+    {"bf16", GGML_TYPE_BF16},
+    {"q8_0", GGML_TYPE_Q8_0},
+    {"q5_1", GGML_TYPE_Q5_1},
+    {"q5_0", GGML_TYPE_Q5_0},
+    {"q4_1", GGML_TYPE_Q4_1},
+    {"q4_0", GGML_TYPE_Q4_0},
+    {"iq4_nl", GGML_TYPE_IQ4_NL},
+};
+
+/// Process, parsed documents and output buffers.
+constexpr std::uint64_t kReserveBytes = std::uint64_t{256} << 20;
+/// Context sizes are planned in steps of this many cells.
+constexpr int kCtxStep = 256;
+constexpr int kMinCtx = 512;
+
+constexpr std::uint64_t kMiB = std::uint64_t{1} << 20;
+
+/// Integer metadata value, or the largest element of a per-layer array; 0 when missing.
+std::uint64_t gguf_uint(const gguf_context* ctx, const std::string& key) {
+    const std::int64_t id = gguf_find_key(ctx, key.c_str());
+    if (id < 0) {
+        return 0;
+    }
+    switch (gguf_get_kv_type(ctx, id)) {
+        case GGUF_TYPE_UINT32:
+            return gguf_get_val_u32(ctx, id);
+        case GGUF_TYPE_INT32:
+            return static_cast<std::uint64_t>(std::max(0, gguf_get_val_i32(ctx, id)));
+        case GGUF_TYPE_UINT64:
+            return gguf_get_val_u64(ctx, id);
+        case GGUF_TYPE_ARRAY: {
+            const gguf_type type = gguf_get_arr_type(ctx, id);
+            if (type != GGUF_TYPE_UINT32 && type != GGUF_TYPE_INT32) {
+                return 0;
+            }
+            const auto* data = static_cast<const std::uint32_t*>(gguf_get_arr_data(ctx, id));
+            std::uint64_t largest = 0;
+            for (std::size_t i = 0; i < gguf_get_arr_n(ctx, id); ++i) {
+                largest = std::max<std::uint64_t>(largest, data[i]);
+            }
+            return largest;
+        }
+        default:
+            return 0;
+    }
+}
+
+/// Bytes per context cell: K and V of every layer plus the cell's column of the attention mask.
+double bytes_per_cell(const ModelMemoryInfo& model, const MemoryPlanRequest& request) {
+    const double kv = static_cast<double>(model.n_layer) * model.n_head_kv
+        * (model.head_dim_k * kv_cache_type_bytes(request.cache_type_k)
+           + model.head_dim_v * kv_cache_type_bytes(request.cache_type_v));
+    return kv + 4.0 * request.n_ubatch;
+}
+
+/// Compute buffers that do not scale with the context (activations of one ubatch, logits). A rough estimate.
+std::uint64_t fixed_context_bytes(const ModelMemoryInfo& model, const MemoryPlanRequest& request) {
+    const std::uint64_t n_ff = model.n_ff > 0 ? model.n_ff : 4ull * model.n_embd;
+    return static_cast<std::uint64_t>(request.n_ubatch) * (6ull * model.n_embd + 2ull * n_ff) * 4ull
+        + 2ull * model.n_vocab * 4ull;
+}
+
+/// Largest planned context whose memory fits in `bytes` (0 if not even kMinCtx does).
+int largest_ctx_within(const ModelMemoryInfo& model, const MemoryPlanRequest& request, std::uint64_t bytes) {
+    const std::uint64_t fixed = fixed_context_bytes(model, request);
+    if (bytes <= fixed) {
+        return 0;
+    }
+    const double cells = static_cast<double>(bytes - fixed) / bytes_per_cell(model, request);
+    const int ctx = static_cast<int>(std::min(cells, double{1 << 22})) / kCtxStep * kCtxStep;
+    return ctx >= kMinCtx ? ctx : 0;
+}
+
+}  // namespace
+
+int kv_cache_ggml_type(const std::string& name) {
+    for (const auto& entry : kKvCacheTypes) {
+        if (name == entry.name) {
+            return static_cast<int>(entry.type);
+        }
+    }
+    return -1;
+}
+
+bool kv_cache_type_quantized(const std::string& name) {
+    const int type = kv_cache_ggml_type(name);
+    return type >= 0 && type != GGML_TYPE_F32 && type != GGML_TYPE_F16 && type != GGML_TYPE_BF16;
+}
+
+double kv_cache_type_bytes(const std::string& name) {
+    const int type = kv_cache_ggml_type(name);
+    if (type < 0) {
+        return 2.0;
+    }
+    const auto ggml = static_cast<ggml_type>(type);
+    return static_cast<double>(ggml_type_size(ggml)) / static_cast<double>(ggml_blck_size(ggml));
+}
+
+bool read_model_memory_info(const std::string& model_path, ModelMemoryInfo& out, std::string& error) {
+    std::error_code ec;
+    const auto file_bytes = std::filesystem::file_size(model_path, ec);
+    if (ec) {
+        error = "Cannot read model for --memory-budget: " + model_path + " (" + ec.message() + ")";
+        return false;
+    }
+
+    gguf_context* ctx = gguf_init_from_file(model_path.c_str(), gguf_init_params{.no_alloc = true, .ctx = nullptr});
+    if (ctx == nullptr) {
+        error = "Cannot read GGUF header: " + model_path;
+        return false;
+    }
+
+    ModelMemoryInfo info;
+    info.file_bytes = file_bytes;
+    if (const std::int64_t id = gguf_find_key(ctx, "general.architecture");
+        id >= 0 && gguf_get_kv_type(ctx, id) == GGUF_TYPE_STRING) {
+        info.architecture = gguf_get_val_str(ctx, id);
+    }
+    const std::string& arch = info.architecture;
+    info.n_layer = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".block_count"));
+    info.n_embd = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".embedding_length"));
+    info.n_head = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".attention.head_count"));
+    info.n_head_kv = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".attention.head_count_kv"));
+    info.head_dim_k = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".attention.key_length"));
+    info.head_dim_v = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".attention.value_length"));
+    info.n_ff = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".feed_forward_length"));
+    info.n_ctx_train = static_cast<std::uint32_t>(gguf_uint(ctx, arch + ".context_length"));
+    if (const std::int64_t id = gguf_find_key(ctx, "tokenizer.ggml.tokens"); id >= 0) {
+        info.n_vocab = static_cast<std::uint32_t>(gguf_get_arr_n(ctx, id));
+    }
+    gguf_free(ctx);
+
+    if (arch.empty() || info.n_layer == 0 || info.n_embd == 0 || info.n_head == 0) {
+        error = "GGUF header lacks the attention hyperparameters needed for --memory-budget: " + model_path;
+        return false;
+    }
+    // Defaults as in llama.cpp: no KV grouping, head size n_embd / n_head.
+    if (info.n_head_kv == 0) {
+        info.n_head_kv = info.n_head;
+    }
+    if (info.head_dim_k == 0) {
+        info.head_dim_k = info.n_embd / info.n_head;
+    }
+    if (info.head_dim_v == 0) {
+        info.head_dim_v = info.n_embd / info.n_head;
+    }
+    out = std::move(info);
+    return true;
+}
+
+std::uint64_t context_memory_bytes(const ModelMemoryInfo& model, const MemoryPlanRequest& request, int n_ctx) {
+    return fixed_context_bytes(model, request)
+        + static_cast<std::uint64_t>(bytes_per_cell(model, request) * std::max(0, n_ctx));
+}
+
+bool plan_memory(
+    const ModelMemoryInfo& model,
+    const MemoryPlanRequest& request,
+    MemoryPlan& out,
+    std::string& error
+) {
+    MemoryPlan plan;
+    plan.model_bytes = model.file_bytes;
+    plan.reserve_bytes = kReserveBytes;
+    plan.kv_bytes_per_token = bytes_per_cell(model, request) - 4.0 * request.n_ubatch;
+    plan.compute_bytes = fixed_context_bytes(model, request);
+
+    const std::uint64_t fixed = plan.model_bytes + plan.reserve_bytes;
+    const std::uint64_t available = request.budget_bytes > fixed ? request.budget_bytes - fixed : 0;
+    const int single_ctx = largest_ctx_within(model, request, available);
+    if (single_ctx == 0) {
+        error = "--memory-budget " + std::to_string(request.budget_bytes / kMiB) + " MiB does not fit the model ("
+            + std::to_string(plan.model_bytes / kMiB) + " MiB), the reserve (" + std::to_string(kReserveBytes / kMiB)
+            + " MiB) and one " + std::to_string(kMinCtx) + "-token context";
+        return false;
+    }
+
+    plan.n_ctx = std::min(request.n_ctx, single_ctx);
+    const int growth = std::min(request.max_n_ctx, 2 * plan.n_ctx);
+    const std::uint64_t per_worker = context_memory_bytes(model, request, growth);
+    plan.workers = std::clamp<std::size_t>(
+        static_cast<std::size_t>(available / std::max<std::uint64_t>(per_worker, 1)),
+        1,
+        std::max<std::size_t>(request.workers, 1)
+    );
+    const int reachable = largest_ctx_within(model, request, available / plan.workers);
+    plan.max_n_ctx = std::max(plan.n_ctx, std::min(request.max_n_ctx, reachable));
+    plan.peak_bytes = fixed + plan.workers * context_memory_bytes(model, request, plan.max_n_ctx);
+    out = plan;
+    return true;
+}
+
+std::string describe_memory_plan(
+    const ModelMemoryInfo& model,
+    const MemoryPlanRequest& request,
+    const MemoryPlan& plan
+) {
+    std::ostringstream out;
+    out << "[memory] model=" << model.architecture << " layers=" << model.n_layer << " kv_heads=" << model.n_head_kv
+        << " head_dim=" << model.head_dim_k << "/" << model.head_dim_v << " train_ctx=" << model.n_ctx_train << "\n";
+    out << "[memory] budget_mib=" << request.budget_bytes / kMiB << " model_mib=" << plan.model_bytes / kMiB
+        << " reserve_mib=" << plan.reserve_bytes / kMiB << " cache_type_k=" << request.cache_type_k
+        << " cache_type_v=" << request.cache_type_v << " kv_kib_per_token=" << plan.kv_bytes_per_token / 1024.0
+        << " compute_mib_per_context=" << plan.compute_bytes / kMiB << "\n";
+    out << "[memory] plan workers=" << plan.workers << " (requested " << request.workers << ") ctx=" << plan.n_ctx
+        << " (requested " << request.n_ctx << ") max_ctx=" << plan.max_n_ctx << " (requested " << request.max_n_ctx
+        << ") peak_mib=" << plan.peak_bytes / kMiB << "\n";
+    return out.str();
+}
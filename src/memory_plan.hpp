@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// KV cache element types accepted by `--cache-type-k` / `--cache-type-v` (llama.cpp names: f16, q8_0, q4_0, ...).
+/// Returns the ggml_type value, or -1 for an unknown name.
+int kv_cache_ggml_type(const std::string& name);
+inline bool is_kv_cache_type(const std::string& name) {
+    return kv_cache_ggml_type(name) >= 0;
+}
+/// Block-quantized types; llama.cpp only supports a quantized V cache with flash attention.
+bool kv_cache_type_quantized(const std::string& name);
+/// Bytes per cached element, quantized types amortized over their block (f16 = 2, q8_0 = 34/32).
+double kv_cache_type_bytes(const std::string& name);
+
+/// Model sizes a memory plan needs, read from the GGUF header (no tensor data is loaded).
+struct ModelMemoryInfo {
+    std::string architecture;
+    /// Weights are mmapped, so the file size is what the model keeps resident.
+    std::uint64_t file_bytes = 0;
+    std::uint32_t n_layer = 0;
+    std::uint32_t n_embd = 0;
+    std::uint32_t n_head = 0;
+    /// Largest over layers for models with a per-layer KV head count.
+    std::uint32_t n_head_kv = 0;
+    std::uint32_t head_dim_k = 0;
+    std::uint32_t head_dim_v = 0;
+    std::uint32_t n_ff = 0;
+    std::uint32_t n_vocab = 0;
+    std::uint32_t n_ctx_train = 0;
+};
+
+bool read_model_memory_info(const std::string& model_path, ModelMemoryInfo& out, std::string& error);
+
+struct MemoryPlanRequest {
+    std::uint64_t budget_bytes = 0;
+    /// From the thread plan; the memory plan only lowers it.
+    std::size_t workers = 1;
+    int n_ctx = 2048;
+    int max_n_ctx = 131072;
+    int n_ubatch = 256;
+    std::string cache_type_k = "f16";
+    std::string cache_type_v = "f16";
+};
+
+struct MemoryPlan {
+    std::size_t workers = 1;
+    int n_ctx = 2048;
+    int max_n_ctx = 2048;
+    std::uint64_t model_bytes = 0;
+    /// Kept free for the process itself, parsed documents and output buffers.
+    std::uint64_t reserve_bytes = 0;
+    double kv_bytes_per_token = 0.0;
+    std::uint64_t compute_bytes = 0;
+    /// Every worker's context grown to max_n_ctx, plus the model and the reserve; never above the budget.
+    std::uint64_t peak_bytes = 0;
+};
+
+/// One context of `n_ctx` cells: K and V for every layer, plus an estimate of its compute buffers.
+std::uint64_t context_memory_bytes(const ModelMemoryInfo& model, const MemoryPlanRequest& request, int n_ctx);
+
+/// Fit workers, n_ctx and max_n_ctx into the budget. Workers are dropped first so that each keeps room to grow
+/// its context to twice n_ctx (or max_n_ctx if lower); n_ctx only shrinks when one worker at n_ctx does not fit.
+/// max_n_ctx is then the largest context every remaining worker can grow to at once.
+bool plan_memory(
+    const ModelMemoryInfo& model,
+    const MemoryPlanRequest& request,
+    MemoryPlan& out,
+    std::string& error
+);
+
+/// `[memory]` lines describing the model, the request and the plan.
+std::string describe_memory_plan(
+    const ModelMemoryInfo& model,
+    const MemoryPlanRequest& request,
+    const MemoryPlan& plan
+);
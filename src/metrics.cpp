@@ -0,0 +1,315 @@
+#include "metrics.hpp"
+
+#include "atomic_file.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <nlohmann/json.hpp>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string format_number(double value) {
+    char buf[32];
+    const auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    return ec == std::errc() ? std::string(buf, ptr) : std::string("0");
+}
+
+std::string with_label(const std::string& labels, const std::string& extra) {
+    return "{" + labels + (labels.empty() ? "" : ",") + extra + "}";
+}
+
+std::string label_block(const std::string& labels) {
+    return labels.empty() ? std::string{} : "{" + labels + "}";
+}
+
+/// Resident set size from /proc/self/statm (0 where unavailable).
+double resident_bytes() {
+#ifdef _WIN32
+    return 0.0;
+#else
+    std::ifstream in("/proc/self/statm");
+    std::uint64_t size_pages = 0;
+    std::uint64_t resident_pages = 0;
+    if (!(in >> size_pages >> resident_pages)) {
+        return 0.0;
+    }
+    return static_cast<double>(resident_pages) * static_cast<double>(::sysconf(_SC_PAGESIZE));
+#endif
+}
+
+double rate(double delta, double seconds) {
+    return seconds > 0.0 ? delta / seconds : 0.0;
+}
+
+}  // namespace
+
+MetricHistogram::MetricHistogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)), counts_(std::make_unique<std::atomic<std::uint64_t>[]>(bounds_.size() + 1)) {
+    std::ranges::sort(bounds_);
+}
+
+void MetricHistogram::observe(double value) {
+    const auto bucket = static_cast<std::size_t>(std::ranges::lower_bound(bounds_, value) - bounds_.begin());
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::vector<std::uint64_t> MetricHistogram::counts() const {
+    std::vector<std::uint64_t> out(bounds_.size() + 1);
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        out[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::find_or_add(
+    Kind kind,
+    const std::string& name,
+    const std::string& help,
+    const std::string& labels
+) {
+    for (auto& entry : entries_) {
+        if (entry.name == name && entry.labels == labels && entry.kind == kind) {
+            return entry;
+        }
+    }
+    auto& entry = entries_.emplace_back();
+    entry.kind = kind;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    return entry;
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = find_or_add(Kind::Counter, name, help, labels);
+    if (!entry.counter) {
+        entry.counter = std::make_unique<MetricCounter>();
+    }
+    return *entry.counter;
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = find_or_add(Kind::Gauge, name, help, labels);
+    if (!entry.gauge) {
+        entry.gauge = std::make_unique<MetricGauge>();
+    }
+    return *entry.gauge;
+}
+
+MetricHistogram& MetricsRegistry::histogram(
+    const std::string& name,
+    const std::string& help,
+    std::vector<double> bounds,
+    const std::string& labels
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = find_or_add(Kind::Histogram, name, help, labels);
+    if (!entry.histogram) {
+        entry.histogram = std::make_unique<MetricHistogram>(std::move(bounds));
+    }
+    return *entry.histogram;
+}
+
+std::string MetricsRegistry::prometheus_text() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Samples of one metric family must be contiguous, under a single HELP/TYPE header.
+    std::map<std::string, std::vector<const Entry*>> families;
+    for (const auto& entry : entries_) {
+        families[entry.name].push_back(&entry);
+    }
+
+    std::string out;
+    for (const auto& [name, entries] : families) {
+        const Kind kind = entries.front()->kind;
+        out += "# HELP " + name + " " + entries.front()->help + "\n";
+        out += "# TYPE " + name + (kind == Kind::Counter ? " counter\n" : kind == Kind::Gauge ? " gauge\n" : " histogram\n");
+        for (const Entry* entry : entries) {
+            if (entry->kind == Kind::Counter) {
+                out += name + label_block(entry->labels) + " " + format_number(entry->counter->value()) + "\n";
+            } else if (entry->kind == Kind::Gauge) {
+                out += name + label_block(entry->labels) + " " + format_number(entry->gauge->value()) + "\n";
+            } else {
+                const auto& bounds = entry->histogram->bounds();
+                const auto counts = entry->histogram->counts();
+                std::uint64_t cumulative = 0;
+                for (std::size_t i = 0; i < counts.size(); ++i) {
+                    cumulative += counts[i];
+                    const std::string le = i < bounds.size() ? format_number(bounds[i]) : "+Inf";
+                    out += name + "_bucket" + with_label(entry->labels, "le=\"" + le + "\"") + " "
+                        + std::to_string(cumulative) + "\n";
+                }
+                out += name + "_sum" + label_block(entry->labels) + " " + format_number(entry->histogram->sum()) + "\n";
+                out += name + "_count" + label_block(entry->labels) + " " + std::to_string(cumulative) + "\n";
+            }
+        }
+    }
+    return out;
+}
+
+std::string MetricsRegistry::json_snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nlohmann::ordered_json metrics = nlohmann::ordered_json::array();
+    for (const auto& entry : entries_) {
+        nlohmann::ordered_json metric{{"name", entry.name}, {"labels", entry.labels}};
+        if (entry.kind == Kind::Counter) {
+            metric["type"] = "counter";
+            metric["value"] = entry.counter->value();
+        } else if (entry.kind == Kind::Gauge) {
+            metric["type"] = "gauge";
+            metric["value"] = entry.gauge->value();
+        } else {
+            metric["type"] = "histogram";
+            metric["bounds"] = entry.histogram->bounds();
+            metric["counts"] = entry.histogram->counts();
+            metric["sum"] = entry.histogram->sum();
+        }
+        metrics.push_back(std::move(metric));
+    }
+    const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    );
+    return nlohmann::ordered_json{{"timestamp_ms", now.count()}, {"metrics", std::move(metrics)}}.dump(2) + "\n";
+}
+
+TeiMetrics::TeiMetrics(MetricsRegistry& r)
+    : registry(r),
+      segments_translated(r.counter("tei_mt_segments_translated_total", "Segments translated.")),
+      files_translated(r.counter("tei_mt_files_translated_total", "Files translated and written.")),
+      files_failed(r.counter("tei_mt_files_failed_total", "Files that failed to read, translate or write.")),
+      prompt_tokens(r.counter("tei_mt_prompt_tokens_total", "Prompt tokens prefilled.")),
+      generated_tokens(r.counter("tei_mt_generated_tokens_total", "Tokens generated.")),
+      prefill_seconds(r.counter("tei_mt_prefill_seconds_total", "Time spent in prompt prefill, summed over workers.")),
+      decode_seconds(r.counter("tei_mt_decode_seconds_total", "Time spent in token decode, summed over workers.")),
+      ctx_grows(r.counter("tei_mt_ctx_grows_total", "Context recreations to fit a long prompt.")),
+      coalesce_fallbacks(r.counter(
+          "tei_mt_coalesce_fallbacks_total", "Coalesced batches retranslated segment by segment."
+      )),
+      repetition_loops(r.counter(
+          "tei_mt_repetition_loops_total", "Generations aborted because the output fell into a repetition loop."
+      )),
+      repetition_tokens_saved(r.counter(
+          "tei_mt_repetition_tokens_saved_total", "Token-cap budget left unspent by aborted repetition loops."
+      )),
+      unit_retries(r.counter("tei_mt_unit_retries_total", "Translation units that threw and were retried.")),
+      segments_failed(r.counter(
+          "tei_mt_segments_failed_total", "Segments left untranslated after every retry of their unit."
+      )),
+      queue_files(r.gauge("tei_mt_queue_files", "Files waiting in the run queue.")),
+      queue_units(r.gauge("tei_mt_queue_units", "Translation units of the current file not yet started.")),
+      kv_cache_bytes(r.gauge("tei_mt_kv_cache_bytes", "KV cache memory of all live contexts.")),
+      unit_seconds(r.histogram(
+          "tei_mt_unit_seconds",
+          "Wall time per translation unit (segment or coalesced batch).",
+          {0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 300.0}
+      )),
+      prefill_tokens_per_second(r.gauge(
+          "tei_mt_prefill_tokens_per_second", "Prompt tokens per second of prefill time over the last interval."
+      )),
+      decode_tokens_per_second(r.gauge(
+          "tei_mt_decode_tokens_per_second", "Generated tokens per second of decode time over the last interval."
+      )),
+      segments_per_second(r.gauge("tei_mt_segments_per_second", "Segments translated per second over the last interval.")),
+      rss_bytes(r.gauge("tei_mt_resident_memory_bytes", "Resident set size of the process.")) {}
+
+MetricCounter& TeiMetrics::worker_busy_seconds(std::size_t worker) {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    while (worker_busy_.size() <= worker) {
+        const std::string labels = "worker=\"" + std::to_string(worker_busy_.size()) + "\"";
+        worker_busy_.push_back(&registry.counter(
+            "tei_mt_worker_busy_seconds_total", "Time a pipeline worker spent translating.", labels
+        ));
+        worker_busy_ratio_.push_back(&registry.gauge(
+            "tei_mt_worker_busy_ratio", "Fraction of the last interval a pipeline worker spent translating.", labels
+        ));
+    }
+    return *worker_busy_[worker];
+}
+
+MetricsRegistry& metrics_registry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+TeiMetrics& tei_metrics() {
+    static TeiMetrics metrics(metrics_registry());
+    return metrics;
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::start(const std::filesystem::path& path, std::chrono::seconds interval, std::string& error) {
+    path_ = path;
+    interval_ = interval;
+    last_ = std::chrono::steady_clock::now();
+    if (!export_once(error)) {
+        return false;
+    }
+    thread_ = std::jthread([this](std::stop_token stop_token) {
+        while (!stop_token.stop_requested()) {
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                wake_.wait_for(lock, stop_token, interval_, [] { return false; });
+            }
+            std::string export_error;
+            if (!export_once(export_error)) {
+                std::cerr << "[metrics] " << export_error << "\n";
+            }
+        }
+    });
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+bool MetricsExporter::export_once(std::string& error) {
+    TeiMetrics& m = tei_metrics();
+    const auto now = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(now - last_).count();
+    last_ = now;
+
+    const double prompt_tokens = m.prompt_tokens.value();
+    const double prefill_seconds = m.prefill_seconds.value();
+    const double generated_tokens = m.generated_tokens.value();
+    const double decode_seconds = m.decode_seconds.value();
+    const double segments = m.segments_translated.value();
+    m.prefill_tokens_per_second.set(rate(prompt_tokens - last_prompt_tokens_, prefill_seconds - last_prefill_seconds_));
+    m.decode_tokens_per_second.set(rate(generated_tokens - last_generated_tokens_, decode_seconds - last_decode_seconds_));
+    m.segments_per_second.set(rate(segments - last_segments_, seconds));
+    m.rss_bytes.set(resident_bytes());
+    last_prompt_tokens_ = prompt_tokens;
+    last_prefill_seconds_ = prefill_seconds;
+    last_generated_tokens_ = generated_tokens;
+    last_decode_seconds_ = decode_seconds;
+    last_segments_ = segments;
+    {
+        std::lock_guard<std::mutex> lock(m.workers_mutex_);
+        last_worker_busy_.resize(m.worker_busy_.size(), 0.0);
+        for (std::size_t w = 0; w < m.worker_busy_.size(); ++w) {
+            const double busy = m.worker_busy_[w]->value();
+            m.worker_busy_ratio_[w]->set(std::clamp(rate(busy - last_worker_busy_[w], seconds), 0.0, 1.0));
+            last_worker_busy_[w] = busy;
+        }
+    }
+
+    const bool json = path_.extension() == ".json";
+    const std::string text = json ? m.registry.json_snapshot() : m.registry.prometheus_text();
+    return write_file_atomically(path_, text, error);
+}
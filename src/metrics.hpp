@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Monotonic total. Updates are single atomic adds, safe from any thread.
+class MetricCounter {
+public:
+    void add(double amount = 1.0) { value_.fetch_add(amount, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/// Current level (queue depth, bytes in use, a rate).
+class MetricGauge {
+public:
+    void set(double value) { value_.store(value, std::memory_order_relaxed); }
+    void add(double amount) { value_.fetch_add(amount, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/// Fixed-bucket distribution; `bounds` are the ascending upper bounds (`+Inf` is implicit).
+class MetricHistogram {
+public:
+    explicit MetricHistogram(std::vector<double> bounds);
+    void observe(double value);
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    /// Per-bucket (not cumulative) counts; the last entry is the overflow bucket.
+    std::vector<std::uint64_t> counts() const;
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+    std::atomic<double> sum_{0.0};
+};
+
+/// Named metrics of one process. Registering takes a lock (once per metric and label set, normally at startup);
+/// updating a registered metric never does. Metrics live as long as the registry, so references can be cached.
+class MetricsRegistry {
+public:
+    /// `labels` is the Prometheus label body without braces, e.g. `worker="0"`; the same name and labels return
+    /// the same metric.
+    MetricCounter& counter(const std::string& name, const std::string& help, const std::string& labels = {});
+    MetricGauge& gauge(const std::string& name, const std::string& help, const std::string& labels = {});
+    MetricHistogram& histogram(
+        const std::string& name,
+        const std::string& help,
+        std::vector<double> bounds,
+        const std::string& labels = {}
+    );
+
+    /// Prometheus text exposition format (what node_exporter's textfile collector reads).
+    std::string prometheus_text() const;
+    /// `{"timestamp_ms":..., "metrics":[{"name","labels","type","value"|"buckets"...}]}`.
+    std::string json_snapshot() const;
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+    struct Entry {
+        Kind kind = Kind::Counter;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    Entry& find_or_add(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+};
+
+/// The metrics tei_mt updates, registered on first use in the process-wide registry.
+struct TeiMetrics {
+    explicit TeiMetrics(MetricsRegistry& registry);
+
+    MetricsRegistry& registry;
+    MetricCounter& segments_translated;
+    MetricCounter& files_translated;
+    MetricCounter& files_failed;
+    MetricCounter& prompt_tokens;
+    MetricCounter& generated_tokens;
+    /// Wall time spent in prompt prefill and in token-by-token decode, summed over workers.
+    MetricCounter& prefill_seconds;
+    MetricCounter& decode_seconds;
+    MetricCounter& ctx_grows;
+    MetricCounter& coalesce_fallbacks;
+    MetricCounter& repetition_loops;
+    MetricCounter& repetition_tokens_saved;
+    MetricCounter& unit_retries;
+    MetricCounter& segments_failed;
+    MetricGauge& queue_files;
+    MetricGauge& queue_units;
+    MetricGauge& kv_cache_bytes;
+    MetricHistogram& unit_seconds;
+    /// Derived by MetricsExporter over each export interval: tokens per second of prefill / decode time (engine
+    /// speed), segments per wall second, resident memory.
+    MetricGauge& prefill_tokens_per_second;
+    MetricGauge& decode_tokens_per_second;
+    MetricGauge& segments_per_second;
+    MetricGauge& rss_bytes;
+
+    /// Busy seconds of pipeline worker `worker` (registers it on first use).
+    MetricCounter& worker_busy_seconds(std::size_t worker);
+
+private:
+    friend class MetricsExporter;
+    std::mutex workers_mutex_;
+    std::vector<MetricCounter*> worker_busy_;
+    std::vector<MetricGauge*> worker_busy_ratio_;
+};
+
+MetricsRegistry& metrics_registry();
+TeiMetrics& tei_metrics();
+
+/// Writes the registry to `path` every `interval` (atomically: `<path>.part` + rename), and once more on stop.
+/// A `.json` path gets the JSON snapshot; anything else the Prometheus text format (use `*.prom` in the textfile
+/// collector directory). Before each write it samples RSS and derives rates and busy fractions from the counters.
+class MetricsExporter {
+public:
+    ~MetricsExporter();
+    bool start(const std::filesystem::path& path, std::chrono::seconds interval, std::string& error);
+    void stop();
+
+private:
+    bool export_once(std::string& error);
+
+    std::filesystem::path path_;
+    std::chrono::seconds interval_{15};
+    std::jthread thread_;
+    std::mutex wake_mutex_;
+    std::condition_variable_any wake_;
+    std::chrono::steady_clock::time_point last_;
+    double last_prompt_tokens_ = 0.0;
+    double last_prefill_seconds_ = 0.0;
+    double last_generated_tokens_ = 0.0;
+    double last_decode_seconds_ = 0.0;
+    double last_segments_ = 0.0;
+    std::vector<double> last_worker_busy_;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/// `--backend mock` settings; kept apart from translator_mock.hpp so AppConfig does not depend on the mock.
+struct MockTranslatorConfig {
+    /// Simulated compute per prompt token (prefill) and per generated token (decode), in microseconds.
+    double prefill_us = 20.0;
+    double decode_us = 200.0;
+    /// Spread of each call's cost: log-normal with this sigma around the mean (0 = exact).
+    double jitter = 0.3;
+    /// Probability that a call throws, as a failed llama_decode would.
+    double fail_rate = 0.0;
+    /// Probability that a coalesced answer loses one `<<<SEG>>>` marker (forcing the per-segment fallback).
+    double drift_rate = 0.0;
+    /// Probability that generation falls into a repetition loop (caught as LlamaTranslator's guard would).
+    double loop_rate = 0.0;
+    /// Cost of recreating the context when a prompt needs more than the current n_ctx.
+    double ctx_grow_ms = 40.0;
+    std::uint64_t seed = 1;
+
+    int n_ctx = 2048;
+    int max_n_ctx = 131072;
+    int max_tokens = 192;
+};
+
+/// `key=value,...` over prefill_us, decode_us, jitter, fail, drift, loop, grow_ms and seed (see `--mock-costs`).
+bool parse_mock_costs(const std::string& spec, MockTranslatorConfig& config, std::string& error);
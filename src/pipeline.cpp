@@ -1,62 +1,324 @@
 #include "pipeline.hpp"
 
+#include "metrics.hpp"
+#include "run_control.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <mutex>
+#include <ranges>
 #include <stop_token>
 #include <thread>
 
 namespace {
 
+/// Add the translator's last call to a unit report (no-op without one).
+void add_call(TranslationUnitReport* report, const Translator& tr) {
+    if (report == nullptr) {
+        return;
+    }
+    const TranslateCallInfo call = tr.last_call();
+    TranslateCallInfo& sum = report->calls;
+    sum.source_tokens += call.source_tokens;
+    sum.prompt_tokens += call.prompt_tokens;
+    sum.output_tokens += call.output_tokens;
+    sum.prefill_ms += call.prefill_ms;
+    sum.decode_ms += call.decode_ms;
+    sum.n_ctx = std::max(sum.n_ctx, call.n_ctx);
+    sum.ctx_grows += call.ctx_grows;
+    sum.cap_hit = sum.cap_hit || call.cap_hit;
+    sum.repetition_loops += call.repetition_loops;
+    sum.tokens_saved += call.tokens_saved;
+    ++report->translate_calls;
+}
+
+/// Reset `report` for a new unit.
+void begin_unit_report(
+    TranslationUnitReport& report,
+    std::span<const std::size_t> segment_indices,
+    std::size_t worker
+) {
+    report.segment_indices = segment_indices;
+    report.worker = worker;
+    report.unit_ms = 0.0;
+    report.calls = TranslateCallInfo{};
+    report.translate_calls = 0;
+    report.fallback = nullptr;
+    report.raw_output.clear();
+    report.failed = false;
+    report.error.clear();
+}
+
+/// Report a unit that failed the batch.
+void report_failed_unit(
+    TranslationUnitReport* report,
+    const std::string& error,
+    std::chrono::steady_clock::time_point unit_started,
+    const UnitDoneCallback& unit_done
+) {
+    if (report == nullptr) {
+        return;
+    }
+    const std::chrono::duration<double> unit_time = std::chrono::steady_clock::now() - unit_started;
+    report->unit_ms = unit_time.count() * 1000.0;
+    report->failed = true;
+    report->error = error;
+    unit_done(*report);
+}
+
+/// Before each unit: while the run is paused, free this worker's translator (its context) and wait; (re)build it
+/// when the run goes on. Returns false when the worker should stop instead; `error` is set if the rebuild failed.
+bool wait_for_run(
+    std::unique_ptr<Translator>& tr,
+    const Translator& prototype,
+    const std::stop_token& stop_token,
+    std::string& error
+) {
+    RunControl& control = run_control();
+    if (control.paused()) {
+        TEI_MT_TRACE_SCOPE("paused");
+        tr.reset();
+        while (control.paused() && !stop_token.stop_requested()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    if (control.stopping() || stop_token.stop_requested()) {
+        return false;
+    }
+    if (tr == nullptr) {
+        try {
+            tr = prototype.clone();
+        } catch (const std::exception& ex) {
+            error = ex.what();
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Segments of the units a drain kept from starting (`first_unstarted` on), as failed segments.
+template <typename UnitIndices>
+void add_unstarted_segments(
+    const std::vector<Segment>& segments,
+    std::size_t first_unstarted,
+    std::size_t units,
+    const UnitIndices& unit_indices,
+    TranslationStats& stats
+) {
+    for (std::size_t unit = first_unstarted; unit < units; ++unit) {
+        for (const std::size_t index : unit_indices(unit)) {
+            stats.failed_segments.push_back(
+                FailedSegment{index, std::string(segments[index].id), "cancelled before translation"}
+            );
+        }
+    }
+    std::ranges::sort(stats.failed_segments, {}, &FailedSegment::index);
+}
+
+/// Retries units that threw (see UnitRetryPolicy) and collects the segments that still fail. Shared by the
+/// workers of one pipeline run.
+class UnitRecovery {
+public:
+    UnitRecovery(const Translator& prototype, const UnitRetryPolicy& policy)
+        : prototype_(prototype), policy_(policy) {}
+
+    /// A unit threw `error` on `tr` (whose failed call is already in `report`). Retry its segments not yet marked
+    /// in `translated`, replacing `tr` with each fresh clone, and mark those that succeed. Returns false when the
+    /// batch must fail instead; `error` is then its message.
+    bool recover(
+        std::unique_ptr<Translator>& tr,
+        const std::vector<Segment>& segments,
+        std::span<const std::size_t> ix,
+        std::vector<std::string>& out,
+        std::vector<std::uint8_t>& translated,
+        std::string& error,
+        TranslationUnitReport* report
+    ) {
+        if (policy_.retries == 0 || run_control().aborting()) {
+            return false;
+        }
+        TEI_MT_TRACE_SCOPE("unit_retry");
+        tei_metrics().unit_retries.add();
+        if (report != nullptr) {
+            report->fallback = "retry";
+            report->raw_output = error;
+        }
+
+        // Only segments still untranslated: a per-segment fallback may have finished some before throwing.
+        std::vector<FailedSegment> pending;
+        pending.reserve(ix.size());
+        for (const std::size_t idx : ix) {
+            if (translated[idx] == 0) {
+                pending.push_back(FailedSegment{idx, std::string(segments[idx].id), error});
+            }
+        }
+        // A drain leaves the unit's segments failed rather than waiting for retries.
+        for (std::size_t attempt = 1; attempt <= policy_.retries && !pending.empty() && !run_control().stopping();
+             ++attempt) {
+            try {
+                tr = prototype_.clone();
+            } catch (const std::exception& ex) {
+                for (auto& segment : pending) {
+                    segment.error = ex.what();
+                }
+                continue;
+            }
+            std::vector<FailedSegment> still_failing;
+            for (auto& failed : pending) {
+                Segment segment = segments[failed.index];
+                if (attempt >= 2) {
+                    const int budget =
+                        segment.max_output_tokens > 0 ? segment.max_output_tokens : policy_.max_output_tokens;
+                    segment.max_output_tokens = std::max(16, budget / 2);
+                }
+                try {
+                    out[failed.index] = tr->translate(segment);
+                    translated[failed.index] = 1;
+                    add_call(report, *tr);
+                } catch (const std::exception& ex) {
+                    add_call(report, *tr);
+                    failed.error = ex.what();
+                    still_failing.push_back(std::move(failed));
+                } catch (...) {
+                    add_call(report, *tr);
+                    failed.error = "Unknown translation error";
+                    still_failing.push_back(std::move(failed));
+                }
+            }
+            pending = std::move(still_failing);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++retried_units_;
+        if (pending.empty()) {
+            consecutive_failed_units_ = 0;
+            return true;
+        }
+        error = pending.back().error;
+        if (report != nullptr) {
+            report->failed = true;
+            report->error = error;
+        }
+        tei_metrics().segments_failed.add(static_cast<double>(pending.size()));
+        for (auto& failed : pending) {
+            out[failed.index].clear();
+            failed_.push_back(std::move(failed));
+        }
+        if (++consecutive_failed_units_ >= policy_.max_consecutive_failed_units) {
+            error = std::to_string(consecutive_failed_units_) + " units in a row failed after retries; last error: "
+                + error;
+            return false;
+        }
+        return true;
+    }
+
+    /// A unit finished without throwing.
+    void unit_ok() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        consecutive_failed_units_ = 0;
+    }
+
+    /// Move the results into `stats` once the workers have joined.
+    void finish(TranslationStats& stats) {
+        std::ranges::sort(failed_, {}, &FailedSegment::index);
+        stats.failed_segments = std::move(failed_);
+        stats.retried_units = retried_units_;
+    }
+
+private:
+    const Translator& prototype_;
+    const UnitRetryPolicy& policy_;
+    std::mutex mutex_;
+    std::vector<FailedSegment> failed_;
+    std::size_t retried_units_ = 0;
+    std::size_t consecutive_failed_units_ = 0;
+};
+
 void run_translation_work_unit(
     Translator& tr,
     const std::vector<Segment>& segments,
     const TranslationWorkUnit& unit,
     std::vector<std::string>& out,
+    std::vector<std::uint8_t>& translated,
     const CoalesceParams& coalesce,
     std::atomic<std::size_t>& fallback_units,
-    std::atomic<std::size_t>& completed
+    std::atomic<std::size_t>& completed,
+    TranslationUnitReport* report
 ) {
+    TEI_MT_TRACE_SCOPE("translation_unit");
     const auto& ix = unit.segment_indices;
     if (ix.size() == 1) {
         out[ix[0]] = tr.translate(segments[ix[0]]);
+        translated[ix[0]] = 1;
+        add_call(report, tr);
         completed.fetch_add(1, std::memory_order_relaxed);
         return;
     }
 
+    const std::string merged_zh = merge_source_zh(segments, ix);
     Segment batched;
-    batched.source_zh = merge_source_zh(segments, ix);
+    batched.source_zh = merged_zh;
     batched.coalesced_batch = true;
     batched.max_output_tokens =
         compute_batch_max_output_tokens(coalesce.max_tokens_per_segment, ix.size(), coalesce.n_ctx);
 
     const auto fallback_individual = [&]() {
+        TEI_MT_TRACE_SCOPE("coalesce_fallback");
         for (std::size_t idx : ix) {
             out[idx] = tr.translate(segments[idx]);
+            translated[idx] = 1;
+            add_call(report, tr);
         }
         fallback_units.fetch_add(1, std::memory_order_relaxed);
+        tei_metrics().coalesce_fallbacks.add();
         completed.fetch_add(ix.size(), std::memory_order_relaxed);
     };
 
+    const auto note_fallback = [&](const char* reason, std::string raw_output) {
+        if (report != nullptr) {
+            report->fallback = reason;
+            report->raw_output = std::move(raw_output);
+        }
+    };
+
     std::string merged_en;
     try {
         merged_en = tr.translate(batched);
+        add_call(report, tr);
+    } catch (const RepetitionLoopError& ex) {
+        add_call(report, tr);
+        note_fallback("loop", ex.output());
+        fallback_individual();
+        return;
+    } catch (const std::exception& ex) {
+        add_call(report, tr);
+        note_fallback("error", ex.what());
+        fallback_individual();
+        return;
     } catch (...) {
+        add_call(report, tr);
+        note_fallback("error", "Unknown translation error");
         fallback_individual();
         return;
     }
 
     const std::vector<std::string> parts = split_coalesced_english(merged_en, ix.size());
     if (parts.size() != ix.size()) {
+        note_fallback("split", std::move(merged_en));
         fallback_individual();
         return;
     }
 
     for (std::size_t j = 0; j < ix.size(); ++j) {
         out[ix[j]] = parts[j];
+        translated[ix[j]] = 1;
     }
     completed.fetch_add(ix.size(), std::memory_order_relaxed);
 }
@@ -70,7 +332,10 @@ bool translate_segments_parallel(
     std::vector<std::string>& out_translations,
     TranslationStats& out_stats,
     std::string& error,
-    const std::function<void(std::size_t, std::size_t)>& progress_callback
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    const SegmentDoneCallback& segment_done,
+    const UnitDoneCallback& unit_done,
+    const UnitRetryPolicy& retry
 ) {
     out_stats = TranslationStats{};
     out_stats.segments_total = segments.size();
@@ -90,12 +355,23 @@ bool translate_segments_parallel(
     out_stats.workers_used = workers_used;
 
     out_translations.resize(segments.size());
+    out_stats.unit_latency_ms.assign(segments.size(), 0.0f);
+    // Per-segment completion, written only by the worker holding the segment's unit.
+    std::vector<std::uint8_t> translated(segments.size(), 0);
 
     std::atomic<std::size_t> next_index{0};
     std::atomic<std::size_t> completed{0};
     std::atomic<bool> failed{false};
     std::mutex error_mutex;
     std::stop_source stop_source;
+    UnitRecovery recovery(prototype, retry);
+    const auto fail_batch = [&](const std::string& message) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed.exchange(true, std::memory_order_relaxed)) {
+            error = run_control().aborting() ? "run aborted" : message;
+        }
+        stop_source.request_stop();
+    };
 
     const auto started = std::chrono::steady_clock::now();
 
@@ -125,47 +401,103 @@ bool translate_segments_parallel(
     std::vector<std::jthread> pool;
     pool.reserve(workers_used);
 
-    auto worker_fn = [&](std::stop_token stop_token) {
-        auto local_translator = prototype.clone();
+    auto worker_fn = [&](std::stop_token stop_token, std::size_t worker) {
+        std::unique_ptr<Translator> local_translator;
+        TeiMetrics& metrics = tei_metrics();
+        MetricCounter& busy_seconds = metrics.worker_busy_seconds(worker);
+        TEI_MT_TRACE_THREAD("worker " + std::to_string(worker));
+        TranslationUnitReport unit_report;
+        TranslationUnitReport* const report = unit_done ? &unit_report : nullptr;
 
         while (!stop_token.stop_requested() && !failed.load(std::memory_order_relaxed)) {
+            std::string wait_error;
+            if (!wait_for_run(local_translator, prototype, stop_token, wait_error)) {
+                if (!wait_error.empty()) {
+                    fail_batch(wait_error);
+                }
+                return;
+            }
             const std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
             if (index >= segments.size()) {
                 return;
             }
+            metrics.queue_units.set(static_cast<double>(segments.size() - index - 1));
+            if (report != nullptr) {
+                begin_unit_report(unit_report, std::span<const std::size_t>(&index, 1), worker);
+            }
 
+            const auto unit_started = std::chrono::steady_clock::now();
+            std::string unit_error;
             try {
                 out_translations[index] = local_translator->translate(segments[index]);
-                completed.fetch_add(1, std::memory_order_relaxed);
+                translated[index] = 1;
             } catch (const std::exception& ex) {
-                std::lock_guard<std::mutex> lock(error_mutex);
-                if (!failed.exchange(true, std::memory_order_relaxed)) {
-                    error = ex.what();
-                }
-                stop_source.request_stop();
-                return;
+                unit_error = ex.what();
             } catch (...) {
-                std::lock_guard<std::mutex> lock(error_mutex);
-                if (!failed.exchange(true, std::memory_order_relaxed)) {
-                    error = "Unknown translation error";
-                }
-                stop_source.request_stop();
+                unit_error = "Unknown translation error";
+            }
+            add_call(report, *local_translator);
+
+            if (unit_error.empty()) {
+                recovery.unit_ok();
+            } else if (!recovery.recover(
+                           local_translator,
+                           segments,
+                           std::span<const std::size_t>(&index, 1),
+                           out_translations,
+                           translated,
+                           unit_error,
+                           report
+                       )) {
+                report_failed_unit(report, unit_error, unit_started, unit_done);
+                fail_batch(unit_error);
                 return;
             }
+
+            const std::chrono::duration<double> unit_time = std::chrono::steady_clock::now() - unit_started;
+            out_stats.unit_latency_ms[index] = static_cast<float>(unit_time.count() * 1000.0);
+            if (report != nullptr) {
+                unit_report.unit_ms = unit_time.count() * 1000.0;
+                unit_done(unit_report);
+            }
+            busy_seconds.add(unit_time.count());
+            metrics.unit_seconds.observe(unit_time.count());
+            completed.fetch_add(1, std::memory_order_relaxed);
+            if (translated[index] != 0) {
+                metrics.segments_translated.add();
+                if (segment_done) {
+                    segment_done(index);
+                }
+            }
         }
     };
 
     for (std::size_t i = 0; i < workers_used; ++i) {
-        pool.emplace_back(worker_fn, stop_source.get_token());
+        pool.emplace_back(worker_fn, stop_source.get_token(), i);
     }
 
     for (auto& thread : pool) {
         thread.join();
     }
+    tei_metrics().queue_units.set(0.0);
+    recovery.finish(out_stats);
 
+    if (run_control().aborting() && !failed.load(std::memory_order_relaxed)) {
+        fail_batch("run aborted");
+    }
     if (failed.load(std::memory_order_relaxed)) {
         return false;
     }
+    if (const std::size_t started_units = std::min(next_index.load(), segments.size());
+        started_units < segments.size()) {
+        add_unstarted_segments(
+            segments,
+            started_units,
+            segments.size(),
+            [](std::size_t unit) { return std::views::single(unit); },
+            out_stats
+        );
+    }
 
     const auto ended = std::chrono::steady_clock::now();
     out_stats.wall_time = std::chrono::duration_cast<std::chrono::milliseconds>(ended - started);
@@ -191,7 +523,10 @@ bool translate_segments_coalesced_parallel(
     std::vector<std::string>& out_translations,
     TranslationStats& out_stats,
     std::string& error,
-    const std::function<void(std::size_t, std::size_t)>& progress_callback
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    const SegmentDoneCallback& segment_done,
+    const UnitDoneCallback& unit_done,
+    const UnitRetryPolicy& retry
 ) {
     out_stats = TranslationStats{};
     out_stats.segments_total = segments.size();
@@ -213,6 +548,9 @@ bool translate_segments_coalesced_parallel(
     out_stats.workers_used = workers_used;
 
     out_translations.resize(segments.size());
+    out_stats.unit_latency_ms.assign(work_units.size(), 0.0f);
+    // Per-segment completion, written only by the worker holding the segment's unit.
+    std::vector<std::uint8_t> translated(segments.size(), 0);
 
     std::atomic<std::size_t> next_index{0};
     std::atomic<std::size_t> completed{0};
@@ -220,6 +558,14 @@ bool translate_segments_coalesced_parallel(
     std::atomic<bool> failed{false};
     std::mutex error_mutex;
     std::stop_source stop_source;
+    UnitRecovery recovery(prototype, retry);
+    const auto fail_batch = [&](const std::string& message) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed.exchange(true, std::memory_order_relaxed)) {
+            error = run_control().aborting() ? "run aborted" : message;
+        }
+        stop_source.request_stop();
+    };
 
     const auto started = std::chrono::steady_clock::now();
 
@@ -249,56 +595,114 @@ bool translate_segments_coalesced_parallel(
     std::vector<std::jthread> pool;
     pool.reserve(workers_used);
 
-    auto worker_fn = [&](std::stop_token stop_token) {
-        auto local_translator = prototype.clone();
+    auto worker_fn = [&](std::stop_token stop_token, std::size_t worker) {
+        std::unique_ptr<Translator> local_translator;
+        TeiMetrics& metrics = tei_metrics();
+        MetricCounter& busy_seconds = metrics.worker_busy_seconds(worker);
+        TEI_MT_TRACE_THREAD("worker " + std::to_string(worker));
+        TranslationUnitReport unit_report;
+        TranslationUnitReport* const report = unit_done ? &unit_report : nullptr;
 
         while (!stop_token.stop_requested() && !failed.load(std::memory_order_relaxed)) {
+            std::string wait_error;
+            if (!wait_for_run(local_translator, prototype, stop_token, wait_error)) {
+                if (!wait_error.empty()) {
+                    fail_batch(wait_error);
+                }
+                return;
+            }
             const std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
             if (index >= work_units.size()) {
                 return;
             }
+            metrics.queue_units.set(static_cast<double>(work_units.size() - index - 1));
+            if (report != nullptr) {
+                begin_unit_report(unit_report, work_units[index].segment_indices, worker);
+            }
 
+            const auto unit_started = std::chrono::steady_clock::now();
+            const auto& unit_indices = work_units[index].segment_indices;
+            std::string unit_error;
             try {
                 run_translation_work_unit(
                     *local_translator,
                     segments,
                     work_units[index],
                     out_translations,
+                    translated,
                     coalesce,
                     fallback_units,
-                    completed
+                    completed,
+                    report
                 );
             } catch (const std::exception& ex) {
-                std::lock_guard<std::mutex> lock(error_mutex);
-                if (!failed.exchange(true, std::memory_order_relaxed)) {
-                    error = ex.what();
-                }
-                stop_source.request_stop();
-                return;
+                unit_error = ex.what();
             } catch (...) {
-                std::lock_guard<std::mutex> lock(error_mutex);
-                if (!failed.exchange(true, std::memory_order_relaxed)) {
-                    error = "Unknown translation error";
+                unit_error = "Unknown translation error";
+            }
+
+            if (unit_error.empty()) {
+                recovery.unit_ok();
+            } else {
+                add_call(report, *local_translator);
+                if (!recovery.recover(
+                        local_translator, segments, unit_indices, out_translations, translated, unit_error, report
+                    )) {
+                    report_failed_unit(report, unit_error, unit_started, unit_done);
+                    fail_batch(unit_error);
+                    return;
+                }
+                completed.fetch_add(unit_indices.size(), std::memory_order_relaxed);
+            }
+
+            const std::chrono::duration<double> unit_time = std::chrono::steady_clock::now() - unit_started;
+            out_stats.unit_latency_ms[index] = static_cast<float>(unit_time.count() * 1000.0);
+            if (report != nullptr) {
+                unit_report.unit_ms = unit_time.count() * 1000.0;
+                unit_done(unit_report);
+            }
+            busy_seconds.add(unit_time.count());
+            metrics.unit_seconds.observe(unit_time.count());
+            for (const std::size_t segment_index : unit_indices) {
+                if (translated[segment_index] == 0) {
+                    continue;
+                }
+                metrics.segments_translated.add();
+                if (segment_done) {
+                    segment_done(segment_index);
                 }
-                stop_source.request_stop();
-                return;
             }
         }
     };
 
     for (std::size_t i = 0; i < workers_used; ++i) {
-        pool.emplace_back(worker_fn, stop_source.get_token());
+        pool.emplace_back(worker_fn, stop_source.get_token(), i);
     }
 
     for (auto& thread : pool) {
         thread.join();
     }
+    tei_metrics().queue_units.set(0.0);
+    recovery.finish(out_stats);
 
     out_stats.coalesce_fallback_units = fallback_units.load(std::memory_order_relaxed);
 
+    if (run_control().aborting() && !failed.load(std::memory_order_relaxed)) {
+        fail_batch("run aborted");
+    }
     if (failed.load(std::memory_order_relaxed)) {
         return false;
     }
+    if (const std::size_t started_units = std::min(next_index.load(), work_units.size());
+        started_units < work_units.size()) {
+        add_unstarted_segments(
+            segments,
+            started_units,
+            work_units.size(),
+            [&](std::size_t unit) { return std::span<const std::size_t>(work_units[unit].segment_indices); },
+            out_stats
+        );
+    }
 
     const auto ended = std::chrono::steady_clock::now();
     out_stats.wall_time = std::chrono::duration_cast<std::chrono::milliseconds>(ended - started);
@@ -7,9 +7,19 @@
 #include <chrono>
 #include <cstddef>
 #include <functional>
+#include <span>
 #include <string>
 #include <vector>
 
+/// A segment still untranslated after every retry of its unit (see UnitRetryPolicy).
+struct FailedSegment {
+    /// Index into the segments passed to the pipeline.
+    std::size_t index = 0;
+    /// Segment key (xml:id or `seg-N`).
+    std::string key;
+    std::string error;
+};
+
 struct TranslationStats {
     std::size_t segments_total = 0;
     /// Single-segment jobs or merged batches actually queued (same as segments_total when coalescing is off).
@@ -19,8 +29,57 @@ struct TranslationStats {
     std::chrono::milliseconds wall_time{0};
     double segments_per_second = 0.0;
     double ms_per_segment = 0.0;
+    /// Wall time of each translation unit (segment or merged batch, fallback included), in completion order for
+    /// remote units and unit order otherwise.
+    std::vector<float> unit_latency_ms;
+    /// Units that threw and were retried.
+    std::size_t retried_units = 0;
+    /// Sorted by index. Their translations are left empty and must not be written out as translations; the
+    /// segment_done callback is not called for them.
+    std::vector<FailedSegment> failed_segments;
+};
+
+/// What a worker does when a unit throws (`--unit-retries`). Each retry translates the unit's remaining segments
+/// one at a time on a fresh translator clone (a new context); the second also halves their output budget.
+/// Segments that fail every retry are reported in TranslationStats::failed_segments and the batch completes.
+struct UnitRetryPolicy {
+    /// 0 fails the whole batch on the first error.
+    std::size_t retries = 2;
+    /// The translator's default output budget (for segments that carry none), halved by the second retry.
+    int max_output_tokens = 192;
+    /// Fail the batch anyway once this many units in a row end with failed segments: then the backend is
+    /// broken, not the segments.
+    std::size_t max_consecutive_failed_units = 8;
 };
 
+/// Called from worker threads with the index of each segment whose translation has just been stored in
+/// `out_translations`; must be thread-safe. Lets callers persist results while the batch is still running.
+using SegmentDoneCallback = std::function<void(std::size_t)>;
+
+/// One translation unit as it finished, for per-unit telemetry (`--unit-log`).
+struct TranslationUnitReport {
+    /// Indices into the segments passed to the pipeline.
+    std::span<const std::size_t> segment_indices;
+    std::size_t worker = 0;
+    double unit_ms = 0.0;
+    /// Summed over every translate() call of the unit (the merged attempt plus any fallback calls).
+    TranslateCallInfo calls;
+    std::size_t translate_calls = 0;
+    /// Set when a merged batch was retranslated segment by segment: "split" (the answer did not split into one
+    /// part per segment), "loop" (generation was aborted in a repetition loop) or "error" (the merged call threw);
+    /// or "retry" when the unit threw and was retried per UnitRetryPolicy. `raw_output` holds the merged answer
+    /// (up to the abort for "loop") or the error.
+    const char* fallback = nullptr;
+    std::string raw_output;
+    /// The unit threw and at least one of its segments failed every retry (or retries are off); `error` is the
+    /// last exception text.
+    bool failed = false;
+    std::string error;
+};
+
+/// Called from worker threads after each unit, including one that failed; must be thread-safe.
+using UnitDoneCallback = std::function<void(const TranslationUnitReport&)>;
+
 bool translate_segments_parallel(
     const std::vector<Segment>& segments,
     const Translator& prototype,
@@ -28,7 +87,10 @@ bool translate_segments_parallel(
     std::vector<std::string>& out_translations,
     TranslationStats& out_stats,
     std::string& error,
-    const std::function<void(std::size_t, std::size_t)>& progress_callback = {}
+    const std::function<void(std::size_t, std::size_t)>& progress_callback = {},
+    const SegmentDoneCallback& segment_done = {},
+    const UnitDoneCallback& unit_done = {},
+    const UnitRetryPolicy& retry = {}
 );
 
 bool translate_segments_coalesced_parallel(
@@ -39,5 +101,8 @@ bool translate_segments_coalesced_parallel(
     std::vector<std::string>& out_translations,
     TranslationStats& out_stats,
     std::string& error,
-    const std::function<void(std::size_t, std::size_t)>& progress_callback = {}
+    const std::function<void(std::size_t, std::size_t)>& progress_callback = {},
+    const SegmentDoneCallback& segment_done = {},
+    const UnitDoneCallback& unit_done = {},
+    const UnitRetryPolicy& retry = {}
 );
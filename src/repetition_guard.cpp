@@ -0,0 +1,34 @@
+#include "repetition_guard.hpp"
+
+#include <algorithm>
+
+void RepetitionGuard::reset() {
+    tokens_.clear();
+    run_.fill(0);
+    boundary_ = 0;
+    keep_ = 0;
+}
+
+void RepetitionGuard::mark_boundary() {
+    run_.fill(0);
+    boundary_ = tokens_.size();
+}
+
+bool RepetitionGuard::push(std::int32_t token) {
+    tokens_.push_back(token);
+    const std::size_t n = tokens_.size() - 1;
+    bool looping = false;
+    for (std::size_t p = 1; p <= kMaxPeriod; ++p) {
+        if (n < boundary_ + p || tokens_[n] != tokens_[n - p]) {
+            run_[p] = 0;
+            continue;
+        }
+        ++run_[p];
+        // run_[p] repeated tokens after the first copy make run_[p] / p + 1 copies.
+        if (!looping && run_[p] >= std::max(kMinRunTokens, (kMinCopies - 1) * p)) {
+            keep_ = n + 1 - run_[p];
+            looping = true;
+        }
+    }
+    return looping;
+}
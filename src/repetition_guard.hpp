@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Spots generated output that has fallen into a loop: the newest tokens repeat a unit of at most kMaxPeriod
+/// tokens over at least kMinCopies copies and kMinRunTokens repeated tokens (33 tokens for a one-token loop, 128
+/// for a 32-token phrase). Checking is O(kMaxPeriod) per token: one running match length per period.
+class RepetitionGuard {
+public:
+    static constexpr std::size_t kMaxPeriod = 32;
+    static constexpr std::size_t kMinCopies = 4;
+    static constexpr std::size_t kMinRunTokens = 32;
+
+    void reset();
+    /// Start of a new passage in a merged answer: repeats spanning the boundary do not count.
+    void mark_boundary();
+    /// Append a generated token; true once the output ends in a loop.
+    bool push(std::int32_t token);
+    /// After push() returned true: tokens before the loop plus its first copy (what is worth keeping).
+    std::size_t keep_tokens() const { return keep_; }
+
+private:
+    std::vector<std::int32_t> tokens_;
+    /// run_[p]: how many of the newest tokens each equal the token p positions earlier.
+    std::array<std::size_t, kMaxPeriod + 1> run_{};
+    std::size_t boundary_ = 0;
+    std::size_t keep_ = 0;
+};
@@ -0,0 +1,108 @@
+#include "run_control.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+/// Constant-initialized, so a signal handler never runs its construction.
+constinit RunControl g_run_control;
+volatile std::sig_atomic_t g_stop_signal = 0;
+
+void write_stderr(const char* message, std::size_t length) {
+#ifndef _WIN32
+    // std::cerr is not async-signal-safe; write(2) is.
+    [[maybe_unused]] const auto written = ::write(STDERR_FILENO, message, length);
+#else
+    (void)message;
+    (void)length;
+#endif
+}
+
+template <std::size_t N>
+void write_stderr(const char (&message)[N]) {
+    write_stderr(message, N - 1);
+}
+
+extern "C" void on_stop_signal(int sig) {
+    switch (g_run_control.mode()) {
+        case RunControl::Mode::Run:
+        case RunControl::Mode::Pause:
+            g_stop_signal = sig;
+            g_run_control.drain();
+            write_stderr("\n[cancel] draining: finishing in-flight units (signal again to abort)\n");
+            break;
+        case RunControl::Mode::Drain:
+            g_run_control.abort();
+            write_stderr("\n[cancel] aborting: stopping generation now (signal again to exit at once)\n");
+            break;
+        case RunControl::Mode::Abort:
+            write_stderr("\n[cancel] third signal: exiting\n");
+            std::_Exit(128 + sig);
+    }
+    std::signal(sig, on_stop_signal);
+}
+
+#ifndef _WIN32
+extern "C" void on_pause_signal(int sig) {
+    if (sig == SIGUSR1) {
+        g_run_control.pause();
+    } else {
+        g_run_control.resume();
+    }
+    std::signal(sig, on_pause_signal);
+}
+#endif
+
+}  // namespace
+
+void RunControl::transition(Mode from, Mode to) {
+    int expected = static_cast<int>(from);
+    mode_.compare_exchange_strong(expected, static_cast<int>(to), std::memory_order_acq_rel);
+}
+
+void RunControl::pause() {
+    transition(Mode::Run, Mode::Pause);
+}
+
+void RunControl::resume() {
+    transition(Mode::Pause, Mode::Run);
+}
+
+void RunControl::drain() {
+    int current = mode_.load(std::memory_order_acquire);
+    while (current < static_cast<int>(Mode::Drain)
+           && !mode_.compare_exchange_weak(current, static_cast<int>(Mode::Drain), std::memory_order_acq_rel)) {
+    }
+}
+
+RunControl::Mode RunControl::wait_while_paused(std::chrono::milliseconds poll) const {
+    Mode current = mode();
+    while (current == Mode::Pause) {
+        std::this_thread::sleep_for(poll);
+        current = mode();
+    }
+    return current;
+}
+
+RunControl& run_control() {
+    return g_run_control;
+}
+
+void install_run_control_signal_handlers() {
+    std::signal(SIGINT, on_stop_signal);
+    std::signal(SIGTERM, on_stop_signal);
+#ifndef _WIN32
+    std::signal(SIGUSR1, on_pause_signal);
+    std::signal(SIGUSR2, on_pause_signal);
+#endif
+}
+
+int run_control_signal() {
+    return g_stop_signal;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+/// Cooperative control of a translation run, steered by signal handlers (CLI) or a host process. Pipeline workers
+/// check it between units, so a unit that has started is never lost: pause and drain both let it finish. Every
+/// member is a lock-free atomic operation and may be called from a signal handler.
+class RunControl {
+public:
+    enum class Mode : int {
+        Run,
+        /// Workers finish their unit, free their translator (its llama context and KV cache) and wait; resume()
+        /// rebuilds it. The loaded model stays.
+        Pause,
+        /// Cancel: workers finish their unit and take no more. Segments not started are left untranslated, so
+        /// the file is written as a partial output (see failed_segments.hpp) and no further files start.
+        Drain,
+        /// Cancel at once: generation stops at the next token and the current batch fails unwritten (its file is
+        /// left for the next run); no further files start.
+        Abort,
+    };
+
+    constexpr RunControl() = default;
+
+    Mode mode() const { return static_cast<Mode>(mode_.load(std::memory_order_acquire)); }
+    bool paused() const { return mode() == Mode::Pause; }
+    /// Drain or abort: no new units should start.
+    bool stopping() const { return mode() >= Mode::Drain; }
+    bool aborting() const { return mode() == Mode::Abort; }
+
+    /// Run -> Pause.
+    void pause();
+    /// Pause -> Run.
+    void resume();
+    /// Run or Pause -> Drain.
+    void drain();
+    void abort() { mode_.store(static_cast<int>(Mode::Abort), std::memory_order_release); }
+
+    /// Block the calling thread while paused (polling every `poll`). Returns the mode that ended the pause.
+    Mode wait_while_paused(std::chrono::milliseconds poll = std::chrono::milliseconds(100)) const;
+
+private:
+    static_assert(std::atomic<int>::is_always_lock_free, "RunControl must be usable from signal handlers");
+    void transition(Mode from, Mode to);
+
+    std::atomic<int> mode_{static_cast<int>(Mode::Run)};
+};
+
+/// The process-wide control every pipeline worker checks.
+RunControl& run_control();
+
+/// CLI handlers: the first SIGINT or SIGTERM drains, a second aborts and a third exits at once; on POSIX SIGUSR1
+/// pauses and SIGUSR2 resumes.
+void install_run_control_signal_handlers();
+/// Signal that started a drain, or 0.
+int run_control_signal();
@@ -0,0 +1,162 @@
+#include "run_order.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+#include <string_view>
+
+namespace {
+
+constexpr double kDefaultMsPerToken = 2.0;
+
+bool parse_u64(std::string_view text, std::uint64_t& out) {
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+/// Split `line` on tabs into exactly `N` fields.
+template <std::size_t N>
+bool split_tabs(std::string_view line, std::string_view (&fields)[N]) {
+    for (std::size_t i = 0; i < N; ++i) {
+        const auto tab = line.find('\t');
+        if ((tab == std::string_view::npos) != (i + 1 == N)) {
+            return false;
+        }
+        fields[i] = line.substr(0, tab);
+        line = tab == std::string_view::npos ? std::string_view{} : line.substr(tab + 1);
+    }
+    return true;
+}
+
+}  // namespace
+
+bool parse_run_order(const std::string& value, RunOrder& out) {
+    if (value == "lexical") {
+        out = RunOrder::Lexical;
+    } else if (value == "lpt") {
+        out = RunOrder::Lpt;
+    } else if (value == "shortest") {
+        out = RunOrder::ShortestFirst;
+    } else if (value == "metadata") {
+        out = RunOrder::Metadata;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* run_order_name(RunOrder order) {
+    switch (order) {
+        case RunOrder::Lexical:
+            return "lexical";
+        case RunOrder::Lpt:
+            return "lpt";
+        case RunOrder::ShortestFirst:
+            return "shortest";
+        case RunOrder::Metadata:
+            return "metadata";
+    }
+    return "lexical";
+}
+
+bool CostHistory::load(const std::filesystem::path& path, std::string& error) {
+    path_ = path;
+    entries_.clear();
+
+    std::ifstream in(path);
+    if (!in) {
+        return true;
+    }
+
+    // key \t bytes \t segments \t tokens \t ms ; unparsable (e.g. torn) lines are skipped.
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string_view fields[5];
+        Entry entry;
+        std::uint64_t ms = 0;
+        if (!split_tabs(line, fields) || fields[0].empty() || !parse_u64(fields[1], entry.bytes)
+            || !parse_u64(fields[2], entry.segments) || !parse_u64(fields[3], entry.tokens) || !parse_u64(fields[4], ms)) {
+            continue;
+        }
+        entry.ms = static_cast<double>(ms);
+        entries_[std::string(fields[0])] = entry;
+    }
+    if (in.bad()) {
+        error = "Failed to read cost history: " + path.string();
+        return false;
+    }
+
+    total_ms_ = 0.0;
+    total_tokens_ = 0;
+    for (const auto& [key, entry] : entries_) {
+        total_ms_ += entry.ms;
+        total_tokens_ += entry.tokens;
+    }
+    return true;
+}
+
+bool CostHistory::append(const std::string& key, const FileWork& work, double ms, std::string& error) {
+    if (!out_.is_open()) {
+        out_.open(path_, std::ios::app);
+        if (!out_) {
+            error = "Failed to open cost history: " + path_.string();
+            return false;
+        }
+    }
+
+    std::ostringstream line;
+    line << key << '\t' << work.bytes << '\t' << work.segments << '\t' << work.tokens << '\t'
+         << static_cast<std::uint64_t>(std::max(0.0, ms)) << '\n';
+    out_ << line.str() << std::flush;
+    if (!out_) {
+        error = "Failed to write cost history: " + path_.string();
+        return false;
+    }
+    return true;
+}
+
+const CostHistory::Entry* CostHistory::find(const std::string& key) const {
+    const auto it = entries_.find(key);
+    return it == entries_.end() ? nullptr : &it->second;
+}
+
+double CostHistory::ms_per_token() const {
+    return total_tokens_ > 0 && total_ms_ > 0.0 ? total_ms_ / static_cast<double>(total_tokens_) : kDefaultMsPerToken;
+}
+
+double CostHistory::predict_ms(const std::string& key, const FileWork& work) const {
+    if (const auto* entry = find(key); entry != nullptr && entry->bytes == work.bytes) {
+        return entry->ms;
+    }
+    return static_cast<double>(work.tokens) * ms_per_token();
+}
+
+void order_run_queue(std::vector<QueuedFile>& queue, RunOrder order) {
+    const auto by_path = [](const QueuedFile& a, const QueuedFile& b) {
+        return a.file < b.file;
+    };
+
+    switch (order) {
+        case RunOrder::Lexical:
+            std::sort(queue.begin(), queue.end(), by_path);
+            break;
+        case RunOrder::Lpt:
+            std::sort(queue.begin(), queue.end(), [&](const QueuedFile& a, const QueuedFile& b) {
+                return a.predicted_ms != b.predicted_ms ? a.predicted_ms > b.predicted_ms : by_path(a, b);
+            });
+            break;
+        case RunOrder::ShortestFirst:
+            std::sort(queue.begin(), queue.end(), [&](const QueuedFile& a, const QueuedFile& b) {
+                return a.predicted_ms != b.predicted_ms ? a.predicted_ms < b.predicted_ms : by_path(a, b);
+            });
+            break;
+        case RunOrder::Metadata:
+            std::sort(queue.begin(), queue.end(), [&](const QueuedFile& a, const QueuedFile& b) {
+                if (a.priority != b.priority) {
+                    return a.priority < b.priority;
+                }
+                return a.predicted_ms != b.predicted_ms ? a.predicted_ms > b.predicted_ms : by_path(a, b);
+            });
+            break;
+    }
+}
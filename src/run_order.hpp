@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Run queue ordering (`--order`).
+enum class RunOrder {
+    /// Path order (default; the queue can start while the scan is still running).
+    Lexical,
+    /// Longest predicted cost first: big files never trail at the end of a run.
+    Lpt,
+    /// Shortest first: the most finished files early, for quick partial results.
+    ShortestFirst,
+    /// `--priority` terms first (in the order given), longest first within each group.
+    Metadata,
+};
+
+bool parse_run_order(const std::string& value, RunOrder& out);
+const char* run_order_name(RunOrder order);
+
+/// What the estimator knows about a file before translating it.
+struct FileWork {
+    std::uint64_t bytes = 0;
+    /// 0 when unknown (file not in a segment store).
+    std::uint64_t segments = 0;
+    /// Source tokens: exact from a tokenized store, otherwise estimated from text or file size.
+    std::uint64_t tokens = 0;
+};
+
+/// Recorded per-file timings (`.tei_mt_costs.tsv` in the output directory), appended as files finish. The latest
+/// line for a file wins.
+class CostHistory {
+public:
+    struct Entry {
+        std::uint64_t bytes = 0;
+        std::uint64_t segments = 0;
+        std::uint64_t tokens = 0;
+        double ms = 0.0;
+    };
+
+    /// A missing file is not an error.
+    bool load(const std::filesystem::path& path, std::string& error);
+    bool append(const std::string& key, const FileWork& work, double ms, std::string& error);
+
+    const Entry* find(const std::string& key) const;
+    /// Learned milliseconds per source token over all entries (a conservative default without history).
+    double ms_per_token() const;
+    /// Cost estimate: the recorded time when the file is unchanged (same byte size), else tokens * ms_per_token().
+    double predict_ms(const std::string& key, const FileWork& work) const;
+
+private:
+    std::filesystem::path path_;
+    std::ofstream out_;
+    std::unordered_map<std::string, Entry> entries_;
+    double total_ms_ = 0.0;
+    std::uint64_t total_tokens_ = 0;
+};
+
+struct QueuedFile {
+    std::filesystem::path file;
+    double predicted_ms = 0.0;
+    /// Metadata priority group (lower first); only used by RunOrder::Metadata.
+    std::size_t priority = 0;
+};
+
+/// Reorder `queue` for `order`; ties fall back to path order so runs are reproducible.
+void order_run_queue(std::vector<QueuedFile>& queue, RunOrder order);
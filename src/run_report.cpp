@@ -0,0 +1,529 @@
+#include "run_report.hpp"
+
+#include "atomic_file.hpp"
+#include "fnv1a.hpp"
+#include "host_info.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+using Json = nlohmann::ordered_json;
+
+constexpr int kReportVersion = 1;
+constexpr std::size_t kLatencyReservoir = 20000;
+/// Bytes hashed from each end of the model file: enough to tell quantizations and finetunes apart without
+/// reading gigabytes.
+constexpr std::size_t kModelHashWindow = std::size_t{4} << 20;
+constexpr int kBootstrapResamples = 2000;
+constexpr double kSignificance = 0.05;
+
+std::string hex64(std::uint64_t value) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << value;
+    return out.str();
+}
+
+std::string iso_utc(std::chrono::system_clock::time_point tp) {
+    const std::time_t t = std::chrono::system_clock::to_time_t(tp);
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    char buf[32] = {};
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    return buf;
+}
+
+std::string cpu_model_name() {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.starts_with("model name")) {
+            const auto colon = line.find(':');
+            if (colon != std::string::npos) {
+                return line.substr(line.find_first_not_of(' ', colon + 1));
+            }
+        }
+    }
+    return {};
+}
+
+/// Size plus FNV-1a over the first and last kModelHashWindow bytes.
+Json model_identity(const std::string& model_path) {
+    Json model{{"path", model_path}};
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(model_path, ec);
+    if (ec) {
+        return model;
+    }
+    model["bytes"] = size;
+
+    std::ifstream in(model_path, std::ios::binary);
+    std::string window(static_cast<std::size_t>(std::min<std::uintmax_t>(size, kModelHashWindow)), '\0');
+    std::uint64_t hash = fnv1a64(std::string_view(reinterpret_cast<const char*>(&size), sizeof(size)));
+    in.read(window.data(), static_cast<std::streamsize>(window.size()));
+    hash = fnv1a64(window, hash);
+    if (size > kModelHashWindow) {
+        in.seekg(static_cast<std::streamoff>(size - window.size()));
+        in.read(window.data(), static_cast<std::streamsize>(window.size()));
+        hash = fnv1a64(window, hash);
+    }
+    if (in) {
+        model["sampled_hash"] = hex64(hash);
+    }
+    return model;
+}
+
+/// Every AppConfig field; the detected CPU topology and the thread plan derived from it go under "host".
+Json config_json(const AppConfig& c) {
+    Json mock{
+        {"prefill_us", c.mock.prefill_us},
+        {"decode_us", c.mock.decode_us},
+        {"jitter", c.mock.jitter},
+        {"fail_rate", c.mock.fail_rate},
+        {"drift_rate", c.mock.drift_rate},
+        {"loop_rate", c.mock.loop_rate},
+        {"ctx_grow_ms", c.mock.ctx_grow_ms},
+        {"seed", c.mock.seed},
+        {"ctx", c.mock.n_ctx},
+        {"max_ctx", c.mock.max_n_ctx},
+        {"max_tokens", c.mock.max_tokens},
+    };
+    return Json{
+        {"input", c.input_path.string()},
+        {"output", c.output_dir.string()},
+        {"model", c.model_path},
+        {"backend", c.backend},
+        {"mock", c.backend == "mock" ? mock : Json(nullptr)},
+        {"workers", c.workers},
+        {"max_tokens", c.max_tokens},
+        {"ctx", c.n_ctx},
+        {"max_ctx", c.max_n_ctx},
+        {"n_gpu_layers", c.n_gpu_layers},
+        {"threads", c.n_threads},
+        {"requested_threads", c.requested_n_threads},
+        {"decode_threads", c.decode_threads},
+        {"n_batch", c.n_batch},
+        {"n_ubatch", c.n_ubatch},
+        {"cache_type_k", c.cache_type_k},
+        {"cache_type_v", c.cache_type_v},
+        {"memory_budget_bytes", c.memory_budget_bytes},
+        {"autotune", c.autotune},
+        {"autotune_out", c.autotune_out.string()},
+        {"autotune_segments", c.autotune_segments},
+        {"pin", c.pin_threads},
+        {"coalesce", c.coalesce_segments},
+        {"coalesce_max_batch", c.coalesce_max_batch},
+        {"coalesce_max_chars", c.coalesce_max_merged_chars},
+        {"tei_strategy", c.tei_strategy},
+        {"stream_windows", c.stream_windows},
+        {"stream_window_bytes", c.stream_window_bytes},
+        {"segment_store", c.segment_store_path.string()},
+        {"order", c.run_order},
+        {"priority", c.priority_terms},
+        {"shard", std::to_string(c.shard_index) + "/" + std::to_string(c.shard_count)},
+        {"lease", c.lease},
+        {"lease_ttl_seconds", c.lease_ttl_seconds},
+        {"coordinator", c.coordinator_endpoint},
+        {"worker", c.worker_endpoint},
+        {"unit_segments", c.unit_segments},
+        {"unit_timeout_seconds", c.unit_timeout_seconds},
+        {"unit_retries", c.unit_retries},
+        {"markdown", c.emit_markdown},
+        {"report", c.report_path.string()},
+        {"metrics", c.metrics_path.string()},
+        {"metrics_interval_seconds", c.metrics_interval_seconds},
+        {"trace", c.trace_path.string()},
+        {"unit_log", c.unit_log_path.string()},
+        {"progress", c.show_progress},
+        {"resume", c.resume},
+        {"overwrite_existing_translations", c.overwrite_existing_translations},
+        {"interactive_drilldown", c.interactive_drilldown},
+        {"drilldown_help", c.drilldown_help},
+        {"sorting_data", c.sorting_data_path.string()},
+        {"drilldown_select", c.drilldown_select},
+        {"filter_canon", c.filter_canon},
+        {"filter_tradition", c.filter_tradition},
+        {"filter_period", c.filter_period},
+        {"filter_origin", c.filter_origin},
+    };
+}
+
+/// Nearest-rank percentile of an already sorted sample.
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::vector<double> sorted_copy(const std::vector<float>& values) {
+    std::vector<double> out(values.begin(), values.end());
+    std::ranges::sort(out);
+    return out;
+}
+
+Json latency_json(const std::vector<float>& samples) {
+    const auto sorted = sorted_copy(samples);
+    double sum = 0.0;
+    for (const double v : sorted) {
+        sum += v;
+    }
+    return Json{
+        {"p50", percentile(sorted, 0.50)},
+        {"p90", percentile(sorted, 0.90)},
+        {"p95", percentile(sorted, 0.95)},
+        {"p99", percentile(sorted, 0.99)},
+        {"max", sorted.empty() ? 0.0 : sorted.back()},
+        {"mean", sorted.empty() ? 0.0 : sum / static_cast<double>(sorted.size())},
+    };
+}
+
+Json file_json(const RunFileRecord& r) {
+    Json out{{"file", r.file}, {"status", r.status}};
+    if (r.status != "ok") {
+        out["reason"] = r.reason;
+        return out;
+    }
+    out["segments"] = r.segments;
+    out["units"] = r.units;
+    out["fallbacks"] = r.fallbacks;
+    out["workers"] = r.workers;
+    out["failed_segments"] = r.failed_segments;
+    out["total_ms"] = r.total_ms;
+    out["translate_ms"] = r.translate_ms;
+    out["io_ms"] = r.io_ms;
+    out["seg_per_sec"] = r.seg_per_sec;
+    out["unit_p50_ms"] = r.unit_p50_ms;
+    out["unit_p95_ms"] = r.unit_p95_ms;
+    return out;
+}
+
+bool load_report(const std::filesystem::path& path, Json& out, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "Failed to open report: " + path.string();
+        return false;
+    }
+    out = Json::parse(in, nullptr, false);
+    if (out.is_discarded() || !out.is_object() || out.value("tei_mt_report", 0) != kReportVersion) {
+        error = "Not a tei_mt run report (version " + std::to_string(kReportVersion) + "): " + path.string();
+        return false;
+    }
+    return true;
+}
+
+std::string change_pct(double before, double after) {
+    if (before == 0.0) {
+        return "n/a";
+    }
+    std::ostringstream out;
+    out << std::showpos << std::fixed << std::setprecision(1) << (100.0 * (after - before) / before) << "%";
+    return out.str();
+}
+
+/// Two-sided p-value of the Mann-Whitney U test (normal approximation with tie correction).
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b) {
+    const double n1 = static_cast<double>(a.size());
+    const double n2 = static_cast<double>(b.size());
+    if (a.empty() || b.empty()) {
+        return 1.0;
+    }
+    std::vector<std::pair<double, bool>> all;
+    all.reserve(a.size() + b.size());
+    for (const double v : a) {
+        all.emplace_back(v, true);
+    }
+    for (const double v : b) {
+        all.emplace_back(v, false);
+    }
+    std::ranges::sort(all, {}, &std::pair<double, bool>::first);
+
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for (std::size_t i = 0; i < all.size();) {
+        std::size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) {
+            ++j;
+        }
+        const double mid_rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2.0;
+        for (std::size_t k = i; k < j; ++k) {
+            if (all[k].second) {
+                rank_sum_a += mid_rank;
+            }
+        }
+        const double t = static_cast<double>(j - i);
+        tie_term += t * t * t - t;
+        i = j;
+    }
+
+    const double n = n1 + n2;
+    const double u = rank_sum_a - n1 * (n1 + 1.0) / 2.0;
+    const double variance = n1 * n2 / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    const double z = (u - n1 * n2 / 2.0) / std::sqrt(variance);
+    return std::erfc(std::abs(z) / std::sqrt(2.0));
+}
+
+void diff_config(const Json& a, const Json& b, std::ostream& out) {
+    std::size_t changed = 0;
+    for (const auto& [key, value] : a.items()) {
+        const Json other = b.contains(key) ? b.at(key) : Json(nullptr);
+        if (value != other) {
+            out << "[config] " << key << ": " << value.dump() << " -> " << other.dump() << "\n";
+            ++changed;
+        }
+    }
+    for (const auto& [key, value] : b.items()) {
+        if (!a.contains(key)) {
+            out << "[config] " << key << ": null -> " << value.dump() << "\n";
+            ++changed;
+        }
+    }
+    if (changed == 0) {
+        out << "[config] identical\n";
+    }
+}
+
+/// Per-file seg/s ratios b/a for files ok in both runs; geometric mean with a seeded bootstrap 95% interval.
+void diff_files(const Json& a, const Json& b, std::ostream& out) {
+    std::unordered_map<std::string, double> a_sps;
+    for (const auto& file : a.value("files", Json::array())) {
+        if (file.value("status", "") == "ok" && file.value("seg_per_sec", 0.0) > 0.0) {
+            a_sps[file.value("file", "")] = file.value("seg_per_sec", 0.0);
+        }
+    }
+    std::vector<double> log_ratios;
+    for (const auto& file : b.value("files", Json::array())) {
+        const auto it = a_sps.find(file.value("file", ""));
+        if (it != a_sps.end() && file.value("status", "") == "ok" && file.value("seg_per_sec", 0.0) > 0.0) {
+            log_ratios.push_back(std::log(file.value("seg_per_sec", 0.0) / it->second));
+        }
+    }
+    if (log_ratios.size() < 2) {
+        out << "[files] paired=" << log_ratios.size() << " (need at least 2 files ok in both runs)\n";
+        return;
+    }
+
+    const auto mean = [](const std::vector<double>& v) {
+        double sum = 0.0;
+        for (const double x : v) {
+            sum += x;
+        }
+        return sum / static_cast<double>(v.size());
+    };
+    std::mt19937_64 rng(1);
+    std::uniform_int_distribution<std::size_t> pick(0, log_ratios.size() - 1);
+    std::vector<double> resample(log_ratios.size());
+    std::vector<double> means;
+    means.reserve(kBootstrapResamples);
+    for (int r = 0; r < kBootstrapResamples; ++r) {
+        for (double& x : resample) {
+            x = log_ratios[pick(rng)];
+        }
+        means.push_back(mean(resample));
+    }
+    std::ranges::sort(means);
+    const double lo = std::exp(percentile(means, 0.025));
+    const double hi = std::exp(percentile(means, 0.975));
+    out << "[files] paired=" << log_ratios.size() << " seg_per_sec_ratio=" << std::exp(mean(log_ratios))
+        << " ci95=[" << lo << ", " << hi << "]" << (lo > 1.0 || hi < 1.0 ? " significant" : " not significant")
+        << "\n";
+}
+
+}  // namespace
+
+void RunReport::begin(int argc, char** argv, const AppConfig& config) {
+    command_line_.assign(argv, argv + argc);
+    config_ = config;
+    started_ = std::chrono::system_clock::now();
+    started_steady_ = std::chrono::steady_clock::now();
+}
+
+void RunReport::set_tokenizer_fingerprint(std::uint64_t fingerprint) {
+    tokenizer_fingerprint_ = fingerprint;
+}
+
+void RunReport::add_ok(const std::string& file, const TranslationStats& stats, std::chrono::milliseconds total) {
+    RunFileRecord record;
+    record.file = file;
+    record.status = "ok";
+    record.segments = stats.segments_total;
+    record.units = stats.translation_units;
+    record.fallbacks = stats.coalesce_fallback_units;
+    record.workers = stats.workers_used;
+    record.failed_segments = stats.failed_segments.size();
+    record.total_ms = static_cast<double>(total.count());
+    record.translate_ms = static_cast<double>(stats.wall_time.count());
+    record.io_ms = std::max(0.0, record.total_ms - record.translate_ms);
+    record.seg_per_sec = stats.segments_per_second;
+    const auto sorted = sorted_copy(stats.unit_latency_ms);
+    record.unit_p50_ms = percentile(sorted, 0.50);
+    record.unit_p95_ms = percentile(sorted, 0.95);
+    files_.push_back(std::move(record));
+
+    for (const float latency : stats.unit_latency_ms) {
+        ++latency_seen_;
+        if (latency_samples_.size() < kLatencyReservoir) {
+            latency_samples_.push_back(latency);
+        } else if (const auto slot = latency_rng_() % latency_seen_; slot < kLatencyReservoir) {
+            latency_samples_[slot] = latency;
+        }
+    }
+}
+
+void RunReport::add_skipped(const std::string& file, const std::string& reason) {
+    files_.push_back(RunFileRecord{.file = file, .status = "skipped", .reason = reason});
+}
+
+void RunReport::add_failed(const std::string& file, const std::string& reason) {
+    files_.push_back(RunFileRecord{.file = file, .status = "failed", .reason = reason});
+}
+
+void RunReport::set_tokens(std::uint64_t prompt_tokens, std::uint64_t generated_tokens) {
+    prompt_tokens_ = prompt_tokens;
+    generated_tokens_ = generated_tokens;
+}
+
+bool RunReport::write(const std::filesystem::path& path, std::string& error) const {
+    std::size_t ok = 0;
+    std::size_t skipped = 0;
+    std::size_t failed = 0;
+    std::size_t segments = 0;
+    std::size_t failed_segments = 0;
+    double translate_ms = 0.0;
+    Json files = Json::array();
+    for (const auto& record : files_) {
+        ok += record.status == "ok";
+        skipped += record.status == "skipped";
+        failed += record.status == "failed";
+        if (record.status == "ok") {
+            segments += record.segments;
+            failed_segments += record.failed_segments;
+            translate_ms += record.translate_ms;
+        }
+        files.push_back(file_json(record));
+    }
+    const double translate_s = translate_ms / 1000.0;
+    const double wall_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started_steady_
+    ).count();
+
+    Json model = config_.backend == "mock" ? Json{{"path", "mock"}} : model_identity(config_.model_path);
+    if (tokenizer_fingerprint_ != 0) {
+        model["tokenizer_fingerprint"] = hex64(tokenizer_fingerprint_);
+    }
+    const auto& plan = config_.thread_plan;
+    const Json report{
+        {"tei_mt_report", kReportVersion},
+        {"started", iso_utc(started_)},
+        {"finished", iso_utc(std::chrono::system_clock::now())},
+        {"command_line", command_line_},
+        {"config", config_json(config_)},
+        {"model", model},
+        {"hardware", {
+            {"host", host_name()},
+            {"cpu_model", cpu_model_name()},
+            {"cpus", config_.cpu_topology.cpus.size()},
+            {"physical_cores", config_.cpu_topology.physical_cores()},
+            {"cache_domains", config_.cpu_topology.cache_domains()},
+            {"cpu_quota", config_.cpu_topology.cpu_quota},
+            {"thread_plan", {
+                {"workers", plan.workers},
+                {"threads", plan.n_threads},
+                {"decode_threads", plan.decode_threads},
+                {"pinned", !plan.worker_cpus.empty()},
+            }},
+        }},
+        {"aggregate", {
+            {"files_ok", ok},
+            {"files_skipped", skipped},
+            {"files_failed", failed},
+            {"segments", segments},
+            {"segments_failed", failed_segments},
+            {"wall_ms", wall_ms},
+            {"translate_ms", translate_ms},
+            {"seg_per_sec", translate_s > 0.0 ? static_cast<double>(segments) / translate_s : 0.0},
+            {"prompt_tokens", prompt_tokens_},
+            {"generated_tokens", generated_tokens_},
+            {"gen_tok_per_sec", translate_s > 0.0 ? static_cast<double>(generated_tokens_) / translate_s : 0.0},
+            {"units", latency_seen_},
+            {"unit_latency_ms", latency_json(latency_samples_)},
+        }},
+        {"files", files},
+        {"unit_latency_samples_ms", latency_samples_},
+    };
+
+    return write_file_atomically(path, report.dump(2, ' ', false, Json::error_handler_t::replace) + "\n", error);
+}
+
+bool diff_run_reports(
+    const std::filesystem::path& a_path,
+    const std::filesystem::path& b_path,
+    std::ostream& out,
+    std::string& error
+) {
+    Json a;
+    Json b;
+    if (!load_report(a_path, a, error) || !load_report(b_path, b, error)) {
+        return false;
+    }
+
+    out << "[diff] a=" << a_path.string() << " (" << a.value("started", "") << ")"
+        << " b=" << b_path.string() << " (" << b.value("started", "") << ")\n";
+    diff_config(a.value("config", Json::object()), b.value("config", Json::object()), out);
+    const Json a_model = a.value("model", Json::object());
+    const Json b_model = b.value("model", Json::object());
+    if (a_model != b_model) {
+        out << "[model] " << a_model.dump() << " -> " << b_model.dump() << "\n";
+    }
+    const Json a_hw = a.value("hardware", Json::object());
+    const Json b_hw = b.value("hardware", Json::object());
+    if (a_hw != b_hw) {
+        out << "[hardware] " << a_hw.value("host", "") << " (" << a_hw.value("cpu_model", "") << ") -> "
+            << b_hw.value("host", "") << " (" << b_hw.value("cpu_model", "") << ")\n";
+    }
+
+    const Json a_agg = a.value("aggregate", Json::object());
+    const Json b_agg = b.value("aggregate", Json::object());
+    for (const char* key : {"seg_per_sec", "gen_tok_per_sec", "translate_ms", "wall_ms"}) {
+        const double before = a_agg.value(key, 0.0);
+        const double after = b_agg.value(key, 0.0);
+        out << "[aggregate] " << key << " " << before << " -> " << after << " (" << change_pct(before, after) << ")\n";
+    }
+    for (const char* key : {"files_ok", "files_failed", "segments_failed"}) {
+        out << "[aggregate] " << key << " " << a_agg.value(key, 0) << " -> " << b_agg.value(key, 0) << "\n";
+    }
+
+    diff_files(a, b, out);
+
+    const Json a_lat = a_agg.value("unit_latency_ms", Json::object());
+    const Json b_lat = b_agg.value("unit_latency_ms", Json::object());
+    for (const char* key : {"p50", "p90", "p95", "p99", "max", "mean"}) {
+        const double before = a_lat.value(key, 0.0);
+        const double after = b_lat.value(key, 0.0);
+        out << "[latency] " << key << "_ms " << before << " -> " << after << " (" << change_pct(before, after) << ")\n";
+    }
+    std::vector<double> a_samples = a.value("unit_latency_samples_ms", std::vector<double>{});
+    std::vector<double> b_samples = b.value("unit_latency_samples_ms", std::vector<double>{});
+    const double p = mann_whitney_p(a_samples, b_samples);
+    out << "[latency] mann_whitney n=" << a_samples.size() << "/" << b_samples.size() << " p=" << p
+        << (p < kSignificance ? " significant" : " not significant") << "\n";
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "config.hpp"
+#include "pipeline.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/// One input file as it ended in a run.
+struct RunFileRecord {
+    /// Path relative to the input root (the key paired across runs).
+    std::string file;
+    /// `ok`, `skipped` or `failed`.
+    std::string status;
+    /// Why a file was skipped or failed (empty for ok).
+    std::string reason;
+    std::size_t segments = 0;
+    std::size_t units = 0;
+    std::size_t fallbacks = 0;
+    std::size_t workers = 0;
+    /// Segments left untranslated after every retry (the output is partial; a `--resume` run fills them).
+    std::size_t failed_segments = 0;
+    /// From dequeue to written output; translate_ms is the pipeline part of it, io_ms the rest.
+    double total_ms = 0.0;
+    double translate_ms = 0.0;
+    double io_ms = 0.0;
+    double seg_per_sec = 0.0;
+    /// Per-unit latency percentiles within the file.
+    double unit_p50_ms = 0.0;
+    double unit_p95_ms = 0.0;
+};
+
+/// Machine-readable record of one translation run (`--report <path>`): command line, full configuration, model
+/// identity, host, per-file results and latency distribution. Two reports are compared with `tei_mt report diff`.
+class RunReport {
+public:
+    /// Capture the command line, configuration and host; call once the configuration is final.
+    void begin(int argc, char** argv, const AppConfig& config);
+    void set_tokenizer_fingerprint(std::uint64_t fingerprint);
+
+    void add_ok(const std::string& file, const TranslationStats& stats, std::chrono::milliseconds total);
+    void add_skipped(const std::string& file, const std::string& reason);
+    void add_failed(const std::string& file, const std::string& reason);
+
+    void set_tokens(std::uint64_t prompt_tokens, std::uint64_t generated_tokens);
+    /// Finish the report and write it atomically (`<path>.part` + rename).
+    bool write(const std::filesystem::path& path, std::string& error) const;
+
+private:
+    std::vector<std::string> command_line_;
+    AppConfig config_;
+    std::chrono::system_clock::time_point started_;
+    std::chrono::steady_clock::time_point started_steady_;
+    std::uint64_t tokenizer_fingerprint_ = 0;
+    std::vector<RunFileRecord> files_;
+    std::uint64_t prompt_tokens_ = 0;
+    std::uint64_t generated_tokens_ = 0;
+    /// Uniform reservoir over every unit latency of the run (bounded, seeded: identical runs keep identical samples).
+    std::vector<float> latency_samples_;
+    std::uint64_t latency_seen_ = 0;
+    std::mt19937_64 latency_rng_{1};
+};
+
+/// `tei_mt report diff a.json b.json`: configuration changes, aggregate throughput, paired per-file throughput
+/// (geometric-mean ratio with a bootstrap 95% interval) and unit latency percentiles (Mann-Whitney U test).
+bool diff_run_reports(
+    const std::filesystem::path& a,
+    const std::filesystem::path& b,
+    std::ostream& out,
+    std::string& error
+);
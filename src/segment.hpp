@@ -1,11 +1,18 @@
 #pragma once
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
 
 struct Segment {
     std::size_t index = 0;
-    std::string id;
-    std::string source_zh;
+    /// `id` and `source_zh` view storage owned by whoever produced the segment (TeiDocument::text for parsed
+    /// documents); the segment must not outlive it.
+    std::string_view id;
+    std::string_view source_zh;
+    /// Pre-tokenized `source_zh` from a compiled segment store; empty means the translator tokenizes itself.
+    std::span<const std::int32_t> source_tokens;
     /// When true, LlamaTranslator uses a multi-passage prompt and relaxed post-processing.
     bool coalesced_batch = false;
     /// 0 = use translator default max_tokens; used for merged TEI batches.
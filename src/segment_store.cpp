@@ -0,0 +1,336 @@
+#include "segment_store.hpp"
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+std::string path_key(const std::filesystem::path& path) {
+    const auto u8 = path.generic_u8string();
+    return std::string(u8.begin(), u8.end());
+}
+
+std::filesystem::path path_from_key(std::string_view key) {
+    return std::filesystem::path(std::u8string(key.begin(), key.end()));
+}
+
+template <typename T>
+bool table_in_range(std::uint64_t offset, std::uint64_t count, std::size_t file_size) {
+    if (offset % alignof(T) != 0 || offset > file_size) {
+        return false;
+    }
+    return count <= (file_size - offset) / sizeof(T);
+}
+
+}  // namespace
+
+std::int64_t segment_store_mtime(const std::filesystem::path& path) {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+}
+
+SegmentStoreWriter::~SegmentStoreWriter() {
+    if (out_.is_open()) {
+        out_.close();
+        std::error_code ec;
+        std::filesystem::remove(tmp_path_, ec);
+    }
+}
+
+bool SegmentStoreWriter::open(const std::filesystem::path& out_path, const std::filesystem::path& root, std::string& error) {
+    out_path_ = out_path;
+    tmp_path_ = out_path.string() + ".part";
+    out_.open(tmp_path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        error = "Failed to open segment store output: " + tmp_path_.string();
+        return false;
+    }
+
+    const SegmentStoreHeader placeholder{};
+    out_.write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+
+    const std::string root_key = path_key(root);
+    root_offset_ = append_data(root_key.data(), root_key.size());
+    root_size_ = root_key.size();
+    return static_cast<bool>(out_);
+}
+
+std::uint64_t SegmentStoreWriter::append_data(const void* bytes, std::size_t size, std::size_t align) {
+    static constexpr char kZeros[8] = {};
+    const std::uint64_t padding = (align - data_size_ % align) % align;
+    out_.write(kZeros, static_cast<std::streamsize>(padding));
+    data_size_ += padding;
+
+    const std::uint64_t offset = data_size_;
+    out_.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+    data_size_ += size;
+    return offset;
+}
+
+bool SegmentStoreWriter::add_document(
+    const std::filesystem::path& relative_path,
+    const TeiDocument& doc,
+    const std::vector<std::vector<std::int32_t>>& tokens,
+    std::string& error
+) {
+    if (doc.note_sites.size() != doc.segments.size()) {
+        error = "Note offsets unavailable for " + doc.source_path.string() + " (byte scan did not match the parsed tree)";
+        return false;
+    }
+    if (!tokens.empty() && tokens.size() != doc.segments.size()) {
+        error = "Token arrays do not match segment count for " + doc.source_path.string();
+        return false;
+    }
+
+    SegmentStoreDoc record{};
+    const std::string key = path_key(relative_path);
+    record.path_offset = append_data(key.data(), key.size());
+    record.path_size = key.size();
+    record.source_size = doc.bytes.size();
+    record.source_mtime = segment_store_mtime(doc.source_path);
+    record.first_segment = segments_.size();
+    record.segment_count = doc.segments.size();
+
+    for (std::size_t i = 0; i < doc.segments.size(); ++i) {
+        const Segment& segment = doc.segments[i];
+        const TeiNoteSite& site = doc.note_sites[i];
+
+        SegmentStoreSegment seg{};
+        seg.id_offset = append_data(segment.id.data(), segment.id.size());
+        seg.id_size = static_cast<std::uint32_t>(segment.id.size());
+        seg.text_offset = append_data(segment.source_zh.data(), segment.source_zh.size());
+        seg.text_size = static_cast<std::uint32_t>(segment.source_zh.size());
+        seg.note_name_offset = append_data(site.note_name.data(), site.note_name.size());
+        seg.note_name_size = static_cast<std::uint32_t>(site.note_name.size());
+        seg.insert_at = site.insert_at;
+        seg.first_note = notes_.size();
+        seg.note_count = static_cast<std::uint32_t>(site.existing_notes.size());
+        for (const auto& [begin, end] : site.existing_notes) {
+            notes_.push_back(SegmentStoreNote{begin, end});
+        }
+        if (!tokens.empty()) {
+            seg.tokens_offset = append_data(tokens[i].data(), tokens[i].size() * sizeof(std::int32_t), alignof(std::int32_t));
+            seg.token_count = static_cast<std::uint32_t>(tokens[i].size());
+            has_tokens_ = true;
+        }
+        segments_.push_back(seg);
+    }
+
+    docs_.push_back(record);
+    doc_paths_.push_back(key);
+    if (!out_) {
+        error = "Failed to write segment store: " + tmp_path_.string();
+        return false;
+    }
+    return true;
+}
+
+bool SegmentStoreWriter::finish(std::uint64_t tokenizer_fingerprint, std::string& error) {
+    // Pad the blob so the tables that follow are 8-byte aligned.
+    append_data(nullptr, 0, 8);
+
+    // Sorted by path bytes so SegmentStore::find() can binary search.
+    std::vector<std::size_t> order(docs_.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return doc_paths_[a] < doc_paths_[b]; });
+    std::vector<SegmentStoreDoc> sorted_docs;
+    sorted_docs.reserve(docs_.size());
+    for (const std::size_t i : order) {
+        sorted_docs.push_back(docs_[i]);
+    }
+    docs_ = std::move(sorted_docs);
+
+    SegmentStoreHeader header{};
+    std::memcpy(header.magic, kSegmentStoreMagic, sizeof(header.magic));
+    header.version = kSegmentStoreVersion;
+    header.flags = has_tokens_ ? kSegmentStoreHasTokens : 0;
+    header.doc_count = docs_.size();
+    header.segment_count = segments_.size();
+    header.note_count = notes_.size();
+    header.data_offset = sizeof(SegmentStoreHeader);
+    header.data_size = data_size_;
+    header.docs_offset = header.data_offset + header.data_size;
+    header.segments_offset = header.docs_offset + docs_.size() * sizeof(SegmentStoreDoc);
+    header.notes_offset = header.segments_offset + segments_.size() * sizeof(SegmentStoreSegment);
+    header.tokenizer_fingerprint = has_tokens_ ? tokenizer_fingerprint : 0;
+    header.root_offset = root_offset_;
+    header.root_size = root_size_;
+
+    out_.write(reinterpret_cast<const char*>(docs_.data()), static_cast<std::streamsize>(docs_.size() * sizeof(SegmentStoreDoc)));
+    out_.write(
+        reinterpret_cast<const char*>(segments_.data()),
+        static_cast<std::streamsize>(segments_.size() * sizeof(SegmentStoreSegment))
+    );
+    out_.write(reinterpret_cast<const char*>(notes_.data()), static_cast<std::streamsize>(notes_.size() * sizeof(SegmentStoreNote)));
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        error = "Failed to write segment store: " + tmp_path_.string();
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(out_path_, ec);
+    ec.clear();
+    std::filesystem::rename(tmp_path_, out_path_, ec);
+    if (ec) {
+        error = "Failed to finalize segment store (rename): " + out_path_.string() + " (" + ec.message() + ")";
+        return false;
+    }
+    return true;
+}
+
+bool SegmentStore::open(const std::filesystem::path& path, std::string& error) {
+    if (!file_.open(path, error)) {
+        return false;
+    }
+
+    const std::size_t size = file_.size();
+    if (size < sizeof(SegmentStoreHeader)) {
+        error = "Not a segment store (too small): " + path.string();
+        return false;
+    }
+    std::memcpy(&header_, file_.data(), sizeof(header_));
+    if (std::memcmp(header_.magic, kSegmentStoreMagic, sizeof(header_.magic)) != 0) {
+        error = "Not a segment store: " + path.string();
+        return false;
+    }
+    if (header_.version != kSegmentStoreVersion) {
+        error = "Unsupported segment store version " + std::to_string(header_.version) + " in " + path.string()
+            + " (expected " + std::to_string(kSegmentStoreVersion) + "; re-run compile)";
+        return false;
+    }
+
+    if (header_.data_offset > size || header_.data_size > size - header_.data_offset
+        || !table_in_range<SegmentStoreDoc>(header_.docs_offset, header_.doc_count, size)
+        || !table_in_range<SegmentStoreSegment>(header_.segments_offset, header_.segment_count, size)
+        || !table_in_range<SegmentStoreNote>(header_.notes_offset, header_.note_count, size)
+        || data_view(header_.root_offset, header_.root_size).size() != header_.root_size) {
+        error = "Corrupt segment store tables in " + path.string();
+        return false;
+    }
+
+    docs_ = reinterpret_cast<const SegmentStoreDoc*>(file_.data() + header_.docs_offset);
+    segments_ = reinterpret_cast<const SegmentStoreSegment*>(file_.data() + header_.segments_offset);
+    notes_ = reinterpret_cast<const SegmentStoreNote*>(file_.data() + header_.notes_offset);
+
+    for (std::size_t i = 0; i < doc_count(); ++i) {
+        const auto& doc = docs_[i];
+        if (data_view(doc.path_offset, doc.path_size).size() != doc.path_size
+            || doc.first_segment > header_.segment_count
+            || doc.segment_count > header_.segment_count - doc.first_segment) {
+            error = "Corrupt segment store document table in " + path.string();
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view SegmentStore::data_view(std::uint64_t offset, std::uint64_t size) const {
+    if (offset > header_.data_size || size > header_.data_size - offset) {
+        return {};
+    }
+    return std::string_view(file_.data() + header_.data_offset + offset, static_cast<std::size_t>(size));
+}
+
+std::filesystem::path SegmentStore::root() const {
+    return path_from_key(data_view(header_.root_offset, header_.root_size));
+}
+
+std::string_view SegmentStore::doc_path(std::size_t doc) const {
+    return data_view(docs_[doc].path_offset, docs_[doc].path_size);
+}
+
+std::size_t SegmentStore::find(const std::filesystem::path& relative_path) const {
+    const std::string key = path_key(relative_path);
+    std::size_t lo = 0;
+    std::size_t hi = doc_count();
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        if (doc_path(mid) < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < doc_count() && doc_path(lo) == key ? lo : static_cast<std::size_t>(-1);
+}
+
+bool SegmentStore::is_fresh(std::size_t doc, const std::filesystem::path& source) const {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(source, ec);
+    return !ec && size == docs_[doc].source_size && segment_store_mtime(source) == docs_[doc].source_mtime;
+}
+
+void SegmentStore::doc_work(
+    std::size_t doc,
+    std::uint64_t& segments,
+    std::uint64_t& text_bytes,
+    std::uint64_t& tokens
+) const {
+    const auto& record = docs_[doc];
+    segments = record.segment_count;
+    text_bytes = 0;
+    tokens = 0;
+    for (std::uint64_t i = 0; i < record.segment_count; ++i) {
+        const auto& seg = segments_[record.first_segment + i];
+        text_bytes += seg.text_size;
+        tokens += seg.token_count;
+    }
+}
+
+bool SegmentStore::load_document(std::size_t doc, TeiDocument& out, bool with_tokens, std::string& error) const {
+    TEI_MT_TRACE_SCOPE("store_load_document");
+    out.segments.clear();
+    out.segment_nodes.clear();
+    out.note_sites.clear();
+
+    const auto& record = docs_[doc];
+    out.segments.reserve(static_cast<std::size_t>(record.segment_count));
+    out.note_sites.reserve(static_cast<std::size_t>(record.segment_count));
+
+    for (std::uint64_t i = 0; i < record.segment_count; ++i) {
+        const auto& seg = segments_[record.first_segment + i];
+        const std::string_view id = data_view(seg.id_offset, seg.id_size);
+        const std::string_view text = data_view(seg.text_offset, seg.text_size);
+        const std::string_view note_name = data_view(seg.note_name_offset, seg.note_name_size);
+        const std::string_view tokens = data_view(seg.tokens_offset, std::uint64_t{seg.token_count} * sizeof(std::int32_t));
+        if (id.size() != seg.id_size || text.size() != seg.text_size || note_name.size() != seg.note_name_size
+            || tokens.size() != std::uint64_t{seg.token_count} * sizeof(std::int32_t)
+            || seg.first_note > header_.note_count || seg.note_count > header_.note_count - seg.first_note
+            || seg.insert_at > record.source_size) {
+            error = "Corrupt segment record " + std::to_string(i) + " for " + std::string(doc_path(doc));
+            out.segments.clear();
+            out.note_sites.clear();
+            return false;
+        }
+
+        Segment segment;
+        segment.index = static_cast<std::size_t>(i);
+        segment.id = id;
+        segment.source_zh = text;
+        if (with_tokens && seg.token_count > 0) {
+            segment.source_tokens = std::span<const std::int32_t>(
+                reinterpret_cast<const std::int32_t*>(tokens.data()),
+                seg.token_count
+            );
+        }
+        out.segments.push_back(segment);
+
+        TeiNoteSite site;
+        site.insert_at = static_cast<std::size_t>(seg.insert_at);
+        site.note_name = std::string(note_name);
+        for (std::uint32_t n = 0; n < seg.note_count; ++n) {
+            const auto& note = notes_[seg.first_note + n];
+            site.existing_notes.emplace_back(static_cast<std::size_t>(note.begin), static_cast<std::size_t>(note.end));
+        }
+        out.note_sites.push_back(std::move(site));
+    }
+    return true;
+}
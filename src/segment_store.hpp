@@ -0,0 +1,151 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "tei_reader.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Compiled segment store (`tei_mt compile`): the extracted segments of a corpus in one versioned file that is
+/// memory-mapped at run time, so repeated runs skip XML parsing and segment text is used in place.
+///
+/// Layout (little-endian; offsets are from the start of the file):
+///   SegmentStoreHeader
+///   data blob       paths, ids, note names, normalized text, 4-byte aligned int32 token arrays
+///   SegmentStoreDoc[doc_count]
+///   SegmentStoreSegment[segment_count]
+///   SegmentStoreNote[note_count]      existing translation-note ranges after segments, in source bytes
+
+static_assert(std::endian::native == std::endian::little, "segment store is little-endian only");
+
+inline constexpr char kSegmentStoreMagic[8] = {'T', 'E', 'I', 'M', 'T', 'S', 'E', 'G'};
+inline constexpr std::uint32_t kSegmentStoreVersion = 1;
+inline constexpr std::uint32_t kSegmentStoreHasTokens = 1u << 0;
+
+struct SegmentStoreHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t doc_count;
+    std::uint64_t segment_count;
+    std::uint64_t note_count;
+    std::uint64_t data_offset;
+    std::uint64_t data_size;
+    std::uint64_t docs_offset;
+    std::uint64_t segments_offset;
+    std::uint64_t notes_offset;
+    /// LlamaTranslator::tokenizer_fingerprint() of the vocabulary the token ids belong to (0 = no tokens).
+    std::uint64_t tokenizer_fingerprint;
+    /// Compiled input root (file or directory), in the data blob.
+    std::uint64_t root_offset;
+    std::uint64_t root_size;
+};
+
+struct SegmentStoreDoc {
+    /// Path relative to the root (the file name when the root is a file), in the data blob.
+    std::uint64_t path_offset;
+    std::uint64_t path_size;
+    /// Source size and mtime at compile time; a mismatch marks the document stale.
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+    std::uint64_t first_segment;
+    std::uint64_t segment_count;
+};
+
+struct SegmentStoreSegment {
+    std::uint64_t id_offset;
+    std::uint64_t text_offset;
+    std::uint32_t id_size;
+    std::uint32_t text_size;
+    std::uint64_t note_name_offset;
+    std::uint32_t note_name_size;
+    std::uint32_t note_count;
+    std::uint64_t first_note;
+    /// Just past the segment's end tag in the source (TeiNoteSite::insert_at).
+    std::uint64_t insert_at;
+    std::uint64_t tokens_offset;
+    std::uint32_t token_count;
+    std::uint32_t reserved;
+};
+
+struct SegmentStoreNote {
+    std::uint64_t begin;
+    std::uint64_t end;
+};
+
+static_assert(sizeof(SegmentStoreHeader) == 104);
+static_assert(sizeof(SegmentStoreDoc) == 48);
+static_assert(sizeof(SegmentStoreSegment) == 72);
+static_assert(sizeof(SegmentStoreNote) == 16);
+
+/// mtime as stored in SegmentStoreDoc::source_mtime.
+std::int64_t segment_store_mtime(const std::filesystem::path& path);
+
+/// Builds a store file. Text is streamed to disk as documents are added; only the fixed-size tables are kept in
+/// memory until finish().
+class SegmentStoreWriter {
+public:
+    ~SegmentStoreWriter();
+
+    bool open(const std::filesystem::path& out_path, const std::filesystem::path& root, std::string& error);
+    /// `doc` must have note sites recorded (read_tei_file). `tokens` is empty or holds one array per segment.
+    bool add_document(
+        const std::filesystem::path& relative_path,
+        const TeiDocument& doc,
+        const std::vector<std::vector<std::int32_t>>& tokens,
+        std::string& error
+    );
+    bool finish(std::uint64_t tokenizer_fingerprint, std::string& error);
+
+private:
+    std::uint64_t append_data(const void* bytes, std::size_t size, std::size_t align = 1);
+
+    std::filesystem::path out_path_;
+    std::filesystem::path tmp_path_;
+    std::ofstream out_;
+    std::uint64_t data_size_ = 0;
+    std::uint64_t root_offset_ = 0;
+    std::uint64_t root_size_ = 0;
+    bool has_tokens_ = false;
+    std::vector<SegmentStoreDoc> docs_;
+    std::vector<std::string> doc_paths_;
+    std::vector<SegmentStoreSegment> segments_;
+    std::vector<SegmentStoreNote> notes_;
+};
+
+/// Read side: validates the tables once at open(); segment text and token ids are views into the mapping.
+class SegmentStore {
+public:
+    bool open(const std::filesystem::path& path, std::string& error);
+
+    bool is_open() const { return file_.is_open(); }
+    std::filesystem::path root() const;
+    std::size_t doc_count() const { return static_cast<std::size_t>(header_.doc_count); }
+    std::string_view doc_path(std::size_t doc) const;
+    std::uint64_t tokenizer_fingerprint() const { return header_.tokenizer_fingerprint; }
+    bool has_tokens() const { return (header_.flags & kSegmentStoreHasTokens) != 0; }
+
+    /// Index of the document with `relative_path`, or npos.
+    std::size_t find(const std::filesystem::path& relative_path) const;
+    /// True when `source` still has the size and mtime recorded at compile time.
+    bool is_fresh(std::size_t doc, const std::filesystem::path& source) const;
+    /// Segment count, normalized text bytes and token ids (0 without tokens) of a document.
+    void doc_work(std::size_t doc, std::uint64_t& segments, std::uint64_t& text_bytes, std::uint64_t& tokens) const;
+    /// Fill `out.segments` and `out.note_sites` (no DOM, no bytes). Token views are attached when `with_tokens`.
+    bool load_document(std::size_t doc, TeiDocument& out, bool with_tokens, std::string& error) const;
+
+private:
+    std::string_view data_view(std::uint64_t offset, std::uint64_t size) const;
+
+    MappedFile file_;
+    SegmentStoreHeader header_{};
+    const SegmentStoreDoc* docs_ = nullptr;
+    const SegmentStoreSegment* segments_ = nullptr;
+    const SegmentStoreNote* notes_ = nullptr;
+};
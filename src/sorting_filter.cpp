@@ -1,9 +1,13 @@
 #include "sorting_filter.hpp"
 
+#include "atomic_file.hpp"
+#include "fnv1a.hpp"
+#include "mapped_file.hpp"
+
 #include <algorithm>
+#include <bit>
 #include <cctype>
-#include <fstream>
-#include <unordered_set>
+#include <cstring>
 
 #include <nlohmann/json.hpp>
 
@@ -56,10 +60,14 @@ std::string make_file_key(
 ) {
     std::filesystem::path rel;
     if (input_is_dir) {
-        std::error_code ec;
-        rel = std::filesystem::relative(xml_file, input_root, ec);
-        if (ec) {
-            rel = xml_file.filename();
+        // Scanned files are lexically under the root; only fall back to the filesystem-resolving form otherwise.
+        rel = xml_file.lexically_normal().lexically_relative(input_root.lexically_normal());
+        if (rel.empty() || *rel.begin() == "..") {
+            std::error_code ec;
+            rel = std::filesystem::relative(xml_file, input_root, ec);
+            if (ec) {
+                rel = xml_file.filename();
+            }
         }
     } else {
         rel = xml_file.filename();
@@ -68,136 +76,601 @@ std::string make_file_key(
     return normalize_path_for_key(rel.generic_string());
 }
 
-std::unordered_set<std::string> make_filter_set(const std::vector<std::string>& values) {
-    std::unordered_set<std::string> out;
-    out.reserve(values.size());
-    for (const auto& value : values) {
-        const auto normalized = normalize_text(value);
-        if (!normalized.empty()) {
-            out.insert(normalized);
-        }
+std::size_t category_index(SortingCategory category) {
+    return static_cast<std::size_t>(category);
+}
+
+const char* default_label(SortingCategory category) {
+    switch (category) {
+        case SortingCategory::Canon:
+            return "Unknown";
+        case SortingCategory::Tradition:
+            return "Unknown Tradition";
+        case SortingCategory::Period:
+            return "Unknown Period";
+        case SortingCategory::Origin:
+            return "Unknown Origin";
     }
-    return out;
+    return "Unknown";
 }
 
-bool match_scalar(const std::string& value, const std::unordered_set<std::string>& filter_set) {
-    if (filter_set.empty()) {
+std::int64_t file_mtime(const std::filesystem::path& path) {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+}
+
+constexpr char kSnapshotMagic[8] = {'T', 'E', 'I', 'M', 'T', 'S', 'M', 'D'};
+constexpr std::uint32_t kSnapshotVersion = 1;
+
+/// Snapshot layout: header, record keys and rows, canon/period/origin columns, tradition offsets and values,
+/// (label, key) pairs per category value, then the string bytes they point into.
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t json_size;
+    std::int64_t json_mtime;
+    std::uint64_t json_hash;
+    std::uint64_t record_count;
+    std::uint64_t row_count;
+    std::uint64_t tradition_value_count;
+    std::uint64_t value_counts[kSortingCategoryCount];
+    std::uint64_t strings_size;
+};
+
+struct SnapshotString {
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+template <typename T>
+void write_pod(std::string& out, const T* items, std::size_t count) {
+    out.append(reinterpret_cast<const char*>(items), count * sizeof(T));
+}
+
+/// Bounds-checked sequential reads from the mapped snapshot (memcpy, so no alignment assumptions).
+struct SnapshotReader {
+    std::string_view bytes;
+    std::size_t pos = 0;
+
+    template <typename T>
+    bool read(std::vector<T>& out, std::uint64_t count) {
+        if (count > (bytes.size() - pos) / sizeof(T)) {
+            return false;
+        }
+        out.resize(static_cast<std::size_t>(count));
+        std::memcpy(out.data(), bytes.data() + pos, out.size() * sizeof(T));
+        pos += out.size() * sizeof(T);
+        return true;
+    }
+
+    std::string_view rest() const { return bytes.substr(pos); }
+};
+
+}  // namespace
+
+/// SAX handler for the sorting JSON: keeps only `detailed_analysis[*].{file,canon,period,origin,traditions}`.
+class SortingJsonSax {
+public:
+    explicit SortingJsonSax(SortingMetadataIndex& index) : index_(index) {}
+
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(nlohmann::json::number_integer_t) { return true; }
+    bool number_unsigned(nlohmann::json::number_unsigned_t) { return true; }
+    bool number_float(nlohmann::json::number_float_t, const std::string&) { return true; }
+    bool binary(nlohmann::json::binary_t&) { return true; }
+
+    bool string(std::string& value) {
+        if (in_item() && depth_ == 3) {
+            if (key_ == "file") {
+                file_ = std::move(value);
+            } else if (key_ == "canon") {
+                canon_ = std::move(value);
+            } else if (key_ == "period") {
+                period_ = std::move(value);
+            } else if (key_ == "origin") {
+                origin_ = std::move(value);
+            }
+        } else if (in_traditions_ && depth_ == 4) {
+            traditions_.push_back(std::move(value));
+        }
+        return true;
+    }
+
+    bool key(std::string& value) {
+        if (depth_ == 1) {
+            root_key_ = value;
+        } else if (depth_ == 3) {
+            key_ = std::move(value);
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        ++depth_;
+        if (in_analysis_ && depth_ == 3) {
+            item_ = true;
+            key_.clear();
+            file_.clear();
+            canon_ = "Unknown";
+            period_ = "Unknown Period";
+            origin_ = "Unknown Origin";
+            traditions_.clear();
+        }
+        return true;
+    }
+
+    bool end_object() {
+        if (in_item() && depth_ == 3) {
+            item_ = false;
+            if (!file_.empty()) {
+                index_.add_record(file_, canon_, period_, origin_, traditions_);
+            }
+        }
+        --depth_;
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        ++depth_;
+        if (depth_ == 2 && root_key_ == "detailed_analysis") {
+            in_analysis_ = true;
+            saw_analysis = true;
+        } else if (in_item() && depth_ == 4 && key_ == "traditions") {
+            in_traditions_ = true;
+        }
+        return true;
+    }
+
+    bool end_array() {
+        if (depth_ == 2) {
+            in_analysis_ = false;
+        } else if (depth_ == 4) {
+            in_traditions_ = false;
+        }
+        --depth_;
         return true;
     }
-    return filter_set.find(normalize_text(value)) != filter_set.end();
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::json::exception& ex) {
+        error = ex.what();
+        return false;
+    }
+
+    bool saw_analysis = false;
+    std::string error;
+
+private:
+    bool in_item() const { return in_analysis_ && item_; }
+
+    SortingMetadataIndex& index_;
+    int depth_ = 0;
+    bool in_analysis_ = false;
+    bool item_ = false;
+    bool in_traditions_ = false;
+    std::string root_key_;
+    std::string key_;
+    std::string file_;
+    std::string canon_;
+    std::string period_;
+    std::string origin_;
+    std::vector<std::string> traditions_;
+};
+
+void SortingBitset::and_with(const SortingBitset& other) {
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+        words_[i] &= other.words_[i];
+    }
+}
+
+void SortingBitset::or_with(const SortingBitset& other) {
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+        words_[i] |= other.words_[i];
+    }
 }
 
-bool match_traditions(
-    const std::vector<std::string>& traditions,
-    const std::unordered_set<std::string>& filter_set
+std::size_t SortingBitset::count() const {
+    std::size_t total = 0;
+    for (const auto word : words_) {
+        total += static_cast<std::size_t>(std::popcount(word));
+    }
+    return total;
+}
+
+std::size_t SortingBitset::count_and(const SortingBitset& other) const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+        total += static_cast<std::size_t>(std::popcount(words_[i] & other.words_[i]));
+    }
+    return total;
+}
+
+std::uint32_t SortingMetadataIndex::intern(SortingCategory category, const std::string& value) {
+    const auto c = category_index(category);
+    std::string key = normalize_text(value);
+    const std::string label = key.empty() ? default_label(category) : value;
+    if (key.empty()) {
+        key = normalize_text(label);
+    }
+
+    const auto [it, inserted] = value_ids_[c].try_emplace(std::move(key), static_cast<std::uint32_t>(value_labels_[c].size()));
+    if (inserted) {
+        value_labels_[c].push_back(label);
+        value_keys_[c].push_back(it->first);
+    }
+    return it->second;
+}
+
+void SortingMetadataIndex::add_record(
+    const std::string& file,
+    const std::string& canon,
+    const std::string& period,
+    const std::string& origin,
+    const std::vector<std::string>& traditions
 ) {
-    if (filter_set.empty()) {
-        return true;
+    auto key = normalize_path_for_key(file);
+    if (key.empty()) {
+        return;
     }
+
+    // A repeated file replaces the earlier record (its row is simply no longer referenced).
+    const auto row = static_cast<std::uint32_t>(tradition_offsets_.size() - 1);
+    record_ids_[std::move(key)] = row;
+
+    scalar_columns_[category_index(SortingCategory::Canon)].push_back(intern(SortingCategory::Canon, canon));
+    scalar_columns_[category_index(SortingCategory::Period)].push_back(intern(SortingCategory::Period, period));
+    scalar_columns_[category_index(SortingCategory::Origin)].push_back(intern(SortingCategory::Origin, origin));
+
+    const std::size_t first = tradition_values_.size();
     for (const auto& tradition : traditions) {
-        if (filter_set.find(normalize_text(tradition)) != filter_set.end()) {
-            return true;
+        const auto id = intern(SortingCategory::Tradition, tradition);
+        if (std::find(tradition_values_.begin() + static_cast<std::ptrdiff_t>(first), tradition_values_.end(), id)
+            == tradition_values_.end()) {
+            tradition_values_.push_back(id);
         }
     }
-    return false;
+    if (tradition_values_.size() == first) {
+        tradition_values_.push_back(intern(SortingCategory::Tradition, "Unknown Tradition"));
+    }
+    tradition_offsets_.push_back(static_cast<std::uint32_t>(tradition_values_.size()));
 }
 
-}  // namespace
+bool SortingMetadataIndex::parse_json(std::string_view json, std::string& error) {
+    SortingJsonSax sax(*this);
+    bool parsed = false;
+    try {
+        parsed = nlohmann::json::sax_parse(json.begin(), json.end(), &sax);
+    } catch (const std::exception& ex) {
+        error = "Failed to parse sorting data JSON: " + std::string(ex.what());
+        return false;
+    }
+    if (!parsed) {
+        error = "Failed to parse sorting data JSON: " + sax.error;
+        return false;
+    }
+    if (!sax.saw_analysis) {
+        error = "Sorting data JSON missing array: detailed_analysis";
+        return false;
+    }
+    return true;
+}
 
 bool SortingMetadataIndex::load(const std::filesystem::path& json_path, std::string& error) {
-    records_.clear();
+    *this = SortingMetadataIndex{};
 
-    std::ifstream in(json_path);
-    if (!in.is_open()) {
+    MappedFile json;
+    if (!json.open(json_path, error)) {
         error = "Failed to open sorting data: " + json_path.string();
         return false;
     }
+    const std::uint64_t json_size = json.size();
+    const std::int64_t json_mtime = file_mtime(json_path);
+    const std::uint64_t json_hash = fnv1a64(json.bytes());
 
-    nlohmann::json data;
-    try {
-        in >> data;
-    } catch (const std::exception& ex) {
-        error = "Failed to parse sorting data JSON: " + std::string(ex.what());
+    const std::filesystem::path snapshot_path = json_path.string() + ".tmidx";
+    {
+        MappedFile snapshot;
+        std::string snapshot_error;
+        if (snapshot.open(snapshot_path, snapshot_error) && read_snapshot(snapshot.bytes(), json_size, json_mtime, json_hash)) {
+            loaded_from_snapshot_ = true;
+            return true;
+        }
+    }
+
+    *this = SortingMetadataIndex{};
+    tradition_offsets_.push_back(0);
+    if (!parse_json(json.bytes(), error)) {
         return false;
     }
 
-    if (!data.contains("detailed_analysis") || !data["detailed_analysis"].is_array()) {
-        error = "Sorting data JSON missing array: detailed_analysis";
+    if (record_ids_.empty()) {
+        error = "Sorting data loaded but no usable records were found.";
         return false;
     }
 
-    for (const auto& item : data["detailed_analysis"]) {
-        if (!item.is_object()) {
-            continue;
-        }
-        const std::string file = item.value("file", "");
-        if (file.empty()) {
-            continue;
+    // Best effort: a read-only data directory just means the next run parses again.
+    write_snapshot(snapshot_path, json_size, json_mtime, json_hash);
+    return true;
+}
+
+bool SortingMetadataIndex::write_snapshot(
+    const std::filesystem::path& path,
+    std::uint64_t json_size,
+    std::int64_t json_mtime,
+    std::uint64_t json_hash
+) const {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.json_size = json_size;
+    header.json_mtime = json_mtime;
+    header.json_hash = json_hash;
+    header.record_count = record_ids_.size();
+    header.row_count = tradition_offsets_.size() - 1;
+    header.tradition_value_count = tradition_values_.size();
+    for (std::size_t c = 0; c < kSortingCategoryCount; ++c) {
+        header.value_counts[c] = value_labels_[c].size();
+    }
+
+    std::string strings;
+    const auto add_string = [&strings](std::string_view value) {
+        const SnapshotString ref{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(value.size())};
+        strings.append(value);
+        return ref;
+    };
+
+    std::vector<SnapshotString> record_keys;
+    std::vector<std::uint32_t> record_rows;
+    record_keys.reserve(record_ids_.size());
+    record_rows.reserve(record_ids_.size());
+    for (const auto& [key, row] : record_ids_) {
+        record_keys.push_back(add_string(key));
+        record_rows.push_back(row);
+    }
+    std::vector<SnapshotString> value_strings;
+    for (std::size_t c = 0; c < kSortingCategoryCount; ++c) {
+        for (std::size_t v = 0; v < value_labels_[c].size(); ++v) {
+            value_strings.push_back(add_string(value_labels_[c][v]));
+            value_strings.push_back(add_string(value_keys_[c][v]));
         }
+    }
+    header.strings_size = strings.size();
 
-        const auto key = normalize_path_for_key(file);
-        if (key.empty()) {
-            continue;
+    std::string out;
+    write_pod(out, &header, 1);
+    write_pod(out, record_keys.data(), record_keys.size());
+    write_pod(out, record_rows.data(), record_rows.size());
+    for (const auto c : {SortingCategory::Canon, SortingCategory::Period, SortingCategory::Origin}) {
+        write_pod(out, scalar_columns_[category_index(c)].data(), scalar_columns_[category_index(c)].size());
+    }
+    write_pod(out, tradition_offsets_.data(), tradition_offsets_.size());
+    write_pod(out, tradition_values_.data(), tradition_values_.size());
+    write_pod(out, value_strings.data(), value_strings.size());
+    out.append(strings);
+
+    std::string error;
+    return write_file_atomically(path, out, error);
+}
+
+bool SortingMetadataIndex::read_snapshot(
+    std::string_view bytes,
+    std::uint64_t json_size,
+    std::int64_t json_mtime,
+    std::uint64_t json_hash
+) {
+    SnapshotHeader header{};
+    if (bytes.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 || header.version != kSnapshotVersion
+        || header.json_size != json_size || header.json_mtime != json_mtime || header.json_hash != json_hash
+        || header.record_count == 0 || header.row_count < header.record_count) {
+        return false;
+    }
+
+    SnapshotReader in{bytes, sizeof(header)};
+    std::vector<SnapshotString> record_keys;
+    std::vector<std::uint32_t> record_rows;
+    std::vector<SnapshotString> value_strings;
+    std::uint64_t value_total = 0;
+    for (const auto count : header.value_counts) {
+        value_total += count;
+    }
+    if (!in.read(record_keys, header.record_count) || !in.read(record_rows, header.record_count)) {
+        return false;
+    }
+    for (const auto c : {SortingCategory::Canon, SortingCategory::Period, SortingCategory::Origin}) {
+        if (!in.read(scalar_columns_[category_index(c)], header.row_count)) {
+            return false;
         }
+    }
+    if (!in.read(tradition_offsets_, header.row_count + 1) || !in.read(tradition_values_, header.tradition_value_count)
+        || !in.read(value_strings, value_total * 2)) {
+        return false;
+    }
+    const std::string_view strings = in.rest();
+    if (strings.size() != header.strings_size) {
+        return false;
+    }
 
-        SortingMetadataRecord rec;
-        rec.canon = item.value("canon", "Unknown");
-        rec.period = item.value("period", "Unknown Period");
-        rec.origin = item.value("origin", "Unknown Origin");
+    const auto view = [&strings](const SnapshotString& ref, std::string_view& out) {
+        if (ref.offset > strings.size() || ref.size > strings.size() - ref.offset) {
+            return false;
+        }
+        out = strings.substr(ref.offset, ref.size);
+        return true;
+    };
 
-        if (item.contains("traditions") && item["traditions"].is_array()) {
-            for (const auto& t : item["traditions"]) {
-                if (t.is_string()) {
-                    rec.traditions.push_back(t.get<std::string>());
-                }
+    // Ids must stay in range so lookups never need bounds checks after loading.
+    std::size_t next = 0;
+    for (std::size_t c = 0; c < kSortingCategoryCount; ++c) {
+        for (std::uint64_t v = 0; v < header.value_counts[c]; ++v) {
+            std::string_view label;
+            std::string_view key;
+            if (!view(value_strings[next++], label) || !view(value_strings[next++], key)) {
+                return false;
             }
+            value_labels_[c].emplace_back(label);
+            const auto [it, inserted] = value_ids_[c].try_emplace(std::string(key), static_cast<std::uint32_t>(v));
+            value_keys_[c].push_back(it->first);
         }
-        if (rec.traditions.empty()) {
-            rec.traditions.push_back("Unknown Tradition");
+    }
+    for (const auto c : {SortingCategory::Canon, SortingCategory::Period, SortingCategory::Origin}) {
+        for (const auto id : scalar_columns_[category_index(c)]) {
+            if (id >= header.value_counts[category_index(c)]) {
+                return false;
+            }
         }
-
-        records_[key] = std::move(rec);
     }
-
-    if (records_.empty()) {
-        error = "Sorting data loaded but no usable records were found.";
-        return false;
+    for (const auto id : tradition_values_) {
+        if (id >= header.value_counts[category_index(SortingCategory::Tradition)]) {
+            return false;
+        }
+    }
+    for (std::size_t r = 0; r < header.row_count; ++r) {
+        if (tradition_offsets_[r] > tradition_offsets_[r + 1] || tradition_offsets_[r + 1] > tradition_values_.size()) {
+            return false;
+        }
     }
 
+    record_ids_.reserve(record_keys.size());
+    for (std::size_t i = 0; i < record_keys.size(); ++i) {
+        std::string_view key;
+        if (!view(record_keys[i], key) || record_rows[i] >= header.row_count) {
+            return false;
+        }
+        record_ids_.emplace(std::string(key), record_rows[i]);
+    }
     return true;
 }
 
-const SortingMetadataRecord* SortingMetadataIndex::lookup(
+std::uint32_t SortingMetadataIndex::find_record(
     const std::filesystem::path& xml_file,
     const std::filesystem::path& input_root,
     bool input_is_dir
 ) const {
-    const auto key = make_file_key(xml_file, input_root, input_is_dir);
-    const auto it = records_.find(key);
-    if (it == records_.end()) {
-        return nullptr;
+    const auto it = record_ids_.find(make_file_key(xml_file, input_root, input_is_dir));
+    return it == record_ids_.end() ? kNoRecord : it->second;
+}
+
+std::size_t SortingMetadataIndex::value_count(SortingCategory category) const {
+    return value_labels_[category_index(category)].size();
+}
+
+const std::string& SortingMetadataIndex::value_label(SortingCategory category, std::uint32_t value) const {
+    return value_labels_[category_index(category)][value];
+}
+
+bool SortingMetadataIndex::find_value(SortingCategory category, std::string_view value, std::uint32_t& out) const {
+    const auto& ids = value_ids_[category_index(category)];
+    const auto it = ids.find(normalize_text(std::string(value)));
+    if (it == ids.end()) {
+        return false;
     }
-    return &it->second;
+    out = it->second;
+    return true;
 }
 
-bool SortingMetadataIndex::match(
-    const std::filesystem::path& xml_file,
-    const std::filesystem::path& input_root,
-    bool input_is_dir,
-    const SortingFilters& filters
+std::pair<const std::uint32_t*, const std::uint32_t*> SortingMetadataIndex::record_values(
+    std::uint32_t record,
+    SortingCategory category
 ) const {
-    const auto* rec = lookup(xml_file, input_root, input_is_dir);
-    if (rec == nullptr) {
-        return false;
+    if (category == SortingCategory::Tradition) {
+        return {
+            tradition_values_.data() + tradition_offsets_[record],
+            tradition_values_.data() + tradition_offsets_[record + 1],
+        };
+    }
+    const auto* value = scalar_columns_[category_index(category)].data() + record;
+    return {value, value + 1};
+}
+
+SortingFileIndex::SortingFileIndex(
+    const SortingMetadataIndex& metadata,
+    std::vector<std::filesystem::path> files,
+    const std::filesystem::path& input_root,
+    bool input_is_dir
+)
+    : metadata_(metadata), files_(std::move(files)), with_metadata_(files_.size()) {
+    for (std::size_t c = 0; c < kSortingCategoryCount; ++c) {
+        value_bits_[c].assign(metadata_.value_count(static_cast<SortingCategory>(c)), SortingBitset(files_.size()));
+    }
+
+    for (std::size_t i = 0; i < files_.size(); ++i) {
+        const auto record = metadata_.find_record(files_[i], input_root, input_is_dir);
+        if (record == SortingMetadataIndex::kNoRecord) {
+            continue;
+        }
+        with_metadata_.set(i);
+        for (std::size_t c = 0; c < kSortingCategoryCount; ++c) {
+            const auto [first, last] = metadata_.record_values(record, static_cast<SortingCategory>(c));
+            for (const auto* value = first; value != last; ++value) {
+                value_bits_[c][*value].set(i);
+            }
+        }
     }
+}
+
+SortingBitset SortingFileIndex::select(const SortingFilters& filters) const {
+    const std::array<const std::vector<std::string>*, kSortingCategoryCount> by_category = {
+        &filters.canon,
+        &filters.tradition,
+        &filters.period,
+        &filters.origin,
+    };
 
-    const auto canon_filters = make_filter_set(filters.canon);
-    const auto tradition_filters = make_filter_set(filters.tradition);
-    const auto period_filters = make_filter_set(filters.period);
-    const auto origin_filters = make_filter_set(filters.origin);
+    SortingBitset result = with_metadata_;
+    for (std::size_t c = 0; c < kSortingCategoryCount; ++c) {
+        bool any_filter = false;
+        SortingBitset any_of(files_.size());
+        for (const auto& value : *by_category[c]) {
+            if (normalize_text(value).empty()) {
+                continue;
+            }
+            any_filter = true;
+            std::uint32_t id = 0;
+            if (metadata_.find_value(static_cast<SortingCategory>(c), value, id)) {
+                any_of.or_with(value_bits_[c][id]);
+            }
+        }
+        if (any_filter) {
+            result.and_with(any_of);
+        }
+    }
+    return result;
+}
 
-    return match_scalar(rec->canon, canon_filters)
-        && match_traditions(rec->traditions, tradition_filters)
-        && match_scalar(rec->period, period_filters)
-        && match_scalar(rec->origin, origin_filters);
+std::vector<std::pair<std::string, std::size_t>> SortingFileIndex::facet_counts(
+    SortingCategory category,
+    const SortingBitset& scope
+) const {
+    std::vector<std::pair<std::string, std::size_t>> out;
+    const auto& bits = value_bits_[category_index(category)];
+    for (std::uint32_t value = 0; value < bits.size(); ++value) {
+        const auto count = bits[value].count_and(scope);
+        if (count > 0) {
+            out.emplace_back(metadata_.value_label(category, value), count);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+        if (a.second != b.second) {
+            return a.second > b.second;
+        }
+        return a.first < b.first;
+    });
+    return out;
+}
+
+std::vector<std::filesystem::path> SortingFileIndex::files_in(const SortingBitset& selection) const {
+    std::vector<std::filesystem::path> out;
+    out.reserve(selection.count());
+    for (std::size_t i = 0; i < files_.size(); ++i) {
+        if (selection.test(i)) {
+            out.push_back(files_[i]);
+        }
+    }
+    return out;
 }
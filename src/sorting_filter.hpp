@@ -1,8 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct SortingFilters {
@@ -12,28 +17,125 @@ struct SortingFilters {
     std::vector<std::string> origin;
 };
 
-struct SortingMetadataRecord {
-    std::string canon;
-    std::vector<std::string> traditions;
-    std::string period;
-    std::string origin;
+enum class SortingCategory : std::uint8_t {
+    Canon,
+    Tradition,
+    Period,
+    Origin,
 };
 
+inline constexpr std::size_t kSortingCategoryCount = 4;
+
+/// Fixed-size bit set over the files of a SortingFileIndex.
+class SortingBitset {
+public:
+    SortingBitset() = default;
+    explicit SortingBitset(std::size_t size) : size_(size), words_((size + 63) / 64, 0) {}
+
+    std::size_t size() const { return size_; }
+    void set(std::size_t i) { words_[i / 64] |= std::uint64_t{1} << (i % 64); }
+    bool test(std::size_t i) const { return (words_[i / 64] >> (i % 64)) & 1u; }
+
+    void and_with(const SortingBitset& other);
+    void or_with(const SortingBitset& other);
+    std::size_t count() const;
+    /// popcount(*this & other) without materializing the intersection.
+    std::size_t count_and(const SortingBitset& other) const;
+
+private:
+    std::size_t size_ = 0;
+    std::vector<std::uint64_t> words_;
+};
+
+class SortingJsonSax;
+
+/// Sorting metadata JSON interned into columns: each category value gets a small integer id (normalized text is the
+/// identity, the first spelling seen is the display label) and each record stores ids instead of strings.
+///
+/// load() keeps a binary snapshot of the columns next to the JSON (`<json>.tmidx`). It is used when the JSON's size,
+/// mtime and content hash still match; otherwise the JSON is stream-parsed (SAX, no DOM) and the snapshot rewritten.
 class SortingMetadataIndex {
 public:
+    static constexpr std::uint32_t kNoRecord = UINT32_MAX;
+
     bool load(const std::filesystem::path& json_path, std::string& error);
-    const SortingMetadataRecord* lookup(
+    /// True when the last load() came from the snapshot.
+    bool loaded_from_snapshot() const { return loaded_from_snapshot_; }
+    std::size_t record_count() const { return record_ids_.size(); }
+
+    /// Record row for `xml_file`, or kNoRecord.
+    std::uint32_t find_record(
         const std::filesystem::path& xml_file,
         const std::filesystem::path& input_root,
         bool input_is_dir
     ) const;
-    bool match(
-        const std::filesystem::path& xml_file,
-        const std::filesystem::path& input_root,
-        bool input_is_dir,
-        const SortingFilters& filters
+
+    std::size_t value_count(SortingCategory category) const;
+    const std::string& value_label(SortingCategory category, std::uint32_t value) const;
+    /// Interned id of `value` (compared after trimming and lowercasing), or false if no record uses it.
+    bool find_value(SortingCategory category, std::string_view value, std::uint32_t& out) const;
+
+    /// Value ids of one record in `category` (several for traditions, one otherwise).
+    std::pair<const std::uint32_t*, const std::uint32_t*> record_values(std::uint32_t record, SortingCategory category) const;
+
+private:
+    friend class SortingJsonSax;
+
+    std::uint32_t intern(SortingCategory category, const std::string& value);
+    void add_record(
+        const std::string& file,
+        const std::string& canon,
+        const std::string& period,
+        const std::string& origin,
+        const std::vector<std::string>& traditions
+    );
+    bool parse_json(std::string_view json, std::string& error);
+    bool read_snapshot(std::string_view bytes, std::uint64_t json_size, std::int64_t json_mtime, std::uint64_t json_hash);
+    bool write_snapshot(
+        const std::filesystem::path& path,
+        std::uint64_t json_size,
+        std::int64_t json_mtime,
+        std::uint64_t json_hash
     ) const;
 
+    bool loaded_from_snapshot_ = false;
+
+    std::unordered_map<std::string, std::uint32_t> record_ids_;
+    std::array<std::unordered_map<std::string, std::uint32_t>, kSortingCategoryCount> value_ids_;
+    std::array<std::vector<std::string>, kSortingCategoryCount> value_labels_;
+    /// Normalized form of each label (the key in value_ids_), kept for the snapshot.
+    std::array<std::vector<std::string>, kSortingCategoryCount> value_keys_;
+    /// Per-record value ids: one column each for canon, period and origin.
+    std::array<std::vector<std::uint32_t>, kSortingCategoryCount> scalar_columns_;
+    /// Traditions in CSR form: record r owns tradition_values_[tradition_offsets_[r], tradition_offsets_[r + 1]).
+    std::vector<std::uint32_t> tradition_offsets_;
+    std::vector<std::uint32_t> tradition_values_;
+};
+
+/// A file list bound to the metadata once: one bitset per category value over the files, so filters are AND/OR
+/// over words and facet counts are popcounts.
+class SortingFileIndex {
+public:
+    SortingFileIndex(
+        const SortingMetadataIndex& metadata,
+        std::vector<std::filesystem::path> files,
+        const std::filesystem::path& input_root,
+        bool input_is_dir
+    );
+
+    const std::vector<std::filesystem::path>& files() const { return files_; }
+    /// Files that have a metadata record.
+    const SortingBitset& with_metadata() const { return with_metadata_; }
+
+    /// Files matching `filters`: AND across categories, OR within one. Values no record uses match nothing.
+    SortingBitset select(const SortingFilters& filters) const;
+    /// (label, files) for every value of `category` present in `scope`, most files first.
+    std::vector<std::pair<std::string, std::size_t>> facet_counts(SortingCategory category, const SortingBitset& scope) const;
+    std::vector<std::filesystem::path> files_in(const SortingBitset& selection) const;
+
 private:
-    std::unordered_map<std::string, SortingMetadataRecord> records_;
+    const SortingMetadataIndex& metadata_;
+    std::vector<std::filesystem::path> files_;
+    SortingBitset with_metadata_;
+    std::array<std::vector<SortingBitset>, kSortingCategoryCount> value_bits_;
 };
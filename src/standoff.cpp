@@ -0,0 +1,204 @@
+#include "standoff.hpp"
+
+#include "fnv1a.hpp"
+#include "tei_reader.hpp"
+#include "trace.hpp"
+#include "writer_tei.hpp"
+
+#include <charconv>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+std::string hash_hex(std::uint64_t hash) {
+    char buf[16];
+    const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), hash, 16);
+    (void)ec;
+    const auto digits = static_cast<std::size_t>(end - buf);
+    std::string out(16 - digits, '0');
+    out.append(buf, digits);
+    return out;
+}
+
+bool parse_hash_hex(const std::string& text, std::uint64_t& out) {
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), out, 16);
+    return ec == std::errc{} && end == text.data() + text.size();
+}
+
+}  // namespace
+
+std::uint64_t standoff_source_hash(std::string_view text) {
+    return fnv1a64(text);
+}
+
+std::filesystem::path standoff_path_for(const std::filesystem::path& tei_path) {
+    std::filesystem::path out = tei_path;
+    out.replace_extension(".en.jsonl");
+    return out;
+}
+
+bool StandoffLog::load(const std::filesystem::path& path, std::string& error) {
+    TEI_MT_TRACE_SCOPE("standoff_load");
+    entries_.clear();
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        if (!std::filesystem::exists(path)) {
+            return true;
+        }
+        error = "Failed to open standoff file " + path.string();
+        return false;
+    }
+
+    // Unparsable lines are skipped: an interrupted append leaves a torn line, which open_append() terminates
+    // before the next run's records.
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        const auto record = nlohmann::json::parse(line, nullptr, false);
+        if (record.is_discarded() || !record.is_object()) {
+            continue;
+        }
+        if (record.contains("standoff")) {
+            continue;
+        }
+
+        const auto key = record.find("key");
+        const auto src = record.find("src");
+        const auto en = record.find("en");
+        Entry entry;
+        if (key == record.end() || !key->is_string() || src == record.end() || !src->is_string()
+            || en == record.end() || !en->is_string() || !parse_hash_hex(src->get<std::string>(), entry.source_hash)) {
+            continue;
+        }
+        entry.translation = en->get<std::string>();
+        entries_.insert_or_assign(key->get<std::string>(), std::move(entry));
+    }
+    return true;
+}
+
+const std::string* StandoffLog::find(const Segment& segment) const {
+    const auto it = entries_.find(segment.id);
+    if (it == entries_.end() || it->second.source_hash != standoff_source_hash(segment.source_zh)) {
+        return nullptr;
+    }
+    return &it->second.translation;
+}
+
+bool StandoffLog::open_append(const std::filesystem::path& path, const std::string& source_name, std::string& error) {
+    path_ = path;
+    write_failed_ = false;
+
+    std::error_code ec;
+    const auto size = std::filesystem::exists(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+    bool needs_newline = false;
+    if (size > 0) {
+        std::ifstream tail(path, std::ios::binary);
+        tail.seekg(-1, std::ios::end);
+        needs_newline = tail.get() != '\n';
+    }
+
+    out_.open(path, std::ios::binary | std::ios::app);
+    if (!out_) {
+        error = "Failed to open standoff file for append: " + path.string();
+        return false;
+    }
+    if (needs_newline) {
+        out_ << '\n';
+    }
+    if (size == 0) {
+        out_ << nlohmann::ordered_json{{"standoff", 1}, {"source", source_name}}.dump(
+            -1, ' ', false, nlohmann::ordered_json::error_handler_t::replace
+        ) << '\n';
+    }
+    out_.flush();
+    if (!out_) {
+        error = "Failed to write standoff file: " + path.string();
+        return false;
+    }
+    return true;
+}
+
+bool StandoffLog::append(const Segment& segment, std::string_view translation) {
+    TEI_MT_TRACE_SCOPE("standoff_append");
+    const nlohmann::ordered_json record = {
+        {"key", std::string(segment.id)},
+        {"src", hash_hex(standoff_source_hash(segment.source_zh))},
+        {"en", std::string(translation)},
+    };
+    const std::string line = record.dump(-1, ' ', false, nlohmann::ordered_json::error_handler_t::replace);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_ << line << '\n';
+    out_.flush();
+    if (!out_) {
+        write_failed_ = true;
+    }
+    return !write_failed_;
+}
+
+bool StandoffLog::close(std::string& error) {
+    if (!out_.is_open()) {
+        return true;
+    }
+    out_.close();
+    if (write_failed_ || !out_) {
+        error = "Failed to write standoff file: " + path_.string();
+        return false;
+    }
+    return true;
+}
+
+bool merge_standoff_into_tei(
+    const std::filesystem::path& source_xml,
+    const std::filesystem::path& standoff_path,
+    const std::filesystem::path& out_path,
+    bool overwrite_existing_translations,
+    std::size_t& merged,
+    std::size_t& missing,
+    std::string& error
+) {
+    merged = 0;
+    missing = 0;
+
+    TeiDocument doc;
+    if (!read_tei_file(source_xml, doc, error)) {
+        return false;
+    }
+
+    StandoffLog log;
+    if (!log.load(standoff_path, error)) {
+        return false;
+    }
+
+    // Keep only the segments that have a translation; the writer then splices notes for exactly those.
+    const bool have_sites = doc.note_sites.size() == doc.segments.size();
+    std::vector<Segment> segments;
+    std::vector<pugi::xml_node> nodes;
+    std::vector<TeiNoteSite> sites;
+    std::vector<std::string> translations;
+    for (std::size_t i = 0; i < doc.segments.size(); ++i) {
+        const std::string* translation = log.find(doc.segments[i]);
+        if (translation == nullptr) {
+            ++missing;
+            continue;
+        }
+        segments.push_back(doc.segments[i]);
+        nodes.push_back(doc.segment_nodes[i]);
+        if (have_sites) {
+            sites.push_back(std::move(doc.note_sites[i]));
+        }
+        translations.push_back(*translation);
+    }
+    merged = translations.size();
+
+    doc.segments = std::move(segments);
+    doc.segment_nodes = std::move(nodes);
+    doc.note_sites = std::move(sites);
+    return write_tei_note_output(out_path, doc, translations, overwrite_existing_translations, error);
+}
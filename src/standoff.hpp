@@ -0,0 +1,72 @@
+#pragma once
+
+#include "segment.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/// Standoff translation store (`--tei-strategy standoff`): a JSONL file next to where the TEI output would go,
+/// one record per translated segment, linked to the untouched source by segment key (xml:id or `seg-N`) and a
+/// hash of the normalized source text. The file is only ever appended to; a later record for a key supersedes
+/// earlier ones, and a record whose hash no longer matches the source is ignored.
+///
+///   {"standoff":1,"source":"T01n0001.xml"}
+///   {"key":"pT01p0001a0101","src":"9f1c0e2b7a4d3e11","en":"Thus have I heard..."}
+
+/// FNV-1a 64 of the normalized source text.
+std::uint64_t standoff_source_hash(std::string_view text);
+
+/// `<dir>/<stem>.en.jsonl` for a TEI output path `<dir>/<stem>.xml`.
+std::filesystem::path standoff_path_for(const std::filesystem::path& tei_path);
+
+class StandoffLog {
+public:
+    /// Read existing records; a missing file is an empty log. Torn lines from interrupted appends are ignored.
+    bool load(const std::filesystem::path& path, std::string& error);
+
+    /// Recorded translation for `segment`, or nullptr when there is none for its key and current source text.
+    const std::string* find(const Segment& segment) const;
+    std::size_t size() const { return entries_.size(); }
+
+    /// Open for appending; writes the header line when the file is new.
+    bool open_append(const std::filesystem::path& path, const std::string& source_name, std::string& error);
+    /// Append and flush one record, so an interrupted run keeps everything translated so far. Thread-safe.
+    bool append(const Segment& segment, std::string_view translation);
+    bool close(std::string& error);
+
+private:
+    struct Entry {
+        std::uint64_t source_hash = 0;
+        std::string translation;
+    };
+
+    struct KeyHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+
+    std::unordered_map<std::string, Entry, KeyHash, std::equal_to<>> entries_;
+    std::filesystem::path path_;
+    std::ofstream out_;
+    std::mutex mutex_;
+    bool write_failed_ = false;
+};
+
+/// Write `out_path` as `source_xml` with the standoff translations spliced in as notes. Segments without a
+/// matching record are left without a note; `missing` counts them.
+bool merge_standoff_into_tei(
+    const std::filesystem::path& source_xml,
+    const std::filesystem::path& standoff_path,
+    const std::filesystem::path& out_path,
+    bool overwrite_existing_translations,
+    std::size_t& merged,
+    std::size_t& missing,
+    std::string& error
+);
@@ -1,67 +1,25 @@
 #include "tei_reader.hpp"
 
-#include <algorithm>
-#include <cctype>
-#include <sstream>
-#include <unordered_set>
+#include "tei_tags.hpp"
+#include "trace.hpp"
+#include "xml_scan.hpp"
 
-namespace {
-
-std::string local_name(const char* raw_name) {
-    if (raw_name == nullptr) {
-        return {};
-    }
-    std::string name(raw_name);
-    const auto pos = name.find(':');
-    if (pos == std::string::npos) {
-        return name;
-    }
-    return name.substr(pos + 1);
-}
-
-bool is_translatable_tag(const std::string& name) {
-    static const std::unordered_set<std::string> tags = {"p", "l", "ab", "head", "seg"};
-    return tags.contains(name);
-}
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string_view>
 
-bool should_skip_text_subtree(const std::string& name) {
-    static const std::unordered_set<std::string> skip_tags = {
-        "note", "pb", "lb", "cb", "fw", "ref", "anchor", "milestone"
-    };
-    return skip_tags.contains(name);
-}
-
-std::string normalize_whitespace(const std::string& input) {
-    std::string out;
-    out.reserve(input.size());
-    bool in_space = false;
-
-    for (unsigned char ch : input) {
-        if (std::isspace(ch)) {
-            if (!in_space) {
-                out.push_back(' ');
-                in_space = true;
-            }
-        } else {
-            out.push_back(static_cast<char>(ch));
-            in_space = false;
-        }
-    }
-
-    while (!out.empty() && out.front() == ' ') {
-        out.erase(out.begin());
-    }
-    while (!out.empty() && out.back() == ' ') {
-        out.pop_back();
-    }
+namespace {
 
-    return out;
+TeiTagClass classify_node(const pugi::xml_node& node) {
+    return classify_tei_tag(xml_local_name(node.name()));
 }
 
-void collect_text(const pugi::xml_node& node, std::string& out) {
+void collect_text(const pugi::xml_node& node, NormalizedTextBuilder& out) {
     if (node.type() == pugi::node_pcdata || node.type() == pugi::node_cdata) {
         out.append(node.value());
-        out.push_back(' ');
+        out.separator();
         return;
     }
 
@@ -69,8 +27,7 @@ void collect_text(const pugi::xml_node& node, std::string& out) {
         return;
     }
 
-    const auto name = local_name(node.name());
-    if (should_skip_text_subtree(name)) {
+    if (classify_node(node) == TeiTagClass::SkipText) {
         return;
     }
 
@@ -79,17 +36,18 @@ void collect_text(const pugi::xml_node& node, std::string& out) {
     }
 }
 
-std::string node_id_or_fallback(const pugi::xml_node& node, std::size_t index) {
+std::string_view node_id_or_fallback(const pugi::xml_node& node, std::size_t index, TextArena& arena) {
     if (const auto attr = node.attribute("xml:id")) {
-        return attr.value();
+        return arena.store(attr.value());
     }
     if (const auto attr = node.attribute("id")) {
-        return attr.value();
+        return arena.store(attr.value());
     }
 
-    std::ostringstream oss;
-    oss << "seg-" << index;
-    return oss.str();
+    char buf[32] = "seg-";
+    const auto [end, ec] = std::to_chars(buf + 4, buf + sizeof(buf), index);
+    (void)ec;
+    return arena.store(std::string_view(buf, static_cast<std::size_t>(end - buf)));
 }
 
 void collect_segments(
@@ -102,9 +60,9 @@ void collect_segments(
         return;
     }
 
-    const auto name = local_name(node.name());
-    const bool now_in_header = in_header || name == "teiHeader";
-    const bool now_in_body = in_body || name == "body";
+    const TeiTagClass tag = classify_node(node);
+    const bool now_in_header = in_header || tag == TeiTagClass::Header;
+    const bool now_in_body = in_body || tag == TeiTagClass::Body;
 
     if (now_in_header) {
         for (const auto& child : node.children()) {
@@ -113,18 +71,18 @@ void collect_segments(
         return;
     }
 
-    if (now_in_body && is_translatable_tag(name)) {
-        std::string raw_text;
-        collect_text(node, raw_text);
-        const std::string normalized = normalize_whitespace(raw_text);
+    if (now_in_body && tag == TeiTagClass::Translatable) {
+        NormalizedTextBuilder text(out_doc.text);
+        collect_text(node, text);
+        const std::string_view normalized = text.finish();
 
         if (!normalized.empty()) {
             Segment segment;
             segment.index = out_doc.segments.size();
-            segment.id = node_id_or_fallback(node, segment.index);
             segment.source_zh = normalized;
+            segment.id = node_id_or_fallback(node, segment.index, out_doc.text);
 
-            out_doc.segments.push_back(std::move(segment));
+            out_doc.segments.push_back(segment);
             out_doc.segment_nodes.push_back(node);
         }
 
@@ -137,13 +95,121 @@ void collect_segments(
     }
 }
 
+/// Next element after `node` in document order, staying below `root`.
+pugi::xml_node next_element_in_order(pugi::xml_node node, const pugi::xml_node& root) {
+    for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling()) {
+        if (child.type() == pugi::node_element) {
+            return child;
+        }
+    }
+    while (node && node != root) {
+        for (pugi::xml_node sib = node.next_sibling(); sib; sib = sib.next_sibling()) {
+            if (sib.type() == pugi::node_element) {
+                return sib;
+            }
+        }
+        node = node.parent();
+    }
+    return {};
+}
+
+bool span_has_name(std::string_view bytes, const XmlElementSpan& span, const char* name) {
+    const std::size_t len = std::strlen(name);
+    if (span.open_begin + 2 + len > span.open_end || bytes.substr(span.open_begin + 1, len) != name) {
+        return false;
+    }
+    const char after = bytes[span.open_begin + 1 + len];
+    return after == '>' || after == '/' || after == ' ' || after == '\t' || after == '\n' || after == '\r';
+}
+
 }  // namespace
 
+bool record_tei_note_sites(TeiDocument& doc, std::string& error) {
+    doc.note_sites.clear();
+
+    std::vector<XmlElementSpan> spans;
+    if (!collect_xml_element_spans(doc.bytes, spans, error)) {
+        return false;
+    }
+
+    // Elements are numbered in document order by both pugixml and the byte scan, so a segment's ordinal
+    // among all elements indexes its span.
+    const auto root = doc.xml.document_element();
+    std::vector<TeiNoteSite> sites;
+    sites.reserve(doc.segment_nodes.size());
+    std::size_t ordinal = 0;
+    for (pugi::xml_node node = root; node && sites.size() < doc.segment_nodes.size();
+         node = next_element_in_order(node, root), ++ordinal) {
+        if (ordinal >= spans.size() || !span_has_name(doc.bytes, spans[ordinal], node.name())) {
+            error = "XML byte scan does not match parsed tree at element <" + std::string(node.name()) + ">";
+            return false;
+        }
+        if (node != doc.segment_nodes[sites.size()]) {
+            continue;
+        }
+
+        TeiNoteSite site;
+        site.insert_at = spans[ordinal].close_end;
+        site.note_name = prefixed_note_name(node.name());
+        if (scan_following_translation_notes(doc.bytes, true, site) != TeiNoteScan::Done) {
+            error = "Malformed XML markup after segment <" + std::string(node.name()) + ">";
+            return false;
+        }
+        sites.push_back(std::move(site));
+    }
+
+    if (sites.size() != doc.segment_nodes.size()) {
+        error = "Not every segment was found by the XML byte scan";
+        return false;
+    }
+    doc.note_sites = std::move(sites);
+    return true;
+}
+
+void collect_tei_segments(TeiDocument& doc) {
+    doc.segments.clear();
+    doc.segment_nodes.clear();
+    doc.text.clear();
+    doc.note_sites.clear();
+
+    const auto root = doc.xml.document_element();
+    if (root) {
+        collect_segments(root, false, false, doc);
+    }
+}
+
+bool read_tei_bytes(const std::filesystem::path& path, std::string& out) {
+    TEI_MT_TRACE_SCOPE("read_tei_bytes");
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    const auto size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (size < 0) {
+        return false;
+    }
+    out.resize(static_cast<std::size_t>(size));
+    in.read(out.data(), size);
+    return static_cast<bool>(in);
+}
+
 bool read_tei_file(const std::filesystem::path& path, TeiDocument& out_doc, std::string& error) {
+    TEI_MT_TRACE_SCOPE("read_tei_file");
     out_doc = TeiDocument{};
     out_doc.source_path = path;
 
-    pugi::xml_parse_result parse = out_doc.xml.load_file(path.c_str(), pugi::parse_default | pugi::parse_ws_pcdata);
+    if (!read_tei_bytes(path, out_doc.bytes)) {
+        error = "Failed to read XML " + path.string();
+        return false;
+    }
+
+    pugi::xml_parse_result parse = out_doc.xml.load_buffer(
+        out_doc.bytes.data(),
+        out_doc.bytes.size(),
+        pugi::parse_default | pugi::parse_ws_pcdata
+    );
     if (!parse) {
         error = "Failed to parse XML " + path.string() + ": " + parse.description();
         return false;
@@ -155,12 +221,18 @@ bool read_tei_file(const std::filesystem::path& path, TeiDocument& out_doc, std:
         return false;
     }
 
-    collect_segments(root, false, false, out_doc);
+    collect_tei_segments(out_doc);
 
     if (out_doc.segments.empty()) {
         error = "No translatable segments found in " + path.string();
         return false;
     }
 
+    std::string site_error;
+    if (!record_tei_note_sites(out_doc, site_error)) {
+        // Not fatal: the writer serializes the DOM instead.
+        out_doc.note_sites.clear();
+    }
+
     return true;
 }
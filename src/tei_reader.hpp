@@ -1,6 +1,8 @@
 #pragma once
 
 #include "segment.hpp"
+#include "tei_splice.hpp"
+#include "text_arena.hpp"
 
 #include <filesystem>
 #include <string>
@@ -10,9 +12,26 @@
 
 struct TeiDocument {
     std::filesystem::path source_path;
+    /// Original file bytes; the TEI writer splices notes into these instead of re-serializing `xml`.
+    std::string bytes;
     pugi::xml_document xml;
+    /// Normalized segment text and ids; `segments` hold views into it.
+    TextArena text;
     std::vector<Segment> segments;
     std::vector<pugi::xml_node> segment_nodes;
+    /// Byte offsets for each segment's note, parallel to `segments`; empty when `bytes` could not be mapped
+    /// onto the parsed tree (the writer then falls back to serializing the DOM).
+    std::vector<TeiNoteSite> note_sites;
 };
 
+/// Read a file's raw bytes (what read_tei_file keeps in `TeiDocument::bytes`).
+bool read_tei_bytes(const std::filesystem::path& path, std::string& out);
+
 bool read_tei_file(const std::filesystem::path& path, TeiDocument& out_doc, std::string& error);
+
+/// Extract segments from an already loaded `doc.xml` (clears previous segments and text).
+void collect_tei_segments(TeiDocument& doc);
+
+/// Fill `doc.note_sites` from `doc.bytes` for the extracted segments. Returns false (with `note_sites` empty)
+/// if the byte scan and the parsed tree disagree.
+bool record_tei_note_sites(TeiDocument& doc, std::string& error);
@@ -0,0 +1,206 @@
+#include "tei_splice.hpp"
+
+#include "xml_scan.hpp"
+
+namespace {
+
+bool attribute_equals(std::string_view tag_bytes, std::string_view name, std::string_view expected) {
+    bool found = false;
+    const auto value = xml_tag_attribute(tag_bytes, name, found);
+    return found && value == expected;
+}
+
+/// Calls `emit` with the output pieces in order: unchanged source ranges and serialized notes.
+template <typename Emit>
+void splice_notes(
+    std::string_view bytes,
+    const std::vector<TeiNoteSite>& sites,
+    const std::vector<std::string>& translations,
+    bool overwrite_existing_translations,
+    std::string& note_scratch,
+    Emit&& emit
+) {
+    std::size_t cursor = 0;
+    const auto copy_until = [&](std::size_t pos) {
+        if (pos > cursor) {
+            emit(bytes.substr(cursor, pos - cursor));
+            cursor = pos;
+        }
+    };
+
+    for (std::size_t i = 0; i < sites.size() && i < translations.size(); ++i) {
+        const auto& site = sites[i];
+        if (!site.existing_notes.empty() && !overwrite_existing_translations) {
+            continue;
+        }
+
+        copy_until(site.insert_at);
+        note_scratch.clear();
+        note_scratch += '<';
+        note_scratch += site.note_name;
+        note_scratch += " type=\"translation\" xml:lang=\"en\">";
+        append_xml_escaped(translations[i], note_scratch);
+        note_scratch += "</";
+        note_scratch += site.note_name;
+        note_scratch += '>';
+        emit(std::string_view(note_scratch));
+
+        for (const auto& [begin, end] : site.existing_notes) {
+            copy_until(begin);
+            cursor = end;
+        }
+    }
+
+    copy_until(bytes.size());
+}
+
+}  // namespace
+
+bool is_translation_note_tag(std::string_view tag_bytes, std::string_view qname) {
+    return xml_local_name(qname) == "note"
+        && attribute_equals(tag_bytes, "type", "translation")
+        && attribute_equals(tag_bytes, "xml:lang", "en");
+}
+
+TeiNoteScan scan_following_translation_notes(std::string_view buf, bool at_eof, TeiNoteSite& site) {
+    site.existing_notes.clear();
+    std::size_t after = site.insert_at;
+    XmlMarkup markup;
+    for (;;) {
+        const XmlScanStatus status = next_xml_markup(buf, after, markup);
+        if (status == XmlScanStatus::Error) {
+            return TeiNoteScan::Error;
+        }
+        if (status == XmlScanStatus::NeedMore || (status == XmlScanStatus::End && !at_eof)) {
+            return at_eof ? TeiNoteScan::Error : TeiNoteScan::NeedMore;
+        }
+        if (status == XmlScanStatus::End) {
+            return TeiNoteScan::Done;
+        }
+        if (markup.kind == XmlMarkupKind::CData || markup.kind == XmlMarkupKind::Other) {
+            after = markup.end;
+            continue;
+        }
+
+        const std::string_view tag = buf.substr(markup.begin, markup.end - markup.begin);
+        if ((markup.kind != XmlMarkupKind::StartTag && markup.kind != XmlMarkupKind::EmptyTag)
+            || !is_translation_note_tag(tag, markup.name)) {
+            return TeiNoteScan::Done;
+        }
+
+        std::size_t note_end = markup.end;
+        if (markup.kind == XmlMarkupKind::StartTag) {
+            bool malformed = false;
+            note_end = xml_element_end(buf, markup.end, malformed);
+            if (note_end == std::string_view::npos) {
+                return malformed || at_eof ? TeiNoteScan::Error : TeiNoteScan::NeedMore;
+            }
+        }
+        site.existing_notes.emplace_back(markup.begin, note_end);
+        after = note_end;
+    }
+}
+
+std::string existing_translation_text(std::string_view bytes, const TeiNoteSite& site) {
+    std::string text;
+    if (site.existing_notes.empty()) {
+        return text;
+    }
+    const auto [begin, end] = site.existing_notes.front();
+    const std::string_view note = bytes.substr(begin, end - begin);
+    std::size_t pos = 0;
+    XmlMarkup markup;
+    while (next_xml_markup(note, pos, markup) == XmlScanStatus::Found) {
+        if (markup.begin > pos) {
+            append_xml_unescaped(note.substr(pos, markup.begin - pos), text);
+        }
+        if (markup.kind == XmlMarkupKind::CData) {
+            text.append(note.substr(markup.begin + 9, markup.end - markup.begin - 12));
+        }
+        pos = markup.end;
+    }
+    return text;
+}
+
+std::string prefixed_note_name(std::string_view segment_qname) {
+    const auto colon = segment_qname.find(':');
+    if (colon == std::string_view::npos) {
+        return "note";
+    }
+    return std::string(segment_qname.substr(0, colon)) + ":note";
+}
+
+void append_spliced_notes(
+    std::string_view bytes,
+    const std::vector<TeiNoteSite>& sites,
+    const std::vector<std::string>& translations,
+    bool overwrite_existing_translations,
+    std::string& out
+) {
+    std::string note;
+    splice_notes(bytes, sites, translations, overwrite_existing_translations, note, [&](std::string_view piece) {
+        out.append(piece);
+    });
+}
+
+TeiSpliceOutput::~TeiSpliceOutput() {
+    abandon();
+}
+
+bool TeiSpliceOutput::open(const std::filesystem::path& out_path, std::string& error) {
+    out_path_ = out_path;
+    tmp_path_ = out_path.string() + ".part";
+    out_.open(tmp_path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        error = "Failed to open TEI output: " + tmp_path_.string();
+        return false;
+    }
+    return true;
+}
+
+bool TeiSpliceOutput::write(
+    std::string_view bytes,
+    const std::vector<TeiNoteSite>& sites,
+    const std::vector<std::string>& translations,
+    bool overwrite_existing_translations,
+    std::string& error
+) {
+    splice_notes(bytes, sites, translations, overwrite_existing_translations, scratch_, [&](std::string_view piece) {
+        out_.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+    });
+    if (!out_) {
+        error = "Failed to write translated TEI XML: " + tmp_path_.string();
+        return false;
+    }
+    return true;
+}
+
+bool TeiSpliceOutput::commit(std::string& error) {
+    out_.close();
+    if (!out_) {
+        error = "Failed to write translated TEI XML: " + tmp_path_.string();
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(out_path_, ec);
+    ec.clear();
+    std::filesystem::rename(tmp_path_, out_path_, ec);
+    if (ec) {
+        error = "Failed to finalize TEI output (rename): " + out_path_.string() + " (" + ec.message() + ")";
+        return false;
+    }
+    tmp_path_.clear();
+    return true;
+}
+
+void TeiSpliceOutput::abandon() {
+    if (out_.is_open()) {
+        out_.close();
+    }
+    if (!tmp_path_.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(tmp_path_, ec);
+        tmp_path_.clear();
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Where a translation note goes for one segment, in byte offsets of the source bytes being spliced.
+struct TeiNoteSite {
+    /// Just past the segment's end tag.
+    std::size_t insert_at = 0;
+    /// `note` carrying the segment element's namespace prefix, if any.
+    std::string note_name = "note";
+    /// `[begin, end)` of existing `<note type="translation" xml:lang="en">` siblings directly after the segment.
+    std::vector<std::pair<std::size_t, std::size_t>> existing_notes;
+};
+
+/// True for the start tag of `<note type="translation" xml:lang="en">` (any namespace prefix).
+bool is_translation_note_tag(std::string_view tag_bytes, std::string_view qname);
+
+enum class TeiNoteScan {
+    Done,
+    /// `buf` ends before the scan could finish; only returned when `at_eof` is false.
+    NeedMore,
+    Error,
+};
+
+/// Record in `site.existing_notes` the translation notes directly after `site.insert_at`. Text, CDATA and
+/// comments in between are skipped, matching the sibling check of the DOM writer.
+TeiNoteScan scan_following_translation_notes(std::string_view buf, bool at_eof, TeiNoteSite& site);
+
+/// Text of the first note in `site.existing_notes` (unescaped; markup inside it is dropped), or empty.
+std::string existing_translation_text(std::string_view bytes, const TeiNoteSite& site);
+
+/// Note element name matching the prefix of a segment's qualified name (`cb:p` -> `cb:note`).
+std::string prefixed_note_name(std::string_view segment_qname);
+
+/// Append `bytes` to `out` with one translation note per site spliced in; all other bytes are copied unchanged.
+void append_spliced_notes(
+    std::string_view bytes,
+    const std::vector<TeiNoteSite>& sites,
+    const std::vector<std::string>& translations,
+    bool overwrite_existing_translations,
+    std::string& out
+);
+
+/// Streams spliced output to `<out_path>.part` and renames it into place on commit.
+class TeiSpliceOutput {
+public:
+    ~TeiSpliceOutput();
+
+    bool open(const std::filesystem::path& out_path, std::string& error);
+    bool write(
+        std::string_view bytes,
+        const std::vector<TeiNoteSite>& sites,
+        const std::vector<std::string>& translations,
+        bool overwrite_existing_translations,
+        std::string& error
+    );
+    bool commit(std::string& error);
+    void abandon();
+
+private:
+    std::filesystem::path out_path_;
+    std::filesystem::path tmp_path_;
+    std::ofstream out_;
+    std::string scratch_;
+};
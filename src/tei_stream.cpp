@@ -0,0 +1,367 @@
+#include "tei_stream.hpp"
+
+#include "tei_tags.hpp"
+
+#include <charconv>
+#include <string_view>
+
+namespace {
+
+constexpr std::size_t kReadChunk = std::size_t{1} << 20;
+
+bool attribute_equals(std::string_view tag_bytes, std::string_view name, std::string_view expected) {
+    bool found = false;
+    const auto value = xml_tag_attribute(tag_bytes, name, found);
+    return found && value == expected;
+}
+
+/// Same text as collect_text() on the parsed element: every text node plus a separator, skip subtrees excluded.
+void collect_segment_text(std::string_view element, NormalizedTextBuilder& out, std::string& unescape_scratch) {
+    std::size_t pos = 0;
+    std::size_t skip_depth = 0;
+    XmlMarkup markup;
+
+    const auto append_text = [&](std::string_view raw) {
+        if (raw.find('&') == std::string_view::npos) {
+            out.append(raw);
+            return;
+        }
+        unescape_scratch.clear();
+        append_xml_unescaped(raw, unescape_scratch);
+        out.append(unescape_scratch);
+    };
+
+    for (;;) {
+        const XmlScanStatus status = next_xml_markup(element, pos, markup);
+        const std::size_t text_end = status == XmlScanStatus::Found ? markup.begin : element.size();
+        if (text_end > pos && skip_depth == 0) {
+            append_text(element.substr(pos, text_end - pos));
+            out.separator();
+        }
+        if (status != XmlScanStatus::Found) {
+            return;
+        }
+
+        switch (markup.kind) {
+            case XmlMarkupKind::StartTag:
+                if (skip_depth > 0 || classify_tei_tag(xml_local_name(markup.name)) == TeiTagClass::SkipText) {
+                    ++skip_depth;
+                }
+                break;
+            case XmlMarkupKind::EndTag:
+                if (skip_depth > 0) {
+                    --skip_depth;
+                }
+                break;
+            case XmlMarkupKind::CData:
+                if (skip_depth == 0) {
+                    out.append(element.substr(markup.begin + 9, markup.end - markup.begin - 12));
+                    out.separator();
+                }
+                break;
+            case XmlMarkupKind::EmptyTag:
+            case XmlMarkupKind::Other:
+                break;
+        }
+        pos = markup.end;
+    }
+}
+
+std::string_view segment_id_or_fallback(std::string_view start_tag, std::size_t index, TextArena& arena) {
+    for (const std::string_view attr : {std::string_view("xml:id"), std::string_view("id")}) {
+        bool found = false;
+        const auto value = xml_tag_attribute(start_tag, attr, found);
+        if (found) {
+            std::string id;
+            append_xml_unescaped(value, id);
+            return arena.store(id);
+        }
+    }
+
+    char buf[32] = "seg-";
+    const auto [end, ec] = std::to_chars(buf + 4, buf + sizeof(buf), index);
+    (void)ec;
+    return arena.store(std::string_view(buf, static_cast<std::size_t>(end - buf)));
+}
+
+bool read_chunk(std::ifstream& in, std::string& buf, bool& eof, const std::filesystem::path& path, std::string& error) {
+    const std::size_t old_size = buf.size();
+    buf.resize(old_size + kReadChunk);
+    in.read(buf.data() + old_size, static_cast<std::streamsize>(kReadChunk));
+    const auto got = static_cast<std::size_t>(in.gcount());
+    buf.resize(old_size + got);
+    if (in.bad()) {
+        error = "Failed to read XML " + path.string();
+        return false;
+    }
+    if (got == 0 || in.eof()) {
+        eof = true;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool parse_tei_window_unit(const std::string& value, TeiWindowUnit& out) {
+    if (value == "div") {
+        out = TeiWindowUnit::Div;
+        return true;
+    }
+    if (value == "juan") {
+        out = TeiWindowUnit::Juan;
+        return true;
+    }
+    return false;
+}
+
+TeiWindowReader::TeiWindowReader(TeiStreamOptions options) : options_(options) {}
+
+bool TeiWindowReader::open(const std::filesystem::path& path, std::string& error) {
+    *this = TeiWindowReader(options_);
+    path_ = path;
+    in_.open(path, std::ios::binary);
+    if (!in_) {
+        error = "Failed to open XML " + path.string();
+        return false;
+    }
+    return true;
+}
+
+bool TeiWindowReader::fill(std::string& error) {
+    return read_chunk(in_, buf_, eof_, path_, error);
+}
+
+bool TeiWindowReader::is_window_trigger(const XmlMarkup& markup) const {
+    if (body_depth_ == 0 || header_depth_ != 0) {
+        return false;
+    }
+    if (markup.kind != XmlMarkupKind::StartTag && markup.kind != XmlMarkupKind::EmptyTag) {
+        return false;
+    }
+
+    const auto local = xml_local_name(markup.name);
+    const std::string_view tag(buf_.data() + markup.begin, markup.end - markup.begin);
+    switch (options_.unit) {
+        case TeiWindowUnit::Div:
+            return local == "div" && open_.size() == body_depth_;
+        case TeiWindowUnit::Juan:
+            return (local == "milestone" && attribute_equals(tag, "unit", "juan"))
+                || (local == "juan" && attribute_equals(tag, "fun", "open"));
+    }
+    return false;
+}
+
+TeiWindowReader::SegmentScan TeiWindowReader::take_segment(
+    const XmlMarkup& start,
+    TeiWindow& out,
+    std::size_t& resume_at,
+    std::string& error
+) {
+    const std::string_view buf(buf_);
+    bool malformed = false;
+    const std::size_t seg_end = xml_element_end(buf, start.end, malformed);
+    if (malformed) {
+        error = "Malformed XML markup inside segment in " + path_.string();
+        return SegmentScan::Error;
+    }
+    if (seg_end == std::string_view::npos) {
+        return SegmentScan::NeedMore;
+    }
+
+    // Existing translation notes directly after the segment (text/CDATA/comments in between are skipped,
+    // matching the DOM writer's sibling check) must stay in this window so they can be kept or replaced.
+    TeiNoteSite site;
+    site.insert_at = seg_end;
+    site.note_name = prefixed_note_name(start.name);
+    switch (scan_following_translation_notes(buf, eof_, site)) {
+        case TeiNoteScan::Done:
+            break;
+        case TeiNoteScan::NeedMore:
+            return SegmentScan::NeedMore;
+        case TeiNoteScan::Error:
+            error = "Malformed XML markup after segment in " + path_.string();
+            return SegmentScan::Error;
+    }
+
+    NormalizedTextBuilder text(out.text);
+    collect_segment_text(buf.substr(start.begin, seg_end - start.begin), text, unescape_scratch_);
+    const std::string_view normalized = text.finish();
+
+    resume_at = seg_end;
+    if (normalized.empty()) {
+        return SegmentScan::Done;
+    }
+
+    Segment segment;
+    segment.index = segments_seen_++;
+    segment.id = segment_id_or_fallback(buf.substr(start.begin, start.end - start.begin), segment.index, out.text);
+    segment.source_zh = normalized;
+    if (!site.existing_notes.empty()) {
+        resume_at = site.existing_notes.back().second;
+    }
+    out.segments.push_back(segment);
+    out.note_sites.push_back(std::move(site));
+    return SegmentScan::Done;
+}
+
+bool TeiWindowReader::next(TeiWindow& out, std::string& error) {
+    out = TeiWindow{};
+    if (done_) {
+        return false;
+    }
+    out.ordinal = windows_emitted_;
+
+    XmlMarkup markup;
+    for (;;) {
+        const XmlScanStatus status = next_xml_markup(buf_, scan_, markup);
+        if (status == XmlScanStatus::Error) {
+            error = "Malformed XML markup in " + path_.string();
+            return false;
+        }
+        if (status != XmlScanStatus::Found) {
+            if (!eof_) {
+                if (!fill(error)) {
+                    return false;
+                }
+                continue;
+            }
+            if (status == XmlScanStatus::NeedMore) {
+                error = "Truncated XML markup in " + path_.string();
+                return false;
+            }
+            if (!open_.empty()) {
+                error = "Unclosed element <" + open_.back() + "> in " + path_.string();
+                return false;
+            }
+            done_ = true;
+            out.bytes = std::move(buf_);
+            buf_.clear();
+            scan_ = 0;
+            if (out.bytes.empty() && out.segments.empty()) {
+                return false;
+            }
+            ++windows_emitted_;
+            return true;
+        }
+
+        const bool over_budget = markup.begin >= options_.max_window_bytes;
+        if (markup.begin > 0 && (over_budget || (!out.segments.empty() && is_window_trigger(markup)))) {
+            out.bytes.assign(buf_, 0, markup.begin);
+            buf_.erase(0, markup.begin);
+            scan_ = 0;
+            ++windows_emitted_;
+            return true;
+        }
+
+        if (markup.kind == XmlMarkupKind::StartTag) {
+            const auto local = xml_local_name(markup.name);
+            const TeiTagClass tag = classify_tei_tag(local);
+            if (body_depth_ > 0 && header_depth_ == 0 && tag == TeiTagClass::Translatable) {
+                std::size_t resume_at = 0;
+                const SegmentScan taken = take_segment(markup, out, resume_at, error);
+                if (taken == SegmentScan::Error) {
+                    return false;
+                }
+                if (taken == SegmentScan::NeedMore) {
+                    if (eof_) {
+                        error = "Truncated segment element in " + path_.string();
+                        return false;
+                    }
+                    if (!fill(error)) {
+                        return false;
+                    }
+                    continue;
+                }
+                scan_ = resume_at;
+                continue;
+            }
+
+            open_.emplace_back(local);
+            if (tag == TeiTagClass::Header && header_depth_ == 0) {
+                header_depth_ = open_.size();
+            } else if (tag == TeiTagClass::Body && header_depth_ == 0 && body_depth_ == 0) {
+                body_depth_ = open_.size();
+            }
+        } else if (markup.kind == XmlMarkupKind::EndTag) {
+            if (open_.empty() || open_.back() != xml_local_name(markup.name)) {
+                error = "Mismatched end tag </" + std::string(markup.name) + "> in " + path_.string();
+                return false;
+            }
+            if (open_.size() == header_depth_) {
+                header_depth_ = 0;
+            }
+            if (open_.size() == body_depth_) {
+                body_depth_ = 0;
+            }
+            open_.pop_back();
+        }
+        scan_ = markup.end;
+    }
+}
+
+bool count_tei_segments_streaming(
+    const std::filesystem::path& path,
+    const TeiStreamOptions& options,
+    std::size_t& out_count,
+    std::string& error
+) {
+    out_count = 0;
+    TeiWindowReader reader(options);
+    if (!reader.open(path, error)) {
+        return false;
+    }
+
+    TeiWindow window;
+    while (reader.next(window, error)) {
+    }
+    if (!error.empty()) {
+        return false;
+    }
+    out_count = reader.segments_seen();
+    return true;
+}
+
+bool count_translation_notes_streaming(const std::filesystem::path& path, std::size_t& out_count, std::string& error) {
+    out_count = 0;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "Failed to open existing output XML " + path.string();
+        return false;
+    }
+
+    std::string buf;
+    std::size_t pos = 0;
+    bool eof = false;
+    XmlMarkup markup;
+    for (;;) {
+        const XmlScanStatus status = next_xml_markup(buf, pos, markup);
+        if (status == XmlScanStatus::Error) {
+            error = "Malformed XML markup in existing output " + path.string();
+            return false;
+        }
+        if (status == XmlScanStatus::Found) {
+            if (markup.kind == XmlMarkupKind::StartTag || markup.kind == XmlMarkupKind::EmptyTag) {
+                const std::string_view tag(buf.data() + markup.begin, markup.end - markup.begin);
+                if (is_translation_note_tag(tag, markup.name)) {
+                    ++out_count;
+                }
+            }
+            pos = markup.end;
+            continue;
+        }
+        if (eof) {
+            if (status == XmlScanStatus::NeedMore) {
+                error = "Truncated existing output XML " + path.string();
+                return false;
+            }
+            return true;
+        }
+
+        const std::size_t keep_from = status == XmlScanStatus::NeedMore ? markup.begin : buf.size();
+        buf.erase(0, keep_from);
+        pos = 0;
+        if (!read_chunk(in, buf, eof, path, error)) {
+            return false;
+        }
+    }
+}
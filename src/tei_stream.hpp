@@ -0,0 +1,86 @@
+#pragma once
+
+#include "segment.hpp"
+#include "tei_splice.hpp"
+#include "text_arena.hpp"
+#include "xml_scan.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class TeiWindowUnit {
+    Div,
+    Juan,
+};
+
+bool parse_tei_window_unit(const std::string& value, TeiWindowUnit& out);
+
+struct TeiStreamOptions {
+    TeiWindowUnit unit = TeiWindowUnit::Div;
+    /// Soft cap: a window that reaches this size closes at the next byte outside a segment.
+    std::size_t max_window_bytes = std::size_t{4} << 20;
+};
+
+/// A contiguous slice of the source file. Every source byte lands in exactly one window, so writing the
+/// windows back in order (with notes spliced in) reproduces the document byte for byte.
+struct TeiWindow {
+    std::size_t ordinal = 0;
+    std::string bytes;
+    /// Normalized text and ids of this window's segments.
+    TextArena text;
+    /// Segment indices and fallback ids are document-global; vector positions are window-local.
+    std::vector<Segment> segments;
+    std::vector<TeiNoteSite> note_sites;
+};
+
+/// Extracts segments straight from the raw bytes (no DOM), holding at most one window plus one read chunk.
+/// Text extraction matches read_tei_file: body-only, paragraph-level, note/lb/pb/... subtrees skipped.
+class TeiWindowReader {
+public:
+    explicit TeiWindowReader(TeiStreamOptions options = {});
+
+    bool open(const std::filesystem::path& path, std::string& error);
+    /// Fills `out` with the next window. Returns false at end of input; `error` is set on failure.
+    bool next(TeiWindow& out, std::string& error);
+
+    std::size_t segments_seen() const { return segments_seen_; }
+
+private:
+    enum class SegmentScan {
+        Done,
+        NeedMore,
+        Error,
+    };
+
+    bool fill(std::string& error);
+    bool is_window_trigger(const XmlMarkup& markup) const;
+    SegmentScan take_segment(const XmlMarkup& start, TeiWindow& out, std::size_t& resume_at, std::string& error);
+
+    TeiStreamOptions options_;
+    std::filesystem::path path_;
+    std::ifstream in_;
+    std::string buf_;
+    std::size_t scan_ = 0;
+    bool eof_ = false;
+    bool done_ = false;
+    std::vector<std::string> open_;
+    std::string unescape_scratch_;
+    std::size_t header_depth_ = 0;
+    std::size_t body_depth_ = 0;
+    std::size_t segments_seen_ = 0;
+    std::size_t windows_emitted_ = 0;
+};
+
+/// Segment count of a file as TeiWindowReader sees it, in bounded memory (used by the resume check).
+bool count_tei_segments_streaming(
+    const std::filesystem::path& path,
+    const TeiStreamOptions& options,
+    std::size_t& out_count,
+    std::string& error
+);
+
+/// Number of `<note type="translation" xml:lang="en">` elements, counted without building a DOM.
+bool count_translation_notes_streaming(const std::filesystem::path& path, std::size_t& out_count, std::string& error);
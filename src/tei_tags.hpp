@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/// Role of a TEI element (by local name) during segment extraction. Resolved with a switch on the name length
+/// and first byte, so hot-path lookups neither allocate nor hash.
+enum class TeiTagClass : std::uint8_t {
+    Other,
+    /// p, l, ab, head, seg: paragraph-level segments.
+    Translatable,
+    /// note, pb, lb, cb, fw, ref, anchor, milestone: text below these is not part of the segment.
+    SkipText,
+    Header,
+    Body,
+};
+
+constexpr TeiTagClass classify_tei_tag(std::string_view local) {
+    switch (local.size()) {
+        case 1:
+            return local[0] == 'p' || local[0] == 'l' ? TeiTagClass::Translatable : TeiTagClass::Other;
+        case 2:
+            if (local == "ab") {
+                return TeiTagClass::Translatable;
+            }
+            if (local == "pb" || local == "lb" || local == "cb" || local == "fw") {
+                return TeiTagClass::SkipText;
+            }
+            return TeiTagClass::Other;
+        case 3:
+            if (local == "seg") {
+                return TeiTagClass::Translatable;
+            }
+            return local == "ref" ? TeiTagClass::SkipText : TeiTagClass::Other;
+        case 4:
+            if (local == "head") {
+                return TeiTagClass::Translatable;
+            }
+            if (local == "note") {
+                return TeiTagClass::SkipText;
+            }
+            return local == "body" ? TeiTagClass::Body : TeiTagClass::Other;
+        case 6:
+            return local == "anchor" ? TeiTagClass::SkipText : TeiTagClass::Other;
+        case 9:
+            if (local == "milestone") {
+                return TeiTagClass::SkipText;
+            }
+            return local == "teiHeader" ? TeiTagClass::Header : TeiTagClass::Other;
+        default:
+            return TeiTagClass::Other;
+    }
+}
+
+static_assert(classify_tei_tag("p") == TeiTagClass::Translatable);
+static_assert(classify_tei_tag("seg") == TeiTagClass::Translatable);
+static_assert(classify_tei_tag("lb") == TeiTagClass::SkipText);
+static_assert(classify_tei_tag("milestone") == TeiTagClass::SkipText);
+static_assert(classify_tei_tag("teiHeader") == TeiTagClass::Header);
+static_assert(classify_tei_tag("body") == TeiTagClass::Body);
+static_assert(classify_tei_tag("div") == TeiTagClass::Other);
+static_assert(classify_tei_tag("lg") == TeiTagClass::Other);
@@ -0,0 +1,102 @@
+#include "text_arena.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+TextArena::TextArena(std::size_t block_size) : block_size_(std::max<std::size_t>(block_size, 256)) {}
+
+void TextArena::begin() {
+    start_ = used_;
+}
+
+void TextArena::reserve_tail(std::size_t extra) {
+    if (used_ + extra <= capacity_) {
+        return;
+    }
+
+    const std::size_t in_progress = used_ - start_;
+    const std::size_t capacity = std::max(block_size_, in_progress + extra);
+    auto block = std::make_unique<char[]>(capacity);
+    if (in_progress > 0) {
+        std::memcpy(block.get(), block_ + start_, in_progress);
+    }
+
+    block_ = block.get();
+    if (blocks_.empty()) {
+        first_capacity_ = capacity;
+    }
+    blocks_.push_back(std::move(block));
+    capacity_ = capacity;
+    start_ = 0;
+    used_ = in_progress;
+    bytes_reserved_ += capacity;
+}
+
+char* TextArena::reserve(std::size_t extra) {
+    reserve_tail(extra);
+    return block_ + used_;
+}
+
+void TextArena::append(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+    std::memcpy(reserve(text.size()), text.data(), text.size());
+    used_ += text.size();
+}
+
+void TextArena::push_back(char c) {
+    *reserve(1) = c;
+    ++used_;
+}
+
+std::string_view TextArena::finish() {
+    const std::string_view out(block_ == nullptr ? "" : block_ + start_, used_ - start_);
+    start_ = used_;
+    return out;
+}
+
+std::string_view TextArena::store(std::string_view text) {
+    begin();
+    append(text);
+    return finish();
+}
+
+void TextArena::clear() {
+    // Keep the first block so re-filling an arena of typical size does not allocate.
+    if (blocks_.size() > 1) {
+        blocks_.resize(1);
+    }
+    block_ = blocks_.empty() ? nullptr : blocks_.front().get();
+    capacity_ = blocks_.empty() ? 0 : first_capacity_;
+    used_ = 0;
+    start_ = 0;
+    bytes_reserved_ = capacity_;
+}
+
+void NormalizedTextBuilder::append(std::string_view text) {
+    // Worst case: one pending separator plus every input byte.
+    char* out = arena_.reserve(text.size() + 1);
+    std::size_t written = 0;
+    for (const char c : text) {
+        const auto ch = static_cast<unsigned char>(c);
+        if (std::isspace(ch)) {
+            pending_space_ = !at_start_;
+            continue;
+        }
+        if (pending_space_) {
+            out[written++] = ' ';
+            pending_space_ = false;
+        }
+        out[written++] = c;
+        at_start_ = false;
+    }
+    arena_.commit(written);
+}
+
+void NormalizedTextBuilder::append(const char* text) {
+    if (text != nullptr) {
+        append(std::string_view(text));
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/// Append-only block storage for a document's segment text. Views returned by finish()/store() stay valid
+/// until clear() or destruction, including across moves of the arena (blocks are never reallocated).
+/// clear() keeps the first block for reuse.
+class TextArena {
+public:
+    TextArena() : TextArena(64 * 1024) {}
+    explicit TextArena(std::size_t block_size);
+
+    /// Start a new string; append()/push_back() grow it until finish().
+    void begin();
+    void append(std::string_view text);
+    void push_back(char c);
+    std::string_view finish();
+    std::string_view store(std::string_view text);
+    /// Writable room for `extra` bytes at the end of the string in progress; commit() the bytes actually written.
+    char* reserve(std::size_t extra);
+    void commit(std::size_t written) { used_ += written; }
+
+    void clear();
+    std::size_t bytes_reserved() const { return bytes_reserved_; }
+
+private:
+    /// Ensure `extra` more bytes fit contiguously after the string in progress (moving it to a new block if needed).
+    void reserve_tail(std::size_t extra);
+
+    std::size_t block_size_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* block_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t first_capacity_ = 0;
+    std::size_t used_ = 0;
+    std::size_t start_ = 0;
+    std::size_t bytes_reserved_ = 0;
+};
+
+/// Appends text to a TextArena string with runs of whitespace collapsed to one space and the edges trimmed,
+/// i.e. the streaming equivalent of normalize_whitespace() over the concatenated input.
+class NormalizedTextBuilder {
+public:
+    explicit NormalizedTextBuilder(TextArena& arena) : arena_(arena) { arena_.begin(); }
+
+    void append(std::string_view text);
+    void append(const char* text);
+    /// Separator between text nodes (collapses like any other whitespace).
+    void separator() { pending_space_ = !at_start_; }
+    std::string_view finish() { return arena_.finish(); }
+
+private:
+    TextArena& arena_;
+    bool at_start_ = true;
+    bool pending_space_ = false;
+};
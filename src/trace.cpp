@@ -0,0 +1,150 @@
+#include "trace.hpp"
+
+#include "atomic_file.hpp"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+/// Events kept per thread track (24 bytes each); later spans are counted as dropped.
+constexpr std::size_t kMaxEventsPerThread = std::size_t{1} << 20;
+
+struct TraceEvent {
+    const char* name;
+    std::int64_t start_us;
+    std::int64_t dur_us;
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    /// Empty for unnamed threads. `name` and `in_use` are guarded by g_buffers_mutex.
+    std::string name;
+    bool in_use = true;
+    /// Uncontended except while trace_write() reads the buffer.
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    std::uint64_t dropped = 0;
+};
+
+std::atomic<std::int64_t> g_epoch_us{0};
+std::mutex g_buffers_mutex;
+std::deque<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+std::int64_t steady_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+ThreadBuffer& new_buffer_locked(std::string name) {
+    auto& buffer = *g_buffers.emplace_back(std::make_unique<ThreadBuffer>());
+    buffer.tid = static_cast<int>(g_buffers.size());
+    buffer.name = std::move(name);
+    return buffer;
+}
+
+/// The calling thread's track; released (for reuse by name) when the thread exits.
+struct ThreadSlot {
+    ThreadBuffer* buffer = nullptr;
+
+    ~ThreadSlot() {
+        if (buffer != nullptr) {
+            std::lock_guard<std::mutex> lock(g_buffers_mutex);
+            buffer->in_use = false;
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+}  // namespace
+
+namespace trace_detail {
+
+std::atomic<bool> g_enabled{false};
+
+std::int64_t now_us() {
+    return steady_us() - g_epoch_us.load(std::memory_order_relaxed);
+}
+
+void record(const char* name, std::int64_t start_us, std::int64_t end_us) {
+    if (t_slot.buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        t_slot.buffer = &new_buffer_locked({});
+    }
+    ThreadBuffer& buffer = *t_slot.buffer;
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() >= kMaxEventsPerThread) {
+        ++buffer.dropped;
+        return;
+    }
+    buffer.events.push_back(TraceEvent{name, start_us, end_us - start_us});
+}
+
+}  // namespace trace_detail
+
+void trace_start() {
+    g_epoch_us.store(steady_us(), std::memory_order_relaxed);
+    trace_detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void trace_thread_name(const std::string& name) {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    ThreadBuffer* current = t_slot.buffer;
+    if (current != nullptr && current->name == name) {
+        return;
+    }
+    for (const auto& buffer : g_buffers) {
+        if (!buffer->in_use && buffer->name == name) {
+            if (current != nullptr) {
+                current->in_use = false;
+            }
+            buffer->in_use = true;
+            t_slot.buffer = buffer.get();
+            return;
+        }
+    }
+    if (current != nullptr && current->name.empty()) {
+        current->name = name;
+        return;
+    }
+    if (current != nullptr) {
+        current->in_use = false;
+    }
+    t_slot.buffer = &new_buffer_locked(name);
+}
+
+bool trace_write(const std::filesystem::path& path, std::string& error) {
+    trace_detail::g_enabled.store(false, std::memory_order_relaxed);
+
+    std::uint64_t events = 0;
+    std::uint64_t dropped = 0;
+    std::ostringstream out;
+    {
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"tei_mt\"}}";
+
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        for (const auto& buffer : g_buffers) {
+            const std::string name = buffer->name.empty() ? "thread " + std::to_string(buffer->tid) : buffer->name;
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":" << nlohmann::json(name).dump() << "}}";
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            for (const auto& event : buffer->events) {
+                out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"ts\":" << event.start_us << ",\"dur\":" << event.dur_us << "}";
+            }
+            events += buffer->events.size();
+            dropped += buffer->dropped;
+        }
+        out << "\n],\"otherData\":{\"events\":" << events << ",\"dropped_events\":" << dropped << "}}\n";
+    }
+    return write_file_atomically(path, out.view(), error);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/// Chrome trace-event timeline (`--trace out.json`, open in Perfetto or chrome://tracing): one track per thread,
+/// one complete event per span. Spans are compiled in only with TEI_MT_TRACE (CMake HYMT_ENABLE_TRACE); when
+/// tracing is not started a span costs one relaxed load and a branch.
+
+namespace trace_detail {
+
+extern std::atomic<bool> g_enabled;
+
+std::int64_t now_us();
+/// Append a complete event to the calling thread's buffer. `name` must be a string literal.
+void record(const char* name, std::int64_t start_us, std::int64_t end_us);
+
+}  // namespace trace_detail
+
+inline bool trace_enabled() {
+    return trace_detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+/// Start recording; spans that began before this are not recorded.
+void trace_start();
+/// Stop recording and write every thread's events to `path` (atomically).
+bool trace_write(const std::filesystem::path& path, std::string& error);
+/// Name the calling thread's track. A later thread taking a name whose previous owner has exited continues that
+/// track, so per-file worker pools show up as one lane per worker.
+void trace_thread_name(const std::string& name);
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : name_(name), start_us_(trace_enabled() ? trace_detail::now_us() : -1) {}
+    ~TraceScope() {
+        if (start_us_ >= 0) {
+            trace_detail::record(name_, start_us_, trace_detail::now_us());
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    std::int64_t start_us_;
+};
+
+#define TEI_MT_TRACE_CONCAT_INNER(a, b) a##b
+#define TEI_MT_TRACE_CONCAT(a, b) TEI_MT_TRACE_CONCAT_INNER(a, b)
+
+#ifdef TEI_MT_TRACE
+/// Span from here to the end of the enclosing scope.
+#define TEI_MT_TRACE_SCOPE(name) const TraceScope TEI_MT_TRACE_CONCAT(tei_mt_trace_scope_, __LINE__)(name)
+#define TEI_MT_TRACE_THREAD(name)      \
+    do {                               \
+        if (trace_enabled()) {         \
+            trace_thread_name(name);   \
+        }                              \
+    } while (false)
+#else
+#define TEI_MT_TRACE_SCOPE(name) static_cast<void>(0)
+#define TEI_MT_TRACE_THREAD(name) static_cast<void>(0)
+#endif
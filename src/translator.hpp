@@ -2,8 +2,41 @@
 
 #include "segment.hpp"
 
+#include <cstdint>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
+
+/// What one translate() call did (all zero for translators that do not track it).
+struct TranslateCallInfo {
+    std::uint32_t source_tokens = 0;
+    /// Source plus prompt template.
+    std::uint32_t prompt_tokens = 0;
+    std::uint32_t output_tokens = 0;
+    double prefill_ms = 0.0;
+    double decode_ms = 0.0;
+    /// Context size the answer was generated in, and how often it had to grow first.
+    int n_ctx = 0;
+    int ctx_grows = 0;
+    /// Generation stopped at the token cap rather than end-of-generation.
+    bool cap_hit = false;
+    /// Generations aborted as repetition loops, and the token-cap budget they left unspent.
+    std::uint32_t repetition_loops = 0;
+    std::uint32_t tokens_saved = 0;
+};
+
+/// translate() aborted a merged batch whose answer fell into a repetition loop; callers retranslate its passages
+/// one by one. `output()` is what was generated up to the abort.
+class RepetitionLoopError : public std::runtime_error {
+public:
+    explicit RepetitionLoopError(std::string output)
+        : std::runtime_error("generation aborted: repetition loop"), output_(std::move(output)) {}
+    const std::string& output() const { return output_; }
+
+private:
+    std::string output_;
+};
 
 class Translator {
 public:
@@ -12,4 +45,6 @@ public:
     // Per-thread isolation point: each worker gets its own translator clone.
     virtual std::unique_ptr<Translator> clone() const = 0;
     virtual std::string translate(const Segment& segment) = 0;
+    /// The most recent translate() on this instance, including one that threw.
+    virtual TranslateCallInfo last_call() const { return {}; }
 };
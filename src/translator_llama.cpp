@@ -1,11 +1,20 @@
 #include "translator_llama.hpp"
 
+#include "cpu_topology.hpp"
+#include "fnv1a.hpp"
+#include "memory_plan.hpp"
+#include "metrics.hpp"
+#include "run_control.hpp"
 #include "segment_batch.hpp"
+#include "trace.hpp"
 
+#include <ggml-cpu.h>
 #include <llama.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <mutex>
@@ -31,6 +40,14 @@ void initialize_backend_once() {
     });
 }
 
+double seconds_since(std::chrono::steady_clock::time_point started) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+/// Sampler for regenerating a passage that looped: the last 64 generated tokens are penalized.
+constexpr int32_t kRepeatPenaltyLastN = 64;
+constexpr float kRepeatPenalty = 1.3f;
+
 std::string trim(std::string s) {
     auto is_ws = [](unsigned char c) { return std::isspace(c) != 0; };
 
@@ -54,6 +71,7 @@ struct LlamaTranslator::SharedModel {
         params.n_gpu_layers = config.n_gpu_layers;
         params.main_gpu = 0;
         params.use_mmap = true;
+        params.vocab_only = config.vocab_only;
 
         model = llama_model_load_from_file(config.model_path.c_str(), params);
         if (model == nullptr) {
@@ -74,8 +92,36 @@ struct LlamaTranslator::SharedModel {
         }
     }
 
+    /// Index of a free LlamaTranslatorConfig::worker_cpus set, or -1 when all are taken.
+    int acquire_cpu_slot(std::size_t slots) {
+        std::lock_guard lock(cpu_slot_mutex);
+        cpu_slot_used.resize(std::max(cpu_slot_used.size(), slots), false);
+        for (std::size_t i = 0; i < slots; ++i) {
+            if (!cpu_slot_used[i]) {
+                cpu_slot_used[i] = true;
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void release_cpu_slot(int slot) {
+        std::lock_guard lock(cpu_slot_mutex);
+        cpu_slot_used[static_cast<std::size_t>(slot)] = false;
+    }
+
     llama_model* model = nullptr;
     const llama_vocab* vocab = nullptr;
+
+    std::mutex cpu_slot_mutex;
+    std::vector<bool> cpu_slot_used;
+    /// Held by the one context currently prefilling on borrowed cores (try_lock; others use their decode cores).
+    std::mutex prefill_lease;
+
+    std::atomic<std::uint64_t> prompt_tokens{0};
+    std::atomic<std::uint64_t> generated_tokens{0};
+    std::atomic<std::uint64_t> repetition_loops{0};
+    std::atomic<std::uint64_t> repetition_tokens_saved{0};
 };
 
 LlamaTranslator::LlamaTranslator(LlamaTranslatorConfig config)
@@ -125,18 +171,34 @@ LlamaTranslator::LlamaTranslator(LlamaTranslatorConfig config, std::shared_ptr<S
 }
 
 void LlamaTranslator::release_context_resources() {
-    if (sampler_ != nullptr) {
-        llama_sampler_free(sampler_);
-        sampler_ = nullptr;
+    for (llama_sampler** sampler : {&sampler_, &penalty_sampler_}) {
+        if (*sampler != nullptr) {
+            llama_sampler_free(*sampler);
+            *sampler = nullptr;
+        }
     }
     if (ctx_ != nullptr) {
         llama_free(ctx_);
         ctx_ = nullptr;
+        tei_metrics().kv_cache_bytes.add(-kv_cache_bytes_);
+        kv_cache_bytes_ = 0.0;
+    }
+    if (batch_pool_ == decode_pool_) {
+        batch_pool_ = nullptr;  // shared with decode_pool_, freed below
+    }
+    for (ggml_threadpool** pool : {&decode_pool_, &batch_pool_, &wide_pool_}) {
+        if (*pool != nullptr) {
+            ggml_threadpool_free(*pool);
+            *pool = nullptr;
+        }
     }
 }
 
 LlamaTranslator::~LlamaTranslator() {
     release_context_resources();
+    if (cpu_slot_ >= 0) {
+        shared_model_->release_cpu_slot(cpu_slot_);
+    }
 }
 
 bool LlamaTranslator::bump_ctx_capacity(const std::size_t prompt_tokens, const int generation_need) {
@@ -160,6 +222,8 @@ bool LlamaTranslator::bump_ctx_capacity(const std::size_t prompt_tokens, const i
 
     release_context_resources();
     config_.n_ctx = next;
+    ++last_call_.ctx_grows;
+    tei_metrics().ctx_grows.add();
     return true;
 }
 
@@ -168,29 +232,84 @@ std::shared_ptr<LlamaTranslator::SharedModel> LlamaTranslator::load_shared_model
 }
 
 void LlamaTranslator::ensure_context_ready() {
-    if (ctx_ != nullptr && sampler_ != nullptr) {
+    if (ctx_ != nullptr && sampler_ != nullptr && penalty_sampler_ != nullptr) {
         return;
     }
+    TEI_MT_TRACE_SCOPE("context_init");
+    if (!is_kv_cache_type(config_.cache_type_k) || !is_kv_cache_type(config_.cache_type_v)) {
+        throw std::runtime_error("unknown KV cache type: " + config_.cache_type_k + "/" + config_.cache_type_v);
+    }
 
     const uint32_t n_ctx = static_cast<uint32_t>(std::max(512, config_.n_ctx));
-    const uint32_t n_batch = std::min<uint32_t>(512u, n_ctx);
-    const uint32_t n_ubatch = std::min<uint32_t>(256u, n_batch);
+    const uint32_t n_batch = std::min<uint32_t>(config_.n_batch > 0 ? static_cast<uint32_t>(config_.n_batch) : 512u, n_ctx);
+    const uint32_t n_ubatch =
+        std::min<uint32_t>(config_.n_ubatch > 0 ? static_cast<uint32_t>(config_.n_ubatch) : 256u, n_batch);
     ctx_n_batch_ = n_batch;
 
+    // Decode steps are one token each and mostly wait on memory; prefill batches are compute-bound.
+    const int batch_threads = batch_thread_count();
+    const int decode_threads = decode_thread_count();
+
     llama_context_params params = llama_context_default_params();
     params.n_ctx = n_ctx;
     params.n_batch = n_batch;
     params.n_ubatch = n_ubatch;
-    params.n_threads = std::max(1, config_.n_threads);
-    params.n_threads_batch = std::max(1, config_.n_threads);
+    params.n_threads = decode_threads;
+    params.n_threads_batch = batch_threads;
     params.offload_kqv = true;
-    params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    params.flash_attn_type = kv_cache_type_quantized(config_.cache_type_v) ? LLAMA_FLASH_ATTN_TYPE_ENABLED
+                                                                           : LLAMA_FLASH_ATTN_TYPE_AUTO;
+    params.type_k = static_cast<ggml_type>(kv_cache_ggml_type(config_.cache_type_k));
+    params.type_v = static_cast<ggml_type>(kv_cache_ggml_type(config_.cache_type_v));
     params.no_perf = true;
 
     ctx_ = llama_init_from_model(shared_model_->model, params);
     if (ctx_ == nullptr) {
         throw std::runtime_error("llama_init_from_model failed");
     }
+    // K and V for every layer and cell; an estimate for models whose head size is not n_embd / n_head.
+    const llama_model* model = shared_model_->model;
+    const double head_dim = static_cast<double>(llama_model_n_embd(model)) / std::max(1, llama_model_n_head(model));
+    kv_cache_bytes_ = (kv_cache_type_bytes(config_.cache_type_k) + kv_cache_type_bytes(config_.cache_type_v))
+        * static_cast<double>(n_ctx) * llama_model_n_layer(model) * head_dim * llama_model_n_head_kv(model);
+    tei_metrics().kv_cache_bytes.add(kv_cache_bytes_);
+
+    // Thread plan: this context computes on its own physical cores. The calling thread joins every compute as
+    // thread 0, so it is pinned to the same set.
+    if (!config_.worker_cpus.empty() && cpu_slot_ < 0) {
+        cpu_slot_ = shared_model_->acquire_cpu_slot(config_.worker_cpus.size());
+    }
+    if (cpu_slot_ >= 0) {
+        const auto slot = static_cast<std::size_t>(cpu_slot_);
+        const auto& cpus = config_.worker_cpus[slot];
+        const auto make_pool = [](const std::vector<int>& pool_cpus, std::size_t n, bool paused) {
+            ggml_threadpool_params tp = ggml_threadpool_params_default(static_cast<int>(n));
+            std::fill(std::begin(tp.cpumask), std::end(tp.cpumask), false);
+            for (std::size_t i = 0; i < n; ++i) {
+                if (pool_cpus[i] >= 0 && pool_cpus[i] < GGML_MAX_N_THREADS) {
+                    tp.cpumask[pool_cpus[i]] = true;
+                }
+            }
+            tp.strict_cpu = true;
+            tp.paused = paused;
+            return ggml_threadpool_new(&tp);
+        };
+        decode_pool_ = make_pool(cpus, std::min<std::size_t>(cpus.size(), static_cast<std::size_t>(decode_threads)), false);
+        // Same cores and thread count (prefill lending, or --decode-threads equal to --threads): one pool serves
+        // both, rather than two strict pools spinning on the same cores.
+        batch_pool_ = batch_threads == decode_threads
+            ? decode_pool_
+            : make_pool(cpus, std::min<std::size_t>(cpus.size(), static_cast<std::size_t>(batch_threads)), false);
+        // Borrowed only while holding the prefill lease; paused (threads asleep) the rest of the time.
+        if (slot < config_.worker_prefill_cpus.size()) {
+            const auto& wide = config_.worker_prefill_cpus[slot];
+            wide_pool_ = make_pool(wide, wide.size(), true);
+        }
+        if (decode_pool_ != nullptr && batch_pool_ != nullptr) {
+            llama_attach_threadpool(ctx_, decode_pool_, batch_pool_);
+        }
+        pin_current_thread(cpus);
+    }
 
     auto sparams = llama_sampler_chain_default_params();
     sparams.no_perf = true;
@@ -200,16 +319,76 @@ void LlamaTranslator::ensure_context_ready() {
     }
 
     llama_sampler_chain_add(sampler_, llama_sampler_init_greedy());
+
+    penalty_sampler_ = llama_sampler_chain_init(sparams);
+    if (penalty_sampler_ == nullptr) {
+        throw std::runtime_error("llama_sampler_chain_init failed");
+    }
+    llama_sampler_chain_add(
+        penalty_sampler_,
+        llama_sampler_init_penalties(kRepeatPenaltyLastN, kRepeatPenalty, 0.0f, 0.0f)
+    );
+    llama_sampler_chain_add(penalty_sampler_, llama_sampler_init_greedy());
+}
+
+int LlamaTranslator::batch_thread_count() const {
+    // With prefill lending the non-decode cores belong to the lease holder's wide pool, so a worker without the
+    // lease prefills on its decode cores only.
+    return config_.worker_prefill_cpus.empty() ? std::max(1, config_.n_threads) : decode_thread_count();
+}
+
+int LlamaTranslator::decode_thread_count() const {
+    const int threads = std::max(1, config_.n_threads);
+    return config_.decode_threads > 0 ? std::min(config_.decode_threads, threads) : threads;
+}
+
+bool LlamaTranslator::begin_prefill() {
+    if (wide_pool_ == nullptr || decode_pool_ == nullptr || !shared_model_->prefill_lease.try_lock()) {
+        return false;
+    }
+    // One worker at a time prefills across the other workers' idle (non-decode) cores.
+    const auto& wide = config_.worker_prefill_cpus[static_cast<std::size_t>(cpu_slot_)];
+    llama_attach_threadpool(ctx_, decode_pool_, wide_pool_);
+    llama_set_n_threads(ctx_, decode_thread_count(), static_cast<int32_t>(wide.size()));
+    return true;
+}
+
+void LlamaTranslator::end_prefill(bool borrowed) {
+    if (!borrowed) {
+        return;
+    }
+    llama_attach_threadpool(ctx_, decode_pool_, batch_pool_);
+    llama_set_n_threads(ctx_, decode_thread_count(), batch_thread_count());
+    ggml_threadpool_pause(wide_pool_);
+    shared_model_->prefill_lease.unlock();
+    // Resuming the paused wide pool moved this thread onto its first CPU; return it to our own cores.
+    pin_current_thread(config_.worker_cpus[static_cast<std::size_t>(cpu_slot_)]);
 }
 
 std::unique_ptr<Translator> LlamaTranslator::clone() const {
     return std::unique_ptr<Translator>(new LlamaTranslator(config_, shared_model_));
 }
 
+std::unique_ptr<LlamaTranslator> LlamaTranslator::clone_with(LlamaTranslatorConfig config) const {
+    config.model_path = config_.model_path;
+    config.n_gpu_layers = config_.n_gpu_layers;
+    config.vocab_only = config_.vocab_only;
+    return std::unique_ptr<LlamaTranslator>(new LlamaTranslator(std::move(config), shared_model_));
+}
+
+LlamaTokenCounters LlamaTranslator::token_counters() const {
+    return LlamaTokenCounters{
+        .prompt_tokens = shared_model_->prompt_tokens.load(std::memory_order_relaxed),
+        .generated_tokens = shared_model_->generated_tokens.load(std::memory_order_relaxed),
+        .repetition_loops = shared_model_->repetition_loops.load(std::memory_order_relaxed),
+        .repetition_tokens_saved = shared_model_->repetition_tokens_saved.load(std::memory_order_relaxed),
+    };
+}
+
 std::vector<int32_t> LlamaTranslator::tokenize(const std::string& text, bool add_special, bool parse_special) const {
     const int32_t required = -llama_tokenize(
         shared_model_->vocab,
-        text.c_str(),
+        text.data(),
         static_cast<int32_t>(text.size()),
         nullptr,
         0,
@@ -241,14 +420,14 @@ std::vector<int32_t> LlamaTranslator::tokenize(const std::string& text, bool add
 }
 
 void LlamaTranslator::tokenize_into(
-    const std::string& text,
+    std::string_view text,
     bool add_special,
     bool parse_special,
     std::vector<int32_t>& out
 ) const {
     const int32_t required = -llama_tokenize(
         shared_model_->vocab,
-        text.c_str(),
+        text.data(),
         static_cast<int32_t>(text.size()),
         nullptr,
         0,
@@ -263,7 +442,7 @@ void LlamaTranslator::tokenize_into(
     out.resize(static_cast<std::size_t>(required));
     const int32_t written = llama_tokenize(
         shared_model_->vocab,
-        text.c_str(),
+        text.data(),
         static_cast<int32_t>(text.size()),
         reinterpret_cast<llama_token*>(out.data()),
         static_cast<int32_t>(out.size()),
@@ -369,20 +548,50 @@ bool LlamaTranslator::has_early_stop_marker(const std::string& generated) const
     return generated.find("\n\n") != std::string::npos;
 }
 
+std::uint64_t LlamaTranslator::tokenizer_fingerprint() const {
+    std::uint64_t hash = kFnv1a64Offset;
+    // Each piece is followed by a 0xff byte, which never occurs in UTF-8, so piece boundaries are hashed too.
+    const auto mix = [&hash](std::string_view bytes) {
+        hash = fnv1a64("\xff", fnv1a64(bytes, hash));
+    };
+
+    const int32_t n_tokens = llama_vocab_n_tokens(shared_model_->vocab);
+    mix(std::to_string(n_tokens));
+    for (int32_t token = 0; token < n_tokens; ++token) {
+        const char* text = llama_vocab_get_text(shared_model_->vocab, token);
+        mix(text != nullptr ? std::string_view(text) : std::string_view());
+    }
+    return hash;
+}
+
+void LlamaTranslator::tokenize_source(std::string_view text, std::vector<int32_t>& out) const {
+    tokenize_into(text, false, true, out);
+}
+
 std::string LlamaTranslator::translate(const Segment& segment) {
+    TEI_MT_TRACE_SCOPE("translate");
+    last_call_ = TranslateCallInfo{};
     const std::vector<int32_t>& prefix_tokens =
         segment.coalesced_batch ? prompt_prefix_multi_tokens_ : prompt_prefix_tokens_;
+    // Set after a single passage fell into a repetition loop: it is regenerated once with repeats penalized.
+    bool penalize_repeats = false;
 
     for (int grow_attempt = 0; grow_attempt < 48; ++grow_attempt) {
         ensure_context_ready();
 
         llama_memory_clear(llama_get_memory(ctx_), true);
         llama_sampler_reset(sampler_);
+        llama_sampler_reset(penalty_sampler_);
 
         const int base_gen =
             segment.max_output_tokens > 0 ? segment.max_output_tokens : std::max(1, config_.max_tokens);
 
-        tokenize_into(segment.source_zh, false, true, segment_tokens_scratch_);
+        if (!segment.source_tokens.empty()) {
+            segment_tokens_scratch_.assign(segment.source_tokens.begin(), segment.source_tokens.end());
+        } else {
+            TEI_MT_TRACE_SCOPE("tokenize");
+            tokenize_source(segment.source_zh, segment_tokens_scratch_);
+        }
 
         prompt_i32_scratch_.clear();
         prompt_i32_scratch_.reserve(
@@ -436,9 +645,85 @@ std::string LlamaTranslator::translate(const Segment& segment) {
         }
 
         const int32_t prompt_len = static_cast<int32_t>(prompt_i32_scratch_.size());
+        shared_model_->prompt_tokens.fetch_add(static_cast<std::uint64_t>(prompt_len), std::memory_order_relaxed);
+        std::uint64_t produced = 0;
+        TeiMetrics& metrics = tei_metrics();
+        metrics.prompt_tokens.add(prompt_len);
+        last_call_.source_tokens = static_cast<std::uint32_t>(segment_tokens_scratch_.size());
+        last_call_.prompt_tokens += static_cast<std::uint32_t>(prompt_len);
+        last_call_.n_ctx = n_ctx_actual;
+        const auto prefill_started = std::chrono::steady_clock::now();
+        const auto finish_prefill_timing = [&] {
+            const double prefill_ms = 1000.0 * seconds_since(prefill_started);
+            last_call_.prefill_ms += prefill_ms;
+            metrics.prefill_seconds.add(prefill_ms / 1000.0);
+        };
+
+        llama_sampler* const sampler = penalize_repeats ? penalty_sampler_ : sampler_;
+        repetition_guard_.reset();
+        piece_ends_.clear();
+        std::string generated;
+        bool looped = false;
+        // Extend the output by one token; true when generation should stop (loop or early-stop marker).
+        const auto append_token = [&](llama_token tok) {
+            if (run_control().aborting()) {
+                throw std::runtime_error("run aborted");
+            }
+            generated += token_to_piece(tok);
+            piece_ends_.push_back(generated.size());
+            ++produced;
+            if (repetition_guard_.push(tok)) {
+                looped = true;
+                return true;
+            }
+            if (segment.coalesced_batch) {
+                if (generated.ends_with(k_coalesce_marker)) {
+                    repetition_guard_.mark_boundary();
+                }
+                return false;
+            }
+            return has_early_stop_marker(generated);
+        };
+        // Account for the generation; false when a looping passage should be regenerated with the penalty sampler.
+        const auto finish_generation = [&](std::chrono::steady_clock::time_point decode_started) {
+            shared_model_->generated_tokens.fetch_add(produced, std::memory_order_relaxed);
+            metrics.generated_tokens.add(static_cast<double>(produced));
+            const double decode_ms = 1000.0 * seconds_since(decode_started);
+            last_call_.output_tokens += static_cast<std::uint32_t>(produced);
+            last_call_.decode_ms += decode_ms;
+            last_call_.cap_hit = produced >= static_cast<std::uint64_t>(gen_cap);
+            metrics.decode_seconds.add(decode_ms / 1000.0);
+            if (!looped) {
+                return true;
+            }
+            const std::uint64_t saved = static_cast<std::uint64_t>(gen_cap) - produced;
+            ++last_call_.repetition_loops;
+            last_call_.tokens_saved += static_cast<std::uint32_t>(saved);
+            shared_model_->repetition_loops.fetch_add(1, std::memory_order_relaxed);
+            shared_model_->repetition_tokens_saved.fetch_add(saved, std::memory_order_relaxed);
+            metrics.repetition_loops.add();
+            metrics.repetition_tokens_saved.add(static_cast<double>(saved));
+            if (segment.coalesced_batch) {
+                throw RepetitionLoopError(std::move(generated));
+            }
+            if (!penalize_repeats) {
+                penalize_repeats = true;
+                return false;
+            }
+            // Still looping under the penalty: keep the text through the loop's first copy.
+            generated.resize(piece_ends_[repetition_guard_.keep_tokens() - 1]);
+            return true;
+        };
 
         if (llama_model_has_encoder(shared_model_->model)) {
-        encode_prompt_chunks(ctx_, prompt_i32_scratch_.data(), prompt_len, ctx_n_batch_);
+        {
+            TEI_MT_TRACE_SCOPE("prefill");
+            PrefillScope prefill(*this);
+            encode_prompt_chunks(ctx_, prompt_i32_scratch_.data(), prompt_len, ctx_n_batch_);
+        }
+        finish_prefill_timing();
+        const auto decode_started = std::chrono::steady_clock::now();
+        TEI_MT_TRACE_SCOPE("decode");
 
         llama_token decoder_start = llama_model_decoder_start_token(shared_model_->model);
         if (decoder_start == LLAMA_TOKEN_NULL) {
@@ -446,40 +731,45 @@ std::string LlamaTranslator::translate(const Segment& segment) {
         }
 
         llama_batch dec_batch = llama_batch_get_one(&decoder_start, 1);
-        std::string generated;
 
         for (int i = 0; i < gen_cap; ++i) {
             if (llama_decode(ctx_, dec_batch) != 0) {
                 throw std::runtime_error("llama_decode failed during encoder-decoder generation");
             }
 
-            llama_token tok = llama_sampler_sample(sampler_, ctx_, -1);
+            llama_token tok = llama_sampler_sample(sampler, ctx_, -1);
             if (llama_vocab_is_eog(shared_model_->vocab, tok)) {
                 break;
             }
 
-            generated += token_to_piece(tok);
-            if (!segment.coalesced_batch && has_early_stop_marker(generated)) {
+            if (append_token(tok)) {
                 break;
             }
             dec_batch = llama_batch_get_one(&tok, 1);
         }
 
+            if (!finish_generation(decode_started)) {
+                continue;
+            }
             return postprocess_translation(std::move(generated), segment.coalesced_batch);
         }
 
-        decode_prompt_chunks(ctx_, prompt_i32_scratch_.data(), prompt_len, ctx_n_batch_);
-
-        std::string generated;
+        {
+            TEI_MT_TRACE_SCOPE("prefill");
+            PrefillScope prefill(*this);
+            decode_prompt_chunks(ctx_, prompt_i32_scratch_.data(), prompt_len, ctx_n_batch_);
+        }
+        finish_prefill_timing();
+        const auto decode_started = std::chrono::steady_clock::now();
+        TEI_MT_TRACE_SCOPE("decode");
 
         for (int i = 0; i < gen_cap; ++i) {
-            const llama_token tok = llama_sampler_sample(sampler_, ctx_, -1);
+            const llama_token tok = llama_sampler_sample(sampler, ctx_, -1);
             if (llama_vocab_is_eog(shared_model_->vocab, tok)) {
                 break;
             }
 
-            generated += token_to_piece(tok);
-            if (!segment.coalesced_batch && has_early_stop_marker(generated)) {
+            if (append_token(tok)) {
                 break;
             }
 
@@ -494,6 +784,9 @@ std::string LlamaTranslator::translate(const Segment& segment) {
             }
         }
 
+        if (!finish_generation(decode_started)) {
+            continue;
+        }
         return postprocess_translation(std::move(generated), segment.coalesced_batch);
     }
 
@@ -1,16 +1,19 @@
 #pragma once
 
+#include "repetition_guard.hpp"
 #include "translator.hpp"
 
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct llama_model;
 struct llama_context;
 struct llama_sampler;
 struct llama_vocab;
+struct ggml_threadpool;
 
 struct LlamaTranslatorConfig {
     std::string model_path;
@@ -19,7 +22,30 @@ struct LlamaTranslatorConfig {
     int max_n_ctx = 131072;
     int n_gpu_layers = -1;
     int n_threads = 0;
+    /// Threads for single-token decode steps (0 = n_threads); prompt prefill uses n_threads.
+    int decode_threads = 0;
     int max_tokens = 192;
+    /// llama.cpp logical / physical batch for prompt prefill (0 = 512 / 256); both are clamped to n_ctx.
+    int n_batch = 0;
+    int n_ubatch = 0;
+    /// KV cache element types (llama.cpp names, see memory_plan.hpp); a quantized V cache turns on flash attention.
+    std::string cache_type_k = "f16";
+    std::string cache_type_v = "f16";
+    /// Per-worker CPU sets from the thread plan; each live context takes a free set and computes on it only.
+    std::vector<std::vector<int>> worker_cpus;
+    /// Parallel to worker_cpus: the wide set borrowed for a prefill while holding the model's prefill lease.
+    std::vector<std::vector<int>> worker_prefill_cpus;
+    /// Load only the vocabulary (tokenize / fingerprint); translate() is unavailable.
+    bool vocab_only = false;
+};
+
+/// Tokens processed by every context on one loaded model since it was loaded.
+struct LlamaTokenCounters {
+    std::uint64_t prompt_tokens = 0;
+    std::uint64_t generated_tokens = 0;
+    /// Generations aborted by the repetition guard, and the token-cap budget they did not spend.
+    std::uint64_t repetition_loops = 0;
+    std::uint64_t repetition_tokens_saved = 0;
 };
 
 class LlamaTranslator final : public Translator {
@@ -29,6 +55,16 @@ public:
 
     std::unique_ptr<Translator> clone() const override;
     std::string translate(const Segment& segment) override;
+    TranslateCallInfo last_call() const override { return last_call_; }
+    /// A translator on the same loaded model with different runtime settings (context size, batch, threads);
+    /// the model path, GPU layers and vocab_only of `config` are ignored.
+    std::unique_ptr<LlamaTranslator> clone_with(LlamaTranslatorConfig config) const;
+    LlamaTokenCounters token_counters() const;
+
+    /// Hash of the vocabulary; token ids stored in a segment store are only reused when this matches.
+    std::uint64_t tokenizer_fingerprint() const;
+    /// Tokenize segment text exactly as translate() does (Segment::source_tokens).
+    void tokenize_source(std::string_view text, std::vector<int32_t>& out) const;
 
 private:
     struct SharedModel;
@@ -41,10 +77,28 @@ private:
     bool has_early_stop_marker(const std::string& generated) const;
 
     std::vector<int32_t> tokenize(const std::string& text, bool add_special, bool parse_special) const;
-    void tokenize_into(const std::string& text, bool add_special, bool parse_special, std::vector<int32_t>& out) const;
+    void tokenize_into(std::string_view text, bool add_special, bool parse_special, std::vector<int32_t>& out) const;
     std::string token_to_piece(int32_t token) const;
 
     void ensure_context_ready();
+    int batch_thread_count() const;
+    int decode_thread_count() const;
+    /// Pick the threadpool for the prompt about to be prefilled: the wide borrowed one if the lease is free.
+    bool begin_prefill();
+    void end_prefill(bool borrowed);
+
+    class PrefillScope {
+    public:
+        explicit PrefillScope(LlamaTranslator& translator)
+            : translator_(translator), borrowed_(translator.begin_prefill()) {}
+        ~PrefillScope() { translator_.end_prefill(borrowed_); }
+        PrefillScope(const PrefillScope&) = delete;
+        PrefillScope& operator=(const PrefillScope&) = delete;
+
+    private:
+        LlamaTranslator& translator_;
+        bool borrowed_;
+    };
     void release_context_resources();
     /// Grow config_.n_ctx (recreate llama context) so prompt + generation can fit. Returns false if already at max.
     bool bump_ctx_capacity(std::size_t prompt_tokens, int generation_need);
@@ -62,4 +116,19 @@ private:
 
     llama_context* ctx_ = nullptr;
     llama_sampler* sampler_ = nullptr;
+    /// Greedy with a repetition penalty, for the retry of a passage that looped.
+    llama_sampler* penalty_sampler_ = nullptr;
+    RepetitionGuard repetition_guard_;
+    /// Byte length of the output after each generated token (to cut a loop off at a token boundary).
+    std::vector<std::size_t> piece_ends_;
+    /// Pinned compute threads when the thread plan assigned this instance a CPU set (cpu_slot_ >= 0): a narrow
+    /// pool for decode steps, one for prefill (all its cores, or only the decode cores when prefill cores are
+    /// lent; then the same pool as decode_pool_), and a paused wide pool borrowed for prefill.
+    ggml_threadpool* decode_pool_ = nullptr;
+    ggml_threadpool* batch_pool_ = nullptr;
+    ggml_threadpool* wide_pool_ = nullptr;
+    int cpu_slot_ = -1;
+    /// This context's share of the `tei_mt_kv_cache_bytes` gauge.
+    double kv_cache_bytes_ = 0.0;
+    TranslateCallInfo last_call_;
 };
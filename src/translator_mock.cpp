@@ -0,0 +1,282 @@
+#include "translator_mock.hpp"
+
+#include "fnv1a.hpp"
+#include "metrics.hpp"
+#include "run_control.hpp"
+#include "segment_batch.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// Prompt template tokens around the passage (instruction prefix and `English:` suffix).
+constexpr std::size_t kPromptOverheadTokens = 40;
+/// Tokens generated before the repetition guard catches a simulated loop.
+constexpr std::size_t kLoopDetectTokens = 40;
+
+constexpr std::array<const char*, 24> kWords = {
+    "the",    "Buddha", "said",   "to",     "monks",  "all",   "dharmas", "are",
+    "empty",  "mind",   "and",    "form",   "arise",  "cease", "thus",    "have",
+    "I",      "heard",  "in",     "that",   "assembly", "great", "wisdom", "path",
+};
+
+std::uint64_t fnv1a(std::string_view text, std::uint64_t seed) {
+    // This start value (not kFnv1a64Offset) is what seeded mock output has always been generated from.
+    return fnv1a64(text, 1469598103934665603ull ^ seed);
+}
+
+/// UTF-8 code points: about one model token per CJK character.
+std::size_t count_code_points(std::string_view text) {
+    return static_cast<std::size_t>(std::count_if(text.begin(), text.end(), [](char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    }));
+}
+
+std::vector<std::string_view> split_passages(std::string_view merged) {
+    const std::string delim = std::string("\n") + k_coalesce_marker + "\n";
+    std::vector<std::string_view> passages;
+    for (std::size_t start = 0;;) {
+        const auto pos = merged.find(delim, start);
+        passages.push_back(merged.substr(start, pos == std::string_view::npos ? std::string_view::npos : pos - start));
+        if (pos == std::string_view::npos) {
+            return passages;
+        }
+        start = pos + delim.size();
+    }
+}
+
+bool parse_double(const std::string& text, double& out) {
+    try {
+        std::size_t used = 0;
+        out = std::stod(text, &used);
+        return used == text.size() && out >= 0.0;
+    } catch (...) {
+        return false;
+    }
+}
+
+}  // namespace
+
+struct MockTranslator::Shared {
+    std::atomic<std::uint64_t> next_clone{0};
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> prompt_tokens{0};
+    std::atomic<std::uint64_t> generated_tokens{0};
+    std::atomic<std::uint64_t> failures{0};
+    std::atomic<std::uint64_t> marker_drifts{0};
+    std::atomic<std::uint64_t> ctx_grows{0};
+    std::atomic<std::uint64_t> repetition_loops{0};
+    std::atomic<std::uint64_t> tokens_saved{0};
+};
+
+bool parse_mock_costs(const std::string& spec, MockTranslatorConfig& config, std::string& error) {
+    std::stringstream in(spec);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        const auto eq = item.find('=');
+        const std::string key = item.substr(0, eq);
+        const std::string value = eq == std::string::npos ? std::string{} : item.substr(eq + 1);
+        double number = 0.0;
+        if (!parse_double(value, number)) {
+            error = "Invalid --mock-costs entry: " + item;
+            return false;
+        }
+        if (key == "prefill_us") {
+            config.prefill_us = number;
+        } else if (key == "decode_us") {
+            config.decode_us = number;
+        } else if (key == "jitter") {
+            config.jitter = number;
+        } else if (key == "fail" || key == "drift" || key == "loop") {
+            if (number > 1.0) {
+                error = "--mock-costs " + key + " is a probability (0..1)";
+                return false;
+            }
+            (key == "fail" ? config.fail_rate : key == "drift" ? config.drift_rate : config.loop_rate) = number;
+        } else if (key == "grow_ms") {
+            config.ctx_grow_ms = number;
+        } else if (key == "seed") {
+            config.seed = static_cast<std::uint64_t>(number);
+        } else {
+            error = "Unknown --mock-costs key: " + key + " (prefill_us, decode_us, jitter, fail, drift, loop, grow_ms, seed)";
+            return false;
+        }
+    }
+    return true;
+}
+
+MockTranslator::MockTranslator(MockTranslatorConfig config)
+    : MockTranslator(std::move(config), std::make_shared<Shared>()) {}
+
+MockTranslator::MockTranslator(MockTranslatorConfig config, std::shared_ptr<Shared> shared)
+    : config_(std::move(config)), shared_(std::move(shared)), n_ctx_(std::max(512, config_.n_ctx)) {
+    const std::uint64_t clone_index = shared_->next_clone.fetch_add(1, std::memory_order_relaxed);
+    rng_.seed(config_.seed ^ (clone_index * 0x9E3779B97F4A7C15ull));
+}
+
+std::unique_ptr<Translator> MockTranslator::clone() const {
+    return std::unique_ptr<Translator>(new MockTranslator(config_, shared_));
+}
+
+MockTranslatorStats MockTranslator::stats() const {
+    return MockTranslatorStats{
+        .calls = shared_->calls.load(std::memory_order_relaxed),
+        .prompt_tokens = shared_->prompt_tokens.load(std::memory_order_relaxed),
+        .generated_tokens = shared_->generated_tokens.load(std::memory_order_relaxed),
+        .failures = shared_->failures.load(std::memory_order_relaxed),
+        .marker_drifts = shared_->marker_drifts.load(std::memory_order_relaxed),
+        .ctx_grows = shared_->ctx_grows.load(std::memory_order_relaxed),
+        .repetition_loops = shared_->repetition_loops.load(std::memory_order_relaxed),
+        .tokens_saved = shared_->tokens_saved.load(std::memory_order_relaxed),
+    };
+}
+
+std::size_t MockTranslator::render_passage(std::string_view source, std::size_t token_budget, std::string& out) const {
+    // Roughly 1.2 English tokens per source character, one word per ~1.3 tokens.
+    const std::size_t tokens = std::min<std::size_t>(token_budget, std::max<std::size_t>(1, count_code_points(source) * 6 / 5));
+    const std::size_t words = std::max<std::size_t>(1, tokens * 3 / 4);
+    std::uint64_t state = fnv1a(source, config_.seed) | 1;
+    for (std::size_t w = 0; w < words; ++w) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        std::string_view word = kWords[state % kWords.size()];
+        if (w == 0) {
+            out.push_back(static_cast<char>(std::toupper(static_cast<unsigned char>(word.front()))));
+            word.remove_prefix(1);
+        } else {
+            out.push_back(' ');
+        }
+        out += word;
+    }
+    out.push_back('.');
+    return tokens;
+}
+
+std::string MockTranslator::translate(const Segment& segment) {
+    TEI_MT_TRACE_SCOPE("translate");
+    if (run_control().aborting()) {
+        throw std::runtime_error("run aborted");
+    }
+    shared_->calls.fetch_add(1, std::memory_order_relaxed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    last_call_ = TranslateCallInfo{};
+    const std::size_t source_tokens = count_code_points(segment.source_zh);
+    const std::size_t prompt_tokens = kPromptOverheadTokens + source_tokens;
+    const int max_output = segment.max_output_tokens > 0 ? segment.max_output_tokens : config_.max_tokens;
+    const std::size_t budget = static_cast<std::size_t>(std::max(1, max_output));
+
+    // Context growth as in LlamaTranslator: double n_ctx until prompt plus generation fits, else fail.
+    while (prompt_tokens + budget >= static_cast<std::size_t>(n_ctx_)) {
+        if (n_ctx_ >= config_.max_n_ctx) {
+            throw std::runtime_error(
+                "Prompt too long for context window (prompt_tokens=" + std::to_string(prompt_tokens)
+                + ", n_ctx=" + std::to_string(n_ctx_) + ", max_n_ctx=" + std::to_string(config_.max_n_ctx) + ")"
+            );
+        }
+        n_ctx_ = std::min(config_.max_n_ctx, n_ctx_ * 2);
+        shared_->ctx_grows.fetch_add(1, std::memory_order_relaxed);
+        ++last_call_.ctx_grows;
+        tei_metrics().ctx_grows.add();
+        TEI_MT_TRACE_SCOPE("context_init");
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(config_.ctx_grow_ms));
+    }
+
+    std::string out;
+    std::size_t generated = 0;
+    bool cap_hit = false;
+    if (segment.coalesced_batch) {
+        const auto passages = split_passages(segment.source_zh);
+        const std::size_t per_passage = std::max<std::size_t>(1, budget / passages.size());
+        const bool drift = passages.size() > 1 && unit(rng_) < config_.drift_rate;
+        const std::size_t dropped = drift ? 1 + static_cast<std::size_t>(rng_() % (passages.size() - 1)) : 0;
+        for (std::size_t p = 0; p < passages.size(); ++p) {
+            if (p > 0) {
+                out += p == dropped ? " " : std::string("\n") + k_coalesce_marker + "\n";
+            }
+            const std::size_t passage_tokens = render_passage(passages[p], per_passage, out);
+            generated += passage_tokens;
+            cap_hit = cap_hit || passage_tokens >= per_passage;
+        }
+        if (drift) {
+            shared_->marker_drifts.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else {
+        generated = render_passage(segment.source_zh, budget, out);
+        cap_hit = generated >= budget;
+    }
+
+    // A loop caught after kLoopDetectTokens: a merged batch is handed back with what it generated so far, a single
+    // passage is regenerated (a second prefill and the loop's tokens on top of the answer).
+    const bool loop = unit(rng_) < config_.loop_rate;
+    const std::size_t loop_tokens = loop ? std::min(budget, kLoopDetectTokens) : 0;
+    if (loop) {
+        const std::uint64_t saved = budget - loop_tokens;
+        shared_->repetition_loops.fetch_add(1, std::memory_order_relaxed);
+        shared_->tokens_saved.fetch_add(saved, std::memory_order_relaxed);
+        tei_metrics().repetition_loops.add();
+        tei_metrics().repetition_tokens_saved.add(static_cast<double>(saved));
+        last_call_.repetition_loops = 1;
+        last_call_.tokens_saved = static_cast<std::uint32_t>(saved);
+        if (segment.coalesced_batch) {
+            generated = loop_tokens;
+            out.resize(std::min(out.size(), loop_tokens * 5));
+            cap_hit = false;
+        }
+    }
+    const bool regenerate = loop && !segment.coalesced_batch;
+    const std::size_t prefilled = prompt_tokens * (regenerate ? 2 : 1);
+    const std::size_t decoded = generated + (regenerate ? loop_tokens : 0);
+
+    // Mean-preserving log-normal jitter on the whole call, spent as a prefill phase then a decode phase.
+    const double factor = config_.jitter > 0.0
+        ? std::lognormal_distribution<double>(-config_.jitter * config_.jitter / 2.0, config_.jitter)(rng_)
+        : 1.0;
+    const auto prefill_us = std::chrono::duration<double, std::micro>(
+        static_cast<double>(prefilled) * config_.prefill_us * factor
+    );
+    const auto decode_us = std::chrono::duration<double, std::micro>(
+        static_cast<double>(decoded) * config_.decode_us * factor
+    );
+    {
+        TEI_MT_TRACE_SCOPE("prefill");
+        std::this_thread::sleep_for(prefill_us);
+    }
+    {
+        TEI_MT_TRACE_SCOPE("decode");
+        std::this_thread::sleep_for(decode_us);
+    }
+
+    shared_->prompt_tokens.fetch_add(prefilled, std::memory_order_relaxed);
+    shared_->generated_tokens.fetch_add(decoded, std::memory_order_relaxed);
+    TeiMetrics& metrics = tei_metrics();
+    metrics.prompt_tokens.add(static_cast<double>(prefilled));
+    metrics.generated_tokens.add(static_cast<double>(decoded));
+    metrics.prefill_seconds.add(std::chrono::duration<double>(prefill_us).count());
+    metrics.decode_seconds.add(std::chrono::duration<double>(decode_us).count());
+    last_call_.source_tokens = static_cast<std::uint32_t>(source_tokens);
+    last_call_.prompt_tokens = static_cast<std::uint32_t>(prefilled);
+    last_call_.output_tokens = static_cast<std::uint32_t>(decoded);
+    last_call_.prefill_ms = std::chrono::duration<double, std::milli>(prefill_us).count();
+    last_call_.decode_ms = std::chrono::duration<double, std::milli>(decode_us).count();
+    last_call_.n_ctx = n_ctx_;
+    last_call_.cap_hit = cap_hit;
+    if (loop && segment.coalesced_batch) {
+        throw RepetitionLoopError(std::move(out));
+    }
+    if (unit(rng_) < config_.fail_rate) {
+        shared_->failures.fetch_add(1, std::memory_order_relaxed);
+        throw std::runtime_error("mock: injected decode failure");
+    }
+    return out;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "mock_options.hpp"
+#include "translator.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+/// Counters shared by a mock translator and all its clones.
+struct MockTranslatorStats {
+    std::uint64_t calls = 0;
+    std::uint64_t prompt_tokens = 0;
+    std::uint64_t generated_tokens = 0;
+    std::uint64_t failures = 0;
+    std::uint64_t marker_drifts = 0;
+    std::uint64_t ctx_grows = 0;
+    std::uint64_t repetition_loops = 0;
+    std::uint64_t tokens_saved = 0;
+};
+
+/// `--backend mock`: a Translator with no model. Output is a deterministic function of the seed and the source
+/// text (English-looking filler sized like a real answer, coalesced batches answered passage by passage with
+/// markers), so runs are reproducible at any worker count; latency, failures, marker drift and context growth
+/// are simulated from MockTranslatorConfig, drawn from a per-clone random stream.
+class MockTranslator final : public Translator {
+public:
+    explicit MockTranslator(MockTranslatorConfig config);
+
+    std::unique_ptr<Translator> clone() const override;
+    std::string translate(const Segment& segment) override;
+    TranslateCallInfo last_call() const override { return last_call_; }
+
+    MockTranslatorStats stats() const;
+
+private:
+    struct Shared;
+
+    MockTranslator(MockTranslatorConfig config, std::shared_ptr<Shared> shared);
+
+    /// Filler English for one passage; returns the generated token count it stands for.
+    std::size_t render_passage(std::string_view source, std::size_t token_budget, std::string& out) const;
+
+    MockTranslatorConfig config_;
+    std::shared_ptr<Shared> shared_;
+    std::mt19937_64 rng_;
+    /// Per-clone context size, grown like LlamaTranslator's.
+    int n_ctx_ = 0;
+    TranslateCallInfo last_call_;
+};
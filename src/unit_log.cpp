@@ -0,0 +1,147 @@
+#include "unit_log.hpp"
+
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+std::uint64_t utf8_code_points(std::string_view text) {
+    std::uint64_t count = 0;
+    for (const char c : text) {
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+std::string to_json_line(const UnitLogRecord& record) {
+    nlohmann::ordered_json line;
+    line["file"] = record.file;
+    line["segments"] = record.segment_ids;
+    line["source_chars"] = record.source_chars;
+    line["source_tokens"] = record.calls.source_tokens;
+    line["prompt_tokens"] = record.calls.prompt_tokens;
+    line["output_tokens"] = record.calls.output_tokens;
+    line["prefill_ms"] = record.calls.prefill_ms;
+    line["decode_ms"] = record.calls.decode_ms;
+    line["unit_ms"] = record.unit_ms;
+    line["n_ctx"] = record.calls.n_ctx;
+    line["ctx_grows"] = record.calls.ctx_grows;
+    line["cap_hit"] = record.calls.cap_hit;
+    line["repetition_loops"] = record.calls.repetition_loops;
+    line["tokens_saved"] = record.calls.tokens_saved;
+    line["calls"] = record.translate_calls;
+    line["worker"] = record.worker;
+    line["status"] = record.failed ? "failed" : record.fallback.empty() ? "ok" : "fallback";
+    if (!record.fallback.empty()) {
+        line["fallback"] = record.fallback;
+        line["raw_output"] = record.raw_output;
+    }
+    if (record.failed) {
+        line["error"] = record.error;
+    }
+    // Model output can end mid-character when generation hits the cap.
+    return line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+}  // namespace
+
+UnitLogRecord make_unit_log_record(
+    const std::string& file,
+    const std::vector<Segment>& segments,
+    const TranslationUnitReport& unit
+) {
+    UnitLogRecord record;
+    record.file = file;
+    record.segment_ids.reserve(unit.segment_indices.size());
+    for (const std::size_t index : unit.segment_indices) {
+        record.segment_ids.emplace_back(segments[index].id);
+        record.source_chars += utf8_code_points(segments[index].source_zh);
+    }
+    record.calls = unit.calls;
+    record.translate_calls = unit.translate_calls;
+    record.worker = unit.worker;
+    record.unit_ms = unit.unit_ms;
+    if (unit.fallback != nullptr) {
+        record.fallback = unit.fallback;
+        record.raw_output = unit.raw_output;
+    }
+    record.failed = unit.failed;
+    record.error = unit.error;
+    return record;
+}
+
+UnitLog::~UnitLog() {
+    std::string ignored;
+    close(ignored);
+}
+
+bool UnitLog::open(const std::filesystem::path& path, std::string& error) {
+    path_ = path;
+    out_.open(path_, std::ios::binary | std::ios::app);
+    if (!out_) {
+        error = "Failed to open unit log: " + path_.string();
+        return false;
+    }
+    pending_.reserve(256);
+    thread_ = std::jthread([this](std::stop_token stop_token) { run(stop_token); });
+    return true;
+}
+
+void UnitLog::submit(UnitLogRecord record) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.size() >= kMaxPending) {
+            ++dropped_;
+            return;
+        }
+        pending_.push_back(std::move(record));
+    }
+    wake_.notify_one();
+}
+
+bool UnitLog::close(std::string& error) {
+    if (!thread_.joinable()) {
+        return true;
+    }
+    thread_.request_stop();
+    thread_.join();
+    out_.close();
+    if (write_failed_) {
+        error = "Failed to write unit log: " + path_.string();
+        return false;
+    }
+    return true;
+}
+
+void UnitLog::run(std::stop_token stop_token) {
+    std::vector<UnitLogRecord> batch;
+    std::string lines;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, stop_token, [&] { return !pending_.empty(); });
+            batch.swap(pending_);
+        }
+        if (batch.empty()) {
+            // Only a stop request wakes the writer with nothing queued.
+            return;
+        }
+        const std::size_t records = batch.size();
+        lines.clear();
+        for (const auto& record : batch) {
+            lines += to_json_line(record);
+            lines += '\n';
+        }
+        batch.clear();
+        if (!write_failed_) {
+            out_ << lines << std::flush;
+            write_failed_ = !out_;
+            if (!write_failed_) {
+                written_ += records;
+            }
+        }
+    }
+}
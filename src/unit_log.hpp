@@ -0,0 +1,74 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "segment.hpp"
+#include "translator.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// One translation unit as written to the `--unit-log` sidecar.
+struct UnitLogRecord {
+    /// Path relative to the input root.
+    std::string file;
+    std::vector<std::string> segment_ids;
+    /// Source length in code points.
+    std::uint64_t source_chars = 0;
+    TranslateCallInfo calls;
+    std::size_t translate_calls = 0;
+    std::size_t worker = 0;
+    double unit_ms = 0.0;
+    /// Empty, "split", "loop", "error" or "retry" (see TranslationUnitReport).
+    std::string fallback;
+    std::string raw_output;
+    bool failed = false;
+    std::string error;
+};
+
+/// Copy what the log needs out of a unit report (segment views do not outlive the document).
+UnitLogRecord make_unit_log_record(
+    const std::string& file,
+    const std::vector<Segment>& segments,
+    const TranslationUnitReport& unit
+);
+
+/// JSONL sidecar with one line per translation unit (`--unit-log <path>`, appended to). Workers only queue a
+/// record under a short lock; a background thread serializes and writes. When the writer falls behind by
+/// `kMaxPending` records, further records are dropped and counted rather than blocking translation.
+class UnitLog {
+public:
+    static constexpr std::size_t kMaxPending = 4096;
+
+    ~UnitLog();
+    bool open(const std::filesystem::path& path, std::string& error);
+    bool is_open() const { return thread_.joinable(); }
+    /// Thread-safe and non-blocking apart from the queue lock.
+    void submit(UnitLogRecord record);
+    /// Write everything still queued, then stop the writer.
+    bool close(std::string& error);
+
+    std::uint64_t written() const { return written_; }
+    std::uint64_t dropped() const { return dropped_; }
+
+private:
+    void run(std::stop_token stop_token);
+
+    std::filesystem::path path_;
+    std::ofstream out_;
+    std::mutex mutex_;
+    std::condition_variable_any wake_;
+    std::vector<UnitLogRecord> pending_;
+    std::uint64_t dropped_ = 0;
+    /// Writer thread only until close() has joined it.
+    std::uint64_t written_ = 0;
+    bool write_failed_ = false;
+    std::jthread thread_;
+};
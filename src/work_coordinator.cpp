@@ -0,0 +1,456 @@
+#include "work_coordinator.hpp"
+
+#include "metrics.hpp"
+#include "run_control.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace {
+
+struct UnitState {
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    int attempts = 0;
+    bool done = false;
+};
+
+}  // namespace
+
+bool WorkCoordinator::listen(const std::string& endpoint, const WorkCoordinatorOptions& options, std::string& error) {
+    WorkEndpoint parsed;
+    if (!parse_work_endpoint(endpoint, parsed, error)) {
+        return false;
+    }
+    options_ = options;
+    options_.unit_segments = std::max<std::size_t>(1, options_.unit_segments);
+    endpoint_name_ = work_endpoint_name(parsed);
+    return listener_.listen(parsed, error);
+}
+
+void WorkCoordinator::accept_worker() {
+    Worker worker;
+    std::string error;
+    if (!listener_.accept(worker.socket, error)) {
+        std::cerr << "[coord] " << error << "\n";
+        return;
+    }
+    workers_.push_back(std::move(worker));
+}
+
+void WorkCoordinator::shutdown() {
+    const std::string frame = make_shutdown_frame();
+    for (auto& worker : workers_) {
+        std::string ignored;
+        worker.socket.send_frame(frame, ignored);
+    }
+    workers_.clear();
+    listener_.close();
+}
+
+#ifdef _WIN32
+
+bool WorkCoordinator::translate(
+    const std::vector<Segment>&,
+    std::vector<std::string>&,
+    TranslationStats&,
+    std::string& error,
+    const std::function<void(std::size_t, std::size_t)>&,
+    const SegmentDoneCallback&
+) {
+    error = "--coordinator is not supported in Windows builds";
+    return false;
+}
+
+#else
+
+bool WorkCoordinator::translate(
+    const std::vector<Segment>& segments,
+    std::vector<std::string>& out_translations,
+    TranslationStats& out_stats,
+    std::string& error,
+    const std::function<void(std::size_t, std::size_t)>& progress_callback,
+    const SegmentDoneCallback& segment_done
+) {
+    out_stats = TranslationStats{};
+    out_stats.segments_total = segments.size();
+    out_translations.clear();
+    if (segments.empty()) {
+        return true;
+    }
+    out_translations.resize(segments.size());
+
+    std::vector<UnitState> units;
+    for (std::size_t begin = 0; begin < segments.size(); begin += options_.unit_segments) {
+        units.push_back(UnitState{.begin = begin, .end = std::min(segments.size(), begin + options_.unit_segments)});
+    }
+    out_stats.translation_units = units.size();
+
+    // Unit ids are unique across calls, so a late answer to an abandoned unit of an earlier document is
+    // recognized and dropped.
+    const std::uint64_t first_id = next_unit_id_;
+    next_unit_id_ += units.size();
+    const auto local_unit = [&](std::uint64_t unit_id) {
+        return unit_id >= first_id && unit_id - first_id < units.size()
+            ? static_cast<std::size_t>(unit_id - first_id)
+            : units.size();
+    };
+
+    std::deque<std::size_t> pending;
+    for (std::size_t u = 0; u < units.size(); ++u) {
+        pending.push_back(u);
+    }
+    std::size_t units_done = 0;
+    std::size_t segments_done = 0;
+    std::unordered_set<std::string> contributors;
+    std::string fatal;
+
+    // Put a lost unit back in the queue, or give up on it once it has used all its attempts.
+    const auto requeue = [&](std::size_t u, const std::string& reason) {
+        if (u >= units.size() || units[u].done) {
+            return;
+        }
+        if (++units[u].attempts >= options_.max_attempts) {
+            fatal = "unit of segments " + std::to_string(units[u].begin) + "-" + std::to_string(units[u].end - 1)
+                + " failed " + std::to_string(units[u].attempts) + " times, last: " + reason;
+            return;
+        }
+        pending.push_front(u);
+    };
+    const auto drop_worker = [&](std::size_t w, const std::string& reason) {
+        auto& worker = workers_[w];
+        std::cerr << "[coord] worker " << (worker.name.empty() ? "(unnamed)" : worker.name) << " dropped: " << reason;
+        if (worker.busy && local_unit(worker.unit_id) < units.size()) {
+            std::cerr << "; reassigning its unit";
+            requeue(local_unit(worker.unit_id), worker.name + ": " + reason);
+        }
+        std::cerr << "\n";
+        worker.busy = false;
+        worker.socket.close();
+    };
+
+    const auto handle_frame = [&](std::size_t w, const std::string& payload) -> bool {
+        auto& worker = workers_[w];
+        WorkMessage type{};
+        if (!decode_work_type(payload, type)) {
+            drop_worker(w, "unknown message");
+            return false;
+        }
+        if (type == WorkMessage::Hello) {
+            std::uint32_t version = 0;
+            if (!decode_hello(payload, version, worker.name) || version != kWorkProtocolVersion) {
+                drop_worker(w, "protocol version mismatch");
+                return false;
+            }
+            worker.ready = true;
+            std::cout << "[coord] worker connected: " << worker.name << "\n";
+            return true;
+        }
+        if (!worker.ready || !worker.busy) {
+            drop_worker(w, "unexpected message");
+            return false;
+        }
+        if (type == WorkMessage::Result) {
+            WorkResultMessage result;
+            if (!decode_result(payload, result) || result.unit_id != worker.unit_id) {
+                drop_worker(w, "malformed result");
+                return false;
+            }
+            worker.busy = false;
+            const std::size_t u = local_unit(result.unit_id);
+            if (u >= units.size() || units[u].done) {
+                return true;
+            }
+            auto& unit = units[u];
+            if (result.translations.size() != unit.end - unit.begin) {
+                drop_worker(w, "result size mismatch");
+                return false;
+            }
+            for (const auto& failed : result.failed) {
+                const std::size_t i = unit.begin + failed.position;
+                result.translations[failed.position].clear();
+                out_stats.failed_segments.push_back(FailedSegment{i, std::string(segments[i].id), failed.error});
+            }
+            for (std::size_t i = unit.begin; i < unit.end; ++i) {
+                out_translations[i] = std::move(result.translations[i - unit.begin]);
+                const bool failed = std::ranges::any_of(result.failed, [&](const WorkFailedSegment& f) {
+                    return unit.begin + f.position == i;
+                });
+                if (segment_done && !failed) {
+                    segment_done(i);
+                }
+            }
+            if (!result.failed.empty()) {
+                std::cerr << "[coord] worker " << worker.name << " left " << result.failed.size()
+                          << " segments of a unit untranslated\n";
+                tei_metrics().segments_failed.add(static_cast<double>(result.failed.size()));
+            }
+            unit.done = true;
+            ++units_done;
+            const std::chrono::duration<double> round_trip =
+                std::chrono::steady_clock::now() - (worker.deadline - options_.unit_timeout);
+            out_stats.unit_latency_ms.push_back(static_cast<float>(round_trip.count() * 1000.0));
+            tei_metrics().unit_seconds.observe(round_trip.count());
+            tei_metrics().segments_translated.add(static_cast<double>(unit.end - unit.begin - result.failed.size()));
+            segments_done += unit.end - unit.begin;
+            contributors.insert(worker.name);
+            if (progress_callback) {
+                progress_callback(segments_done, segments.size());
+            }
+            return true;
+        }
+        if (type == WorkMessage::Failed) {
+            std::uint64_t unit_id = 0;
+            std::string unit_error;
+            if (!decode_failed(payload, unit_id, unit_error) || unit_id != worker.unit_id) {
+                drop_worker(w, "malformed failure report");
+                return false;
+            }
+            worker.busy = false;
+            if (unit_error == kWorkerDrainingError) {
+                std::cout << "[coord] worker " << worker.name << " drained; reassigning its unit\n";
+                pending.push_front(local_unit(unit_id));
+                worker.socket.close();
+                return false;
+            }
+            std::cerr << "[coord] worker " << worker.name << " failed a unit: " << unit_error << "\n";
+            requeue(local_unit(unit_id), worker.name + ": " + unit_error);
+            return true;
+        }
+        drop_worker(w, "unexpected message");
+        return false;
+    };
+
+    const auto started = std::chrono::steady_clock::now();
+    bool announced_wait = false;
+    std::vector<pollfd> fds;
+    while (units_done < units.size() && fatal.empty()) {
+        // A drain stops handing out units and waits for the ones workers hold; an abort gives up at once.
+        if (run_control().aborting()) {
+            error = "run aborted";
+            return false;
+        }
+        const bool stopping = run_control().stopping();
+        if (stopping && std::ranges::none_of(workers_, [](const Worker& worker) { return worker.busy; })) {
+            break;
+        }
+        // Hand a unit to every idle worker.
+        for (std::size_t w = 0; w < workers_.size() && !pending.empty() && !stopping; ++w) {
+            auto& worker = workers_[w];
+            if (!worker.ready || worker.busy || !worker.socket.is_open()) {
+                continue;
+            }
+            const std::size_t u = pending.front();
+            pending.pop_front();
+            const auto& unit = units[u];
+            std::string send_error;
+            const std::span<const Segment> unit_segments(segments.data() + unit.begin, unit.end - unit.begin);
+            worker.busy = true;
+            worker.unit_id = first_id + u;
+            worker.deadline = std::chrono::steady_clock::now() + options_.unit_timeout;
+            if (!worker.socket.send_frame(make_unit_frame(worker.unit_id, unit_segments), send_error)) {
+                drop_worker(w, send_error);
+            }
+        }
+        std::erase_if(workers_, [](const Worker& worker) { return !worker.socket.is_open(); });
+
+        const bool any_ready = std::ranges::any_of(workers_, [](const Worker& worker) { return worker.ready; });
+        if (!any_ready && !announced_wait) {
+            std::cout << "[coord] waiting for workers on " << endpoint_name_ << "\n";
+            announced_wait = true;
+        }
+
+        auto wait = std::chrono::milliseconds(1000);
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& worker : workers_) {
+            if (worker.busy) {
+                wait = std::min(wait, std::max(std::chrono::milliseconds(0),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(worker.deadline - now)));
+            }
+        }
+
+        fds.clear();
+        fds.push_back(pollfd{.fd = listener_.fd(), .events = POLLIN, .revents = 0});
+        for (const auto& worker : workers_) {
+            fds.push_back(pollfd{.fd = worker.socket.fd(), .events = POLLIN, .revents = 0});
+        }
+        if (::poll(fds.data(), fds.size(), static_cast<int>(wait.count())) < 0 && errno != EINTR) {
+            error = "poll failed";
+            return false;
+        }
+
+        // Workers accepted below are only polled from the next round on.
+        const std::size_t polled_workers = workers_.size();
+        for (std::size_t w = 0; w < polled_workers; ++w) {
+            if ((fds[w + 1].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+                continue;
+            }
+            auto& worker = workers_[w];
+            std::string read_error;
+            if (!worker.socket.read_some(worker.buffer, read_error)) {
+                drop_worker(w, read_error);
+                continue;
+            }
+            std::string payload;
+            std::string frame_error;
+            while (workers_[w].socket.is_open() && take_work_frame(workers_[w].buffer, payload, frame_error)) {
+                handle_frame(w, payload);
+            }
+            if (!frame_error.empty()) {
+                drop_worker(w, frame_error);
+            }
+        }
+        if ((fds[0].revents & POLLIN) != 0) {
+            accept_worker();
+        }
+
+        const auto checked = std::chrono::steady_clock::now();
+        for (std::size_t w = 0; w < workers_.size(); ++w) {
+            if (workers_[w].socket.is_open() && workers_[w].busy && checked >= workers_[w].deadline) {
+                drop_worker(w, "unit timed out");
+            }
+        }
+        std::erase_if(workers_, [](const Worker& worker) { return !worker.socket.is_open(); });
+    }
+
+    if (!fatal.empty()) {
+        error = fatal;
+        return false;
+    }
+
+    for (const auto& unit : units) {
+        if (!unit.done) {
+            for (std::size_t i = unit.begin; i < unit.end; ++i) {
+                out_stats.failed_segments.push_back(
+                    FailedSegment{i, std::string(segments[i].id), "cancelled before translation"}
+                );
+            }
+        }
+    }
+    std::ranges::sort(out_stats.failed_segments, {}, &FailedSegment::index);
+    out_stats.workers_used = contributors.size();
+    out_stats.wall_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    const double wall_seconds = static_cast<double>(out_stats.wall_time.count()) / 1000.0;
+    if (wall_seconds > 0.0) {
+        out_stats.segments_per_second = static_cast<double>(segments.size()) / wall_seconds;
+    }
+    out_stats.ms_per_segment =
+        static_cast<double>(out_stats.wall_time.count()) / static_cast<double>(segments.size());
+    return true;
+}
+
+#endif
+
+bool run_work_worker(
+    const std::string& endpoint,
+    const std::string& worker_name,
+    std::chrono::seconds connect_wait,
+    const WorkUnitTranslateFn& translate,
+    std::string& error
+) {
+    WorkEndpoint parsed;
+    if (!parse_work_endpoint(endpoint, parsed, error)) {
+        return false;
+    }
+
+    // The coordinator may still be parsing its input; keep trying for a while.
+    WorkSocket socket;
+    const auto give_up = std::chrono::steady_clock::now() + connect_wait;
+    while (!socket.connect(parsed, error)) {
+        if (std::chrono::steady_clock::now() >= give_up) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    if (!socket.send_frame(make_hello_frame(worker_name), error)) {
+        return false;
+    }
+    std::cout << "[worker] connected to " << work_endpoint_name(parsed) << " as " << worker_name << "\n";
+
+    std::size_t units = 0;
+    std::size_t segments_total = 0;
+    std::string payload;
+    WorkUnitMessage unit;
+    std::vector<Segment> segments;
+    WorkResultMessage result;
+    std::vector<FailedSegment> failed_segments;
+    for (;;) {
+        std::string recv_error;
+        if (!socket.recv_frame(payload, recv_error)) {
+            // The coordinator going away without Shutdown ends the worker too; the unit it held is reassigned.
+            std::cout << "[worker] coordinator disconnected (" << recv_error << ") after units=" << units << "\n";
+            return true;
+        }
+        WorkMessage type{};
+        if (!decode_work_type(payload, type)) {
+            error = "Unknown message from coordinator";
+            return false;
+        }
+        if (type == WorkMessage::Shutdown) {
+            std::cout << "[worker] shutdown after units=" << units << " segments=" << segments_total << "\n";
+            return true;
+        }
+        if (type != WorkMessage::Unit || !decode_unit(payload, unit)) {
+            error = "Malformed unit from coordinator";
+            return false;
+        }
+        // Drained while idle: hand the unit straight back for another worker.
+        if (run_control().stopping()) {
+            std::cout << "[worker] drained after units=" << units << " segments=" << segments_total << "\n";
+            return socket.send_frame(make_failed_frame(unit.unit_id, kWorkerDrainingError), error);
+        }
+
+        // Segments view the decoded unit's strings.
+        segments.assign(unit.segments.size(), Segment{});
+        for (std::size_t i = 0; i < unit.segments.size(); ++i) {
+            segments[i].index = i;
+            segments[i].id = unit.segments[i].id;
+            segments[i].source_zh = unit.segments[i].source;
+            segments[i].max_output_tokens = unit.segments[i].max_output_tokens;
+        }
+
+        const auto started = std::chrono::steady_clock::now();
+        std::string unit_error;
+        std::string frame;
+        result.unit_id = unit.unit_id;
+        failed_segments.clear();
+        const bool translated = translate(segments, result.translations, failed_segments, unit_error)
+            && result.translations.size() == segments.size();
+        // A drain mid-unit leaves its unstarted segments cancelled; return the whole unit so another worker
+        // translates them instead of the coordinator listing them as failed.
+        if (translated && run_control().stopping() && !failed_segments.empty()) {
+            frame = make_failed_frame(unit.unit_id, kWorkerDrainingError);
+        } else if (translated) {
+            result.failed.clear();
+            for (auto& failed : failed_segments) {
+                result.failed.push_back(
+                    WorkFailedSegment{static_cast<std::uint32_t>(failed.index), std::move(failed.error)}
+                );
+            }
+            result.wall_ms = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started
+            ).count());
+            frame = make_result_frame(result);
+            ++units;
+            segments_total += segments.size();
+        } else {
+            frame = make_failed_frame(unit.unit_id, unit_error.empty() ? "translation failed" : unit_error);
+        }
+        if (!socket.send_frame(frame, error)) {
+            return false;
+        }
+        if (run_control().stopping()) {
+            std::cout << "[worker] drained after units=" << units << " segments=" << segments_total << "\n";
+            return true;
+        }
+    }
+}
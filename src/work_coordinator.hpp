@@ -0,0 +1,80 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "work_protocol.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct WorkCoordinatorOptions {
+    /// Segments per work unit sent to one worker.
+    std::size_t unit_segments = 32;
+    /// A worker that has not answered a unit by then is presumed hung: it is disconnected and the unit reassigned.
+    std::chrono::seconds unit_timeout{900};
+    /// A unit that failed, timed out or took its worker down this many times fails the document.
+    int max_attempts = 3;
+};
+
+/// Coordinator side of `--coordinator`: owns the parsed documents and hands their segments out in units to any
+/// number of `--worker` processes, which may connect and disconnect at any time. Single-threaded; all socket work
+/// happens inside translate().
+class WorkCoordinator {
+public:
+    bool listen(const std::string& endpoint, const WorkCoordinatorOptions& options, std::string& error);
+
+    /// Same contract as translate_segments_parallel: blocks until every unit is answered by some worker.
+    /// A unit lost with its worker (disconnect, timeout) is requeued for another one; segments a worker could not
+    /// translate after its retries come back in `out_stats.failed_segments`.
+    bool translate(
+        const std::vector<Segment>& segments,
+        std::vector<std::string>& out_translations,
+        TranslationStats& out_stats,
+        std::string& error,
+        const std::function<void(std::size_t, std::size_t)>& progress_callback = {},
+        const SegmentDoneCallback& segment_done = {}
+    );
+
+    /// Tell connected workers to exit and stop listening.
+    void shutdown();
+
+    const std::string& endpoint_name() const { return endpoint_name_; }
+
+private:
+    struct Worker {
+        WorkSocket socket;
+        std::string buffer;
+        std::string name;
+        bool ready = false;
+        bool busy = false;
+        std::uint64_t unit_id = 0;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void accept_worker();
+
+    WorkCoordinatorOptions options_;
+    std::string endpoint_name_;
+    WorkSocket listener_;
+    std::vector<Worker> workers_;
+    std::uint64_t next_unit_id_ = 1;
+};
+
+/// Translate the segments of one received unit; `translations` is parallel to `segments`. Segments left
+/// untranslated go to `failed` (indices into `segments`) and are reported back with the result.
+using WorkUnitTranslateFn = std::function<
+    bool(const std::vector<Segment>&, std::vector<std::string>&, std::vector<FailedSegment>&, std::string&)>;
+
+/// Worker side of `--worker`: connect (retrying for up to `connect_wait`), then translate units until the
+/// coordinator sends Shutdown or closes the connection, or a drain (see run_control.hpp) ends the current unit. A
+/// unit the drain cut short, or one received after it, is handed back as failed so the coordinator requeues it.
+bool run_work_worker(
+    const std::string& endpoint,
+    const std::string& worker_name,
+    std::chrono::seconds connect_wait,
+    const WorkUnitTranslateFn& translate,
+    std::string& error
+);
@@ -0,0 +1,516 @@
+#include "work_protocol.hpp"
+
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void put_u32(std::string& out, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+}
+
+void put_u64(std::string& out, std::uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+}
+
+void put_str(std::string& out, std::string_view s) {
+    put_u32(out, static_cast<std::uint32_t>(s.size()));
+    out.append(s);
+}
+
+/// Start a frame: size placeholder + type byte. finish_frame() fills in the size.
+std::string begin_frame(WorkMessage type) {
+    std::string out(4, '\0');
+    out.push_back(static_cast<char>(type));
+    return out;
+}
+
+std::string finish_frame(std::string frame) {
+    const auto size = static_cast<std::uint32_t>(frame.size() - 4);
+    for (int i = 0; i < 4; ++i) {
+        frame[static_cast<std::size_t>(i)] = static_cast<char>((size >> (8 * i)) & 0xFF);
+    }
+    return frame;
+}
+
+/// Bounds-checked little-endian reader over one payload (past the type byte).
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view payload) : data_(payload.substr(payload.empty() ? 0 : 1)) {}
+
+    bool u32(std::uint32_t& v) {
+        if (data_.size() - pos_ < 4) {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= static_cast<std::uint32_t>(static_cast<unsigned char>(data_[pos_ + static_cast<std::size_t>(i)])) << (8 * i);
+        }
+        pos_ += 4;
+        return true;
+    }
+
+    bool u64(std::uint64_t& v) {
+        if (data_.size() - pos_ < 8) {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v |= static_cast<std::uint64_t>(static_cast<unsigned char>(data_[pos_ + static_cast<std::size_t>(i)])) << (8 * i);
+        }
+        pos_ += 8;
+        return true;
+    }
+
+    bool str(std::string& s) {
+        std::uint32_t size = 0;
+        if (!u32(size) || data_.size() - pos_ < size) {
+            return false;
+        }
+        s.assign(data_.substr(pos_, size));
+        pos_ += size;
+        return true;
+    }
+
+    bool at_end() const { return pos_ == data_.size(); }
+
+private:
+    std::string_view data_;
+    std::size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::string make_hello_frame(std::string_view worker_name) {
+    auto frame = begin_frame(WorkMessage::Hello);
+    put_u32(frame, kWorkProtocolVersion);
+    put_str(frame, worker_name);
+    return finish_frame(std::move(frame));
+}
+
+std::string make_unit_frame(std::uint64_t unit_id, std::span<const Segment> segments) {
+    auto frame = begin_frame(WorkMessage::Unit);
+    put_u64(frame, unit_id);
+    put_u32(frame, static_cast<std::uint32_t>(segments.size()));
+    for (const auto& segment : segments) {
+        put_str(frame, segment.id);
+        put_str(frame, segment.source_zh);
+        put_u32(frame, static_cast<std::uint32_t>(segment.max_output_tokens));
+    }
+    return finish_frame(std::move(frame));
+}
+
+std::string make_result_frame(const WorkResultMessage& result) {
+    auto frame = begin_frame(WorkMessage::Result);
+    put_u64(frame, result.unit_id);
+    put_u64(frame, result.wall_ms);
+    put_u32(frame, static_cast<std::uint32_t>(result.translations.size()));
+    for (const auto& translation : result.translations) {
+        put_str(frame, translation);
+    }
+    put_u32(frame, static_cast<std::uint32_t>(result.failed.size()));
+    for (const auto& failed : result.failed) {
+        put_u32(frame, failed.position);
+        put_str(frame, failed.error);
+    }
+    return finish_frame(std::move(frame));
+}
+
+std::string make_failed_frame(std::uint64_t unit_id, std::string_view error) {
+    auto frame = begin_frame(WorkMessage::Failed);
+    put_u64(frame, unit_id);
+    put_str(frame, error);
+    return finish_frame(std::move(frame));
+}
+
+std::string make_shutdown_frame() {
+    return finish_frame(begin_frame(WorkMessage::Shutdown));
+}
+
+bool take_work_frame(std::string& buffer, std::string& payload, std::string& error) {
+    if (buffer.size() < 4) {
+        return false;
+    }
+    std::uint32_t size = 0;
+    for (int i = 0; i < 4; ++i) {
+        size |= static_cast<std::uint32_t>(static_cast<unsigned char>(buffer[static_cast<std::size_t>(i)])) << (8 * i);
+    }
+    if (size == 0 || size > kMaxWorkFrameBytes) {
+        error = "invalid frame size " + std::to_string(size);
+        return false;
+    }
+    if (buffer.size() - 4 < size) {
+        return false;
+    }
+    payload.assign(buffer, 4, size);
+    buffer.erase(0, 4 + static_cast<std::size_t>(size));
+    return true;
+}
+
+bool decode_work_type(std::string_view payload, WorkMessage& type) {
+    if (payload.empty()) {
+        return false;
+    }
+    const auto raw = static_cast<std::uint8_t>(payload.front());
+    if (raw < static_cast<std::uint8_t>(WorkMessage::Hello) || raw > static_cast<std::uint8_t>(WorkMessage::Shutdown)) {
+        return false;
+    }
+    type = static_cast<WorkMessage>(raw);
+    return true;
+}
+
+bool decode_hello(std::string_view payload, std::uint32_t& version, std::string& worker_name) {
+    PayloadReader in(payload);
+    return in.u32(version) && in.str(worker_name) && in.at_end();
+}
+
+bool decode_unit(std::string_view payload, WorkUnitMessage& out) {
+    PayloadReader in(payload);
+    std::uint32_t count = 0;
+    if (!in.u64(out.unit_id) || !in.u32(count)) {
+        return false;
+    }
+    out.segments.clear();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        WorkSegment segment;
+        std::uint32_t max_tokens = 0;
+        if (!in.str(segment.id) || !in.str(segment.source) || !in.u32(max_tokens)) {
+            return false;
+        }
+        segment.max_output_tokens = static_cast<std::int32_t>(max_tokens);
+        out.segments.push_back(std::move(segment));
+    }
+    return in.at_end();
+}
+
+bool decode_result(std::string_view payload, WorkResultMessage& out) {
+    PayloadReader in(payload);
+    std::uint32_t count = 0;
+    if (!in.u64(out.unit_id) || !in.u64(out.wall_ms) || !in.u32(count)) {
+        return false;
+    }
+    out.translations.clear();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        std::string translation;
+        if (!in.str(translation)) {
+            return false;
+        }
+        out.translations.push_back(std::move(translation));
+    }
+    std::uint32_t failed_count = 0;
+    if (!in.u32(failed_count)) {
+        return false;
+    }
+    out.failed.clear();
+    for (std::uint32_t i = 0; i < failed_count; ++i) {
+        WorkFailedSegment failed;
+        if (!in.u32(failed.position) || !in.str(failed.error) || failed.position >= count) {
+            return false;
+        }
+        out.failed.push_back(std::move(failed));
+    }
+    return in.at_end();
+}
+
+bool decode_failed(std::string_view payload, std::uint64_t& unit_id, std::string& error) {
+    PayloadReader in(payload);
+    return in.u64(unit_id) && in.str(error) && in.at_end();
+}
+
+bool parse_work_endpoint(const std::string& text, WorkEndpoint& out, std::string& error) {
+    out = WorkEndpoint{};
+    if (text.starts_with("unix:")) {
+        out.is_unix = true;
+        out.path = text.substr(5);
+        if (out.path.empty()) {
+            error = "Empty Unix socket path in endpoint: " + text;
+            return false;
+        }
+        return true;
+    }
+
+    const std::string rest = text.starts_with("tcp:") ? text.substr(4) : text;
+    const auto colon = rest.rfind(':');
+    if (colon == std::string::npos || colon + 1 == rest.size()) {
+        error = "Invalid endpoint (expected unix:/path, tcp:host:port or host:port): " + text;
+        return false;
+    }
+    out.host = rest.substr(0, colon);
+    out.port = rest.substr(colon + 1);
+    if (out.host.size() >= 2 && out.host.front() == '[' && out.host.back() == ']') {
+        out.host = out.host.substr(1, out.host.size() - 2);
+    }
+    return true;
+}
+
+std::string work_endpoint_name(const WorkEndpoint& endpoint) {
+    return endpoint.is_unix ? "unix:" + endpoint.path : "tcp:" + endpoint.host + ":" + endpoint.port;
+}
+
+WorkSocket::~WorkSocket() {
+    close();
+}
+
+WorkSocket::WorkSocket(WorkSocket&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      unlink_path_(std::move(other.unlink_path_)),
+      pending_(std::move(other.pending_)) {
+    other.unlink_path_.clear();
+}
+
+WorkSocket& WorkSocket::operator=(WorkSocket&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd_ = std::exchange(other.fd_, -1);
+        unlink_path_ = std::move(other.unlink_path_);
+        other.unlink_path_.clear();
+        pending_ = std::move(other.pending_);
+    }
+    return *this;
+}
+
+bool WorkSocket::recv_frame(std::string& payload, std::string& error) {
+    std::string frame_error;
+    while (!take_work_frame(pending_, payload, frame_error)) {
+        if (!frame_error.empty()) {
+            error = frame_error;
+            return false;
+        }
+        if (!read_some(pending_, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool WorkSocket::listen(const WorkEndpoint&, std::string& error) {
+    error = "--coordinator/--worker are not supported in Windows builds";
+    return false;
+}
+
+bool WorkSocket::connect(const WorkEndpoint&, std::string& error) {
+    error = "--coordinator/--worker are not supported in Windows builds";
+    return false;
+}
+
+bool WorkSocket::accept(WorkSocket&, std::string& error) {
+    error = "--coordinator/--worker are not supported in Windows builds";
+    return false;
+}
+
+bool WorkSocket::send_frame(std::string_view, std::string& error) {
+    error = "--coordinator/--worker are not supported in Windows builds";
+    return false;
+}
+
+bool WorkSocket::read_some(std::string&, std::string& error) {
+    error = "--coordinator/--worker are not supported in Windows builds";
+    return false;
+}
+
+void WorkSocket::close() {
+    fd_ = -1;
+}
+
+#else
+
+namespace {
+
+std::string errno_text(const char* what) {
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+bool fill_unix_address(const std::string& path, sockaddr_un& addr, std::string& error) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "Unix socket path too long: " + path;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/// getaddrinfo for a TCP endpoint; `passive` for bind (empty/`*` host = all interfaces).
+addrinfo* resolve_tcp(const WorkEndpoint& endpoint, bool passive, std::string& error) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    const bool any_host = endpoint.host.empty() || endpoint.host == "*";
+    addrinfo* result = nullptr;
+    const int rc = ::getaddrinfo(any_host ? nullptr : endpoint.host.c_str(), endpoint.port.c_str(), &hints, &result);
+    if (rc != 0) {
+        error = "Cannot resolve " + work_endpoint_name(endpoint) + ": " + ::gai_strerror(rc);
+        return nullptr;
+    }
+    return result;
+}
+
+}  // namespace
+
+bool WorkSocket::listen(const WorkEndpoint& endpoint, std::string& error) {
+    close();
+    if (endpoint.is_unix) {
+        sockaddr_un addr{};
+        if (!fill_unix_address(endpoint.path, addr, error)) {
+            return false;
+        }
+        // Replace a socket file left by a previous coordinator, but never an ordinary file.
+        struct stat st{};
+        if (::stat(endpoint.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            ::unlink(endpoint.path.c_str());
+        }
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) {
+            error = errno_text("socket");
+            return false;
+        }
+        if (::bind(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = errno_text(("bind " + endpoint.path).c_str());
+            close();
+            return false;
+        }
+        unlink_path_ = endpoint.path;
+    } else {
+        addrinfo* addrs = resolve_tcp(endpoint, true, error);
+        if (addrs == nullptr) {
+            return false;
+        }
+        for (addrinfo* ai = addrs; ai != nullptr; ai = ai->ai_next) {
+            fd_ = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd_ < 0) {
+                continue;
+            }
+            const int one = 1;
+            ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (::bind(fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            error = errno_text(("bind " + work_endpoint_name(endpoint)).c_str());
+            close();
+        }
+        ::freeaddrinfo(addrs);
+        if (fd_ < 0) {
+            return false;
+        }
+    }
+    if (::listen(fd_, 64) != 0) {
+        error = errno_text("listen");
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool WorkSocket::connect(const WorkEndpoint& endpoint, std::string& error) {
+    close();
+    if (endpoint.is_unix) {
+        sockaddr_un addr{};
+        if (!fill_unix_address(endpoint.path, addr, error)) {
+            return false;
+        }
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0 || ::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = errno_text(("connect " + endpoint.path).c_str());
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    addrinfo* addrs = resolve_tcp(endpoint, false, error);
+    if (addrs == nullptr) {
+        return false;
+    }
+    for (addrinfo* ai = addrs; ai != nullptr; ai = ai->ai_next) {
+        fd_ = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd_ < 0) {
+            continue;
+        }
+        if (::connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+            const int one = 1;
+            ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        error = errno_text(("connect " + work_endpoint_name(endpoint)).c_str());
+        close();
+    }
+    ::freeaddrinfo(addrs);
+    return fd_ >= 0;
+}
+
+bool WorkSocket::accept(WorkSocket& out, std::string& error) {
+    const int fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        error = errno_text("accept");
+        return false;
+    }
+    out = WorkSocket(fd);
+    return true;
+}
+
+bool WorkSocket::send_frame(std::string_view frame, std::string& error) {
+    while (!frame.empty()) {
+        // MSG_NOSIGNAL: a dead peer is an error return, not SIGPIPE.
+        const ssize_t sent = ::send(fd_, frame.data(), frame.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno_text("send");
+            return false;
+        }
+        frame.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+}
+
+bool WorkSocket::read_some(std::string& buffer, std::string& error) {
+    char chunk[64 * 1024];
+    for (;;) {
+        const ssize_t got = ::recv(fd_, chunk, sizeof(chunk), 0);
+        if (got > 0) {
+            buffer.append(chunk, static_cast<std::size_t>(got));
+            return true;
+        }
+        if (got == 0) {
+            error = "connection closed";
+            return false;
+        }
+        if (errno != EINTR) {
+            error = errno_text("recv");
+            return false;
+        }
+    }
+}
+
+void WorkSocket::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (!unlink_path_.empty()) {
+        ::unlink(unlink_path_.c_str());
+        unlink_path_.clear();
+    }
+}
+
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "segment.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Coordinator/worker wire protocol (`--coordinator` / `--worker`). Every message is one frame: a little-endian
+/// u32 payload size, then the payload, whose first byte is the WorkMessage type. Integers are little-endian,
+/// strings are a u32 size followed by the bytes.
+///
+///   Hello    worker -> coordinator  u32 version, str worker name
+///   Unit     coordinator -> worker  u64 unit id, u32 count, count x (str id, str source, i32 max_output_tokens)
+///   Result   worker -> coordinator  u64 unit id, u64 wall ms, u32 count, count x str translation,
+///                                   u32 failed, failed x (u32 position in unit, str error)
+///   Failed   worker -> coordinator  u64 unit id, str error
+///   Shutdown coordinator -> worker  (empty)
+
+inline constexpr std::uint32_t kWorkProtocolVersion = 2;
+/// Frames above this are rejected as corrupt rather than allocated.
+inline constexpr std::uint32_t kMaxWorkFrameBytes = 64u << 20;
+/// Failed-frame error of a worker leaving on a drain: its unit is requeued without using up an attempt.
+inline constexpr std::string_view kWorkerDrainingError = "worker draining";
+
+enum class WorkMessage : std::uint8_t {
+    Hello = 1,
+    Unit = 2,
+    Result = 3,
+    Failed = 4,
+    Shutdown = 5,
+};
+
+struct WorkSegment {
+    std::string id;
+    std::string source;
+    std::int32_t max_output_tokens = 0;
+};
+
+struct WorkUnitMessage {
+    std::uint64_t unit_id = 0;
+    std::vector<WorkSegment> segments;
+};
+
+/// A segment of a unit the worker could not translate even after retries (its translation is empty).
+struct WorkFailedSegment {
+    std::uint32_t position = 0;
+    std::string error;
+};
+
+struct WorkResultMessage {
+    std::uint64_t unit_id = 0;
+    std::uint64_t wall_ms = 0;
+    std::vector<std::string> translations;
+    std::vector<WorkFailedSegment> failed;
+};
+
+std::string make_hello_frame(std::string_view worker_name);
+std::string make_unit_frame(std::uint64_t unit_id, std::span<const Segment> segments);
+std::string make_result_frame(const WorkResultMessage& result);
+std::string make_failed_frame(std::uint64_t unit_id, std::string_view error);
+std::string make_shutdown_frame();
+
+/// Move one complete frame's payload out of the front of `buffer`. False when more bytes are needed; `error` is
+/// set (and false returned) for an oversized frame.
+bool take_work_frame(std::string& buffer, std::string& payload, std::string& error);
+
+bool decode_work_type(std::string_view payload, WorkMessage& type);
+bool decode_hello(std::string_view payload, std::uint32_t& version, std::string& worker_name);
+bool decode_unit(std::string_view payload, WorkUnitMessage& out);
+bool decode_result(std::string_view payload, WorkResultMessage& out);
+bool decode_failed(std::string_view payload, std::uint64_t& unit_id, std::string& error);
+
+/// `unix:/path/to.sock`, `tcp:host:port` or `host:port`.
+struct WorkEndpoint {
+    bool is_unix = false;
+    std::string host;
+    std::string port;
+    std::string path;
+};
+
+bool parse_work_endpoint(const std::string& text, WorkEndpoint& out, std::string& error);
+std::string work_endpoint_name(const WorkEndpoint& endpoint);
+
+/// Owning stream socket. Writes are blocking; the coordinator polls fd() before reading.
+class WorkSocket {
+public:
+    WorkSocket() = default;
+    explicit WorkSocket(int fd) : fd_(fd) {}
+    ~WorkSocket();
+    WorkSocket(WorkSocket&& other) noexcept;
+    WorkSocket& operator=(WorkSocket&& other) noexcept;
+    WorkSocket(const WorkSocket&) = delete;
+    WorkSocket& operator=(const WorkSocket&) = delete;
+
+    /// Bind and listen (a stale Unix socket file is replaced).
+    bool listen(const WorkEndpoint& endpoint, std::string& error);
+    bool connect(const WorkEndpoint& endpoint, std::string& error);
+    /// Accept one pending connection (call when fd() is readable).
+    bool accept(WorkSocket& out, std::string& error);
+
+    bool send_frame(std::string_view frame, std::string& error);
+    /// Append whatever is available (one recv); false on EOF or error.
+    bool read_some(std::string& buffer, std::string& error);
+    /// Block until one frame arrives; false on EOF or error.
+    bool recv_frame(std::string& payload, std::string& error);
+
+    int fd() const { return fd_; }
+    bool is_open() const { return fd_ >= 0; }
+    void close();
+
+private:
+    int fd_ = -1;
+    std::string unlink_path_;
+    std::string pending_;
+};
@@ -1,5 +1,7 @@
 #include "writer_md.hpp"
 
+#include "trace.hpp"
+
 #include <fstream>
 
 bool write_markdown_output(
@@ -8,6 +10,7 @@ bool write_markdown_output(
     const std::vector<std::string>& translations,
     std::string& error
 ) {
+    TEI_MT_TRACE_SCOPE("write_markdown");
     if (translations.size() != doc.segments.size()) {
         error = "Translation count does not match segment count for markdown writer";
         return false;
@@ -20,16 +23,24 @@ bool write_markdown_output(
     }
 
     out << "# " << doc.source_path.filename().string() << "\n\n";
+    write_markdown_segments(out, doc.segments, translations, 1);
+
+    return true;
+}
 
-    for (std::size_t i = 0; i < doc.segments.size(); ++i) {
-        const auto& seg = doc.segments[i];
+void write_markdown_segments(
+    std::ostream& out,
+    const std::vector<Segment>& segments,
+    const std::vector<std::string>& translations,
+    std::size_t first_number
+) {
+    for (std::size_t i = 0; i < segments.size() && i < translations.size(); ++i) {
+        const auto& seg = segments[i];
         const auto& translated = translations[i];
 
-        out << "## Segment " << (i + 1) << " (" << seg.id << ")\n";
+        out << "## Segment " << (first_number + i) << " (" << seg.id << ")\n";
         out << "**Original (lzh):** " << seg.source_zh << "\n\n";
         out << "**English:** " << translated << "\n\n";
         out << "---\n\n";
     }
-
-    return true;
 }
@@ -2,7 +2,9 @@
 
 #include "tei_reader.hpp"
 
+#include <cstddef>
 #include <filesystem>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -12,3 +14,11 @@ bool write_markdown_output(
     const std::vector<std::string>& translations,
     std::string& error
 );
+
+/// Segment sections only; `first_number` is the 1-based number of `segments[0]` (streaming windows).
+void write_markdown_segments(
+    std::ostream& out,
+    const std::vector<Segment>& segments,
+    const std::vector<std::string>& translations,
+    std::size_t first_number
+);
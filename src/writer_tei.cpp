@@ -1,9 +1,21 @@
 #include "writer_tei.hpp"
 
+#include "atomic_file.hpp"
+#include "trace.hpp"
+
 #include <filesystem>
 
 namespace {
 
+/// Collects pugixml's serialized output so the file can be written in one atomic step.
+struct StringXmlWriter final : pugi::xml_writer {
+    std::string bytes;
+
+    void write(const void* data, std::size_t size) override {
+        bytes.append(static_cast<const char*>(data), size);
+    }
+};
+
 std::string local_name(const char* raw_name) {
     if (raw_name == nullptr) {
         return {};
@@ -16,15 +28,6 @@ std::string local_name(const char* raw_name) {
     return name.substr(pos + 1);
 }
 
-std::string prefixed_note_name(const pugi::xml_node& node) {
-    const std::string node_name = node.name();
-    const auto colon = node_name.find(':');
-    if (colon == std::string::npos) {
-        return "note";
-    }
-    return node_name.substr(0, colon) + ":note";
-}
-
 bool is_translation_note_en(const pugi::xml_node& node) {
     if (!node || node.type() != pugi::node_element) {
         return false;
@@ -53,20 +56,14 @@ void remove_following_translation_notes(pugi::xml_node parent, pugi::xml_node an
     }
 }
 
-}  // namespace
-
-bool write_tei_note_output(
+/// Insert notes into the parsed tree and re-serialize it; used when `doc.note_sites` is unavailable.
+bool write_tei_note_output_dom(
     const std::filesystem::path& out_path,
     TeiDocument& doc,
     const std::vector<std::string>& translations,
     bool overwrite_existing_translations,
     std::string& error
 ) {
-    if (translations.size() != doc.segment_nodes.size()) {
-        error = "Translation count does not match segment node count for TEI writer";
-        return false;
-    }
-
     for (std::size_t i = 0; i < doc.segment_nodes.size(); ++i) {
         auto node = doc.segment_nodes[i];
         auto parent = node.parent();
@@ -86,27 +83,66 @@ bool write_tei_note_output(
             }
         }
 
-        const std::string note_name = prefixed_note_name(node);
+        const std::string note_name = prefixed_note_name(node.name());
         auto note = parent.insert_child_after(note_name.c_str(), node);
         note.append_attribute("type") = "translation";
         note.append_attribute("xml:lang") = "en";
         note.text().set(translations[i].c_str());
     }
 
-    const std::filesystem::path tmp_path = out_path.string() + ".part";
-    if (!doc.xml.save_file(tmp_path.string().c_str(), "  ", pugi::format_default, pugi::encoding_utf8)) {
-        error = "Failed to write translated TEI XML: " + tmp_path.string();
+    StringXmlWriter writer;
+    doc.xml.save(writer, "  ", pugi::format_default, pugi::encoding_utf8);
+    return write_file_atomically(out_path, writer.bytes, error);
+}
+
+}  // namespace
+
+bool existing_translation_note(const TeiDocument& doc, std::size_t index, std::string& out) {
+    if (doc.note_sites.size() == doc.segments.size()) {
+        const auto& site = doc.note_sites[index];
+        if (site.existing_notes.empty()) {
+            return false;
+        }
+        out = existing_translation_text(doc.bytes, site);
+        return true;
+    }
+    if (index >= doc.segment_nodes.size()) {
         return false;
     }
+    pugi::xml_node next = doc.segment_nodes[index].next_sibling();
+    while (next && (next.type() == pugi::node_pcdata || next.type() == pugi::node_cdata)) {
+        next = next.next_sibling();
+    }
+    if (!is_translation_note_en(next)) {
+        return false;
+    }
+    out = next.text().get();
+    return true;
+}
 
-    std::error_code ec;
-    std::filesystem::remove(out_path, ec);
-    ec.clear();
-    std::filesystem::rename(tmp_path, out_path, ec);
-    if (ec) {
-        error = "Failed to finalize TEI output (rename): " + out_path.string() + " (" + ec.message() + ")";
+bool write_tei_note_output(
+    const std::filesystem::path& out_path,
+    TeiDocument& doc,
+    const std::vector<std::string>& translations,
+    bool overwrite_existing_translations,
+    std::string& error
+) {
+    TEI_MT_TRACE_SCOPE("write_tei");
+    if (translations.size() != doc.segments.size()) {
+        error = "Translation count does not match segment count for TEI writer";
         return false;
     }
 
-    return true;
+    if (doc.note_sites.size() != doc.segments.size()) {
+        if (doc.segment_nodes.size() != doc.segments.size()) {
+            error = "TEI writer has neither note offsets nor parsed nodes for " + doc.source_path.string();
+            return false;
+        }
+        return write_tei_note_output_dom(out_path, doc, translations, overwrite_existing_translations, error);
+    }
+
+    TeiSpliceOutput out;
+    return out.open(out_path, error)
+        && out.write(doc.bytes, doc.note_sites, translations, overwrite_existing_translations, error)
+        && out.commit(error);
 }
@@ -2,10 +2,15 @@
 
 #include "tei_reader.hpp"
 
+#include <cstddef>
 #include <filesystem>
 #include <string>
 #include <vector>
 
+/// Translation of segment `index` already in `doc` (a `<note type="translation" xml:lang="en">` directly after
+/// it, as in an output being resumed). Returns false when there is none.
+bool existing_translation_note(const TeiDocument& doc, std::size_t index, std::string& out);
+
 bool write_tei_note_output(
     const std::filesystem::path& out_path,
     TeiDocument& doc,
@@ -0,0 +1,387 @@
+#include "xml_scan.hpp"
+
+#include <cstdint>
+
+namespace {
+
+bool is_xml_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool is_name_start(char c) {
+    const auto u = static_cast<unsigned char>(c);
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || u == '_' || u == ':' || u >= 0x80;
+}
+
+bool ends_name(char c) {
+    return is_xml_space(c) || c == '/' || c == '>';
+}
+
+/// True when `rest` is a strict prefix of `token` (the token may still complete after more input).
+bool is_partial_prefix(std::string_view rest, std::string_view token) {
+    return rest.size() < token.size() && token.starts_with(rest);
+}
+
+/// Find the '>' closing a tag starting at `from`, skipping quoted attribute values.
+std::size_t find_tag_close(std::string_view buf, std::size_t from) {
+    char quote = 0;
+    for (std::size_t i = from; i < buf.size(); ++i) {
+        const char c = buf[i];
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+std::size_t find_declaration_close(std::string_view buf, std::size_t from) {
+    char quote = 0;
+    int bracket_depth = 0;
+    for (std::size_t i = from; i < buf.size(); ++i) {
+        const char c = buf[i];
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '[') {
+            ++bracket_depth;
+        } else if (c == ']') {
+            --bracket_depth;
+        } else if (c == '>' && bracket_depth <= 0) {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+void append_utf8(std::uint32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool decode_char_ref(std::string_view body, std::uint32_t& cp) {
+    // body excludes '&#' and ';'
+    if (body.empty()) {
+        return false;
+    }
+    int base = 10;
+    if (body.front() == 'x' || body.front() == 'X') {
+        base = 16;
+        body.remove_prefix(1);
+        if (body.empty()) {
+            return false;
+        }
+    }
+    std::uint32_t value = 0;
+    for (const char c : body) {
+        std::uint32_t digit = 0;
+        if (c >= '0' && c <= '9') {
+            digit = static_cast<std::uint32_t>(c - '0');
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = static_cast<std::uint32_t>(c - 'a' + 10);
+        } else if (base == 16 && c >= 'A' && c <= 'F') {
+            digit = static_cast<std::uint32_t>(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        value = value * static_cast<std::uint32_t>(base) + digit;
+        if (value > 0x10FFFF) {
+            return false;
+        }
+    }
+    cp = value;
+    return true;
+}
+
+}  // namespace
+
+XmlScanStatus next_xml_markup(std::string_view buf, std::size_t pos, XmlMarkup& out) {
+    const std::size_t lt = buf.find('<', pos);
+    if (lt == std::string_view::npos) {
+        return XmlScanStatus::End;
+    }
+
+    out = XmlMarkup{};
+    out.begin = lt;
+
+    const std::string_view rest = buf.substr(lt);
+    if (rest.size() < 2) {
+        return XmlScanStatus::NeedMore;
+    }
+
+    const char c = rest[1];
+    if (c == '!') {
+        if (is_partial_prefix(rest, "<!--") || is_partial_prefix(rest, "<![CDATA[")) {
+            return XmlScanStatus::NeedMore;
+        }
+        if (rest.starts_with("<!--")) {
+            const auto close = buf.find("-->", lt + 4);
+            if (close == std::string_view::npos) {
+                return XmlScanStatus::NeedMore;
+            }
+            out.end = close + 3;
+            return XmlScanStatus::Found;
+        }
+        if (rest.starts_with("<![CDATA[")) {
+            const auto close = buf.find("]]>", lt + 9);
+            if (close == std::string_view::npos) {
+                return XmlScanStatus::NeedMore;
+            }
+            out.kind = XmlMarkupKind::CData;
+            out.end = close + 3;
+            return XmlScanStatus::Found;
+        }
+        const auto close = find_declaration_close(buf, lt + 2);
+        if (close == std::string_view::npos) {
+            return XmlScanStatus::NeedMore;
+        }
+        out.end = close + 1;
+        return XmlScanStatus::Found;
+    }
+
+    if (c == '?') {
+        const auto close = buf.find("?>", lt + 2);
+        if (close == std::string_view::npos) {
+            return XmlScanStatus::NeedMore;
+        }
+        out.end = close + 2;
+        return XmlScanStatus::Found;
+    }
+
+    const bool is_end = (c == '/');
+    const std::size_t name_begin = lt + (is_end ? 2 : 1);
+    if (name_begin >= buf.size()) {
+        return XmlScanStatus::NeedMore;
+    }
+    if (!is_name_start(buf[name_begin])) {
+        return XmlScanStatus::Error;
+    }
+
+    std::size_t name_end = name_begin;
+    while (name_end < buf.size() && !ends_name(buf[name_end])) {
+        ++name_end;
+    }
+    if (name_end >= buf.size()) {
+        return XmlScanStatus::NeedMore;
+    }
+
+    const auto close = find_tag_close(buf, name_end);
+    if (close == std::string_view::npos) {
+        return XmlScanStatus::NeedMore;
+    }
+
+    out.name = buf.substr(name_begin, name_end - name_begin);
+    out.end = close + 1;
+    if (is_end) {
+        out.kind = XmlMarkupKind::EndTag;
+    } else if (buf[close - 1] == '/') {
+        out.kind = XmlMarkupKind::EmptyTag;
+    } else {
+        out.kind = XmlMarkupKind::StartTag;
+    }
+    return XmlScanStatus::Found;
+}
+
+std::size_t xml_element_end(std::string_view buf, std::size_t from, bool& malformed) {
+    malformed = false;
+    std::size_t depth = 1;
+    XmlMarkup markup;
+    for (;;) {
+        const XmlScanStatus status = next_xml_markup(buf, from, markup);
+        if (status == XmlScanStatus::Error) {
+            malformed = true;
+            return std::string_view::npos;
+        }
+        if (status != XmlScanStatus::Found) {
+            return std::string_view::npos;
+        }
+        from = markup.end;
+        if (markup.kind == XmlMarkupKind::StartTag) {
+            ++depth;
+        } else if (markup.kind == XmlMarkupKind::EndTag && --depth == 0) {
+            return markup.end;
+        }
+    }
+}
+
+std::string_view xml_tag_attribute(std::string_view tag_bytes, std::string_view name, bool& found) {
+    found = false;
+    std::size_t i = 1;
+    while (i < tag_bytes.size() && !ends_name(tag_bytes[i])) {
+        ++i;
+    }
+
+    while (i < tag_bytes.size()) {
+        while (i < tag_bytes.size() && is_xml_space(tag_bytes[i])) {
+            ++i;
+        }
+        if (i >= tag_bytes.size() || tag_bytes[i] == '/' || tag_bytes[i] == '>') {
+            break;
+        }
+
+        const std::size_t attr_begin = i;
+        while (i < tag_bytes.size() && tag_bytes[i] != '=' && !is_xml_space(tag_bytes[i]) && tag_bytes[i] != '>') {
+            ++i;
+        }
+        const std::string_view attr_name = tag_bytes.substr(attr_begin, i - attr_begin);
+
+        while (i < tag_bytes.size() && is_xml_space(tag_bytes[i])) {
+            ++i;
+        }
+        if (i >= tag_bytes.size() || tag_bytes[i] != '=') {
+            break;
+        }
+        ++i;
+        while (i < tag_bytes.size() && is_xml_space(tag_bytes[i])) {
+            ++i;
+        }
+        if (i >= tag_bytes.size() || (tag_bytes[i] != '"' && tag_bytes[i] != '\'')) {
+            break;
+        }
+
+        const char quote = tag_bytes[i++];
+        const std::size_t value_begin = i;
+        while (i < tag_bytes.size() && tag_bytes[i] != quote) {
+            ++i;
+        }
+        const std::string_view value = tag_bytes.substr(value_begin, i - value_begin);
+        ++i;
+
+        if (attr_name == name) {
+            found = true;
+            return value;
+        }
+    }
+
+    return {};
+}
+
+void append_xml_unescaped(std::string_view raw, std::string& out) {
+    std::size_t i = 0;
+    while (i < raw.size()) {
+        const auto amp = raw.find('&', i);
+        if (amp == std::string_view::npos) {
+            out.append(raw.substr(i));
+            return;
+        }
+        out.append(raw.substr(i, amp - i));
+
+        const auto semi = raw.find(';', amp + 1);
+        if (semi == std::string_view::npos || semi - amp > 12) {
+            out.push_back('&');
+            i = amp + 1;
+            continue;
+        }
+
+        const std::string_view entity = raw.substr(amp + 1, semi - amp - 1);
+        std::uint32_t cp = 0;
+        if (entity == "lt") {
+            out.push_back('<');
+        } else if (entity == "gt") {
+            out.push_back('>');
+        } else if (entity == "amp") {
+            out.push_back('&');
+        } else if (entity == "apos") {
+            out.push_back('\'');
+        } else if (entity == "quot") {
+            out.push_back('"');
+        } else if (entity.starts_with('#') && decode_char_ref(entity.substr(1), cp)) {
+            append_utf8(cp, out);
+        } else {
+            // Unknown entities are kept verbatim, as pugixml does.
+            out.push_back('&');
+            i = amp + 1;
+            continue;
+        }
+        i = semi + 1;
+    }
+}
+
+void append_xml_escaped(std::string_view text, std::string& out) {
+    for (const char c : text) {
+        switch (c) {
+            case '&':
+                out += "&amp;";
+                break;
+            case '<':
+                out += "&lt;";
+                break;
+            case '>':
+                out += "&gt;";
+                break;
+            default:
+                out.push_back(c);
+                break;
+        }
+    }
+}
+
+bool collect_xml_element_spans(std::string_view xml, std::vector<XmlElementSpan>& out, std::string& error) {
+    out.clear();
+
+    std::vector<std::size_t> open;
+    std::vector<std::string_view> open_names;
+    std::size_t pos = 0;
+    XmlMarkup markup;
+
+    for (;;) {
+        const XmlScanStatus status = next_xml_markup(xml, pos, markup);
+        if (status == XmlScanStatus::End) {
+            break;
+        }
+        if (status == XmlScanStatus::NeedMore) {
+            error = "Truncated XML markup at byte " + std::to_string(markup.begin);
+            return false;
+        }
+        if (status == XmlScanStatus::Error) {
+            error = "Malformed XML markup at byte " + std::to_string(markup.begin);
+            return false;
+        }
+        pos = markup.end;
+
+        if (markup.kind == XmlMarkupKind::StartTag) {
+            open.push_back(out.size());
+            open_names.push_back(markup.name);
+            out.push_back(XmlElementSpan{markup.begin, markup.end, 0, 0});
+        } else if (markup.kind == XmlMarkupKind::EmptyTag) {
+            out.push_back(XmlElementSpan{markup.begin, markup.end, markup.end, markup.end});
+        } else if (markup.kind == XmlMarkupKind::EndTag) {
+            if (open.empty() || open_names.back() != markup.name) {
+                error = "Mismatched end tag </" + std::string(markup.name) + "> at byte " + std::to_string(markup.begin);
+                return false;
+            }
+            auto& span = out[open.back()];
+            span.close_begin = markup.begin;
+            span.close_end = markup.end;
+            open.pop_back();
+            open_names.pop_back();
+        }
+    }
+
+    if (!open.empty()) {
+        error = "Unclosed element <" + std::string(open_names.back()) + ">";
+        return false;
+    }
+    return true;
+}
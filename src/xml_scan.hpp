@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Minimal byte-level XML markup scanner. It does not build a tree: callers walk markup tokens in order and
+/// keep whatever state they need, which lets TEI input be processed in bounded windows straight from raw bytes.
+
+enum class XmlMarkupKind {
+    StartTag,
+    EmptyTag,
+    EndTag,
+    CData,
+    Other,  // comment, processing instruction, DOCTYPE
+};
+
+struct XmlMarkup {
+    XmlMarkupKind kind = XmlMarkupKind::Other;
+    /// Offset of '<'.
+    std::size_t begin = 0;
+    /// One past the closing '>'.
+    std::size_t end = 0;
+    /// Qualified element name (empty for CData/Other).
+    std::string_view name;
+};
+
+enum class XmlScanStatus {
+    Found,
+    /// The buffer ends inside a markup token; append more bytes and retry from the same position.
+    NeedMore,
+    /// No further '<' in the buffer (remaining bytes are character data).
+    End,
+    Error,
+};
+
+XmlScanStatus next_xml_markup(std::string_view buf, std::size_t pos, XmlMarkup& out);
+
+/// One past the end tag of the element whose start tag ends at `from`; npos when `buf` ends first or on
+/// malformed markup (`malformed` tells the two apart).
+std::size_t xml_element_end(std::string_view buf, std::size_t from, bool& malformed);
+
+/// Local part of a qualified name (`cb:div` -> `div`).
+constexpr std::string_view xml_local_name(std::string_view qname) {
+    const auto colon = qname.find(':');
+    return colon == std::string_view::npos ? qname : qname.substr(colon + 1);
+}
+
+/// Raw (still escaped) value of attribute `name` inside a start tag's bytes; empty view when absent.
+std::string_view xml_tag_attribute(std::string_view tag_bytes, std::string_view name, bool& found);
+
+/// Append `raw` with the predefined entities and numeric character references decoded (pugixml parse_escapes).
+void append_xml_unescaped(std::string_view raw, std::string& out);
+
+/// Append `text` escaped for use as element content.
+void append_xml_escaped(std::string_view text, std::string& out);
+
+struct XmlElementSpan {
+    std::size_t open_begin = 0;
+    std::size_t open_end = 0;
+    /// Start of the end tag (== open_end for empty-element tags).
+    std::size_t close_begin = 0;
+    /// One past the end tag.
+    std::size_t close_end = 0;
+};
+
+/// Spans of every element in document (pre-)order, i.e. the order pugixml visits element nodes.
+bool collect_xml_element_spans(std::string_view xml, std::vector<XmlElementSpan>& out, std::string& error);